@@ -0,0 +1,157 @@
+// Copyright (c) 2016 BitPay, Inc.
+// Copyright (c) 2020 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef YODA_ADDRESSINDEX_H
+#define YODA_ADDRESSINDEX_H
+
+#include "amount.h"
+#include "script/script.h"
+#include "serialize.h"
+#include "uint256.h"
+
+enum AddressIndexType {
+    ADDRESS_INDEX_NONE = 0,
+    ADDRESS_INDEX_PUBKEYHASH = 1,
+    ADDRESS_INDEX_SCRIPTHASH = 2,
+};
+
+/** Map an output script to the (type, hash) pair it is indexed under; false if it has no single address */
+bool GetAddressIndexHash(const CScript& scriptPubKey, int& nTypeRet, uint160& hashRet);
+
+/**
+ * One balance change of an address: an output paying to it, or an input spending from it.
+ * The height and position come first so a prefix scan returns the history in chain order.
+ */
+struct CAddressIndexKey {
+    unsigned char type;
+    uint160 hashBytes;
+    int blockHeight;
+    unsigned int txindex;
+    uint256 txhash;
+    unsigned int index;
+    bool spending;
+
+    CAddressIndexKey() { SetNull(); }
+
+    CAddressIndexKey(int nType, const uint160& hash, int nHeight, unsigned int nTxIndex, const uint256& txid, unsigned int nIndex, bool fSpending)
+        : type((unsigned char)nType), hashBytes(hash), blockHeight(nHeight), txindex(nTxIndex), txhash(txid), index(nIndex), spending(fSpending) {}
+
+    void SetNull()
+    {
+        type = ADDRESS_INDEX_NONE;
+        hashBytes.SetNull();
+        blockHeight = 0;
+        txindex = 0;
+        txhash.SetNull();
+        index = 0;
+        spending = false;
+    }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(type);
+        READWRITE(hashBytes);
+        READWRITE(BIGENDIAN32(blockHeight));
+        READWRITE(BIGENDIAN32(txindex));
+        READWRITE(txhash);
+        READWRITE(index);
+        READWRITE(spending);
+    }
+};
+
+/** Seek prefix for all CAddressIndexKey entries of an address, optionally from a given height */
+struct CAddressIndexIteratorKey {
+    unsigned char type;
+    uint160 hashBytes;
+    int blockHeight;
+
+    CAddressIndexIteratorKey(int nType, const uint160& hash, int nHeight = 0) : type((unsigned char)nType), hashBytes(hash), blockHeight(nHeight) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(type);
+        READWRITE(hashBytes);
+        READWRITE(BIGENDIAN32(blockHeight));
+    }
+};
+
+/** An unspent output paying to an address */
+struct CAddressUnspentKey {
+    unsigned char type;
+    uint160 hashBytes;
+    uint256 txhash;
+    unsigned int index;
+
+    CAddressUnspentKey() : type(ADDRESS_INDEX_NONE), index(0) {}
+
+    CAddressUnspentKey(int nType, const uint160& hash, const uint256& txid, unsigned int nIndex)
+        : type((unsigned char)nType), hashBytes(hash), txhash(txid), index(nIndex) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(type);
+        READWRITE(hashBytes);
+        READWRITE(txhash);
+        READWRITE(index);
+    }
+};
+
+/** Seek prefix for all CAddressUnspentKey entries of an address */
+struct CAddressUnspentIteratorKey {
+    unsigned char type;
+    uint160 hashBytes;
+
+    CAddressUnspentIteratorKey(int nType, const uint160& hash) : type((unsigned char)nType), hashBytes(hash) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(type);
+        READWRITE(hashBytes);
+    }
+};
+
+struct CAddressUnspentValue {
+    CAmount satoshis;
+    CScript script;
+    int blockHeight;
+
+    CAddressUnspentValue() { SetNull(); }
+
+    CAddressUnspentValue(CAmount nValue, const CScript& scriptPubKey, int nHeight) : satoshis(nValue), script(scriptPubKey), blockHeight(nHeight) {}
+
+    //! A null value in an update batch erases the entry
+    void SetNull()
+    {
+        satoshis = -1;
+        script.clear();
+        blockHeight = 0;
+    }
+
+    bool IsNull() const { return satoshis == -1; }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(satoshis);
+        READWRITE(script);
+        READWRITE(blockHeight);
+    }
+};
+
+#endif // YODA_ADDRESSINDEX_H
@@ -0,0 +1,77 @@
+// Copyright (c) 2015 The Bitcoin Core developers
+// Copyright (c) 2020 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+static double gettimedouble()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+benchmark::BenchRunner::BenchmarkMap& benchmark::BenchRunner::benchmarks()
+{
+    // Constructed on first use, so registration from other translation units does not depend on init order
+    static BenchmarkMap benchmarks_map;
+    return benchmarks_map;
+}
+
+benchmark::BenchRunner::BenchRunner(const std::string& name, benchmark::BenchFunction func)
+{
+    benchmarks().insert(std::make_pair(name, func));
+}
+
+void benchmark::BenchRunner::RunAll(const std::string& strFilter, double elapsedTimeForOne)
+{
+    std::cout << "#Benchmark" << "," << "count" << "," << "min" << "," << "median" << "," << "max" << std::endl;
+
+    for (const auto& bench : benchmarks()) {
+        if (bench.first.find(strFilter) == std::string::npos)
+            continue;
+        State state(bench.first, elapsedTimeForOne);
+        bench.second(state);
+
+        std::vector<double> vSamples = state.GetSamples();
+        if (vSamples.empty()) {
+            std::cout << bench.first << "," << state.GetIterations() << ",,," << std::endl;
+            continue;
+        }
+        std::sort(vSamples.begin(), vSamples.end());
+        std::cout << bench.first << "," << state.GetIterations() << ","
+                  << vSamples.front() << "," << vSamples[vSamples.size() / 2] << "," << vSamples.back() << std::endl;
+    }
+}
+
+bool benchmark::State::KeepRunning()
+{
+    if (count & countMask) {
+        ++count;
+        return true;
+    }
+    double now;
+    if (count == 0) {
+        beginTime = now = gettimedouble();
+    } else {
+        now = gettimedouble();
+        double elapsed = now - lastTime;
+        vSamples.push_back(elapsed / (count - lastCount));
+        if (now - beginTime > maxElapsed)
+            return false;
+
+        // Grow the batches until one takes 1/128th of the budget
+        if (elapsed * 128 < maxElapsed) {
+            countMask = ((countMask + 1) * 2) - 1;
+            // Samples of batches shorter than that are mostly clock overhead
+            vSamples.clear();
+        }
+    }
+    lastTime = now;
+    lastCount = count;
+    ++count;
+    return true;
+}
@@ -0,0 +1,89 @@
+// Copyright (c) 2015 The Bitcoin Core developers
+// Copyright (c) 2020 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef YODA_BENCH_BENCH_H
+#define YODA_BENCH_BENCH_H
+
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/preprocessor/cat.hpp>
+#include <boost/preprocessor/stringize.hpp>
+
+// Simple micro-benchmarking framework; API mostly matches a subset of the Google Benchmark
+// framework (see https://github.com/google/benchmark)
+// Why not use the Google Benchmark framework? Because adding Yet Another Dependency
+// (that uses cmake as its build system and has lots of features we don't need) isn't
+// worth it.
+
+/*
+ * Usage:
+
+static void CODE_TO_TIME(benchmark::State& state)
+{
+    ... do any setup needed...
+    while (state.KeepRunning()) {
+       ... do stuff you want to time...
+    }
+    ... do any cleanup needed...
+}
+
+BENCHMARK(CODE_TO_TIME);
+
+ */
+
+namespace benchmark
+{
+/**
+ * Timing state of one benchmark. Iterations are timed in batches; the batch size
+ * doubles until a batch takes a noticeable part of the time budget, so the clock
+ * is read rarely once the loop body is fast. Every batch gives one sample of the
+ * time per iteration, and min, median and max are taken over the samples.
+ */
+class State
+{
+    std::string name;
+    double maxElapsed;
+    double beginTime;
+    double lastTime;
+    std::vector<double> vSamples;
+    uint64_t count;
+    //! Iteration count at the last clock read
+    uint64_t lastCount;
+    uint64_t countMask;
+
+public:
+    State(const std::string& _name, double _maxElapsed) : name(_name), maxElapsed(_maxElapsed), beginTime(0), lastTime(0), count(0), lastCount(0), countMask(0) {}
+
+    bool KeepRunning();
+
+    //! Per iteration times of the finished batches, in seconds
+    const std::vector<double>& GetSamples() const { return vSamples; }
+    uint64_t GetIterations() const { return count; }
+};
+
+typedef boost::function<void(State&)> BenchFunction;
+
+class BenchRunner
+{
+    typedef std::map<std::string, BenchFunction> BenchmarkMap;
+    static BenchmarkMap& benchmarks();
+
+public:
+    BenchRunner(const std::string& name, BenchFunction func);
+
+    //! Run every benchmark whose name contains strFilter, each for about elapsedTimeForOne seconds
+    static void RunAll(const std::string& strFilter = "", double elapsedTimeForOne = 1.0);
+};
+} // namespace benchmark
+
+// BENCHMARK(foo) expands to:  benchmark::BenchRunner bench_11foo("foo", foo);
+#define BENCHMARK(n) \
+    benchmark::BenchRunner BOOST_PP_CAT(bench_, BOOST_PP_CAT(__LINE__, n))(BOOST_PP_STRINGIZE(n), n);
+
+#endif // YODA_BENCH_BENCH_H
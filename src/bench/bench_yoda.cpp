@@ -0,0 +1,36 @@
+// Copyright (c) 2015 The Bitcoin Core developers
+// Copyright (c) 2020 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "chainparams.h"
+#include "guiinterface.h"
+#include "key.h"
+#include "random.h"
+#include "script/sigcache.h"
+#include "util.h"
+
+CClientUIInterface uiInterface;
+class CWallet;
+CWallet* pwalletMain;
+
+int main(int argc, char** argv)
+{
+    ParseParameters(argc, argv);
+    RandomInit();
+    ECC_Start();
+    ECCVerifyHandle globalVerifyHandle;
+    SetupEnvironment();
+    InitSignatureCache();
+    // Nothing timed should be spent writing log lines
+    fPrintToConsole = false;
+    fPrintToDebugLog = false;
+    SelectParams(CBaseChainParams::MAIN);
+
+    benchmark::BenchRunner::RunAll(GetArg("-filter", ""), GetArg("-time", 1000) / 1000.0);
+
+    ECC_Stop();
+    return 0;
+}
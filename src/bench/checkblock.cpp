@@ -0,0 +1,64 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Copyright (c) 2020 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "data.h"
+
+#include "blocksignature.h"
+#include "main.h"
+#include "streams.h"
+#include "version.h"
+
+#include <assert.h>
+
+// These are the two major time-sinks which happen after we have fully received
+// a block off the wire, but before we can relay the block on to peers using
+// compact block relay.
+
+static void DeserializeBlockTest(benchmark::State& state)
+{
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << BenchPoSBlock(200);
+    const std::string strBlock = stream.str();
+
+    while (state.KeepRunning()) {
+        CDataStream ss(strBlock.data(), strBlock.data() + strBlock.size(), SER_NETWORK, PROTOCOL_VERSION);
+        CBlock block;
+        ss >> block;
+        assert(block.vtx.size() == 202);
+    }
+}
+
+static void DeserializeAndCheckBlockTest(benchmark::State& state)
+{
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << BenchPoSBlock(200);
+    const std::string strBlock = stream.str();
+
+    while (state.KeepRunning()) {
+        CDataStream ss(strBlock.data(), strBlock.data() + strBlock.size(), SER_NETWORK, PROTOCOL_VERSION);
+        CBlock block;
+        ss >> block;
+        CValidationState validationState;
+        bool fValid = CheckBlock(block, validationState) && CheckBlockSignature(block);
+        assert(fValid);
+    }
+}
+
+/** Context free checks of an already decoded block */
+static void CheckBlockTest(benchmark::State& state)
+{
+    const CBlock block = BenchPoSBlock(200);
+    while (state.KeepRunning()) {
+        block.fChecked = false;
+        CValidationState validationState;
+        bool fValid = CheckBlock(block, validationState);
+        assert(fValid);
+    }
+}
+
+BENCHMARK(DeserializeBlockTest);
+BENCHMARK(DeserializeAndCheckBlockTest);
+BENCHMARK(CheckBlockTest);
@@ -0,0 +1,73 @@
+// Copyright (c) 2020 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "data.h"
+
+#include "checkqueue.h"
+#include "hash.h"
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <assert.h>
+
+/** Stands in for a script check: a few microseconds of hashing */
+class CBenchCheck
+{
+private:
+    uint256 hash;
+
+public:
+    CBenchCheck() {}
+    explicit CBenchCheck(const uint256& hashIn) : hash(hashIn) {}
+
+    bool operator()()
+    {
+        for (int i = 0; i < 20; i++)
+            hash = Hash(hash.begin(), hash.end());
+        return true;
+    }
+
+    void swap(CBenchCheck& check) { std::swap(hash, check.hash); }
+};
+
+/** One block worth of checks, 2000 inputs, spread over nThreads threads including the caller */
+static void CheckQueueBlock(benchmark::State& state, int nThreads)
+{
+    CCheckQueue<CBenchCheck> queue(128, nThreads - 1);
+    boost::thread_group threadGroup;
+    for (int i = 0; i < nThreads - 1; i++)
+        threadGroup.create_thread(boost::bind(&CCheckQueue<CBenchCheck>::Thread, &queue));
+
+    std::vector<uint256> vHashes;
+    for (uint32_t i = 0; i < 2000; i++)
+        vHashes.push_back(BenchHash(i));
+
+    while (state.KeepRunning()) {
+        CCheckQueueControl<CBenchCheck> control(&queue);
+        // Added per transaction, the way ConnectBlock does
+        for (size_t i = 0; i < vHashes.size(); i += 2) {
+            std::vector<CBenchCheck> vChecks;
+            vChecks.emplace_back(vHashes[i]);
+            vChecks.emplace_back(vHashes[i + 1]);
+            control.Add(vChecks);
+        }
+        bool fOk = control.Wait();
+        assert(fOk);
+    }
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+}
+
+static void CheckQueueBlock1(benchmark::State& state) { CheckQueueBlock(state, 1); }
+static void CheckQueueBlock2(benchmark::State& state) { CheckQueueBlock(state, 2); }
+static void CheckQueueBlock4(benchmark::State& state) { CheckQueueBlock(state, 4); }
+static void CheckQueueBlock8(benchmark::State& state) { CheckQueueBlock(state, 8); }
+
+BENCHMARK(CheckQueueBlock1);
+BENCHMARK(CheckQueueBlock2);
+BENCHMARK(CheckQueueBlock4);
+BENCHMARK(CheckQueueBlock8);
@@ -0,0 +1,60 @@
+// Copyright (c) 2020 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "data.h"
+
+#include "coins.h"
+
+#include <assert.h>
+
+/**
+ * Connecting the outputs of 100 transactions in a block cache and spending
+ * them again, then flushing the cache to its parent, like a block connected
+ * on top of the chainstate cache.
+ */
+static void CoinsCacheAddSpendFlush(benchmark::State& state)
+{
+    std::vector<CTransaction> vTx;
+    for (uint32_t i = 0; i < 100; i++)
+        vTx.push_back(CTransaction(BenchSpendTx(i, 1, 2)));
+
+    CCoinsView viewDummy;
+    CCoinsViewCache viewChain(&viewDummy);
+    int nHeight = 0;
+    while (state.KeepRunning()) {
+        nHeight++;
+        CCoinsViewCache view(&viewChain);
+        for (const CTransaction& tx : vTx)
+            *view.ModifyCoins(tx.GetHash()) = CCoins(tx, nHeight);
+        for (const CTransaction& tx : vTx) {
+            const CCoins* coins = view.AccessCoins(tx.GetHash());
+            assert(coins && coins->IsAvailable(1));
+            view.ModifyCoins(tx.GetHash())->Spend(1);
+        }
+        bool fFlushed = view.Flush();
+        assert(fFlushed);
+    }
+}
+
+/** Lookups of coins already in the cache */
+static void CoinsCacheAccess(benchmark::State& state)
+{
+    std::vector<uint256> vHashes;
+    CCoinsView viewDummy;
+    CCoinsViewCache view(&viewDummy);
+    for (uint32_t i = 0; i < 1000; i++) {
+        CTransaction tx(BenchSpendTx(i, 1, 2));
+        vHashes.push_back(tx.GetHash());
+        *view.ModifyCoins(tx.GetHash()) = CCoins(tx, 1);
+    }
+
+    while (state.KeepRunning()) {
+        for (const uint256& hash : vHashes)
+            view.AccessCoins(hash);
+    }
+}
+
+BENCHMARK(CoinsCacheAddSpendFlush);
+BENCHMARK(CoinsCacheAccess);
@@ -0,0 +1,47 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Copyright (c) 2020 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "data.h"
+
+#include "crypto/sha256.h"
+#include "hash.h"
+#include "utilstrencodings.h"
+
+#include <vector>
+
+/* Number of bytes to hash per iteration */
+static const uint64_t BUFFER_SIZE = 1000 * 1000;
+
+static void SHA256_1M(benchmark::State& state)
+{
+    uint8_t hash[CSHA256::OUTPUT_SIZE];
+    std::vector<uint8_t> in(BUFFER_SIZE, 0);
+    while (state.KeepRunning())
+        CSHA256().Write(in.data(), in.size()).Finalize(hash);
+}
+
+static void SHA256_32b(benchmark::State& state)
+{
+    std::vector<uint8_t> in(32, 0);
+    while (state.KeepRunning()) {
+        for (int i = 0; i < 1000; i++)
+            CSHA256().Write(in.data(), in.size()).Finalize(&in[0]);
+    }
+}
+
+/** The PoW/header hash of one block header */
+static void HashQuarkHeader(benchmark::State& state)
+{
+    CBlockHeader header = BenchPoSBlock(0).GetBlockHeader();
+    while (state.KeepRunning()) {
+        HashQuark(BEGIN(header.nVersion), END(header.nNonce));
+        header.nNonce++;
+    }
+}
+
+BENCHMARK(SHA256_1M);
+BENCHMARK(SHA256_32b);
+BENCHMARK(HashQuarkHeader);
@@ -0,0 +1,93 @@
+// Copyright (c) 2020 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "data.h"
+
+#include "amount.h"
+#include "blocksignature.h"
+#include "chainparams.h"
+#include "consensus/merkle.h"
+#include "hash.h"
+#include "script/standard.h"
+
+#include <assert.h>
+
+uint256 BenchHash(uint32_t n)
+{
+    CHashWriter ss(SER_GETHASH, 0);
+    ss << std::string("yoda bench") << n;
+    return ss.GetHash();
+}
+
+CKey BenchKey(uint32_t n)
+{
+    uint256 secret = BenchHash(n);
+    CKey key;
+    key.Set(secret.begin(), secret.end(), true);
+    assert(key.IsValid());
+    return key;
+}
+
+CMutableTransaction BenchSpendTx(uint32_t n, int nIn, int nOut)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(nIn);
+    for (int i = 0; i < nIn; i++) {
+        CKey key = BenchKey(n * 64 + i);
+        std::vector<unsigned char> vchSig;
+        bool fSigned = key.Sign(BenchHash(n * 64 + i), vchSig);
+        assert(fSigned);
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+        tx.vin[i].prevout = COutPoint(BenchHash(0x80000000 | n), i);
+        tx.vin[i].scriptSig << vchSig << ToByteVector(key.GetPubKey());
+    }
+    tx.vout.resize(nOut);
+    for (int i = 0; i < nOut; i++) {
+        tx.vout[i].nValue = (i + 1) * COIN;
+        tx.vout[i].scriptPubKey = GetScriptForDestination(BenchKey(n * 64 + 32 + i).GetPubKey().GetID());
+    }
+    return tx;
+}
+
+CBlock BenchPoSBlock(int nTx)
+{
+    const CKey keyStake = BenchKey(0);
+
+    CBlock block;
+    block.nVersion = Params().Zerocoin_HeaderVersion();
+    block.nTime = Params().Zerocoin_StartTime() + 1;
+    block.nBits = 0x1e0ffff0;
+    block.hashPrevBlock = BenchHash(1);
+
+    CMutableTransaction txCoinbase;
+    txCoinbase.vin.resize(1);
+    txCoinbase.vin[0].prevout.SetNull();
+    txCoinbase.vin[0].scriptSig = CScript() << 1000 << OP_0;
+    txCoinbase.vout.resize(1);
+    txCoinbase.vout[0].SetEmpty();
+    block.vtx.push_back(txCoinbase);
+
+    // P2PK kernel paid back to the staker, plus a masternode payment
+    CMutableTransaction txCoinStake;
+    txCoinStake.vin.resize(1);
+    txCoinStake.vin[0].prevout = COutPoint(BenchHash(2), 1);
+    std::vector<unsigned char> vchSig;
+    bool fSigned = keyStake.Sign(BenchHash(3), vchSig);
+    assert(fSigned);
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    txCoinStake.vin[0].scriptSig << vchSig;
+    txCoinStake.vout.resize(3);
+    txCoinStake.vout[0].SetEmpty();
+    txCoinStake.vout[1] = CTxOut(1002 * COIN, CScript() << ToByteVector(keyStake.GetPubKey()) << OP_CHECKSIG);
+    txCoinStake.vout[2] = CTxOut(3 * COIN, GetScriptForDestination(BenchKey(4).GetPubKey().GetID()));
+    block.vtx.push_back(txCoinStake);
+
+    for (int i = 0; i < nTx; i++)
+        block.vtx.push_back(BenchSpendTx(100 + i, 2, 2));
+
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+    fSigned = SignBlockWithKey(block, keyStake);
+    assert(fSigned);
+    return block;
+}
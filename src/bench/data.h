@@ -0,0 +1,27 @@
+// Copyright (c) 2020 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef YODA_BENCH_DATA_H
+#define YODA_BENCH_DATA_H
+
+#include "key.h"
+#include "primitives/block.h"
+#include "primitives/transaction.h"
+#include "uint256.h"
+
+#include <stdint.h>
+
+// Benchmark fixtures. They are derived from their number only, so every run and
+// every machine measures the same data.
+
+/** Hash number n */
+uint256 BenchHash(uint32_t n);
+/** Compressed key number n */
+CKey BenchKey(uint32_t n);
+/** A P2PKH spend of nIn made up outputs to nOut outputs, with real signatures and keys in the scriptSigs */
+CMutableTransaction BenchSpendTx(uint32_t n, int nIn, int nOut);
+/** A proof of stake block staked and signed by BenchKey(0), with nTx spends besides the coinbase and coinstake */
+CBlock BenchPoSBlock(int nTx);
+
+#endif // YODA_BENCH_DATA_H
@@ -0,0 +1,33 @@
+// Copyright (c) 2020 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "data.h"
+
+#include "chainparams.h"
+#include "kernel.h"
+#include "script/standard.h"
+
+/** One kernel hash attempt, as the staker makes for every coin and time slot */
+static void CheckStakeKernelHashTest(benchmark::State& state)
+{
+    const int nHeight = Params().GetConsensus().height_start_StakeModifierV2 + 1000;
+    CBlockIndex indexFrom;
+    indexFrom.nHeight = nHeight - 600;
+    indexFrom.nTime = 1600000000;
+    CBlockIndex indexPrev;
+    indexPrev.nHeight = nHeight;
+    indexPrev.nTime = indexFrom.nTime + 600 * 60;
+    indexPrev.SetStakeModifier(BenchHash(5));
+
+    CPivStake stake;
+    stake.SetPrevout(COutPoint(BenchHash(6), 1), CTxOut(1000 * COIN, GetScriptForDestination(BenchKey(0).GetPubKey().GetID())), &indexFrom);
+
+    unsigned int nTimeTx = indexPrev.nTime;
+    uint256 hashProofOfStake;
+    while (state.KeepRunning())
+        CheckStakeKernelHash(&indexPrev, 0x1e0ffff0, &stake, nTimeTx++, hashProofOfStake);
+}
+
+BENCHMARK(CheckStakeKernelHashTest);
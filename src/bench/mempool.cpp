@@ -0,0 +1,30 @@
+// Copyright (c) 2020 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "data.h"
+
+#include "txmempool.h"
+
+#include <list>
+
+/** Adding 100 transactions to the pool and removing them again */
+static void MempoolAddRemove(benchmark::State& state)
+{
+    std::vector<CTransaction> vTx;
+    for (uint32_t i = 0; i < 100; i++)
+        vTx.push_back(CTransaction(BenchSpendTx(i, 1, 2)));
+
+    CTxMemPool pool(CFeeRate(0));
+    std::list<CTransaction> removed;
+    while (state.KeepRunning()) {
+        for (const CTransaction& tx : vTx)
+            pool.addUnchecked(tx.GetHash(), CTxMemPoolEntry(tx, 10000, 1, 0.0, 1));
+        for (const CTransaction& tx : vTx)
+            pool.remove(tx, removed);
+        removed.clear();
+    }
+}
+
+BENCHMARK(MempoolAddRemove);
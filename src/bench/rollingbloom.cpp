@@ -0,0 +1,37 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Copyright (c) 2020 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "data.h"
+
+#include "bloom.h"
+#include "mruset.h"
+
+/** The filter of inventory known to a peer */
+static void RollingBloom(benchmark::State& state)
+{
+    CRollingBloomFilter filter(10000, 0.000001);
+    uint32_t n = 0;
+    while (state.KeepRunning()) {
+        uint256 hash = BenchHash(n++);
+        filter.insert(hash);
+        filter.contains(BenchHash(n + 1000000));
+    }
+}
+
+/** The set that the filter replaced, for comparison */
+static void RollingMruSet(benchmark::State& state)
+{
+    mruset<uint256> set(10000);
+    uint32_t n = 0;
+    while (state.KeepRunning()) {
+        uint256 hash = BenchHash(n++);
+        set.insert(hash);
+        set.count(BenchHash(n + 1000000));
+    }
+}
+
+BENCHMARK(RollingBloom);
+BENCHMARK(RollingMruSet);
@@ -0,0 +1,77 @@
+// Copyright (c) 2020 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "scheduler.h"
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+static const int PENDING_TIMERS = 100000;
+
+static void Nothing()
+{
+}
+
+/** Timers spread over the next hour, like peer and cache timeouts */
+static void AddPendingTimers(CScheduler& s)
+{
+    boost::chrono::system_clock::time_point now = boost::chrono::system_clock::now();
+    for (int i = 0; i < PENDING_TIMERS; i++)
+        s.schedule(&Nothing, now + boost::chrono::seconds(60) + boost::chrono::milliseconds((i * 7919) % 3600000));
+}
+
+/** Scheduling and cancelling one more timer */
+static void SchedulerScheduleCancel(benchmark::State& state)
+{
+    CScheduler s;
+    AddPendingTimers(s);
+    boost::chrono::system_clock::time_point now = boost::chrono::system_clock::now();
+    int n = 0;
+    while (state.KeepRunning()) {
+        CScheduler::TaskId id = s.schedule(&Nothing, now + boost::chrono::milliseconds(60000 + (n++ * 104729) % 3600000));
+        s.cancel(id);
+    }
+}
+
+struct CLatencyProbe {
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    bool fDone;
+
+    CLatencyProbe() : fDone(false) {}
+
+    void Run()
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fDone = true;
+        cond.notify_one();
+    }
+};
+
+/** From scheduling a task that is due now until it has run, with the pool idle on many timers */
+static void SchedulerLatency(benchmark::State& state)
+{
+    CScheduler s;
+    AddPendingTimers(s);
+    boost::thread_group threads;
+    for (int i = 0; i < DEFAULT_SCHEDULER_THREADS; i++)
+        threads.create_thread(boost::bind(&CScheduler::serviceQueue, &s));
+
+    CLatencyProbe probe;
+    while (state.KeepRunning()) {
+        boost::unique_lock<boost::mutex> lock(probe.mutex);
+        probe.fDone = false;
+        s.schedule(boost::bind(&CLatencyProbe::Run, &probe), boost::chrono::system_clock::now());
+        while (!probe.fDone)
+            probe.cond.wait(lock);
+    }
+
+    s.stop();
+    threads.join_all();
+}
+
+BENCHMARK(SchedulerScheduleCancel);
+BENCHMARK(SchedulerLatency);
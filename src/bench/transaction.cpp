@@ -0,0 +1,37 @@
+// Copyright (c) 2020 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "data.h"
+
+#include "streams.h"
+#include "version.h"
+
+#include <assert.h>
+
+static void SerializeTransaction(benchmark::State& state)
+{
+    const CTransaction tx(BenchSpendTx(0, 2, 2));
+    while (state.KeepRunning()) {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << tx;
+    }
+}
+
+static void DeserializeTransaction(benchmark::State& state)
+{
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << CTransaction(BenchSpendTx(0, 2, 2));
+    const std::string strTx = stream.str();
+
+    while (state.KeepRunning()) {
+        CDataStream ss(strTx.data(), strTx.data() + strTx.size(), SER_NETWORK, PROTOCOL_VERSION);
+        CTransaction tx;
+        ss >> tx;
+        assert(tx.vin.size() == 2);
+    }
+}
+
+BENCHMARK(SerializeTransaction);
+BENCHMARK(DeserializeTransaction);
@@ -0,0 +1,40 @@
+// Copyright (c) 2020 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "data.h"
+
+#include "pubkey.h"
+
+#include <assert.h>
+
+static void VerifySignature(benchmark::State& state)
+{
+    const CKey key = BenchKey(0);
+    const CPubKey pubkey = key.GetPubKey();
+    const uint256 hash = BenchHash(0);
+    std::vector<unsigned char> vchSig;
+    bool fSigned = key.Sign(hash, vchSig);
+    assert(fSigned);
+
+    while (state.KeepRunning())
+        pubkey.Verify(hash, vchSig);
+}
+
+/** How masternode and budget messages are checked */
+static void RecoverCompactSignature(benchmark::State& state)
+{
+    const CKey key = BenchKey(0);
+    const uint256 hash = BenchHash(0);
+    std::vector<unsigned char> vchSig;
+    bool fSigned = key.SignCompact(hash, vchSig);
+    assert(fSigned);
+
+    CPubKey pubkey;
+    while (state.KeepRunning())
+        pubkey.RecoverCompact(hash, vchSig);
+}
+
+BENCHMARK(VerifySignature);
+BENCHMARK(RecoverCompactSignature);
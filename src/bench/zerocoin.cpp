@@ -0,0 +1,38 @@
+// Copyright (c) 2020 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "data.h"
+
+#include "chainparams.h"
+#include "zpiv/zpivmodule.h"
+
+#include <assert.h>
+
+/**
+ * The check of a public spend of a v1 coin: a Schnorr signature of the spending
+ * transaction by the randomness of the coin commitment.
+ */
+static void VerifyPublicCoinSpend(benchmark::State& state)
+{
+    libzerocoin::ZerocoinParams* params = Params().Zerocoin_Params(true);
+    const libzerocoin::IntegerGroupParams& group = params->coinCommitmentGroup;
+
+    // The top byte is cleared so the serial reads as a v1 serial
+    uint256 hashSerial = BenchHash(0);
+    hashSerial >>= 8;
+    const CBigNum serial = CBigNum(hashSerial) % group.groupOrder;
+    const CBigNum randomness = CBigNum(BenchHash(1)) % group.groupOrder;
+    const CBigNum commitment = group.g.pow_mod(serial, group.modulus).mul_mod(group.h.pow_mod(randomness, group.modulus), group.modulus);
+
+    PublicCoinSpend spend(params, PUBSPEND_SCHNORR, serial, randomness, BenchHash(2), nullptr);
+    spend.pubCoin = libzerocoin::PublicCoin(params, commitment, libzerocoin::ZQ_ONE);
+    bool fValid = spend.Verify();
+    assert(fValid);
+
+    while (state.KeepRunning())
+        spend.Verify();
+}
+
+BENCHMARK(VerifyPublicCoinSpend);
@@ -0,0 +1,151 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Copyright (c) 2020 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockencodings.h"
+
+#include "consensus/consensus.h"
+#include "consensus/merkle.h"
+#include "crypto/sha256.h"
+#include "hash.h"
+#include "random.h"
+#include "streams.h"
+#include "txmempool.h"
+#include "util.h"
+#include "version.h"
+
+#include <unordered_map>
+
+//! Smallest serialized transaction, bounds the number of transactions a compact block may claim
+static const unsigned int MIN_TRANSACTION_SIZE = 60;
+
+CBlockHeaderAndShortTxIDs::CBlockHeaderAndShortTxIDs(const CBlock& block) : nonce(GetRand(std::numeric_limits<uint64_t>::max())),
+                                                                            header(block.GetBlockHeader()),
+                                                                            vchBlockSig(block.vchBlockSig)
+{
+    // The coinbase, and the coinstake of PoS blocks, are never in the receiver's mempool
+    size_t nPrefilled = std::min(block.vtx.size(), (size_t)(block.IsProofOfStake() ? 2 : 1));
+    prefilledtxn.resize(nPrefilled);
+    shorttxids.resize(block.vtx.size() - nPrefilled);
+    FillShortTxIDSelector();
+    for (size_t i = 0; i < nPrefilled; i++) {
+        prefilledtxn[i].index = i;
+        prefilledtxn[i].tx = block.vtx[i];
+    }
+    for (size_t i = nPrefilled; i < block.vtx.size(); i++)
+        shorttxids[i - nPrefilled] = GetShortID(block.vtx[i].GetHash());
+}
+
+void CBlockHeaderAndShortTxIDs::FillShortTxIDSelector() const
+{
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << header << nonce;
+    uint256 shorttxidhash;
+    CSHA256().Write((const unsigned char*)&stream[0], stream.size()).Finalize(shorttxidhash.begin());
+    shorttxidk0 = shorttxidhash.Get64(0);
+    shorttxidk1 = shorttxidhash.Get64(1);
+}
+
+uint64_t CBlockHeaderAndShortTxIDs::GetShortID(const uint256& txhash) const
+{
+    return SipHashUint256(shorttxidk0, shorttxidk1, txhash) & 0xffffffffffffL;
+}
+
+ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& cmpctblock)
+{
+    if (cmpctblock.header.IsNull() || (cmpctblock.shorttxids.empty() && cmpctblock.prefilledtxn.empty()))
+        return READ_STATUS_INVALID;
+    if (cmpctblock.BlockTxCount() > MAX_BLOCK_SIZE_CURRENT / MIN_TRANSACTION_SIZE)
+        return READ_STATUS_INVALID;
+
+    assert(header.IsNull() && txn_available.empty());
+    header = cmpctblock.header;
+    vchBlockSig = cmpctblock.vchBlockSig;
+    txn_available.resize(cmpctblock.BlockTxCount());
+
+    for (const PrefilledTransaction& prefilled : cmpctblock.prefilledtxn) {
+        if (prefilled.tx.IsNull() || prefilled.index >= txn_available.size())
+            return READ_STATUS_INVALID;
+        txn_available[prefilled.index] = std::make_shared<const CTransaction>(prefilled.tx);
+    }
+    prefilled_count = cmpctblock.prefilledtxn.size();
+
+    // Positions of the short ids, skipping the slots taken by prefilled transactions.
+    // Indexes are decoded strictly increasing, so every short id gets a distinct free slot.
+    std::unordered_map<uint64_t, uint16_t> shorttxids(cmpctblock.shorttxids.size());
+    uint16_t index_offset = 0;
+    for (size_t i = 0; i < cmpctblock.shorttxids.size(); i++) {
+        while (txn_available[i + index_offset])
+            index_offset++;
+        shorttxids[cmpctblock.shorttxids[i]] = i + index_offset;
+    }
+    // Two transactions of the block share a short id: let the caller fetch the full block
+    if (shorttxids.size() != cmpctblock.shorttxids.size())
+        return READ_STATUS_FAILED;
+
+    std::vector<bool> have_txn(txn_available.size());
+    {
+        LOCK(pool->cs);
+        for (const auto& entry : pool->mapTx) {
+            std::unordered_map<uint64_t, uint16_t>::iterator idit = shorttxids.find(cmpctblock.GetShortID(entry.first));
+            if (idit == shorttxids.end())
+                continue;
+            if (!have_txn[idit->second]) {
+                txn_available[idit->second] = std::make_shared<const CTransaction>(entry.second.GetTx());
+                have_txn[idit->second] = true;
+                mempool_count++;
+            } else if (txn_available[idit->second]) {
+                // Two mempool transactions match the same short id, we cannot tell which one is in the block
+                txn_available[idit->second].reset();
+                mempool_count--;
+            }
+            if (mempool_count == shorttxids.size())
+                break;
+        }
+    }
+
+    LogPrint("cmpctblock", "Initialized PartiallyDownloadedBlock for block %s using a cmpctblock of size %lu\n",
+        cmpctblock.header.GetHash().ToString(), GetSerializeSize(cmpctblock, SER_NETWORK, PROTOCOL_VERSION));
+
+    return READ_STATUS_OK;
+}
+
+bool PartiallyDownloadedBlock::IsTxAvailable(size_t index) const
+{
+    assert(!header.IsNull());
+    assert(index < txn_available.size());
+    return txn_available[index] ? true : false;
+}
+
+ReadStatus PartiallyDownloadedBlock::FillBlock(CBlock& block, const std::vector<CTransaction>& vtx_missing) const
+{
+    assert(!header.IsNull());
+    block = CBlock(header);
+    block.vchBlockSig = vchBlockSig;
+    block.vtx.resize(txn_available.size());
+
+    size_t tx_missing_offset = 0;
+    for (size_t i = 0; i < txn_available.size(); i++) {
+        if (txn_available[i]) {
+            block.vtx[i] = *txn_available[i];
+        } else {
+            if (vtx_missing.size() <= tx_missing_offset)
+                return READ_STATUS_INVALID;
+            block.vtx[i] = vtx_missing[tx_missing_offset++];
+        }
+    }
+    if (vtx_missing.size() != tx_missing_offset)
+        return READ_STATUS_INVALID;
+
+    // A short id collision with a mempool transaction shows up as a merkle root mismatch.
+    // That is not the peer's fault, so ask for the full block instead of punishing it.
+    bool mutated;
+    if (BlockMerkleRoot(block, &mutated) != header.hashMerkleRoot || mutated)
+        return READ_STATUS_FAILED;
+
+    LogPrint("cmpctblock", "Successfully reconstructed block %s with %lu txn prefilled, %lu txn from mempool and %lu txn requested\n",
+        header.GetHash().ToString(), prefilled_count, mempool_count, vtx_missing.size());
+
+    return READ_STATUS_OK;
+}
@@ -0,0 +1,222 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Copyright (c) 2020 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef YODA_BLOCKENCODINGS_H
+#define YODA_BLOCKENCODINGS_H
+
+#include "primitives/block.h"
+#include "serialize.h"
+
+#include <ios>
+#include <limits>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+class CTxMemPool;
+
+/** Version of the compact block encoding negotiated with "sendcmpct" */
+static const uint64_t COMPACT_BLOCKS_VERSION = 1;
+/** Only answer MSG_CMPCT_BLOCK requests with a compact block for blocks this close to the tip */
+static const int MAX_CMPCTBLOCK_DEPTH = 5;
+/** Number of peers we ask to push compact blocks to us without an inv round trip */
+static const unsigned int MAX_HB_CMPCTBLOCK_PEERS = 3;
+
+/** "getblocktxn": the transactions of a compact block the receiver could not find in its mempool */
+class BlockTransactionsRequest
+{
+public:
+    uint256 blockhash;
+    //! Absolute positions in the block, sent differentially encoded
+    std::vector<uint16_t> indexes;
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const
+    {
+        CSizeComputer s(nType, nVersion);
+        Serialize(s, nType, nVersion);
+        return s.size();
+    }
+
+    template <typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        ::Serialize(s, blockhash, nType, nVersion);
+        WriteCompactSize(s, indexes.size());
+        for (size_t i = 0; i < indexes.size(); i++)
+            WriteCompactSize(s, indexes[i] - (i == 0 ? 0 : (indexes[i - 1] + 1)));
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion)
+    {
+        ::Unserialize(s, blockhash, nType, nVersion);
+        uint64_t nCount = ReadCompactSize(s);
+        if (nCount > std::numeric_limits<uint16_t>::max())
+            throw std::ios_base::failure("indexes count overflowed 16 bits");
+        indexes.resize(nCount);
+        uint64_t nOffset = 0;
+        for (size_t i = 0; i < indexes.size(); i++) {
+            nOffset += ReadCompactSize(s);
+            if (nOffset > std::numeric_limits<uint16_t>::max())
+                throw std::ios_base::failure("index overflowed 16 bits");
+            indexes[i] = nOffset++;
+        }
+    }
+};
+
+/** "blocktxn": the answer to a getblocktxn, transactions in the order they were requested */
+class BlockTransactions
+{
+public:
+    uint256 blockhash;
+    std::vector<CTransaction> txn;
+
+    BlockTransactions() {}
+    explicit BlockTransactions(const BlockTransactionsRequest& req) : blockhash(req.blockhash), txn(req.indexes.size()) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(blockhash);
+        READWRITE(txn);
+    }
+};
+
+/** A transaction sent in full inside a compact block, at an absolute block position */
+struct PrefilledTransaction {
+    uint16_t index;
+    CTransaction tx;
+};
+
+/** Result of PartiallyDownloadedBlock::InitData and FillBlock */
+enum ReadStatus {
+    READ_STATUS_OK,
+    READ_STATUS_INVALID, //!< the peer sent something malformed, punish it
+    READ_STATUS_FAILED,  //!< could not reconstruct (e.g. short id collision), fall back to the full block
+};
+
+/**
+ * "cmpctblock": a block header, the PoS block signature, the coinbase and coinstake
+ * in full, and a 6 byte salted short id for every other transaction. The salt is
+ * SHA256(header || nonce), so short ids differ per announcement and per block and
+ * cannot be precomputed to collide.
+ */
+class CBlockHeaderAndShortTxIDs
+{
+private:
+    mutable uint64_t shorttxidk0, shorttxidk1;
+    uint64_t nonce;
+
+    void FillShortTxIDSelector() const;
+
+    friend class PartiallyDownloadedBlock;
+
+protected:
+    std::vector<uint64_t> shorttxids;
+    std::vector<PrefilledTransaction> prefilledtxn;
+
+public:
+    static const int SHORTTXIDS_LENGTH = 6;
+
+    CBlockHeader header;
+    std::vector<unsigned char> vchBlockSig;
+
+    // Dummy for deserialization
+    CBlockHeaderAndShortTxIDs() {}
+
+    explicit CBlockHeaderAndShortTxIDs(const CBlock& block);
+
+    uint64_t GetShortID(const uint256& txhash) const;
+
+    size_t BlockTxCount() const { return shorttxids.size() + prefilledtxn.size(); }
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const
+    {
+        CSizeComputer s(nType, nVersion);
+        Serialize(s, nType, nVersion);
+        return s.size();
+    }
+
+    template <typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        ::Serialize(s, header, nType, nVersion);
+        ::Serialize(s, vchBlockSig, nType, nVersion);
+        ::Serialize(s, nonce, nType, nVersion);
+        WriteCompactSize(s, shorttxids.size());
+        for (const uint64_t& shortid : shorttxids) {
+            uint32_t lsb = shortid & 0xffffffff;
+            uint16_t msb = (shortid >> 32) & 0xffff;
+            ::Serialize(s, lsb, nType, nVersion);
+            ::Serialize(s, msb, nType, nVersion);
+        }
+        WriteCompactSize(s, prefilledtxn.size());
+        for (size_t i = 0; i < prefilledtxn.size(); i++) {
+            WriteCompactSize(s, prefilledtxn[i].index - (i == 0 ? 0 : (prefilledtxn[i - 1].index + 1)));
+            ::Serialize(s, prefilledtxn[i].tx, nType, nVersion);
+        }
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion)
+    {
+        ::Unserialize(s, header, nType, nVersion);
+        ::Unserialize(s, vchBlockSig, nType, nVersion);
+        ::Unserialize(s, nonce, nType, nVersion);
+        uint64_t nCount = ReadCompactSize(s);
+        if (nCount > std::numeric_limits<uint16_t>::max())
+            throw std::ios_base::failure("shorttxids count overflowed 16 bits");
+        shorttxids.resize(nCount);
+        for (uint64_t& shortid : shorttxids) {
+            uint32_t lsb;
+            uint16_t msb;
+            ::Unserialize(s, lsb, nType, nVersion);
+            ::Unserialize(s, msb, nType, nVersion);
+            shortid = (uint64_t(msb) << 32) | uint64_t(lsb);
+        }
+        nCount = ReadCompactSize(s);
+        if (nCount > std::numeric_limits<uint16_t>::max())
+            throw std::ios_base::failure("prefilledtxn count overflowed 16 bits");
+        prefilledtxn.resize(nCount);
+        uint64_t nOffset = 0;
+        for (size_t i = 0; i < prefilledtxn.size(); i++) {
+            nOffset += ReadCompactSize(s);
+            if (nOffset > std::numeric_limits<uint16_t>::max())
+                throw std::ios_base::failure("index overflowed 16 bits");
+            prefilledtxn[i].index = nOffset++;
+            ::Unserialize(s, prefilledtxn[i].tx, nType, nVersion);
+        }
+        FillShortTxIDSelector();
+    }
+};
+
+/** Receiver side state of a compact block while missing transactions are fetched */
+class PartiallyDownloadedBlock
+{
+protected:
+    //! Null entries are still missing
+    std::vector<std::shared_ptr<const CTransaction> > txn_available;
+    size_t prefilled_count, mempool_count;
+    CTxMemPool* pool;
+
+public:
+    CBlockHeader header;
+    std::vector<unsigned char> vchBlockSig;
+
+    explicit PartiallyDownloadedBlock(CTxMemPool* poolIn) : prefilled_count(0), mempool_count(0), pool(poolIn) {}
+
+    //! Matches the short ids against the mempool, locks pool->cs
+    ReadStatus InitData(const CBlockHeaderAndShortTxIDs& cmpctblock);
+    bool IsTxAvailable(size_t index) const;
+    //! vtx_missing must hold exactly the transactions that were missing, in block order
+    ReadStatus FillBlock(CBlock& block, const std::vector<CTransaction>& vtx_missing) const;
+
+    size_t GetPrefilledCount() const { return prefilled_count; }
+    size_t GetMempoolCount() const { return mempool_count; }
+};
+
+#endif // YODA_BLOCKENCODINGS_H
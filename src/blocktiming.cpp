@@ -0,0 +1,174 @@
+// Copyright (c) 2020 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blocktiming.h"
+
+#include <algorithm>
+
+static const size_t DEFAULT_BLOCK_TIMING_RECORDS = 1000;
+
+CBlockTimingLog blockTimingLog(DEFAULT_BLOCK_TIMING_RECORDS);
+
+const char* GetBlockStageName(int nStage)
+{
+    switch (nStage) {
+    case BLOCKSTAGE_CHECK_BLOCK: return "checkblock";
+    case BLOCKSTAGE_CHECK_SIGNATURE: return "checkblocksignature";
+    case BLOCKSTAGE_CHECK_STAKE: return "checkproofofstake";
+    case BLOCKSTAGE_ACCEPT: return "acceptblock";
+    case BLOCKSTAGE_READ_DISK: return "readdisk";
+    case BLOCKSTAGE_ZEROCOIN_SPENDS: return "zerocoinspends";
+    case BLOCKSTAGE_FETCH_INPUTS: return "fetchinputs";
+    case BLOCKSTAGE_CHECK_INPUTS: return "checkinputs";
+    case BLOCKSTAGE_SCRIPT_WAIT: return "scriptwait";
+    case BLOCKSTAGE_UNDO_WRITE: return "undowrite";
+    case BLOCKSTAGE_INDEX_WRITE: return "indexwrite";
+    case BLOCKSTAGE_CONNECT: return "connectblock";
+    case BLOCKSTAGE_VIEW_FLUSH: return "viewflush";
+    case BLOCKSTAGE_FLUSH_STATE: return "flushstatetodisk";
+    case BLOCKSTAGE_MEMPOOL: return "mempool";
+    case BLOCKSTAGE_CB_UPDATED_TRANSACTION: return "updatedtransaction";
+    case BLOCKSTAGE_CB_BLOCK_CHECKED: return "blockchecked";
+    case BLOCKSTAGE_CB_SYNC_TRANSACTION: return "synctransaction";
+    case BLOCKSTAGE_CB_UPDATED_BLOCK_TIP: return "updatedblocktip";
+    case BLOCKSTAGE_CONNECT_TIP: return "connecttip";
+    }
+    return "unknown";
+}
+
+CBlockTimingRecord::CBlockTimingRecord() : nHeight(-1), nTx(0), nInputs(0), fProofOfStake(false), nTime(0)
+{
+    for (int i = 0; i < BLOCKSTAGE_COUNT; i++)
+        vStageMicros[i] = -1;
+}
+
+void CBlockTimingRecord::Add(int nStage, int64_t nMicros)
+{
+    if (vStageMicros[nStage] < 0)
+        vStageMicros[nStage] = 0;
+    vStageMicros[nStage] += nMicros;
+}
+
+CStageHistogram::CStageHistogram() : nCount(0), nTotalMicros(0), nMaxMicros(0)
+{
+    for (int i = 0; i < BUCKETS; i++)
+        vBuckets[i] = 0;
+}
+
+void CStageHistogram::Add(int64_t nMicros)
+{
+    int nBucket = 0;
+    while (nBucket < BUCKETS - 1 && BucketLimit(nBucket) < nMicros)
+        nBucket++;
+    vBuckets[nBucket]++;
+    nCount++;
+    nTotalMicros += nMicros;
+    nMaxMicros = std::max(nMaxMicros, nMicros);
+}
+
+int64_t CStageHistogram::Percentile(double dFraction) const
+{
+    if (nCount == 0)
+        return 0;
+    uint64_t nSeen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        nSeen += vBuckets[i];
+        if (nSeen >= dFraction * nCount)
+            return std::min(BucketLimit(i), nMaxMicros);
+    }
+    return nMaxMicros;
+}
+
+CBlockTimingLog::CBlockTimingLog(size_t nRecords) : nMaxRecords(std::max<size_t>(1, nRecords)), nNext(0), nBlocks(0), nPendingNext(0)
+{
+}
+
+CBlockTimingRecord* CBlockTimingLog::FindRecord(const uint256& hash)
+{
+    // Late stages come right after the block is connected, so search from the newest
+    for (size_t i = 0; i < vRecords.size(); i++) {
+        CBlockTimingRecord& record = vRecords[(nNext + vRecords.size() - 1 - i) % vRecords.size()];
+        if (record.hash == hash)
+            return &record;
+    }
+    return NULL;
+}
+
+void CBlockTimingLog::AddPending(const uint256& hash, int nStage, int64_t nMicros)
+{
+    LOCK(cs);
+    std::map<uint256, std::pair<uint64_t, CBlockTimingRecord> >::iterator it = mapPending.find(hash);
+    if (it == mapPending.end()) {
+        // Blocks that never get connected would pile up otherwise
+        if (mapPending.size() >= MAX_PENDING) {
+            mapPending.erase(mapPendingOrder.begin()->second);
+            mapPendingOrder.erase(mapPendingOrder.begin());
+        }
+        it = mapPending.insert(std::make_pair(hash, std::make_pair(nPendingNext, CBlockTimingRecord()))).first;
+        mapPendingOrder.insert(std::make_pair(nPendingNext++, hash));
+    }
+    it->second.second.Add(nStage, nMicros);
+}
+
+void CBlockTimingLog::Add(const CBlockTimingRecord& recordIn)
+{
+    LOCK(cs);
+    CBlockTimingRecord record = recordIn;
+    std::map<uint256, std::pair<uint64_t, CBlockTimingRecord> >::iterator it = mapPending.find(record.hash);
+    if (it != mapPending.end()) {
+        const CBlockTimingRecord& pending = it->second.second;
+        for (int i = 0; i < BLOCKSTAGE_COUNT; i++) {
+            if (pending.vStageMicros[i] >= 0)
+                record.Add(i, pending.vStageMicros[i]);
+        }
+        mapPendingOrder.erase(it->second.first);
+        mapPending.erase(it);
+    }
+
+    for (int i = 0; i < BLOCKSTAGE_COUNT; i++) {
+        if (record.vStageMicros[i] >= 0)
+            vHistograms[i].Add(record.vStageMicros[i]);
+    }
+    nBlocks++;
+
+    if (vRecords.size() < nMaxRecords) {
+        vRecords.push_back(record);
+        nNext = vRecords.size() % nMaxRecords;
+    } else {
+        vRecords[nNext] = record;
+        nNext = (nNext + 1) % vRecords.size();
+    }
+}
+
+void CBlockTimingLog::AddLate(const uint256& hash, int nStage, int64_t nMicros)
+{
+    LOCK(cs);
+    CBlockTimingRecord* precord = FindRecord(hash);
+    if (!precord)
+        return;
+    precord->Add(nStage, nMicros);
+    vHistograms[nStage].Add(nMicros);
+}
+
+uint64_t CBlockTimingLog::GetBlockCount() const
+{
+    LOCK(cs);
+    return nBlocks;
+}
+
+std::vector<CBlockTimingRecord> CBlockTimingLog::GetRecords() const
+{
+    LOCK(cs);
+    std::vector<CBlockTimingRecord> vRet;
+    vRet.reserve(vRecords.size());
+    for (size_t i = 0; i < vRecords.size(); i++)
+        vRet.push_back(vRecords[(nNext + i) % vRecords.size()]);
+    return vRet;
+}
+
+void CBlockTimingLog::GetHistograms(std::vector<CStageHistogram>& vHistogramsOut) const
+{
+    LOCK(cs);
+    vHistogramsOut.assign(vHistograms, vHistograms + BLOCKSTAGE_COUNT);
+}
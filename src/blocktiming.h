@@ -0,0 +1,144 @@
+// Copyright (c) 2020 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef YODA_BLOCKTIMING_H
+#define YODA_BLOCKTIMING_H
+
+#include "sync.h"
+#include "uint256.h"
+#include "utiltime.h"
+
+#include <map>
+#include <stdint.h>
+#include <vector>
+
+/** Stages of accepting and connecting a block, in the order they run */
+enum BlockStage {
+    // In ProcessNewBlock and AcceptBlock, before the block is connected
+    BLOCKSTAGE_CHECK_BLOCK,
+    BLOCKSTAGE_CHECK_SIGNATURE,
+    BLOCKSTAGE_CHECK_STAKE,
+    BLOCKSTAGE_ACCEPT,
+    // ConnectTip and ConnectBlock
+    BLOCKSTAGE_READ_DISK,
+    BLOCKSTAGE_ZEROCOIN_SPENDS,
+    BLOCKSTAGE_FETCH_INPUTS,
+    BLOCKSTAGE_CHECK_INPUTS,
+    BLOCKSTAGE_SCRIPT_WAIT,
+    BLOCKSTAGE_UNDO_WRITE,
+    BLOCKSTAGE_INDEX_WRITE,
+    BLOCKSTAGE_CONNECT,
+    BLOCKSTAGE_VIEW_FLUSH,
+    BLOCKSTAGE_FLUSH_STATE,
+    BLOCKSTAGE_MEMPOOL,
+    // Validation interface callbacks
+    BLOCKSTAGE_CB_UPDATED_TRANSACTION,
+    BLOCKSTAGE_CB_BLOCK_CHECKED,
+    BLOCKSTAGE_CB_SYNC_TRANSACTION,
+    BLOCKSTAGE_CB_UPDATED_BLOCK_TIP,
+    BLOCKSTAGE_CONNECT_TIP,
+    BLOCKSTAGE_COUNT
+};
+
+const char* GetBlockStageName(int nStage);
+
+/** Where the time to connect one block went */
+struct CBlockTimingRecord {
+    uint256 hash;
+    int nHeight;
+    unsigned int nTx;
+    unsigned int nInputs;
+    bool fProofOfStake;
+    //! When the block was connected
+    int64_t nTime;
+    //! Microseconds per stage, -1 for stages that did not run
+    int64_t vStageMicros[BLOCKSTAGE_COUNT];
+
+    CBlockTimingRecord();
+
+    //! Add to a stage, which then counts as run
+    void Add(int nStage, int64_t nMicros);
+};
+
+/** Counts of samples with a duration up to 2^i microseconds */
+struct CStageHistogram {
+    static const int BUCKETS = 26;
+
+    uint64_t nCount;
+    int64_t nTotalMicros;
+    int64_t nMaxMicros;
+    uint64_t vBuckets[BUCKETS];
+
+    CStageHistogram();
+
+    void Add(int64_t nMicros);
+    //! Upper bound of the bucket holding the given fraction of the samples
+    int64_t Percentile(double dFraction) const;
+    static int64_t BucketLimit(int nBucket) { return (int64_t)1 << nBucket; }
+};
+
+/**
+ * Timing of the recently connected blocks, and histograms of each stage over
+ * every block connected since startup.
+ *
+ * Stages that run before a block is connected are kept by block hash until the
+ * block is. Only blocks that were stored get them. Of those, the MAX_PENDING
+ * most recent are kept, as side-chain blocks may never be connected.
+ */
+class CBlockTimingLog
+{
+private:
+    static const size_t MAX_PENDING = 256;
+
+    mutable CCriticalSection cs;
+    const size_t nMaxRecords;
+    std::vector<CBlockTimingRecord> vRecords;
+    //! Next slot of vRecords to write
+    size_t nNext;
+    uint64_t nBlocks;
+    //! Pending stages by block hash, with the order in which the block came in
+    std::map<uint256, std::pair<uint64_t, CBlockTimingRecord> > mapPending;
+    //! Block hashes of mapPending by that order
+    std::map<uint64_t, uint256> mapPendingOrder;
+    uint64_t nPendingNext;
+    CStageHistogram vHistograms[BLOCKSTAGE_COUNT];
+
+    CBlockTimingRecord* FindRecord(const uint256& hash);
+
+public:
+    explicit CBlockTimingLog(size_t nRecords);
+
+    //! A stage of a block that is not connected yet
+    void AddPending(const uint256& hash, int nStage, int64_t nMicros);
+    //! A connected block; takes in its pending stages
+    void Add(const CBlockTimingRecord& recordIn);
+    //! A stage of an already connected block, ignored once the block is out of the log
+    void AddLate(const uint256& hash, int nStage, int64_t nMicros);
+
+    uint64_t GetBlockCount() const;
+    //! The logged blocks, oldest first
+    std::vector<CBlockTimingRecord> GetRecords() const;
+    void GetHistograms(std::vector<CStageHistogram>& vHistogramsOut) const;
+};
+
+extern CBlockTimingLog blockTimingLog;
+
+/** Adds the time until it goes out of scope to a stage of a record, when there is one */
+class CBlockStageTimer
+{
+private:
+    CBlockTimingRecord* precord;
+    int nStage;
+    int64_t nStart;
+
+public:
+    CBlockStageTimer(CBlockTimingRecord* precordIn, int nStageIn) : precord(precordIn), nStage(nStageIn), nStart(precordIn ? GetTimeMicros() : 0) {}
+    ~CBlockStageTimer()
+    {
+        if (precord)
+            precord->Add(nStage, GetTimeMicros() - nStart);
+    }
+};
+
+#endif // YODA_BLOCKTIMING_H
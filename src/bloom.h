@@ -104,4 +104,45 @@ public:
     void UpdateEmptyFull();
 };
 
+/**
+ * RollingBloomFilter is a probabilistic "keep track of most recently inserted" set.
+ * Construct it with the number of items to keep track of, and a false-positive
+ * rate. Unlike CBloomFilter, it is never serialized or sent over the wire.
+ *
+ * contains(item) will always return true if item was one of the last nElements
+ * items insert()'ed, and will usually (depending on nFPRate) return false for
+ * anything older. Items are kept in up to three generations of nElements / 2
+ * entries; starting a new generation wipes the oldest one. Every bit of the
+ * filter is stored as two bits holding the generation (1-3) that last set it,
+ * 0 meaning unset.
+ *
+ * Don't create global CRollingBloomFilter objects, the constructor draws a random
+ * tweak and may run before the randomizer is initialized.
+ */
+class CRollingBloomFilter
+{
+public:
+    CRollingBloomFilter(unsigned int nElements, double nFPRate);
+
+    void insert(const std::vector<unsigned char>& vKey);
+    void insert(const uint256& hash);
+    bool contains(const std::vector<unsigned char>& vKey) const;
+    bool contains(const uint256& hash) const;
+
+    //! Forget everything and draw a new tweak
+    void reset();
+
+    //! Memory held by the filter bits, for comparing configurations
+    size_t DynamicMemoryUsage() const { return data.size() * sizeof(uint64_t); }
+
+private:
+    int nEntriesPerGeneration;
+    int nEntriesThisGeneration;
+    int nGeneration;
+    //! Bit P lives at position (P & 63) of data[(P >> 6) * 2] (low generation bit) and data[(P >> 6) * 2 + 1] (high bit)
+    std::vector<uint64_t> data;
+    unsigned int nTweak;
+    int nHashFuncs;
+};
+
 #endif // BITCOIN_BLOOM_H
@@ -6,8 +6,13 @@
 #define BITCOIN_CHECKQUEUE_H
 
 #include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
 #include <vector>
 
+#include <assert.h>
+
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/locks.hpp>
 #include <boost/thread/mutex.hpp>
@@ -24,12 +29,30 @@ class CCheckQueueControl;
   * onto the queue, where they are processed by N-1 worker threads. When
   * the master is done adding work, it temporarily joins the worker pool
   * as an N'th worker, until all jobs are done.
+  *
+  * Every thread owns a deque of pending checks, slot 0 being the master's.
+  * Add() spreads new checks over the deques, so workers start on them while
+  * the master is still adding more, and a thread that runs out of work
+  * steals from the front of the others. The only lock shared by all threads
+  * is taken to go to sleep and to wake sleepers up.
+  *
+  * Submission is not lock-free: Add() locks each deque it fills, once per
+  * chunk rather than once per check. That lock is only contended by a thief
+  * taking from the same deque at the same moment, and it keeps T, which is
+  * swapped in and out rather than copied, out of a lock-free ring whose
+  * slots would have to be reclaimed behind concurrent readers.
   */
 template <typename T>
 class CCheckQueue
 {
 private:
-    //! Mutex to protect the inner state
+    //! A thread's own pending checks, popped by the owner at the back and stolen at the front
+    struct WorkerQueue {
+        boost::mutex mutex;
+        std::deque<T> queue;
+    };
+
+    //! Mutex that idle threads sleep on
     boost::mutex mutex;
 
     //! Worker threads block on this when out of work
@@ -38,96 +61,126 @@ private:
     //! Master thread blocks on this when out of work
     boost::condition_variable condMaster;
 
-    //! The queue of elements to be processed.
-    //! As the order of booleans doesn't matter, it is used as a LIFO (stack)
-    std::vector<T> queue;
+    //! One queue per thread, slot 0 belongs to the master
+    std::vector<std::unique_ptr<WorkerQueue> > vQueues;
 
-    //! The number of workers (including the master) that are idle.
-    int nIdle;
+    //! Number of worker threads that claimed a slot
+    std::atomic<unsigned int> nWorkers;
 
-    //! The total number of workers (including the master).
-    int nTotal;
+    //! The number of workers that are asleep.
+    std::atomic<int> nIdle;
 
     //! The temporary evaluation result.
-    bool fAllOk;
+    std::atomic<bool> fAllOk;
 
     /**
      * Number of verifications that haven't completed yet.
-     * This includes elements that are not anymore in queue, but still in
-     * worker's own batches.
+     * This includes elements that are not anymore in a queue, but still in
+     * a thread's own batch.
      */
-    unsigned int nTodo;
+    std::atomic<unsigned int> nTodo;
 
-    //! Whether we're shutting down.
-    bool fQuit;
+    //! Number of verifications still waiting in the queues
+    std::atomic<unsigned int> nQueued;
 
     //! The maximum number of elements to be processed in one batch
     unsigned int nBatchSize;
 
+    //! Next queue Add() puts work in
+    unsigned int nNextQueue;
+
+    /** Move up to half of a queue, at most nBatchSize checks, into vChecks. */
+    bool TakeFrom(WorkerQueue& wq, bool fOwner, std::vector<T>& vChecks)
+    {
+        boost::unique_lock<boost::mutex> lock(wq.mutex);
+        if (wq.queue.empty())
+            return false;
+        unsigned int nNow = std::max(1U, std::min(nBatchSize, (unsigned int)wq.queue.size() / 2));
+        vChecks.resize(nNow);
+        for (unsigned int i = 0; i < nNow; i++) {
+            // swap instead of copying, to keep the lock short
+            if (fOwner) {
+                vChecks[i].swap(wq.queue.back());
+                wq.queue.pop_back();
+            } else {
+                vChecks[i].swap(wq.queue.front());
+                wq.queue.pop_front();
+            }
+        }
+        nQueued -= nNow;
+        return true;
+    }
+
+    /** Take a batch from our own queue, or steal one from another thread. */
+    bool Take(unsigned int nSelf, std::vector<T>& vChecks)
+    {
+        if (TakeFrom(*vQueues[nSelf], true, vChecks))
+            return true;
+        const unsigned int nThreads = nWorkers + 1;
+        for (unsigned int i = 1; i < nThreads && nQueued > 0; i++) {
+            if (TakeFrom(*vQueues[(nSelf + i) % nThreads], false, vChecks))
+                return true;
+        }
+        return false;
+    }
+
     /** Internal function that does bulk of the verification work. */
     bool Loop(bool fMaster = false)
     {
-        boost::condition_variable& cond = fMaster ? condMaster : condWorker;
+        unsigned int nSelf = 0;
+        if (!fMaster) {
+            nSelf = ++nWorkers;
+            assert(nSelf < vQueues.size());
+        }
         std::vector<T> vChecks;
         vChecks.reserve(nBatchSize);
-        unsigned int nNow = 0;
-        bool fOk = true;
         do {
-            {
+            if (!Take(nSelf, vChecks)) {
                 boost::unique_lock<boost::mutex> lock(mutex);
-                // first do the clean-up of the previous loop run (allowing us to do it in the same critsect)
-                if (nNow) {
-                    fAllOk &= fOk;
-                    nTodo -= nNow;
-                    if (nTodo == 0 && !fMaster)
-                        // We processed the last element; inform the master he can exit and return the result
-                        condMaster.notify_one();
-                } else {
-                    // first iteration
-                    nTotal++;
-                }
-                // logically, the do loop starts here
-                while (queue.empty()) {
-                    if ((fMaster || fQuit) && nTodo == 0) {
-                        nTotal--;
+                if (fMaster) {
+                    // wait for the batches other threads are still running
+                    while (nTodo > 0 && nQueued == 0)
+                        condMaster.wait(lock);
+                    if (nTodo == 0) {
                         bool fRet = fAllOk;
                         // reset the status for new work later
-                        if (fMaster)
-                            fAllOk = true;
+                        fAllOk = true;
                         // return the current status
                         return fRet;
                     }
+                } else {
+                    // Add() checks nIdle after raising nQueued, so it cannot miss us
                     nIdle++;
-                    cond.wait(lock); // wait
+                    while (nQueued == 0)
+                        condWorker.wait(lock);
                     nIdle--;
                 }
-                // Decide how many work units to process now.
-                // * Do not try to do everything at once, but aim for increasingly smaller batches so
-                //   all workers finish approximately simultaneously.
-                // * Try to account for idle jobs which will instantly start helping.
-                // * Don't do batches smaller than 1 (duh), or larger than nBatchSize.
-                nNow = std::max(1U, std::min(nBatchSize, (unsigned int)queue.size() / (nTotal + nIdle + 1)));
-                vChecks.resize(nNow);
-                for (unsigned int i = 0; i < nNow; i++) {
-                    // We want the lock on the mutex to be as short as possible, so swap jobs from the global
-                    // queue to the local batch vector instead of copying.
-                    vChecks[i].swap(queue.back());
-                    queue.pop_back();
-                }
-                // Check whether we need to do work at all
-                fOk = fAllOk;
+                continue;
             }
-            // execute work
+            // execute work, unless some check already failed
+            bool fOk = fAllOk;
             for (T& check : vChecks)
                 if (fOk)
                     fOk = check();
+            if (!fOk)
+                fAllOk = false;
+            unsigned int nNow = vChecks.size();
             vChecks.clear();
+            if (nTodo.fetch_sub(nNow) == nNow) {
+                // We processed the last element; inform the master it can exit and return the result
+                boost::unique_lock<boost::mutex> lock(mutex);
+                condMaster.notify_one();
+            }
         } while (true);
     }
 
 public:
-    //! Create a new check queue
-    CCheckQueue(unsigned int nBatchSizeIn) : nIdle(0), nTotal(0), fAllOk(true), nTodo(0), fQuit(false), nBatchSize(nBatchSizeIn) {}
+    //! Create a new check queue for a master and up to nMaxWorkers worker threads
+    CCheckQueue(unsigned int nBatchSizeIn, unsigned int nMaxWorkers) : nWorkers(0), nIdle(0), fAllOk(true), nTodo(0), nQueued(0), nBatchSize(nBatchSizeIn), nNextQueue(0)
+    {
+        for (unsigned int i = 0; i <= nMaxWorkers; i++)
+            vQueues.emplace_back(new WorkerQueue());
+    }
 
     //! Worker thread
     void Thread()
@@ -144,16 +197,33 @@ public:
     //! Add a batch of checks to the queue
     void Add(std::vector<T>& vChecks)
     {
-        boost::unique_lock<boost::mutex> lock(mutex);
-        for (T& check : vChecks) {
-            queue.push_back(T());
-            check.swap(queue.back());
-        }
+        if (vChecks.empty())
+            return;
         nTodo += vChecks.size();
-        if (vChecks.size() == 1)
-            condWorker.notify_one();
-        else if (vChecks.size() > 1)
-            condWorker.notify_all();
+
+        // One chunk per thread, starting where the previous batch stopped
+        const unsigned int nThreads = nWorkers + 1;
+        const size_t nChunk = (vChecks.size() + nThreads - 1) / nThreads;
+        for (size_t nPos = 0; nPos < vChecks.size(); nPos += nChunk) {
+            const size_t nEnd = std::min(nPos + nChunk, vChecks.size());
+            WorkerQueue& wq = *vQueues[nNextQueue++ % nThreads];
+            {
+                boost::unique_lock<boost::mutex> lock(wq.mutex);
+                for (size_t i = nPos; i < nEnd; i++) {
+                    wq.queue.push_back(T());
+                    vChecks[i].swap(wq.queue.back());
+                }
+            }
+            nQueued += nEnd - nPos;
+        }
+
+        if (nIdle > 0) {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (vChecks.size() == 1)
+                condWorker.notify_one();
+            else
+                condWorker.notify_all();
+        }
     }
 
     ~CCheckQueue()
@@ -162,8 +232,7 @@ public:
 
     bool IsIdle()
     {
-        boost::unique_lock<boost::mutex> lock(mutex);
-        return (nTotal == nIdle && nTodo == 0 && fAllOk == true);
+        return (nTodo == 0 && nQueued == 0 && fAllOk == true);
     }
 };
 
@@ -205,7 +205,10 @@ bool CCryptoKeyStore::Lock()
     {
         LOCK(cs_KeyStore);
         vMasterKey.clear();
-        pwalletMain->zwalletMain->Lock();
+        // CKey wipes its locked memory when released
+        mapStakingKeys.clear();
+        if (pwalletMain && pwalletMain->zwalletMain)
+            pwalletMain->zwalletMain->Lock();
     }
 
     NotifyStatusChanged(this);
@@ -253,22 +256,25 @@ bool CCryptoKeyStore::Unlock(const CKeyingMaterial& vMasterKeyIn)
         vMasterKey = vMasterKeyIn;
         fDecryptionThoroughlyChecked = true;
 
-        uint256 hashSeed;
-        if (CWalletDB(pwalletMain->strWalletFile).ReadCurrentSeedHash(hashSeed)) {
-            uint256 nSeed;
-            if (!GetDeterministicSeed(hashSeed, nSeed)) {
-                return error("Failed to read zYODA seed from DB. Wallet is probably corrupt.");
+        // The zYODA wallet is attached only once the wallet has loaded
+        if (pwalletMain && pwalletMain->zwalletMain) {
+            uint256 hashSeed;
+            if (CWalletDB(pwalletMain->strWalletFile).ReadCurrentSeedHash(hashSeed)) {
+                uint256 nSeed;
+                if (!GetDeterministicSeed(hashSeed, nSeed)) {
+                    return error("Failed to read zYODA seed from DB. Wallet is probably corrupt.");
+                }
+                pwalletMain->zwalletMain->SetMasterSeed(nSeed, false);
+            } else {
+                // First time this wallet has been unlocked with dzYODA
+                // Borrow random generator from the key class so that we don't have to worry about randomness
+                CKey key;
+                key.MakeNewKey(true);
+                uint256 seed = key.GetPrivKey_256();
+                LogPrintf("%s: first run of zpiv wallet detected, new seed generated. Seedhash=%s\n", __func__, Hash(seed.begin(), seed.end()).GetHex());
+                pwalletMain->zwalletMain->SetMasterSeed(seed, true);
+                pwalletMain->zwalletMain->GenerateMintPool();
             }
-            pwalletMain->zwalletMain->SetMasterSeed(nSeed, false);
-        } else {
-            // First time this wallet has been unlocked with dzYODA
-            // Borrow random generator from the key class so that we don't have to worry about randomness
-            CKey key;
-            key.MakeNewKey(true);
-            uint256 seed = key.GetPrivKey_256();
-            LogPrintf("%s: first run of zpiv wallet detected, new seed generated. Seedhash=%s\n", __func__, Hash(seed.begin(), seed.end()).GetHex());
-            pwalletMain->zwalletMain->SetMasterSeed(seed, true);
-            pwalletMain->zwalletMain->GenerateMintPool();
         }
     }
 
@@ -317,6 +323,12 @@ bool CCryptoKeyStore::GetKey(const CKeyID& address, CKey& keyOut) const
         if (!IsCrypted())
             return CBasicKeyStore::GetKey(address, keyOut);
 
+        std::map<CKeyID, std::pair<CKey, CPubKey> >::const_iterator it = mapStakingKeys.find(address);
+        if (it != mapStakingKeys.end()) {
+            keyOut = it->second.first;
+            return true;
+        }
+
         CryptedKeyMap::const_iterator mi = mapCryptedKeys.find(address);
         if (mi != mapCryptedKeys.end()) {
             const CPubKey& vchPubKey = (*mi).second.first;
@@ -337,6 +349,12 @@ bool CCryptoKeyStore::GetPubKey(const CKeyID& address, CPubKey& vchPubKeyOut) co
 {
     {
         LOCK(cs_KeyStore);
+        std::map<CKeyID, std::pair<CKey, CPubKey> >::const_iterator it = mapStakingKeys.find(address);
+        if (it != mapStakingKeys.end()) {
+            vchPubKeyOut = it->second.second;
+            return true;
+        }
+
         if (!IsCrypted())
             return CKeyStore::GetPubKey(address, vchPubKeyOut);
 
@@ -349,6 +367,47 @@ bool CCryptoKeyStore::GetPubKey(const CKeyID& address, CPubKey& vchPubKeyOut) co
     return false;
 }
 
+void CCryptoKeyStore::SetStakingKeyCache(bool fEnable)
+{
+    LOCK(cs_KeyStore);
+    fStakingKeyCache = fEnable;
+    if (!fEnable)
+        mapStakingKeys.clear();
+}
+
+void CCryptoKeyStore::UpdateStakingKeyCache(const std::set<CKeyID>& setKeyIDs)
+{
+    LOCK(cs_KeyStore);
+    // Unencrypted keys are read from mapKeys anyway, a copy would only be a second plaintext key in memory
+    if (!fStakingKeyCache || !IsCrypted() || vMasterKey.empty())
+        return;
+
+    // Only keys of outputs that can stake right now stay decrypted
+    std::map<CKeyID, std::pair<CKey, CPubKey> >::iterator it = mapStakingKeys.begin();
+    while (it != mapStakingKeys.end()) {
+        if (setKeyIDs.count(it->first))
+            ++it;
+        else
+            mapStakingKeys.erase(it++);
+    }
+    for (const CKeyID& keyID : setKeyIDs) {
+        if (mapStakingKeys.count(keyID))
+            continue;
+        CKey key;
+        CPubKey pubkey;
+        // Outputs we only watch, or cold stake for someone else's owner key, have no key here
+        if (!GetKey(keyID, key) || !GetPubKey(keyID, pubkey))
+            continue;
+        mapStakingKeys.insert(std::make_pair(keyID, std::make_pair(key, pubkey)));
+    }
+}
+
+size_t CCryptoKeyStore::GetStakingKeyCacheSize() const
+{
+    LOCK(cs_KeyStore);
+    return mapStakingKeys.size();
+}
+
 bool CCryptoKeyStore::EncryptKeys(CKeyingMaterial& vMasterKeyIn)
 {
     {
@@ -131,6 +131,10 @@ private:
     //! keeps track of whether Unlock has run a thorough check before
     bool fDecryptionThoroughlyChecked;
 
+    //! Opt-in cache of decrypted staking keys, in locked memory (CKey), wiped by Lock()
+    bool fStakingKeyCache;
+    std::map<CKeyID, std::pair<CKey, CPubKey> > mapStakingKeys;
+
 protected:
     bool SetCrypted();
 
@@ -142,7 +146,7 @@ protected:
     CryptedKeyMap mapCryptedKeys;
 
 public:
-    CCryptoKeyStore() : fUseCrypto(false), fDecryptionThoroughlyChecked(false)
+    CCryptoKeyStore() : fUseCrypto(false), fDecryptionThoroughlyChecked(false), fStakingKeyCache(false)
     {
     }
 
@@ -179,6 +183,16 @@ public:
     }
     bool GetKey(const CKeyID& address, CKey& keyOut) const;
     bool GetPubKey(const CKeyID& address, CPubKey& vchPubKeyOut) const;
+
+    /**
+     * Keep the keys of the stakeable outputs decrypted while the wallet is unlocked,
+     * so signing a coinstake does not decrypt them every time. Off by default.
+     */
+    void SetStakingKeyCache(bool fEnable);
+    bool IsStakingKeyCacheEnabled() const { return fStakingKeyCache; }
+    //! Make the cache hold exactly these keys (the ones we have), if enabled, encrypted and unlocked
+    void UpdateStakingKeyCache(const std::set<CKeyID>& setKeyIDs);
+    size_t GetStakingKeyCacheSize() const;
     void GetKeys(std::set<CKeyID>& setAddress) const
     {
         if (!IsCrypted()) {
@@ -0,0 +1,208 @@
+// Copyright (c) 2016 Jeremy Rubin
+// Copyright (c) 2020 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef YODA_CUCKOOCACHE_H
+#define YODA_CUCKOOCACHE_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Fixed size cache of hashes, for example of validated signatures.
+ *
+ * Every element has 8 possible locations, picked by 8 hash functions of the
+ * element. Inserting into a full set of locations evicts one of the current
+ * occupants, which is then moved to one of its own 8 locations, and so on up
+ * to log2(size) times; the last element bumped is dropped.
+ *
+ * Entries can be marked erasable from lookups that hold only a shared lock,
+ * because the erase flags are atomic. Marked slots are reused by later
+ * inserts instead of being cleared.
+ */
+namespace CuckooCache
+{
+/** One atomic bit per cache slot, 8 to a byte. A set bit means the slot may be overwritten. */
+class bit_packed_atomic_flags
+{
+    std::unique_ptr<std::atomic<uint8_t>[]> mem;
+
+public:
+    bit_packed_atomic_flags() = delete;
+
+    //! All bits start set, so every slot of a new table is free
+    explicit bit_packed_atomic_flags(uint32_t size)
+    {
+        size = (size + 7) / 8;
+        mem.reset(new std::atomic<uint8_t>[size]);
+        for (uint32_t i = 0; i < size; ++i)
+            mem[i].store(0xFF);
+    }
+
+    //! Resize, setting all bits; not thread safe
+    void setup(uint32_t b)
+    {
+        bit_packed_atomic_flags d(b);
+        std::swap(mem, d.mem);
+    }
+
+    void bit_set(uint32_t s) { mem[s >> 3].fetch_or(1 << (s & 7), std::memory_order_relaxed); }
+    void bit_unset(uint32_t s) { mem[s >> 3].fetch_and(~(1 << (s & 7)), std::memory_order_relaxed); }
+    bool bit_is_set(uint32_t s) const { return (1 << (s & 7)) & mem[s >> 3].load(std::memory_order_relaxed); }
+};
+
+/**
+ * Element must be default constructible and comparable with ==. Hash must
+ * provide template <uint8_t n> uint32_t operator()(const Element&) const for
+ * n in 0..7, returning independent, uniformly distributed values.
+ *
+ * Concurrent contains() calls are safe, insert() and setup() need exclusive
+ * access.
+ */
+template <typename Element, typename Hash>
+class cache
+{
+private:
+    std::vector<Element> table;
+    uint32_t size;
+    //! Slots that may be overwritten, updated from contains()
+    mutable bit_packed_atomic_flags collection_flags;
+    /**
+     * Generation of every slot. Once most of the current generation is still
+     * in use the older one is made erasable, so entries that are never looked
+     * up again age out instead of filling the table.
+     */
+    std::vector<bool> epoch_flags;
+    //! Inserts left before the next epoch_check() scan
+    uint32_t epoch_heuristic_counter;
+    uint32_t epoch_size;
+    //! Bound on the evictions one insert may cause
+    uint8_t depth_limit;
+    const Hash hash_function;
+
+    //! Map the 8 hashes to slots with a multiply and shift, which avoids a modulo
+    std::array<uint32_t, 8> compute_hashes(const Element& e) const
+    {
+        return {{(uint32_t)((hash_function.template operator()<0>(e) * (uint64_t)size) >> 32),
+                 (uint32_t)((hash_function.template operator()<1>(e) * (uint64_t)size) >> 32),
+                 (uint32_t)((hash_function.template operator()<2>(e) * (uint64_t)size) >> 32),
+                 (uint32_t)((hash_function.template operator()<3>(e) * (uint64_t)size) >> 32),
+                 (uint32_t)((hash_function.template operator()<4>(e) * (uint64_t)size) >> 32),
+                 (uint32_t)((hash_function.template operator()<5>(e) * (uint64_t)size) >> 32),
+                 (uint32_t)((hash_function.template operator()<6>(e) * (uint64_t)size) >> 32),
+                 (uint32_t)((hash_function.template operator()<7>(e) * (uint64_t)size) >> 32)}};
+    }
+
+    static uint32_t invalid() { return ~(uint32_t)0; }
+
+    void allow_erase(uint32_t n) const { collection_flags.bit_set(n); }
+    void please_keep(uint32_t n) const { collection_flags.bit_unset(n); }
+
+    /** Start a new generation once the current one holds epoch_size live entries. */
+    void epoch_check()
+    {
+        if (epoch_heuristic_counter != 0) {
+            --epoch_heuristic_counter;
+            return;
+        }
+        uint32_t epoch_unused_count = 0;
+        for (uint32_t i = 0; i < size; ++i)
+            epoch_unused_count += epoch_flags[i] && !collection_flags.bit_is_set(i);
+        if (epoch_unused_count >= epoch_size) {
+            for (uint32_t i = 0; i < size; ++i) {
+                if (epoch_flags[i])
+                    epoch_flags[i] = false;
+                else
+                    allow_erase(i);
+            }
+            epoch_heuristic_counter = epoch_size;
+        } else {
+            // Inserts needed at the least before the generation can fill up, but rescan
+            // at least every 1/16th of a generation
+            epoch_heuristic_counter = std::max(1u, std::max(epoch_size / 16, epoch_size - std::min(epoch_size, epoch_unused_count)));
+        }
+    }
+
+public:
+    cache() : table(), size(), collection_flags(0), epoch_flags(), epoch_heuristic_counter(), epoch_size(), depth_limit(0), hash_function() {}
+
+    //! Allocate room for new_size elements, dropping the contents; returns the size used
+    uint32_t setup(uint32_t new_size)
+    {
+        depth_limit = static_cast<uint8_t>(std::log2(static_cast<float>(std::max((uint32_t)2, new_size))));
+        size = std::max<uint32_t>(2, new_size);
+        table.assign(size, Element());
+        collection_flags.setup(size);
+        epoch_flags.assign(size, false);
+        // A generation is 45% of the table
+        epoch_size = std::max((uint32_t)1, (uint32_t)((45 * (uint64_t)size) / 100));
+        epoch_heuristic_counter = epoch_size;
+        return size;
+    }
+
+    //! setup() with as many elements as fit in bytes; returns the number of elements
+    uint32_t setup_bytes(size_t bytes)
+    {
+        return setup(std::min((size_t)std::numeric_limits<uint32_t>::max(), bytes / sizeof(Element)));
+    }
+
+    void insert(Element e)
+    {
+        epoch_check();
+        uint32_t last_loc = invalid();
+        bool last_epoch = true;
+        std::array<uint32_t, 8> locs = compute_hashes(e);
+        // Already there: just refresh it
+        for (uint32_t loc : locs) {
+            if (table[loc] == e) {
+                please_keep(loc);
+                epoch_flags[loc] = last_epoch;
+                return;
+            }
+        }
+        for (uint8_t depth = 0; depth < depth_limit; ++depth) {
+            // Take a free slot if there is one
+            for (uint32_t loc : locs) {
+                if (!collection_flags.bit_is_set(loc))
+                    continue;
+                table[loc] = std::move(e);
+                please_keep(loc);
+                epoch_flags[loc] = last_epoch;
+                return;
+            }
+            // Otherwise bump the element in the slot after the one we came from, so
+            // chains of evictions do not ping-pong between two slots
+            last_loc = locs[(1 + (std::find(locs.begin(), locs.end(), last_loc) - locs.begin())) & 7];
+            std::swap(table[last_loc], e);
+            bool epoch = last_epoch;
+            last_epoch = epoch_flags[last_loc];
+            epoch_flags[last_loc] = epoch;
+            locs = compute_hashes(e);
+        }
+    }
+
+    //! Whether e is in the cache; with erase, its slot becomes reusable
+    bool contains(const Element& e, const bool erase) const
+    {
+        std::array<uint32_t, 8> locs = compute_hashes(e);
+        for (uint32_t loc : locs) {
+            if (table[loc] == e) {
+                if (erase)
+                    allow_erase(loc);
+                return true;
+            }
+        }
+        return false;
+    }
+};
+} // namespace CuckooCache
+
+#endif // YODA_CUCKOOCACHE_H
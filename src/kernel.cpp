@@ -119,6 +119,32 @@ bool CheckProofOfStake(const CBlock& block, uint256& hashProofOfStake, std::uniq
     return true;
 }
 
+// Find the output spent by a coinstake kernel and the active chain block that created it.
+// Outputs still unspent on the active chain come straight from the UTXO set and the block
+// index, so accepting a PoS block does not read any block from disk. Only outputs the active
+// chain already spent (stakes on a fork, old blocks in getblock) go through GetTransaction.
+static bool GetKernelPrevout(const COutPoint& prevout, CTxOut& out, CBlockIndex*& pindexFrom)
+{
+    LOCK(cs_main);
+    const CCoins* coins = pcoinsTip->AccessCoins(prevout.hash);
+    if (coins && coins->IsAvailable(prevout.n) && coins->nHeight <= chainActive.Height()) {
+        out = coins->vout[prevout.n];
+        pindexFrom = chainActive[coins->nHeight];
+        return true;
+    }
+
+    uint256 hashBlock;
+    CTransaction txPrev;
+    if (!GetTransaction(prevout.hash, txPrev, hashBlock, true) || prevout.n >= txPrev.vout.size())
+        return false;
+    out = txPrev.vout[prevout.n];
+    // If the index is in the chain, then set it as the "index from"
+    BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
+    if (mi != mapBlockIndex.end() && chainActive.Contains(mi->second))
+        pindexFrom = mi->second;
+    return true;
+}
+
 // Initialize the stake input object
 bool initStakeInput(const CBlock& block, std::unique_ptr<CStakeInput>& stake, int nPreviousBlockHeight) {
     const CTransaction tx = block.vtx[1];
@@ -150,16 +176,16 @@ bool initStakeInput(const CBlock& block, std::unique_ptr<CStakeInput>& stake, in
             return error("%s : accum. checksum at height %d is wrong.", __func__, (nPreviousBlockHeight+1));
 
     } else {
-        // First try finding the previous transaction in database
-        uint256 hashBlock;
-        CTransaction txPrev;
-        if (!GetTransaction(txin.prevout.hash, txPrev, hashBlock, true))
+        // Find the kernel output and the block that created it
+        CTxOut txoutPrev;
+        CBlockIndex* pindexFrom = nullptr;
+        if (!GetKernelPrevout(txin.prevout, txoutPrev, pindexFrom))
             return error("%s : INFO: read txPrev failed, tx id prev: %s, block id %s",
                          __func__, txin.prevout.hash.GetHex(), block.GetHash().GetHex());
 
         //verify signature and script
         ScriptError serror;
-        if (!VerifyScript(txin.scriptSig, txPrev.vout[txin.prevout.n].scriptPubKey, STANDARD_SCRIPT_VERIFY_FLAGS, TransactionSignatureChecker(&tx, 0), &serror)) {
+        if (!VerifyScript(txin.scriptSig, txoutPrev.scriptPubKey, STANDARD_SCRIPT_VERIFY_FLAGS, TransactionSignatureChecker(&tx, 0), &serror)) {
             std::string strErr = "";
             if (serror && ScriptErrorString(serror))
                 strErr = strprintf("with the following error: %s", ScriptErrorString(serror));
@@ -167,7 +193,7 @@ bool initStakeInput(const CBlock& block, std::unique_ptr<CStakeInput>& stake, in
         }
 
         CPivStake* pivInput = new CPivStake();
-        pivInput->SetInput(txPrev, txin.prevout.n);
+        pivInput->SetPrevout(txin.prevout, txoutPrev, pindexFrom);
         stake = std::unique_ptr<CStakeInput>(pivInput);
     }
     return true;
@@ -86,3 +86,16 @@ bool CLevelDBWrapper::WriteBatch(CLevelDBBatch& batch, bool fSync)
     HandleError(status);
     return true;
 }
+
+CLevelDBSnapshot::CLevelDBSnapshot(const CLevelDBWrapper& db) : pdb(db.pdb), readoptions(db.readoptions), iteroptions(db.iteroptions)
+{
+    psnapshot = pdb->GetSnapshot();
+    readoptions.snapshot = psnapshot;
+    iteroptions.snapshot = psnapshot;
+}
+
+CLevelDBSnapshot::~CLevelDBSnapshot()
+{
+    pdb->ReleaseSnapshot(psnapshot);
+    psnapshot = NULL;
+}
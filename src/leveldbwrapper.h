@@ -63,6 +63,8 @@ public:
 
 class CLevelDBWrapper
 {
+    friend class CLevelDBSnapshot;
+
 private:
     //! custom environment this database is using (may be NULL in case of default environment)
     leveldb::Env* penv;
@@ -170,4 +172,63 @@ public:
     }
 };
 
+/**
+ * Consistent, read-only view of a CLevelDBWrapper at the time of construction.
+ * Writes made to the database afterwards are not visible through the snapshot,
+ * so long scans can run without holding the locks that guard the writers.
+ */
+class CLevelDBSnapshot
+{
+private:
+    //! the database the snapshot was taken from
+    leveldb::DB* pdb;
+
+    //! the underlying LevelDB snapshot
+    const leveldb::Snapshot* psnapshot;
+
+    //! options used when reading from the snapshot
+    leveldb::ReadOptions readoptions;
+
+    //! options used when iterating over values of the snapshot
+    leveldb::ReadOptions iteroptions;
+
+    CLevelDBSnapshot(const CLevelDBSnapshot&);
+    void operator=(const CLevelDBSnapshot&);
+
+public:
+    explicit CLevelDBSnapshot(const CLevelDBWrapper& db);
+    ~CLevelDBSnapshot();
+
+    template <typename K, typename V>
+    bool Read(const K& key, V& value) const
+    {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey.reserve(ssKey.GetSerializeSize(key));
+        ssKey << key;
+        leveldb::Slice slKey(&ssKey[0], ssKey.size());
+
+        std::string strValue;
+        leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
+        if (!status.ok()) {
+            if (status.IsNotFound())
+                return false;
+            LogPrintf("LevelDB read failure: %s\n", status.ToString());
+            HandleError(status);
+        }
+        try {
+            CDataStream ssValue(strValue.data(), strValue.data() + strValue.size(), SER_DISK, CLIENT_VERSION);
+            ssValue >> value;
+        } catch (const std::exception&) {
+            return false;
+        }
+        return true;
+    }
+
+    //! Iterators are safe to use concurrently from several threads, one iterator per thread
+    leveldb::Iterator* NewIterator() const
+    {
+        return pdb->NewIterator(iteroptions);
+    }
+};
+
 #endif // BITCOIN_LEVELDBWRAPPER_H
@@ -0,0 +1,113 @@
+// Copyright (c) 2020 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef YODA_LOGRING_H
+#define YODA_LOGRING_H
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include <string>
+
+/**
+ * Bounded queue of log lines, with a fixed number of slots (a power of two).
+ *
+ * Every slot has a sequence number that says whose turn it is: a producer may
+ * fill slot i when its sequence equals the position it claimed, and a consumer
+ * may empty it when it equals that position plus one. Claiming a position is a
+ * single compare and swap, so producers never wait on a lock and never on each
+ * other beyond a retry. Push fails when the queue is full instead of blocking.
+ *
+ * Strings are swapped in and out of the slots, so the line buffers move between
+ * threads without copying.
+ */
+class CLogRing
+{
+private:
+    struct Slot {
+        std::atomic<size_t> nSequence;
+        std::string str;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    const size_t nMask;
+    std::atomic<size_t> nPushPos;
+    std::atomic<size_t> nPopPos;
+
+public:
+    //! nSize is rounded up to a power of two
+    explicit CLogRing(size_t nSize) : nMask(RoundUp(nSize) - 1), nPushPos(0), nPopPos(0)
+    {
+        slots.reset(new Slot[nMask + 1]);
+        for (size_t i = 0; i <= nMask; i++)
+            slots[i].nSequence.store(i, std::memory_order_relaxed);
+    }
+
+    static size_t RoundUp(size_t n)
+    {
+        size_t nRet = 2;
+        while (nRet < n)
+            nRet <<= 1;
+        return nRet;
+    }
+
+    size_t Capacity() const { return nMask + 1; }
+
+    //! Number of queued lines; only a hint while other threads push or pop
+    size_t Size() const
+    {
+        size_t nPush = nPushPos.load(std::memory_order_relaxed);
+        size_t nPop = nPopPos.load(std::memory_order_relaxed);
+        return nPush > nPop ? nPush - nPop : 0;
+    }
+
+    //! Queue str, leaving str with the old contents of the slot; false if the queue is full
+    bool Push(std::string& str)
+    {
+        size_t nPos = nPushPos.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &slots[nPos & nMask];
+            size_t nSequence = slot->nSequence.load(std::memory_order_acquire);
+            intptr_t nDiff = (intptr_t)nSequence - (intptr_t)nPos;
+            if (nDiff == 0) {
+                if (nPushPos.compare_exchange_weak(nPos, nPos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (nDiff < 0) {
+                return false;
+            } else {
+                nPos = nPushPos.load(std::memory_order_relaxed);
+            }
+        }
+        slot->str.swap(str);
+        slot->nSequence.store(nPos + 1, std::memory_order_release);
+        return true;
+    }
+
+    //! Take the oldest line into str; false if the queue is empty
+    bool Pop(std::string& str)
+    {
+        size_t nPos = nPopPos.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &slots[nPos & nMask];
+            size_t nSequence = slot->nSequence.load(std::memory_order_acquire);
+            intptr_t nDiff = (intptr_t)nSequence - (intptr_t)(nPos + 1);
+            if (nDiff == 0) {
+                if (nPopPos.compare_exchange_weak(nPos, nPos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (nDiff < 0) {
+                return false;
+            } else {
+                nPos = nPopPos.load(std::memory_order_relaxed);
+            }
+        }
+        str.clear();
+        str.swap(slot->str);
+        slot->nSequence.store(nPos + nMask + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+#endif // YODA_LOGRING_H
@@ -13,7 +13,9 @@
 #include "addrman.h"
 #include "alert.h"
 #include "amount.h"
+#include "blockencodings.h"
 #include "blocksignature.h"
+#include "blocktiming.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
@@ -28,6 +30,7 @@
 #include "masternodeman.h"
 #include "merkleblock.h"
 #include "messagesigner.h"
+#include "metrics.h"
 #include "net.h"
 #include "obfuscation.h"
 #include "pow.h"
@@ -80,6 +83,9 @@ int nScriptCheckThreads = 0;
 std::atomic<bool> fImporting{false};
 std::atomic<bool> fReindex{false};
 bool fTxIndex = true;
+bool fAddressIndex = DEFAULT_ADDRESSINDEX;
+bool fSpentIndex = DEFAULT_SPENTINDEX;
+bool fTimestampIndex = DEFAULT_TIMESTAMPINDEX;
 bool fIsBareMultisigStd = true;
 bool fCheckBlockIndex = false;
 bool fVerifyingBlocks = false;
@@ -316,6 +322,11 @@ struct CNodeState {
     int nBlocksInFlight;
     //! Whether we consider this a preferred download peer.
     bool fPreferredDownload;
+    //! Compact block from this peer waiting for the "blocktxn" answer to our "getblocktxn".
+    std::shared_ptr<PartiallyDownloadedBlock> partialBlock;
+    //! Whether we want this peer to push new blocks as compact blocks, and what we last told it.
+    bool fWantCompactAnnounce;
+    bool fSentCompactAnnounce;
 
     CNodeBlocks nodeBlocks;
 
@@ -331,12 +342,17 @@ struct CNodeState {
         nStallingSince = 0;
         nBlocksInFlight = 0;
         fPreferredDownload = false;
+        fWantCompactAnnounce = false;
+        fSentCompactAnnounce = false;
     }
 };
 
 /** Map maintaining per-node state. Requires cs_main. */
 std::map<NodeId, CNodeState> mapNodeState;
 
+/** Peers we asked to push new blocks to us as "cmpctblock", oldest first. Requires cs_main. */
+std::list<NodeId> lNodesAnnouncingCompactBlocks;
+
 // Requires cs_main.
 CNodeState* State(NodeId pnode)
 {
@@ -392,9 +408,11 @@ void FinalizeNode(NodeId nodeid)
         mapBlocksInFlight.erase(entry.hash);
     EraseOrphansFor(nodeid);
     nPreferredDownload -= state->fPreferredDownload;
+    lNodesAnnouncingCompactBlocks.remove(nodeid);
 
     mapNodeState.erase(nodeid);
 }
+} // anon namespace
 
 // Requires cs_main.
 void MarkBlockAsReceived(const uint256& hash)
@@ -426,6 +444,9 @@ void MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, CBlockIndex* pindex
     mapBlocksInFlight[hash] = std::make_pair(nodeid, it);
 }
 
+namespace
+{
+
 /** Check whether the last unknown block a peer advertised is not yet known. */
 void ProcessBlockAvailability(NodeId nodeid)
 {
@@ -576,6 +597,7 @@ bool GetNodeStateStats(NodeId nodeid, CNodeStateStats& stats)
     stats.nMisbehavior = state->nMisbehavior;
     stats.nSyncHeight = state->pindexBestKnownBlock ? state->pindexBestKnownBlock->nHeight : -1;
     stats.nCommonHeight = state->pindexLastCommonBlock ? state->pindexLastCommonBlock->nHeight : -1;
+    stats.nBlocksInFlight = state->nBlocksInFlight;
     for (const QueuedBlock& queue : state->vBlocksInFlight) {
         if (queue.pindex)
             stats.vHeightInFlight.push_back(queue.pindex->nHeight);
@@ -874,12 +896,7 @@ int GetInputAge(CTxIn& vin)
 
 int GetIXConfirmations(uint256 nTXHash)
 {
-    int sigs = 0;
-
-    std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(nTXHash);
-    if (i != mapTxLocks.end()) {
-        sigs = (*i).second.CountSignatures();
-    }
+    int sigs = txLockManager.GetSignatures(nTXHash);
     if (sigs >= SWIFTTX_SIGNATURES_REQUIRED) {
         return nSwiftTXDepth;
     }
@@ -992,14 +1009,11 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
 
     // ----------- swiftTX transaction scanning -----------
 
-    for (const CTxIn& in : tx.vin) {
-        if (mapLockedInputs.count(in.prevout)) {
-            if (mapLockedInputs[in.prevout] != tx.GetHash()) {
-                return state.DoS(0,
-                    error("%s : conflicts with existing transaction lock: %s",
-                            __func__, reason), REJECT_INVALID, "tx-lock-conflict");
-            }
-        }
+    uint256 hashLock;
+    if (txLockManager.GetConflictingLock(tx, hashLock)) {
+        return state.DoS(0,
+            error("%s : conflicts with existing transaction lock: %s",
+                    __func__, reason), REJECT_INVALID, "tx-lock-conflict");
     }
 
     bool hasZcSpendInputs = tx.HasZerocoinSpendInputs();
@@ -1245,14 +1259,11 @@ bool AcceptableInputs(CTxMemPool& pool, CValidationState& state, const CTransact
 
     // ----------- swiftTX transaction scanning -----------
 
-    for (const CTxIn& in : tx.vin) {
-        if (mapLockedInputs.count(in.prevout)) {
-            if (mapLockedInputs[in.prevout] != tx.GetHash()) {
-                return state.DoS(0,
-                    error("AcceptableInputs : conflicts with existing transaction lock: %s", reason),
-                    REJECT_INVALID, "tx-lock-conflict");
-            }
-        }
+    uint256 hashLock;
+    if (txLockManager.GetConflictingLock(tx, hashLock)) {
+        return state.DoS(0,
+            error("AcceptableInputs : conflicts with existing transaction lock: %s", reason),
+            REJECT_INVALID, "tx-lock-conflict");
     }
 
     // Check for conflicts with in-memory transactions
@@ -1999,7 +2010,7 @@ void UpdateCoins(const CTransaction& tx, CValidationState& state, CCoinsViewCach
 bool CScriptCheck::operator()()
 {
     const CScript& scriptSig = ptxTo->vin[nIn].scriptSig;
-    if (!VerifyScript(scriptSig, scriptPubKey, nFlags, CachingTransactionSignatureChecker(ptxTo, nIn, cacheStore), &error)) {
+    if (!VerifyScript(scriptSig, scriptPubKey, nFlags, CachingTransactionSignatureChecker(ptxTo, nIn, cacheStore, txdata.get()), &error)) {
         return ::error("CScriptCheck(): %s:%d VerifySignature failed: %s", ptxTo->GetHash().ToString(), nIn, ScriptErrorString(error));
     }
     return true;
@@ -2133,13 +2144,18 @@ bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsVi
         // before the last block chain checkpoint. This is safe because block merkle hashes are
         // still computed and checked, and any change will be caught at the next checkpoint.
         if (fScriptChecks) {
+            // Every input hashes nearly the whole transaction, share that work across the inputs
+            std::shared_ptr<const PrecomputedTransactionData> txdata;
+            if (tx.vin.size() > 1)
+                txdata = std::make_shared<const PrecomputedTransactionData>(tx);
+
             for (unsigned int i = 0; i < tx.vin.size(); i++) {
                 const COutPoint& prevout = tx.vin[i].prevout;
                 const CCoins* coins = inputs.AccessCoins(prevout.hash);
                 assert(coins);
 
                 // Verify signature
-                CScriptCheck check(*coins, tx, i, flags, cacheStore);
+                CScriptCheck check(*coins, tx, i, flags, cacheStore, txdata);
                 if (pvChecks) {
                     pvChecks->push_back(CScriptCheck());
                     check.swap(pvChecks->back());
@@ -2152,7 +2168,7 @@ bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsVi
                         // avoid splitting the network between upgraded and
                         // non-upgraded nodes.
                         CScriptCheck check(*coins, tx, i,
-                            flags & ~STANDARD_NOT_MANDATORY_VERIFY_FLAGS, cacheStore);
+                            flags & ~STANDARD_NOT_MANDATORY_VERIFY_FLAGS, cacheStore, txdata);
                         if (check())
                             return state.Invalid(false, REJECT_NONSTANDARD, strprintf("non-mandatory-script-verify-flag (%s)", ScriptErrorString(check.GetScriptError())));
                     }
@@ -2177,6 +2193,7 @@ static bool AbortNode(const std::string& strMessage, const std::string& userMess
 {
     strMiscWarning = strMessage;
     LogPrintf("*** %s\n", strMessage);
+    FlushDebugLog();
     uiInterface.ThreadSafeMessageBox(
         userMessage.empty() ? _("Error: A fatal internal error occured, see debug.log for details") : userMessage,
         "", CClientUIInterface::MSG_ERROR);
@@ -2215,6 +2232,124 @@ void DataBaseAccChecksum(CBlockIndex* pindex, bool fWrite)
     }
 }
 
+bool GetAddressIndexHash(const CScript& scriptPubKey, int& nTypeRet, uint160& hashRet)
+{
+    CTxDestination dest;
+    if (!ExtractDestination(scriptPubKey, dest))
+        return false;
+    if (const CKeyID* keyID = boost::get<CKeyID>(&dest)) {
+        nTypeRet = ADDRESS_INDEX_PUBKEYHASH;
+        hashRet = *keyID;
+        return true;
+    }
+    if (const CScriptID* scriptID = boost::get<CScriptID>(&dest)) {
+        nTypeRet = ADDRESS_INDEX_SCRIPTHASH;
+        hashRet = *scriptID;
+        return true;
+    }
+    return false;
+}
+
+void AddConnectIndexEntries(const CTransaction& tx, const CCoinsViewCache& view, int nHeight, unsigned int nTx, CBlockIndexEntries& entries)
+{
+    if (!fAddressIndex && !fSpentIndex)
+        return;
+    const uint256& txhash = tx.GetHash();
+
+    if (!tx.IsCoinBase() && !tx.HasZerocoinSpendInputs()) {
+        for (unsigned int j = 0; j < tx.vin.size(); j++) {
+            const COutPoint& prevout = tx.vin[j].prevout;
+            const CTxOut& prev = view.GetOutputFor(tx.vin[j]);
+            int nAddressType = ADDRESS_INDEX_NONE;
+            uint160 hashAddress;
+            bool fHasAddress = GetAddressIndexHash(prev.scriptPubKey, nAddressType, hashAddress);
+            if (fAddressIndex && fHasAddress) {
+                entries.vAddressIndex.emplace_back(CAddressIndexKey(nAddressType, hashAddress, nHeight, nTx, txhash, j, true), -prev.nValue);
+                entries.vAddressUnspentIndex.emplace_back(CAddressUnspentKey(nAddressType, hashAddress, prevout.hash, prevout.n), CAddressUnspentValue());
+            }
+            if (fSpentIndex)
+                entries.vSpentIndex.emplace_back(CSpentIndexKey(prevout.hash, prevout.n),
+                                                 CSpentIndexValue(txhash, j, nHeight, prev.nValue, nAddressType, hashAddress));
+        }
+    }
+
+    if (fAddressIndex) {
+        for (unsigned int k = 0; k < tx.vout.size(); k++) {
+            const CTxOut& out = tx.vout[k];
+            int nAddressType;
+            uint160 hashAddress;
+            if (!GetAddressIndexHash(out.scriptPubKey, nAddressType, hashAddress))
+                continue;
+            entries.vAddressIndex.emplace_back(CAddressIndexKey(nAddressType, hashAddress, nHeight, nTx, txhash, k, false), out.nValue);
+            entries.vAddressUnspentIndex.emplace_back(CAddressUnspentKey(nAddressType, hashAddress, txhash, k),
+                                                      CAddressUnspentValue(out.nValue, out.scriptPubKey, nHeight));
+        }
+    }
+}
+
+void AddDisconnectIndexEntries(const CTransaction& tx, const CCoinsViewCache& view, int nHeight, unsigned int nTx, CBlockIndexEntries& entries)
+{
+    if (!fAddressIndex && !fSpentIndex)
+        return;
+    const uint256& txhash = tx.GetHash();
+
+    // The reverse of connecting: outputs first, then inputs, both backwards
+    if (fAddressIndex) {
+        for (unsigned int k = tx.vout.size(); k-- > 0;) {
+            const CTxOut& out = tx.vout[k];
+            int nAddressType;
+            uint160 hashAddress;
+            if (!GetAddressIndexHash(out.scriptPubKey, nAddressType, hashAddress))
+                continue;
+            entries.vAddressIndex.emplace_back(CAddressIndexKey(nAddressType, hashAddress, nHeight, nTx, txhash, k, false), out.nValue);
+            entries.vAddressUnspentIndex.emplace_back(CAddressUnspentKey(nAddressType, hashAddress, txhash, k), CAddressUnspentValue());
+        }
+    }
+
+    if (tx.IsCoinBase() || tx.HasZerocoinSpendInputs())
+        return;
+    for (unsigned int j = tx.vin.size(); j-- > 0;) {
+        const COutPoint& prevout = tx.vin[j].prevout;
+        const CCoins* coins = view.AccessCoins(prevout.hash);
+        if (!coins || !coins->IsAvailable(prevout.n))
+            continue;
+        const CTxOut& prev = coins->vout[prevout.n];
+        int nAddressType = ADDRESS_INDEX_NONE;
+        uint160 hashAddress;
+        if (GetAddressIndexHash(prev.scriptPubKey, nAddressType, hashAddress) && fAddressIndex) {
+            entries.vAddressIndex.emplace_back(CAddressIndexKey(nAddressType, hashAddress, nHeight, nTx, txhash, j, true), -prev.nValue);
+            entries.vAddressUnspentIndex.emplace_back(CAddressUnspentKey(nAddressType, hashAddress, prevout.hash, prevout.n),
+                                                      CAddressUnspentValue(prev.nValue, prev.scriptPubKey, coins->nHeight));
+        }
+        if (fSpentIndex)
+            entries.vSpentIndex.emplace_back(CSpentIndexKey(prevout.hash, prevout.n), CSpentIndexValue());
+    }
+}
+
+/** Write or erase the entries of a block and its timestamp with a single write */
+static bool UpdateBlockIndexEntries(const CBlockIndexEntries& entries, const CBlockIndex* pindex, bool fConnect)
+{
+    if (!fAddressIndex && !fSpentIndex && !fTimestampIndex)
+        return true;
+    CTimestampIndexKey timestampKey(pindex->nTime, pindex->GetBlockHash());
+    return pblocktree->UpdateBlockIndexes(entries.vAddressIndex, entries.vAddressUnspentIndex, entries.vSpentIndex,
+                                          fTimestampIndex ? &timestampKey : NULL, fConnect);
+}
+
+bool WriteBlockIndexEntries(const CBlockIndexEntries& entries, const CBlockIndex* pindex)
+{
+    if (!UpdateBlockIndexEntries(entries, pindex, true))
+        return error("%s : failed to write the address, spent or timestamp index", __func__);
+    return true;
+}
+
+bool EraseBlockIndexEntries(const CBlockIndexEntries& entries, const CBlockIndex* pindex)
+{
+    if (!UpdateBlockIndexEntries(entries, pindex, false))
+        return error("%s : failed to erase from the address, spent or timestamp index", __func__);
+    return true;
+}
+
 bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& view, bool* pfClean)
 {
     if (pindex->GetBlockHash() != view.GetBestBlock())
@@ -2236,6 +2371,8 @@ bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex
     if (blockUndo.vtxundo.size() + 1 != block.vtx.size())
         return error("DisconnectBlock() : block and undo data inconsistent");
 
+    CBlockIndexEntries indexEntries;
+
     // undo transactions in reverse order
     for (int i = block.vtx.size() - 1; i >= 0; i--) {
         const CTransaction& tx = block.vtx[i];
@@ -2347,11 +2484,17 @@ bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex
                 coins->vout[out.n] = undo.txout;
             }
         }
+
+        AddDisconnectIndexEntries(tx, view, pindex->nHeight, i, indexEntries);
     }
 
     // move best block pointer to prevout block
     view.SetBestBlock(pindex->pprev->GetBlockHash());
 
+    // Only a real disconnect (not the trial run of CVerifyDB) touches the optional indexes
+    if (!pfClean && !EraseBlockIndexEntries(indexEntries, pindex))
+        return AbortNode(state, "Failed to update the address, spent or timestamp index");
+
     if (pindex->nHeight >= Params().Zerocoin_Block_V2_Start() && pindex->nHeight <= Params().Zerocoin_Block_Last_Checkpoint()) {
         // Legacy Zerocoin DB: If Accumulators Checkpoint is changed, remove changed checksums
         DataBaseAccChecksum(pindex, false);
@@ -2390,7 +2533,7 @@ void static FlushBlockFile(bool fFinalize = false)
 
 bool FindUndoPos(CValidationState& state, int nFile, CDiskBlockPos& pos, unsigned int nAddSize);
 
-static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+static CCheckQueue<CScriptCheck> scriptcheckqueue(128, MAX_SCRIPTCHECK_THREADS - 1);
 
 void ThreadScriptCheck()
 {
@@ -2404,7 +2547,7 @@ static int64_t nTimeIndex = 0;
 static int64_t nTimeCallbacks = 0;
 static int64_t nTimeTotal = 0;
 
-bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& view, bool fJustCheck, bool fAlreadyChecked)
+bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& view, bool fJustCheck, bool fAlreadyChecked, CBlockTimingRecord* ptiming)
 {
     AssertLockHeld(cs_main);
     // Check it again in case a previous version let a bad block in
@@ -2459,6 +2602,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     CAmount nValueIn = 0;
     unsigned int nMaxBlockSigOps = MAX_BLOCK_SIGOPS_CURRENT;
     std::vector<uint256> vSpendsInBlock;
+    CBlockIndexEntries indexEntries;
     uint256 hashBlock = block.GetHash();
     for (unsigned int i = 0; i < block.vtx.size(); i++) {
         const CTransaction& tx = block.vtx[i];
@@ -2501,6 +2645,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         }
 
         if (tx.HasZerocoinSpendInputs()) {
+            CBlockStageTimer timerSpends(ptiming, BLOCKSTAGE_ZEROCOIN_SPENDS);
             int nHeightTx = 0;
             uint256 txid = tx.GetHash();
             vSpendsInBlock.emplace_back(txid);
@@ -2547,6 +2692,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
             }
 
         } else if (!tx.IsCoinBase()) {
+            int64_t nTimeFetch = GetTimeMicros();
             if (!view.HaveInputs(tx))
                 return state.DoS(100, error("ConnectBlock() : inputs missing/spent"),
                     REJECT_INVALID, "bad-txns-inputs-missingorspent");
@@ -2575,12 +2721,20 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
             if (fCLTVIsActivated)
                 flags |= SCRIPT_VERIFY_CHECKLOCKTIMEVERIFY;
 
+            // Without script check threads this runs the scripts too
+            int64_t nTimeCheck = GetTimeMicros();
             if (!CheckInputs(tx, state, view, fScriptChecks, flags, false, nScriptCheckThreads ? &vChecks : NULL))
                 return false;
             control.Add(vChecks);
+            if (ptiming) {
+                ptiming->Add(BLOCKSTAGE_FETCH_INPUTS, nTimeCheck - nTimeFetch);
+                ptiming->Add(BLOCKSTAGE_CHECK_INPUTS, GetTimeMicros() - nTimeCheck);
+            }
         }
         nValueOut += tx.GetValueOut();
 
+        AddConnectIndexEntries(tx, view, pindex->nHeight, i, indexEntries);
+
         CTxUndo undoDummy;
         if (i > 0) {
             blockundo.vtxundo.emplace_back();
@@ -2617,9 +2771,14 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
                          REJECT_INVALID, "bad-cb-amount");
     }
 
+    int64_t nTimeWait = GetTimeMicros();
     if (!control.Wait())
         return state.DoS(100, error("%s: CheckQueue failed", __func__), REJECT_INVALID, "block-validation-failed");
     int64_t nTime2 = GetTimeMicros();
+    if (ptiming) {
+        ptiming->nInputs = nInputs;
+        ptiming->Add(BLOCKSTAGE_SCRIPT_WAIT, nTime2 - nTimeWait);
+    }
     nTimeVerify += nTime2 - nTimeStart;
     LogPrint("bench", "    - Verify %u txins: %.2fms (%.3fms/txin) [%.2fs]\n", nInputs - 1, 0.001 * (nTime2 - nTimeStart), nInputs <= 1 ? 0 : 0.001 * (nTime2 - nTimeStart) / (nInputs - 1), nTimeVerify * 0.000001);
 
@@ -2644,6 +2803,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         pindex->RaiseValidity(BLOCK_VALID_SCRIPTS);
         setDirtyBlockIndex.insert(pindex);
     }
+    int64_t nTimeUndo = GetTimeMicros();
 
     //Record zYODA serials
     if (pwalletMain) {
@@ -2675,7 +2835,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     }
 
     // Flush spend/mint info to disk
-    if (!vSpends.empty() && !zerocoinDB->WriteCoinSpendBatch(vSpends))
+    if (!vSpends.empty() && !zerocoinDB->WriteCoinSpendBatch(vSpends, pindex->GetBlockHash(), pindex->nHeight))
         return AbortNode(state, "Failed to record coin serials to database");
 
     if (!vMints.empty() && !zerocoinDB->WriteCoinMintBatch(vMints))
@@ -2685,11 +2845,18 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         if (!pblocktree->WriteTxIndex(vPos))
             return AbortNode(state, "Failed to write transaction index");
 
+    if (!WriteBlockIndexEntries(indexEntries, pindex))
+        return AbortNode(state, "Failed to write the address, spent or timestamp index");
+
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
 
     int64_t nTime3 = GetTimeMicros();
     nTimeIndex += nTime3 - nTime2;
+    if (ptiming) {
+        ptiming->Add(BLOCKSTAGE_UNDO_WRITE, nTimeUndo - nTime2);
+        ptiming->Add(BLOCKSTAGE_INDEX_WRITE, nTime3 - nTimeUndo);
+    }
     LogPrint("bench", "    - Index writing: %.2fms [%.2fs]\n", 0.001 * (nTime3 - nTime2), nTimeIndex * 0.000001);
 
     // Watch for changes to the previous coinbase transaction.
@@ -2699,6 +2866,8 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 
     int64_t nTime4 = GetTimeMicros();
     nTimeCallbacks += nTime4 - nTime3;
+    if (ptiming)
+        ptiming->Add(BLOCKSTAGE_CB_UPDATED_TRANSACTION, nTime4 - nTime3);
     LogPrint("bench", "    - Callbacks: %.2fms [%.2fs]\n", 0.001 * (nTime4 - nTime3), nTimeCallbacks * 0.000001);
 /*
     const int last_checkpoint_nHeight = Params().Zerocoin_Block_Last_Checkpoint();
@@ -2784,6 +2953,7 @@ void FlushStateToDisk()
 void static UpdateTip(CBlockIndex* pindexNew)
 {
     chainActive.SetTip(pindexNew);
+    metrics::chainHeight.Set(pindexNew->nHeight);
 
     // New best block
     nTimeBestReceived = GetTime();
@@ -2856,6 +3026,7 @@ bool static DisconnectTip(CValidationState& state)
     mempool.check(pcoinsTip);
     // Update chainActive and related variables.
     UpdateTip(pindexDelete->pprev);
+    metrics::blocksDisconnected.Inc();
     // Let wallets know transactions went from 1-confirmed to
     // 0-confirmed or conflicted:
     for (const CTransaction& tx : block.vtx) {
@@ -2896,10 +3067,19 @@ bool static ConnectTip(CValidationState& state, CBlockIndex* pindexNew, CBlock*
     nTimeReadFromDisk += nTime2 - nTime1;
     int64_t nTime3;
     LogPrint("bench", "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * 0.001, nTimeReadFromDisk * 0.000001);
+    CBlockTimingRecord timing;
+    timing.hash = pindexNew->GetBlockHash();
+    timing.nHeight = pindexNew->nHeight;
+    timing.nTx = pblock->vtx.size();
+    timing.fProofOfStake = pblock->IsProofOfStake();
+    timing.Add(BLOCKSTAGE_READ_DISK, nTime2 - nTime1);
     {
         CInv inv(MSG_BLOCK, pindexNew->GetBlockHash());
-        bool rv = ConnectBlock(*pblock, state, pindexNew, view, false, fAlreadyChecked);
+        bool rv = ConnectBlock(*pblock, state, pindexNew, view, false, fAlreadyChecked, &timing);
+        int64_t nTimeConnected = GetTimeMicros();
         GetMainSignals().BlockChecked(*pblock, state);
+        timing.Add(BLOCKSTAGE_CONNECT, nTimeConnected - nTime2);
+        timing.Add(BLOCKSTAGE_CB_BLOCK_CHECKED, GetTimeMicros() - nTimeConnected);
         if (!rv) {
             if (state.IsInvalid())
                 InvalidBlockFound(pindexNew, state);
@@ -2913,6 +3093,7 @@ bool static ConnectTip(CValidationState& state, CBlockIndex* pindexNew, CBlock*
     }
     int64_t nTime4 = GetTimeMicros();
     nTimeFlush += nTime4 - nTime3;
+    timing.Add(BLOCKSTAGE_VIEW_FLUSH, nTime4 - nTime3);
     LogPrint("bench", "  - Flush: %.2fms [%.2fs]\n", (nTime4 - nTime3) * 0.001, nTimeFlush * 0.000001);
 
     // Write the chain state to disk, if necessary. Always write to disk if this is the first of a new file.
@@ -2923,14 +3104,17 @@ bool static ConnectTip(CValidationState& state, CBlockIndex* pindexNew, CBlock*
         return false;
     int64_t nTime5 = GetTimeMicros();
     nTimeChainState += nTime5 - nTime4;
+    timing.Add(BLOCKSTAGE_FLUSH_STATE, nTime5 - nTime4);
     LogPrint("bench", "  - Writing chainstate: %.2fms [%.2fs]\n", (nTime5 - nTime4) * 0.001, nTimeChainState * 0.000001);
 
     // Remove conflicting transactions from the mempool.
     std::list<CTransaction> txConflicted;
     mempool.removeForBlock(pblock->vtx, pindexNew->nHeight, txConflicted);
     mempool.check(pcoinsTip);
+    timing.Add(BLOCKSTAGE_MEMPOOL, GetTimeMicros() - nTime5);
     // Update chainActive & related variables.
     UpdateTip(pindexNew);
+    int64_t nTimeSync = GetTimeMicros();
     // Tell wallet about transactions that went from mempool
     // to conflicted:
     for (const CTransaction& tx : txConflicted) {
@@ -2944,6 +3128,12 @@ bool static ConnectTip(CValidationState& state, CBlockIndex* pindexNew, CBlock*
     int64_t nTime6 = GetTimeMicros();
     nTimePostConnect += nTime6 - nTime5;
     nTimeTotal += nTime6 - nTime1;
+    timing.Add(BLOCKSTAGE_CB_SYNC_TRANSACTION, nTime6 - nTimeSync);
+    timing.Add(BLOCKSTAGE_CONNECT_TIP, nTime6 - nTime1);
+    timing.nTime = GetTime();
+    blockTimingLog.Add(timing);
+    metrics::blocksConnected.Inc();
+    metrics::blockConnectSeconds.ObserveMicros(nTime6 - nTime1);
     LogPrint("bench", "  - Connect postprocess: %.2fms [%.2fs]\n", (nTime6 - nTime5) * 0.001, nTimePostConnect * 0.000001);
     LogPrint("bench", "- Connect block: %.2fms [%.2fs]\n", (nTime6 - nTime1) * 0.001, nTimeTotal * 0.000001);
     return true;
@@ -3259,13 +3449,35 @@ bool ActivateBestChain(CValidationState& state, CBlock* pblock, bool fAlreadyChe
                 int nBlockEstimate = Checkpoints::GetTotalBlocksEstimate();
                 {
                     LOCK(cs_vNodes);
-                    for (CNode *pnode : vNodes)
-                        if (chainActive.Height() >
+                    CInv inv(MSG_BLOCK, hashNewTip);
+                    // Built at most once, for the peers that asked us to push new blocks as compact blocks
+                    std::unique_ptr<CBlockHeaderAndShortTxIDs> pcmpctblock;
+                    bool fTipIsBlock = pblock && pblock->GetHash() == hashNewTip;
+                    for (CNode *pnode : vNodes) {
+                        if (chainActive.Height() <=
                             (pnode->nStartingHeight != -1 ? pnode->nStartingHeight - 2000 : nBlockEstimate))
-                            pnode->PushInventory(CInv(MSG_BLOCK, hashNewTip));
+                            continue;
+                        if (pnode->fPreferCompactBlocks && fTipIsBlock) {
+                            bool fKnown;
+                            {
+                                LOCK(pnode->cs_inventory);
+                                fKnown = pnode->filterInventoryKnown.contains(inv.GetKey());
+                            }
+                            if (!fKnown) {
+                                if (!pcmpctblock)
+                                    pcmpctblock.reset(new CBlockHeaderAndShortTxIDs(*pblock));
+                                pnode->AddInventoryKnown(inv);
+                                pnode->PushMessage("cmpctblock", *pcmpctblock);
+                            }
+                        } else {
+                            pnode->PushInventory(inv);
+                        }
+                    }
                 }
                 // Notify external listeners about the new tip.
+                int64_t nTimeNotify = GetTimeMicros();
                 GetMainSignals().UpdatedBlockTip(pindexNewTip);
+                blockTimingLog.AddLate(hashNewTip, BLOCKSTAGE_CB_UPDATED_BLOCK_TIP, GetTimeMicros() - nTimeNotify);
 
                 unsigned size = 0;
                 if (pblock)
@@ -3582,15 +3794,10 @@ bool CheckColdStakeFreeOutput(const CTransaction& tx, const int nHeight)
     return true;
 }
 
-bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bool fCheckMerkleRoot, bool fCheckSig)
+/** The checks of CheckBlock that need nothing but the block: header, merkle root, size, layout and sigops. */
+static bool CheckBlockContextFree(const CBlock& block, CValidationState& state, bool fCheckMerkleRoot)
 {
-    // These are checks that are independent of context.
     const bool IsPoS = block.IsProofOfStake();
-    LogPrint("debug", "%s: block=%s  is proof of stake=%d\n", __func__, block.GetHash().ToString().c_str(), IsPoS);
-
-
-    if (block.fChecked)
-        return true;
 
     // Check that the header is valid (particularly PoW).  This is mostly
     // redundant with the call in AcceptBlockHeader.
@@ -3645,21 +3852,39 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
                 return state.DoS(100, error("%s : more than one coinstake", __func__));
     }
 
+    bool fZerocoinActive = block.GetBlockTime() > Params().Zerocoin_StartTime();
+    unsigned int nSigOps = 0;
+    for (const CTransaction& tx : block.vtx) {
+        nSigOps += GetLegacySigOpCount(tx);
+    }
+    unsigned int nMaxBlockSigOps = fZerocoinActive ? MAX_BLOCK_SIGOPS_CURRENT : MAX_BLOCK_SIGOPS_LEGACY;
+    if (nSigOps > nMaxBlockSigOps)
+        return state.DoS(100, error("%s : out-of-bounds SigOpCount", __func__),
+            REJECT_INVALID, "bad-blk-sigops", true);
+
+    return true;
+}
+
+/**
+ * The checks of CheckBlock that depend on the chain, the sporks, the masternodes and the SwiftTX locks.
+ * Returns in fColdStakingActive whether the transactions must be checked with cold staking enforced.
+ */
+static bool CheckBlockChainState(const CBlock& block, CValidationState& state, bool& fColdStakingActive)
+{
+    const bool IsPoS = block.IsProofOfStake();
+
     // ----------- swiftTX transaction scanning -----------
     if (sporkManager.IsSporkActive(SPORK_3_SWIFTTX_BLOCK_FILTERING)) {
         for (const CTransaction& tx : block.vtx) {
             if (!tx.IsCoinBase()) {
                 //only reject blocks when it's based on complete consensus
-                for (const CTxIn& in : tx.vin) {
-                    if (mapLockedInputs.count(in.prevout)) {
-                        if (mapLockedInputs[in.prevout] != tx.GetHash()) {
-                            mapRejectedBlocks.insert(std::make_pair(block.GetHash(), GetTime()));
-                            LogPrintf("%s : found conflicting transaction with transaction lock %s %s\n", __func__,
-                                    mapLockedInputs[in.prevout].ToString(), tx.GetHash().GetHex());
-                            return state.DoS(0, error("%s : found conflicting transaction with transaction lock", __func__),
-                                REJECT_INVALID, "conflicting-tx-ix");
-                        }
-                    }
+                uint256 hashLock;
+                if (txLockManager.GetConflictingLock(tx, hashLock)) {
+                    mapRejectedBlocks.insert(std::make_pair(block.GetHash(), GetTime()));
+                    LogPrintf("%s : found conflicting transaction with transaction lock %s %s\n", __func__,
+                            hashLock.ToString(), tx.GetHash().GetHex());
+                    return state.DoS(0, error("%s : found conflicting transaction with transaction lock", __func__),
+                        REJECT_INVALID, "conflicting-tx-ix");
                 }
             }
         }
@@ -3668,10 +3893,7 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
     }
 
     // Cold Staking enforcement (true during sync - reject P2CS outputs when false)
-    bool fColdStakingActive = true;
-
-    // Zerocoin activation
-    bool fZerocoinActive = block.GetBlockTime() > Params().Zerocoin_StartTime();
+    fColdStakingActive = true;
 
     // masternode payments / budgets
     CBlockIndex* pindexPrev = chainActive.Tip();
@@ -3714,17 +3936,27 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
         }
     }
 
+    return true;
+}
+
+/**
+ * CheckTransaction on every transaction of block, and no zerocoin serial spent twice in it. Only
+ * the zerocoin spend checks look at the chain, so for a block without them this is context-free.
+ */
+static bool CheckBlockTransactions(const CBlock& block, CValidationState& state, bool fFakeSerialAttack, bool fColdStakingActive)
+{
+    // Zerocoin activation
+    bool fZerocoinActive = block.GetBlockTime() > Params().Zerocoin_StartTime();
+
     // Check transactions
     std::vector<CBigNum> vBlockSerials;
-    // TODO: Check if this is ok... blockHeight is always the tip or should we look for the prevHash and get the height?
-    int blockHeight = chainActive.Height() + 1;
     for (const CTransaction& tx : block.vtx) {
         if (!CheckTransaction(
                 tx,
                 fZerocoinActive,
                 false,
                 state,
-                isBlockBetweenFakeSerialAttackRange(blockHeight),
+                fFakeSerialAttack,
                 fColdStakingActive
         ))
             return error("%s : CheckTransaction failed", __func__);
@@ -3759,14 +3991,27 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
         }
     }
 
-    unsigned int nSigOps = 0;
-    for (const CTransaction& tx : block.vtx) {
-        nSigOps += GetLegacySigOpCount(tx);
-    }
-    unsigned int nMaxBlockSigOps = fZerocoinActive ? MAX_BLOCK_SIGOPS_CURRENT : MAX_BLOCK_SIGOPS_LEGACY;
-    if (nSigOps > nMaxBlockSigOps)
-        return state.DoS(100, error("%s : out-of-bounds SigOpCount", __func__),
-            REJECT_INVALID, "bad-blk-sigops", true);
+    return true;
+}
+
+bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bool fCheckMerkleRoot, bool fCheckSig)
+{
+    LogPrint("debug", "%s: block=%s  is proof of stake=%d\n", __func__, block.GetHash().ToString().c_str(), block.IsProofOfStake());
+
+    if (block.fChecked)
+        return true;
+
+    if (!CheckBlockContextFree(block, state, fCheckMerkleRoot))
+        return false;
+
+    bool fColdStakingActive;
+    if (!CheckBlockChainState(block, state, fColdStakingActive))
+        return false;
+
+    // TODO: Check if this is ok... blockHeight is always the tip or should we look for the prevHash and get the height?
+    int blockHeight = chainActive.Height() + 1;
+    if (!CheckBlockTransactions(block, state, isBlockBetweenFakeSerialAttackRange(blockHeight), fColdStakingActive))
+        return false;
 
     if (fCheckPOW && fCheckMerkleRoot && fCheckSig)
         block.fChecked = true;
@@ -3973,6 +4218,78 @@ bool AcceptBlockHeader(const CBlock& block, CValidationState& state, CBlockIndex
     return true;
 }
 
+/**
+ * Prevouts and zerocoin serial hashes spent by one block, sorted for lookups. Lets AcceptBlock
+ * check a PoS block that builds on a fork against the forked blocks without reading them back.
+ */
+struct CBlockSpends {
+    std::vector<COutPoint> vOutpoints;
+    std::vector<uint256> vSerialHashes;
+
+    explicit CBlockSpends(const CBlock& block)
+    {
+        for (const CTransaction& tx : block.vtx) {
+            for (const CTxIn& in : tx.vin) {
+                if (in.IsZerocoinSpend())
+                    vSerialHashes.push_back(GetSerialHash(TxInToZerocoinSpend(in).getCoinSerialNumber()));
+                else
+                    vOutpoints.push_back(in.prevout);
+            }
+        }
+        std::sort(vOutpoints.begin(), vOutpoints.end());
+        std::sort(vSerialHashes.begin(), vSerialHashes.end());
+    }
+
+    bool HasOutpoint(const COutPoint& out) const { return std::binary_search(vOutpoints.begin(), vOutpoints.end(), out); }
+    bool HasSerialHash(const uint256& hash) const { return std::binary_search(vSerialHashes.begin(), vSerialHashes.end(), hash); }
+};
+
+/**
+ * Spends of the blocks within MaxReorganizationDepth() of the tip, on any branch, ordered by
+ * height so pruning only visits the blocks it removes. Guarded by cs_main.
+ */
+static std::map<std::pair<int, const CBlockIndex*>, CBlockSpends> mapBlockSpends;
+
+/** Forget the spends of blocks too deep to be part of a valid fork, and return that depth. */
+static int PruneBlockSpends()
+{
+    AssertLockHeld(cs_main);
+    const int nMinHeight = chainActive.Height() - Params().MaxReorganizationDepth();
+    while (!mapBlockSpends.empty() && mapBlockSpends.begin()->first.first < nMinHeight)
+        mapBlockSpends.erase(mapBlockSpends.begin());
+    return nMinHeight;
+}
+
+/**
+ * Spends of pindex, read from disk if it was accepted before we started indexing (e.g. after a
+ * restart). Spends read for a block too deep to be kept are returned in pspendsDeep.
+ */
+static const CBlockSpends* GetBlockSpends(const CBlockIndex* pindex, std::unique_ptr<CBlockSpends>& pspendsDeep)
+{
+    AssertLockHeld(cs_main);
+    const std::pair<int, const CBlockIndex*> key(pindex->nHeight, pindex);
+    std::map<std::pair<int, const CBlockIndex*>, CBlockSpends>::const_iterator it = mapBlockSpends.find(key);
+    if (it != mapBlockSpends.end())
+        return &it->second;
+
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pindex))
+        return nullptr;
+    if (pindex->nHeight < PruneBlockSpends()) {
+        pspendsDeep.reset(new CBlockSpends(block));
+        return pspendsDeep.get();
+    }
+    return &mapBlockSpends.insert(std::make_pair(key, CBlockSpends(block))).first->second;
+}
+
+/** Index the spends of a newly accepted block and forget blocks too deep to be part of a valid fork. */
+static void AddBlockSpends(const CBlockIndex* pindex, const CBlock& block)
+{
+    AssertLockHeld(cs_main);
+    if (pindex->nHeight >= PruneBlockSpends())
+        mapBlockSpends.insert(std::make_pair(std::make_pair(pindex->nHeight, pindex), CBlockSpends(block)));
+}
+
 bool AcceptBlock(CBlock& block, CValidationState& state, CBlockIndex** ppindex, CDiskBlockPos* dbp, bool fAlreadyCheckedBlock)
 {
     AssertLockHeld(cs_main);
@@ -4006,11 +4323,15 @@ bool AcceptBlock(CBlock& block, CValidationState& state, CBlockIndex** ppindex,
         return false;
 
     bool isPoS = block.IsProofOfStake();
+    // Only logged once the block is stored
+    int64_t nMicrosStake = -1;
     if (isPoS) {
         uint256 hashProofOfStake = 0;
         std::unique_ptr<CStakeInput> stake;
+        int64_t nTimeStake = GetTimeMicros();
         if (!CheckProofOfStake(block, hashProofOfStake, stake, pindexPrev->nHeight))
             return state.DoS(100, error("%s: proof of stake check failed", __func__));
+        nMicrosStake = GetTimeMicros() - nTimeStake;
     }
 
     if (!AcceptBlockHeader(block, state, &pindex))
@@ -4110,14 +4431,14 @@ bool AcceptBlock(CBlock& block, CValidationState& state, CBlockIndex** ppindex,
         // Check whether is a fork or not
         if (isBlockFromFork) {
 
+            // Serial hashes of the zYODA stake inputs, matched against the spends of the forked blocks
+            std::vector<uint256> vStakeSerialHashes;
+            for (const CTxIn& zPivInput : zYODAInputs)
+                vStakeSerialHashes.push_back(GetSerialHash(TxInToZerocoinSpend(zPivInput).getCoinSerialNumber()));
+
             // Start at the block we're adding on to
             CBlockIndex *prev = pindexPrev;
 
-            CBlock bl;
-            if (!ReadBlockFromDisk(bl, prev))
-                return error("%s: previous block %s not on disk", __func__, prev->GetBlockHash().GetHex());
-
-            std::vector<CBigNum> vBlockSerials;
             int readBlock = 0;
             // Go backwards on the forked chain up to the split
             while (!chainActive.Contains(prev)) {
@@ -4130,31 +4451,24 @@ bool AcceptBlock(CBlock& block, CValidationState& state, CBlockIndex** ppindex,
                     return error("%s: forked chain longer than maximum reorg limit", __func__);
                 }
 
-                // Loop through every tx of this block
-                for (const CTransaction& t : bl.vtx) {
-                    // Loop through every input of this tx
-                    for (const CTxIn& in: t.vin) {
-                        // If this input is a zerocoin spend, and the coinstake has zerocoin inputs
-                        // then store the serials for later check
-                        if(hasZPIVInputs && in.IsZerocoinSpend())
-                            vBlockSerials.push_back(TxInToZerocoinSpend(in).getCoinSerialNumber());
-
-                        // Loop through every input of the staking tx
-                        if (hasPIVInputs) {
-                            for (const CTxIn& stakeIn : pivInputs)
-                                // check if the tx input is double spending any coinstake input
-                                if (stakeIn.prevout == in.prevout)
-                                    return state.DoS(100, error("%s: input already spent on a previous block", __func__));
-                        }
-                    }
-                }
-
-                // Prev block
-                prev = prev->pprev;
-                if (!ReadBlockFromDisk(bl, prev))
+                std::unique_ptr<CBlockSpends> pspendsDeep;
+                const CBlockSpends* pspends = GetBlockSpends(prev, pspendsDeep);
+                if (!pspends)
                     // Previous block not on disk
                     return error("%s: previous block %s not on disk", __func__, prev->GetBlockHash().GetHex());
 
+                // check if the block is double spending any coinstake input
+                for (const CTxIn& stakeIn : pivInputs)
+                    if (pspends->HasOutpoint(stakeIn.prevout))
+                        return state.DoS(100, error("%s: input already spent on a previous block", __func__));
+
+                // check if the serials were not already spent on the forked blocks
+                for (const uint256& hashSerial : vStakeSerialHashes)
+                    if (pspends->HasSerialHash(hashSerial))
+                        return state.DoS(100, error("%s: serial double spent on fork", __func__));
+
+                // Prev block
+                prev = prev->pprev;
             }
 
             // Split height
@@ -4165,14 +4479,6 @@ bool AcceptBlock(CBlock& block, CValidationState& state, CBlockIndex** ppindex,
                 for (const CTxIn& zPivInput : zYODAInputs) {
                     libzerocoin::CoinSpend spend = TxInToZerocoinSpend(zPivInput);
 
-                    // First check if the serials were not already spent on the forked blocks.
-                    CBigNum coinSerial = spend.getCoinSerialNumber();
-                    for(const CBigNum& serial : vBlockSerials){
-                        if(serial == coinSerial){
-                            return state.DoS(100, error("%s: serial double spent on fork", __func__));
-                        }
-                    }
-
                     // Now check if the serial exists before the chain split.
                     int nHeightTx = 0;
                     if (IsSerialInBlockchain(spend.getCoinSerialNumber(), nHeightTx)) {
@@ -4234,10 +4540,15 @@ bool AcceptBlock(CBlock& block, CValidationState& state, CBlockIndex** ppindex,
                 return AbortNode(state, "Failed to write block");
         if (!ReceivedBlockTransactions(block, state, pindex, blockPos))
             return error("AcceptBlock() : ReceivedBlockTransactions failed");
+        // Blocks arriving near the tip may become the base of a PoS fork, index their spends now
+        if (!IsInitialBlockDownload())
+            AddBlockSpends(pindex, block);
     } catch (const std::runtime_error& e) {
         return AbortNode(state, std::string("System error: ") + e.what());
     }
 
+    if (nMicrosStake >= 0)
+        blockTimingLog.AddPending(pindex->GetBlockHash(), BLOCKSTAGE_CHECK_STAKE, nMicrosStake);
     return true;
 }
 
@@ -4302,16 +4613,33 @@ void CBlockIndex::BuildSkip()
         pskip = pprev->GetAncestor(GetSkipHeight(nHeight));
 }
 
-bool ProcessNewBlock(CValidationState& state, CNode* pfrom, CBlock* pblock, CDiskBlockPos* dbp)
+bool ProcessNewBlock(CValidationState& state, CNode* pfrom, CBlock* pblock, CDiskBlockPos* dbp, bool fPrechecked)
 {
     // Preliminary checks
     int64_t nStartTime = GetTimeMillis();
 
     // check block
-    bool checked = CheckBlock(*pblock, state);
+    const uint256 hashBlock = pblock->GetHash();
+    int64_t nTimeCheck = GetTimeMicros();
+    bool checked;
+    if (fPrechecked) {
+        // The context-free and transaction checks ran on an import worker, with cold staking treated
+        // as during initial download. What depends on the chain is left, on this thread.
+        bool fColdStakingActive;
+        checked = CheckBlockChainState(*pblock, state, fColdStakingActive) &&
+                  (fColdStakingActive || CheckBlockTransactions(*pblock, state, isBlockBetweenFakeSerialAttackRange(chainActive.Height() + 1), false));
+        pblock->fChecked = checked;
+    } else {
+        checked = CheckBlock(*pblock, state);
+    }
+    int64_t nTimeChecked = GetTimeMicros();
+    int64_t nTimeSignature = nTimeChecked;
 
-    if (!CheckBlockSignature(*pblock))
-        return error("%s : bad proof-of-stake block signature", __func__);
+    if (!fPrechecked) {
+        if (!CheckBlockSignature(*pblock))
+            return error("%s : bad proof-of-stake block signature", __func__);
+        nTimeSignature = GetTimeMicros();
+    }
 
     if (pblock->GetHash() != Params().GetConsensus().hashGenesisBlock && pfrom != NULL) {
         //if we get this far, check if the prev block is our prev block, if not then request sync and return false
@@ -4332,7 +4660,18 @@ bool ProcessNewBlock(CValidationState& state, CNode* pfrom, CBlock* pblock, CDis
 
         // Store to disk
         CBlockIndex* pindex = nullptr;
+        BlockMap::iterator miSelf = mapBlockIndex.find(hashBlock);
+        const bool fHaveData = miSelf != mapBlockIndex.end() && (miSelf->second->nStatus & BLOCK_HAVE_DATA);
+        int64_t nTimeAccept = GetTimeMicros();
         bool ret = AcceptBlock(*pblock, state, &pindex, dbp, checked);
+        if (ret && !fHaveData) {
+            // Stages are only kept for blocks that were stored just now, the ones that may get connected
+            if (!fPrechecked) {
+                blockTimingLog.AddPending(hashBlock, BLOCKSTAGE_CHECK_BLOCK, nTimeChecked - nTimeCheck);
+                blockTimingLog.AddPending(hashBlock, BLOCKSTAGE_CHECK_SIGNATURE, nTimeSignature - nTimeChecked);
+            }
+            blockTimingLog.AddPending(hashBlock, BLOCKSTAGE_ACCEPT, GetTimeMicros() - nTimeAccept);
+        }
         if (pindex && pfrom) {
             mapBlockSource[pindex->GetBlockHash ()] = pfrom->GetId ();
         }
@@ -4575,6 +4914,14 @@ bool static LoadBlockIndexDB(std::string& strError)
     pblocktree->ReadFlag("txindex", fTxIndex);
     LogPrintf("LoadBlockIndexDB(): transaction index %s\n", fTxIndex ? "enabled" : "disabled");
 
+    // Check whether we have the optional explorer indexes
+    pblocktree->ReadFlag("addressindex", fAddressIndex);
+    LogPrintf("LoadBlockIndexDB(): address index %s\n", fAddressIndex ? "enabled" : "disabled");
+    pblocktree->ReadFlag("spentindex", fSpentIndex);
+    LogPrintf("LoadBlockIndexDB(): spent index %s\n", fSpentIndex ? "enabled" : "disabled");
+    pblocktree->ReadFlag("timestampindex", fTimestampIndex);
+    LogPrintf("LoadBlockIndexDB(): timestamp index %s\n", fTimestampIndex ? "enabled" : "disabled");
+
     // If this is written true before the next client init, then we know the shutdown process failed
     pblocktree->WriteFlag("shutdown", false);
 
@@ -4705,6 +5052,7 @@ void UnloadBlockIndex()
     setDirtyBlockIndex.clear();
     setDirtyFileInfo.clear();
     mapNodeState.clear();
+    mapBlockSpends.clear();
 
     for (BlockMap::value_type& entry : mapBlockIndex) {
         delete entry.second;
@@ -4731,6 +5079,12 @@ bool InitBlockIndex()
     // Use the provided setting for -txindex in the new database
     fTxIndex = GetBoolArg("-txindex", true);
     pblocktree->WriteFlag("txindex", fTxIndex);
+    fAddressIndex = GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
+    pblocktree->WriteFlag("addressindex", fAddressIndex);
+    fSpentIndex = GetBoolArg("-spentindex", DEFAULT_SPENTINDEX);
+    pblocktree->WriteFlag("spentindex", fSpentIndex);
+    fTimestampIndex = GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
+    pblocktree->WriteFlag("timestampindex", fTimestampIndex);
     LogPrintf("Initializing databases...\n");
 
     // Only add the genesis block if not reindexing (in which case we reuse the one already on disk)
@@ -4759,6 +5113,201 @@ bool InitBlockIndex()
 }
 
 
+namespace
+{
+/** A block on its way from the block file to ProcessNewBlock */
+struct CImportedBlock {
+    uint64_t nRewind;   //!< where to resume scanning if the block cannot be decoded
+    uint64_t nBlockPos; //!< position of the block data in the file
+    uint64_t nSize;
+    std::vector<char> vchRaw;
+    CBlock block;
+    bool fDone;
+    bool fDecoded;
+    bool fPrechecked; //!< passed the context-free checks of CheckBlock and CheckBlockSignature
+
+    CImportedBlock() : nRewind(0), nBlockPos(0), nSize(0), fDone(false), fDecoded(false), fPrechecked(false) {}
+};
+
+/**
+ * -reindex and -loadblock pipeline for one block file. A reader thread locates the blocks
+ * and reads their raw bytes, a pool of workers deserializes them and runs the checks of
+ * CheckBlock that need no chain state and CheckBlockSignature, and Next() hands them back
+ * in file order to the caller, which accepts and connects them one at a time.
+ */
+class CBlockImportPipeline
+{
+private:
+    CBufferedFile& blkdat;
+    boost::mutex cs;
+    boost::condition_variable condReader;    //!< the read-ahead window has room
+    boost::condition_variable condWorker;    //!< a block waits to be decoded
+    boost::condition_variable condConnector; //!< the oldest block is decoded
+    //! Blocks in file order; the first nClaimed are decoded or being decoded
+    std::deque<std::shared_ptr<CImportedBlock> > queue;
+    size_t nClaimed;
+    uint64_t nQueuedBytes;
+    bool fReaderDone;
+    bool fStop;
+    std::string strReadError;
+    boost::thread_group threads;
+
+    void ThreadReader(uint64_t nRewind)
+    {
+        try {
+            if (!blkdat.SetPos(nRewind))
+                blkdat.Seek(nRewind);
+            while (!blkdat.eof()) {
+                blkdat.SetPos(nRewind);
+                nRewind++;         // start one byte further next time, in case of failure
+                blkdat.SetLimit(); // remove former limit
+                unsigned int nSize = 0;
+                try {
+                    // locate a header
+                    unsigned char buf[MESSAGE_START_SIZE];
+                    blkdat.FindByte(Params().MessageStart()[0]);
+                    nRewind = blkdat.GetPos() + 1;
+                    blkdat >> FLATDATA(buf);
+                    if (memcmp(buf, Params().MessageStart(), MESSAGE_START_SIZE))
+                        continue;
+                    // read size
+                    blkdat >> nSize;
+                    if (nSize < 80 || nSize > MAX_BLOCK_SIZE_CURRENT)
+                        continue;
+                } catch (const std::exception&) {
+                    // no valid block header found; don't complain
+                    break;
+                }
+                std::shared_ptr<CImportedBlock> pimport = std::make_shared<CImportedBlock>();
+                try {
+                    // read block
+                    pimport->nRewind = nRewind;
+                    pimport->nBlockPos = blkdat.GetPos();
+                    pimport->nSize = nSize;
+                    blkdat.SetLimit(pimport->nBlockPos + nSize);
+                    pimport->vchRaw.resize(nSize);
+                    blkdat.read(&pimport->vchRaw[0], nSize);
+                    nRewind = blkdat.GetPos();
+                } catch (const std::exception& e) {
+                    LogPrintf("%s : Deserialize or I/O error - %s", __func__, e.what());
+                    continue;
+                }
+
+                boost::unique_lock<boost::mutex> lock(cs);
+                while (!fStop && !queue.empty() && nQueuedBytes + nSize > MAX_IMPORT_READAHEAD)
+                    condReader.wait(lock);
+                if (fStop)
+                    break;
+                queue.push_back(pimport);
+                nQueuedBytes += nSize;
+                condWorker.notify_one();
+            }
+        } catch (const std::runtime_error& e) {
+            boost::unique_lock<boost::mutex> lock(cs);
+            strReadError = e.what();
+        }
+
+        boost::unique_lock<boost::mutex> lock(cs);
+        fReaderDone = true;
+        condWorker.notify_all();
+        condConnector.notify_all();
+    }
+
+    void ThreadWorker()
+    {
+        while (true) {
+            std::shared_ptr<CImportedBlock> pimport;
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                while (!fStop && nClaimed == queue.size()) {
+                    if (fReaderDone)
+                        return;
+                    condWorker.wait(lock);
+                }
+                if (fStop)
+                    return;
+                pimport = queue[nClaimed++];
+            }
+
+            try {
+                CDataStream ss(pimport->vchRaw, SER_DISK, CLIENT_VERSION);
+                ss >> pimport->block;
+                pimport->fDecoded = true;
+                // Only the checks that need nothing but the block run here; chainActive, cs_main and
+                // mapRejectedBlocks stay with the connector. Zerocoin spends are checked against the
+                // tip, which the workers run ahead of, so those blocks are left to the connector.
+                bool fZerocoinSpends = false;
+                for (const CTransaction& tx : pimport->block.vtx) {
+                    if (tx.HasZerocoinSpendInputs()) {
+                        fZerocoinSpends = true;
+                        break;
+                    }
+                }
+                // A failed check is repeated by the connector, which reports it
+                CValidationState state;
+                pimport->fPrechecked = !fZerocoinSpends && CheckBlockContextFree(pimport->block, state, true) &&
+                                       CheckBlockTransactions(pimport->block, state, false, true) &&
+                                       CheckBlockSignature(pimport->block);
+            } catch (const std::exception&) {
+                // reported by the caller, which rescans from nRewind
+            }
+            std::vector<char>().swap(pimport->vchRaw);
+
+            boost::unique_lock<boost::mutex> lock(cs);
+            pimport->fDone = true;
+            condConnector.notify_one();
+        }
+    }
+
+public:
+    CBlockImportPipeline(CBufferedFile& blkdatIn, uint64_t nRewind) : blkdat(blkdatIn), nClaimed(0), nQueuedBytes(0), fReaderDone(false), fStop(false)
+    {
+        const int nWorkers = std::max(1, std::min((int)boost::thread::hardware_concurrency() - 1, MAX_IMPORT_THREADS));
+        threads.create_thread(boost::bind(&CBlockImportPipeline::ThreadReader, this, nRewind));
+        for (int i = 0; i < nWorkers; i++)
+            threads.create_thread(boost::bind(&CBlockImportPipeline::ThreadWorker, this));
+    }
+
+    ~CBlockImportPipeline()
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            fStop = true;
+        }
+        condReader.notify_all();
+        condWorker.notify_all();
+        boost::this_thread::disable_interruption di;
+        threads.join_all();
+    }
+
+    //! The next block in file order, or null once the reader reached the end of the file
+    std::shared_ptr<CImportedBlock> Next()
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        while (true) {
+            if (!queue.empty() && queue.front()->fDone) {
+                std::shared_ptr<CImportedBlock> pimport = queue.front();
+                queue.pop_front();
+                nClaimed--;
+                nQueuedBytes -= pimport->nSize;
+                condReader.notify_one();
+                return pimport;
+            }
+            if (queue.empty() && fReaderDone)
+                return std::shared_ptr<CImportedBlock>();
+            condConnector.wait(lock);
+        }
+    }
+
+    //! Error that stopped the reader, empty if it reached the end of the file
+    std::string GetReadError()
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        return strReadError;
+    }
+};
+} // anon namespace
+
 bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
 {
     // Map of disk positions for blocks with unknown parent (only used for reindex)
@@ -4770,86 +5319,81 @@ bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
         // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
         CBufferedFile blkdat(fileIn, 2 * MAX_BLOCK_SIZE_CURRENT, MAX_BLOCK_SIZE_CURRENT + 8, SER_DISK, CLIENT_VERSION);
         uint64_t nRewind = blkdat.GetPos();
-        while (!blkdat.eof()) {
-            boost::this_thread::interruption_point();
-
-            blkdat.SetPos(nRewind);
-            nRewind++;         // start one byte further next time, in case of failure
-            blkdat.SetLimit(); // remove former limit
-            unsigned int nSize = 0;
-            try {
-                // locate a header
-                unsigned char buf[MESSAGE_START_SIZE];
-                blkdat.FindByte(Params().MessageStart()[0]);
-                nRewind = blkdat.GetPos() + 1;
-                blkdat >> FLATDATA(buf);
-                if (memcmp(buf, Params().MessageStart(), MESSAGE_START_SIZE))
-                    continue;
-                // read size
-                blkdat >> nSize;
-                if (nSize < 80 || nSize > MAX_BLOCK_SIZE_CURRENT)
-                    continue;
-            } catch (const std::exception&) {
-                // no valid block header found; don't complain
-                break;
-            }
-            try {
-                // read block
-                uint64_t nBlockPos = blkdat.GetPos();
-                if (dbp)
-                    dbp->nPos = nBlockPos;
-                blkdat.SetLimit(nBlockPos + nSize);
-                blkdat.SetPos(nBlockPos);
-                CBlock block;
-                blkdat >> block;
-                nRewind = blkdat.GetPos();
-
-                // detect out of order blocks, and store them for later
-                uint256 hash = block.GetHash();
-                if (hash != Params().GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
-                    LogPrint("reindex", "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
-                        block.hashPrevBlock.ToString());
-                    if (dbp)
-                        mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
-                    continue;
-                }
-
-                // process in case the block isn't known yet
-                if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
-                    CValidationState state;
-                    if (ProcessNewBlock(state, NULL, &block, dbp))
-                        nLoaded++;
-                    if (state.IsError())
+        bool fRescan = true;
+        while (fRescan) {
+            fRescan = false;
+            std::string strReadError;
+            {
+                CBlockImportPipeline pipeline(blkdat, nRewind);
+                std::shared_ptr<CImportedBlock> pimport;
+                while ((pimport = pipeline.Next())) {
+                    boost::this_thread::interruption_point();
+
+                    if (!pimport->fDecoded) {
+                        // Scan again from just past the block's magic bytes; the blocks read after
+                        // it are dropped with the pipeline and read again.
+                        LogPrintf("%s : Deserialize or I/O error - failed to decode block at position %u\n", __func__, pimport->nBlockPos);
+                        nRewind = pimport->nRewind;
+                        fRescan = true;
                         break;
-                } else if (hash != Params().GetConsensus().hashGenesisBlock && mapBlockIndex[hash]->nHeight % 1000 == 0) {
-                    LogPrintf("Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
-                }
+                    }
+
+                    try {
+                        if (dbp)
+                            dbp->nPos = pimport->nBlockPos;
+                        CBlock& block = pimport->block;
+
+                        // detect out of order blocks, and store them for later
+                        uint256 hash = block.GetHash();
+                        if (hash != Params().GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
+                            LogPrint("reindex", "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
+                                block.hashPrevBlock.ToString());
+                            if (dbp)
+                                mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
+                            continue;
+                        }
 
-                // Recursively process earlier encountered successors of this block
-                std::deque<uint256> queue;
-                queue.push_back(hash);
-                while (!queue.empty()) {
-                    uint256 head = queue.front();
-                    queue.pop_front();
-                    std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
-                    while (range.first != range.second) {
-                        std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
-                        if (ReadBlockFromDisk(block, it->second)) {
-                            LogPrintf("%s: Processing out of order child %s of %s\n", __func__, block.GetHash().ToString(),
-                                head.ToString());
-                            CValidationState dummy;
-                            if (ProcessNewBlock(dummy, NULL, &block, &it->second)) {
+                        // process in case the block isn't known yet
+                        if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
+                            CValidationState state;
+                            if (ProcessNewBlock(state, NULL, &block, dbp, pimport->fPrechecked))
                                 nLoaded++;
-                                queue.push_back(block.GetHash());
+                            if (state.IsError())
+                                break;
+                        } else if (hash != Params().GetConsensus().hashGenesisBlock && mapBlockIndex[hash]->nHeight % 1000 == 0) {
+                            LogPrintf("Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
+                        }
+
+                        // Recursively process earlier encountered successors of this block
+                        std::deque<uint256> queue;
+                        queue.push_back(hash);
+                        while (!queue.empty()) {
+                            uint256 head = queue.front();
+                            queue.pop_front();
+                            std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
+                            while (range.first != range.second) {
+                                std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
+                                if (ReadBlockFromDisk(block, it->second)) {
+                                    LogPrintf("%s: Processing out of order child %s of %s\n", __func__, block.GetHash().ToString(),
+                                        head.ToString());
+                                    CValidationState dummy;
+                                    if (ProcessNewBlock(dummy, NULL, &block, &it->second)) {
+                                        nLoaded++;
+                                        queue.push_back(block.GetHash());
+                                    }
+                                }
+                                range.first++;
+                                mapBlocksUnknownParent.erase(it);
                             }
                         }
-                        range.first++;
-                        mapBlocksUnknownParent.erase(it);
+                    } catch (const std::exception& e) {
+                        LogPrintf("%s : Deserialize or I/O error - %s", __func__, e.what());
                     }
                 }
-            } catch (const std::exception& e) {
-                LogPrintf("%s : Deserialize or I/O error - %s", __func__, e.what());
+                strReadError = pipeline.GetReadError();
             }
+            if (!strReadError.empty())
+                throw std::runtime_error(strReadError);
         }
     } catch (const std::runtime_error& e) {
         AbortNode(std::string("System error: ") + e.what());
@@ -5074,10 +5618,9 @@ bool static AlreadyHave(const CInv& inv)
     case MSG_BLOCK:
         return mapBlockIndex.count(inv.hash);
     case MSG_TXLOCK_REQUEST:
-        return mapTxLockReq.count(inv.hash) ||
-               mapTxLockReqRejected.count(inv.hash);
+        return txLockManager.HaveLockRequest(inv.hash);
     case MSG_TXLOCK_VOTE:
-        return mapTxLockVote.count(inv.hash);
+        return txLockManager.HaveVote(inv.hash);
     case MSG_SPORK:
         return mapSporks.count(inv.hash);
     case MSG_MASTERNODE_WINNER:
@@ -5141,7 +5684,7 @@ void static ProcessGetData(CNode* pfrom)
             boost::this_thread::interruption_point();
             it++;
 
-            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK) {
+            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_CMPCT_BLOCK) {
                 bool send = false;
                 BlockMap::iterator mi = mapBlockIndex.find(inv.hash);
                 if (mi != mapBlockIndex.end()) {
@@ -5166,7 +5709,13 @@ void static ProcessGetData(CNode* pfrom)
                         assert(!"cannot load block from disk");
                     if (inv.type == MSG_BLOCK)
                         pfrom->PushMessage("block", block);
-                    else // MSG_FILTERED_BLOCK)
+                    else if (inv.type == MSG_CMPCT_BLOCK) {
+                        // Older blocks are unlikely to be in the peer's mempool any more, send them whole
+                        if (chainActive.Height() - mi->second->nHeight <= MAX_CMPCTBLOCK_DEPTH)
+                            pfrom->PushMessage("cmpctblock", CBlockHeaderAndShortTxIDs(block));
+                        else
+                            pfrom->PushMessage("block", block);
+                    } else // MSG_FILTERED_BLOCK)
                     {
                         LOCK(pfrom->cs_filter);
                         if (pfrom->pfilter) {
@@ -5180,7 +5729,7 @@ void static ProcessGetData(CNode* pfrom)
                             // however we MUST always provide at least what the remote peer needs
                             typedef std::pair<unsigned int, uint256> PairType;
                             for (PairType& pair : merkleBlock.vMatchedTxn)
-                                if (!pfrom->setInventoryKnown.count(CInv(MSG_TX, pair.second)))
+                                if (!pfrom->filterInventoryKnown.contains(CInv(MSG_TX, pair.second).GetKey()))
                                     pfrom->PushMessage("tx", block.vtx[pair.first]);
                         }
                         // else
@@ -5225,20 +5774,22 @@ void static ProcessGetData(CNode* pfrom)
                 }
 
                 if (!pushed && inv.type == MSG_TXLOCK_VOTE) {
-                    if (mapTxLockVote.count(inv.hash)) {
+                    CConsensusVote vote;
+                    if (txLockManager.GetVote(inv.hash, vote)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
-                        ss << mapTxLockVote[inv.hash];
+                        ss << vote;
                         LogPrintf("ProcessGetData(): Send command: txlvote \n");
                         pfrom->PushMessage("txlvote", ss);
                         pushed = true;
                     }
                 }
                 if (!pushed && inv.type == MSG_TXLOCK_REQUEST) {
-                    if (mapTxLockReq.count(inv.hash)) {
+                    CTransaction txLockReq;
+                    if (txLockManager.GetLockRequest(inv.hash, txLockReq)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
-                        ss << mapTxLockReq[inv.hash];
+                        ss << txLockReq;
                         LogPrintf("ProcessGetData(): Send command: ix \n");
                         pfrom->PushMessage("ix", ss);
                         pushed = true;
@@ -5351,7 +5902,7 @@ void static ProcessGetData(CNode* pfrom)
             // Track requests for our stuff.
             GetMainSignals().Inventory(inv.hash);
 
-            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK)
+            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_CMPCT_BLOCK)
                 break;
         }
     }
@@ -5371,7 +5922,87 @@ void static ProcessGetData(CNode* pfrom)
 }
 
 bool fRequestedSporksIDB = false;
-bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vRecv, int64_t nTimeReceived)
+/** Whether to ask pfrom for new blocks as compact blocks. Requires cs_main. */
+bool static CanRequestCompactBlock(CNode* pfrom)
+{
+    return (nLocalServices & NODE_COMPACT_BLOCKS) && pfrom->fSupportsCompactBlocks && !IsInitialBlockDownload();
+}
+
+/**
+ * pfrom just gave us a new tip: ask it to push its next blocks as compact blocks, keeping only
+ * the MAX_HB_CMPCTBLOCK_PEERS peers that did so most recently. The "sendcmpct" messages go out
+ * from SendMessages. Requires cs_main.
+ */
+void static MaybeSetPeerAsAnnouncingCompactBlocks(CNode* pfrom)
+{
+    if (!(nLocalServices & NODE_COMPACT_BLOCKS) || !pfrom->fSupportsCompactBlocks)
+        return;
+
+    NodeId nodeid = pfrom->GetId();
+    for (std::list<NodeId>::iterator it = lNodesAnnouncingCompactBlocks.begin(); it != lNodesAnnouncingCompactBlocks.end(); ++it) {
+        if (*it == nodeid) {
+            lNodesAnnouncingCompactBlocks.erase(it);
+            lNodesAnnouncingCompactBlocks.push_back(nodeid);
+            return;
+        }
+    }
+
+    if (lNodesAnnouncingCompactBlocks.size() >= MAX_HB_CMPCTBLOCK_PEERS) {
+        State(lNodesAnnouncingCompactBlocks.front())->fWantCompactAnnounce = false;
+        lNodesAnnouncingCompactBlocks.pop_front();
+    }
+    State(nodeid)->fWantCompactAnnounce = true;
+    lNodesAnnouncingCompactBlocks.push_back(nodeid);
+}
+
+/** Hand a block received from pfrom, in full or rebuilt from a compact block, to ProcessNewBlock */
+void static ProcessReceivedBlock(CNode* pfrom, const std::string& strCommand, CBlock& block)
+{
+    uint256 hashBlock = block.GetHash();
+    CInv inv(MSG_BLOCK, hashBlock);
+    LogPrint("net", "received block %s peer=%d\n", inv.hash.ToString(), pfrom->id);
+
+    //sometimes we will be sent their most recent block and its not the one we want, in that case tell where we are
+    if (!mapBlockIndex.count(block.hashPrevBlock)) {
+        if (find(pfrom->vBlockRequested.begin(), pfrom->vBlockRequested.end(), hashBlock) != pfrom->vBlockRequested.end()) {
+            //we already asked for this block, so lets work backwards and ask for the previous block
+            pfrom->PushMessage("getblocks", chainActive.GetLocator(), block.hashPrevBlock);
+            pfrom->vBlockRequested.push_back(block.hashPrevBlock);
+        } else {
+            //ask to sync to this block
+            pfrom->PushMessage("getblocks", chainActive.GetLocator(), hashBlock);
+            pfrom->vBlockRequested.push_back(hashBlock);
+        }
+    } else {
+        pfrom->AddInventoryKnown(inv);
+
+        CValidationState state;
+        // The header may already be indexed from a compact block, only the data tells it was processed
+        BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
+        if (mi == mapBlockIndex.end() || !(mi->second->nStatus & BLOCK_HAVE_DATA)) {
+            ProcessNewBlock(state, pfrom, &block);
+            int nDoS;
+            if(state.IsInvalid(nDoS)) {
+                pfrom->PushMessage("reject", strCommand, state.GetRejectCode(),
+                                   state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), inv.hash);
+                if(nDoS > 0) {
+                    TRY_LOCK(cs_main, lockMain);
+                    if(lockMain) Misbehaving(pfrom->GetId(), nDoS);
+                }
+            } else {
+                LOCK(cs_main);
+                if (chainActive.Tip()->GetBlockHash() == hashBlock)
+                    MaybeSetPeerAsAnnouncingCompactBlocks(pfrom);
+            }
+            //disconnect this node if its old protocol version
+            pfrom->DisconnectOldProtocol(ActiveProtocol(), strCommand);
+        } else {
+            LogPrint("net", "%s : Already processed block %s, skipping ProcessNewBlock()\n", __func__, block.GetHash().GetHex());
+        }
+    }
+}
+
+bool ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vRecv, int64_t nTimeReceived)
 {
     LogPrint("net", "received: %s (%u bytes) peer=%d, addr=%s\n", SanitizeString(strCommand), vRecv.size(), pfrom->id, pfrom->addrName);
 
@@ -5527,6 +6158,10 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
             LOCK(cs_main);
             State(pfrom->GetId())->fCurrentlyConnected = true;
         }
+
+        // Start in low bandwidth mode: compact blocks only when we ask for them
+        if ((nLocalServices & NODE_COMPACT_BLOCKS) && (pfrom->nServices & NODE_COMPACT_BLOCKS))
+            pfrom->PushMessage("sendcmpct", false, COMPACT_BLOCKS_VERSION);
     }
 
 
@@ -5559,7 +6194,7 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
                 {
                     LOCK(cs_vNodes);
                     // Use deterministic randomness to send to the same nodes for 24 hours
-                    // at a time so the setAddrKnowns of the chosen nodes prevent repeats
+                    // at a time so the addrKnowns of the chosen nodes prevent repeats
                     static uint256 hashSalt;
                     if (hashSalt == 0)
                         hashSalt = GetRandHash();
@@ -5624,7 +6259,13 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
                 UpdateBlockAvailability(pfrom->GetId(), inv.hash);
                 if (!fAlreadyHave && !fImporting && !fReindex && !mapBlocksInFlight.count(inv.hash)) {
                     // Add this to the list of blocks to request
-                    vToFetch.push_back(inv);
+                    if (CanRequestCompactBlock(pfrom)) {
+                        // Remembered so the "cmpctblock" answer counts as solicited
+                        vToFetch.push_back(CInv(MSG_CMPCT_BLOCK, inv.hash));
+                        MarkBlockAsInFlight(pfrom->GetId(), inv.hash);
+                    } else {
+                        vToFetch.push_back(inv);
+                    }
                     LogPrint("net", "getblocks (%d) %s to peer=%d\n", pindexBestHeader->nHeight, inv.hash.ToString(), pfrom->id);
                 }
             }
@@ -5953,41 +6594,167 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
     {
         CBlock block;
         vRecv >> block;
-        uint256 hashBlock = block.GetHash();
-        CInv inv(MSG_BLOCK, hashBlock);
-        LogPrint("net", "received block %s peer=%d\n", inv.hash.ToString(), pfrom->id);
-
-        //sometimes we will be sent their most recent block and its not the one we want, in that case tell where we are
-        if (!mapBlockIndex.count(block.hashPrevBlock)) {
-            if (find(pfrom->vBlockRequested.begin(), pfrom->vBlockRequested.end(), hashBlock) != pfrom->vBlockRequested.end()) {
-                //we already asked for this block, so lets work backwards and ask for the previous block
-                pfrom->PushMessage("getblocks", chainActive.GetLocator(), block.hashPrevBlock);
-                pfrom->vBlockRequested.push_back(block.hashPrevBlock);
-            } else {
-                //ask to sync to this block
-                pfrom->PushMessage("getblocks", chainActive.GetLocator(), hashBlock);
-                pfrom->vBlockRequested.push_back(hashBlock);
+        ProcessReceivedBlock(pfrom, strCommand, block);
+    }
+
+
+    else if (strCommand == "cmpctblock" && !fImporting && !fReindex) // Ignore blocks received while importing
+    {
+        CBlockHeaderAndShortTxIDs cmpctblock;
+        vRecv >> cmpctblock;
+        uint256 hashBlock = cmpctblock.header.GetHash();
+        LogPrint("net", "received cmpctblock %s peer=%d\n", hashBlock.ToString(), pfrom->id);
+        pfrom->AddInventoryKnown(CInv(MSG_BLOCK, hashBlock));
+
+        {
+            LOCK(cs_main);
+            BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
+            if (mi != mapBlockIndex.end() && (mi->second->nStatus & BLOCK_HAVE_DATA)) {
+                MarkBlockAsReceived(hashBlock);
+                return true;
+            }
+            // Without the parent the block cannot be connected anyway, the full block path knows how to catch up.
+            // That path does not reach ProcessNewBlock for an orphan, so the compact request is settled here.
+            if (!mapBlockIndex.count(cmpctblock.header.hashPrevBlock)) {
+                MarkBlockAsReceived(hashBlock);
+                pfrom->PushMessage("getdata", std::vector<CInv>(1, CInv(MSG_BLOCK, hashBlock)));
+                return true;
+            }
+
+            // Only rebuild blocks we asked this peer for, or that it pushed because we asked it to
+            std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> >::iterator itInFlight = mapBlocksInFlight.find(hashBlock);
+            bool fRequested = itInFlight != mapBlocksInFlight.end() && itInFlight->second.first == pfrom->GetId();
+            if (!fRequested && !State(pfrom->GetId())->fSentCompactAnnounce) {
+                LogPrint("net", "peer=%d sent unsolicited cmpctblock %s\n", pfrom->id, hashBlock.ToString());
+                pfrom->PushMessage("getdata", std::vector<CInv>(1, CInv(MSG_BLOCK, hashBlock)));
+                return true;
             }
+        }
+
+        // Rebuilding scans the whole mempool, so the header has to pass the context-free checks first.
+        // It is not indexed here: the header only reaches mapBlockIndex through ProcessNewBlock, once the
+        // rebuilt block has passed CheckBlock, CheckBlockSignature and CheckProofOfStake.
+        CValidationState state;
+        if (!CheckBlockHeader(cmpctblock.header, state, false)) {
+            LOCK(cs_main);
+            MarkBlockAsReceived(hashBlock);
+            int nDoS;
+            if (state.IsInvalid(nDoS) && nDoS > 0)
+                Misbehaving(pfrom->GetId(), nDoS);
+            return error("invalid cmpctblock header %s from peer=%d", hashBlock.ToString(), pfrom->id);
+        }
+
+        std::shared_ptr<PartiallyDownloadedBlock> partialBlock = std::make_shared<PartiallyDownloadedBlock>(&mempool);
+        ReadStatus status = partialBlock->InitData(cmpctblock);
+        if (status == READ_STATUS_INVALID) {
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), 100);
+            return error("invalid cmpctblock %s from peer=%d", hashBlock.ToString(), pfrom->id);
+        } else if (status == READ_STATUS_FAILED) {
+            pfrom->PushMessage("getdata", std::vector<CInv>(1, CInv(MSG_BLOCK, hashBlock)));
+            return true;
+        }
+
+        BlockTransactionsRequest req;
+        req.blockhash = hashBlock;
+        for (size_t i = 0; i < cmpctblock.BlockTxCount(); i++) {
+            if (!partialBlock->IsTxAvailable(i))
+                req.indexes.push_back(i);
+        }
+
+        if (req.indexes.empty()) {
+            CBlock block;
+            if (partialBlock->FillBlock(block, std::vector<CTransaction>()) != READ_STATUS_OK) {
+                pfrom->PushMessage("getdata", std::vector<CInv>(1, CInv(MSG_BLOCK, hashBlock)));
+                return true;
+            }
+            ProcessReceivedBlock(pfrom, strCommand, block);
         } else {
-            pfrom->AddInventoryKnown(inv);
+            {
+                LOCK(cs_main);
+                State(pfrom->GetId())->partialBlock = partialBlock;
+            }
+            pfrom->PushMessage("getblocktxn", req);
+        }
+    }
 
-            CValidationState state;
-            if (!mapBlockIndex.count(block.GetHash())) {
-                ProcessNewBlock(state, pfrom, &block);
-                int nDoS;
-                if(state.IsInvalid(nDoS)) {
-                    pfrom->PushMessage("reject", strCommand, state.GetRejectCode(),
-                                       state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), inv.hash);
-                    if(nDoS > 0) {
-                        TRY_LOCK(cs_main, lockMain);
-                        if(lockMain) Misbehaving(pfrom->GetId(), nDoS);
-                    }
-                }
-                //disconnect this node if its old protocol version
-                pfrom->DisconnectOldProtocol(ActiveProtocol(), strCommand);
-            } else {
-                LogPrint("net", "%s : Already processed block %s, skipping ProcessNewBlock()\n", __func__, block.GetHash().GetHex());
+
+    else if (strCommand == "getblocktxn") {
+        BlockTransactionsRequest req;
+        vRecv >> req;
+
+        CBlock block;
+        bool fServeWhole = false;
+        {
+            LOCK(cs_main);
+            BlockMap::iterator mi = mapBlockIndex.find(req.blockhash);
+            if (mi == mapBlockIndex.end() || !(mi->second->nStatus & BLOCK_HAVE_DATA)) {
+                LogPrint("net", "peer=%d asked for transactions of block %s we don't have\n", pfrom->id, req.blockhash.ToString());
+                return true;
+            }
+            // We only hand out compact blocks for recent blocks, anything older is served whole
+            fServeWhole = chainActive.Height() - mi->second->nHeight > MAX_CMPCTBLOCK_DEPTH;
+            if (!fServeWhole && !ReadBlockFromDisk(block, mi->second))
+                assert(!"cannot load block from disk");
+        }
+        if (fServeWhole) {
+            // ProcessGetData takes cs_main itself
+            pfrom->vRecvGetData.push_back(CInv(MSG_BLOCK, req.blockhash));
+            ProcessGetData(pfrom);
+            return true;
+        }
+
+        BlockTransactions resp(req);
+        for (size_t i = 0; i < req.indexes.size(); i++) {
+            if (req.indexes[i] >= block.vtx.size()) {
+                LOCK(cs_main);
+                Misbehaving(pfrom->GetId(), 100);
+                return error("getblocktxn index %u out of range from peer=%d", req.indexes[i], pfrom->id);
             }
+            resp.txn[i] = block.vtx[req.indexes[i]];
+        }
+        pfrom->PushMessage("blocktxn", resp);
+    }
+
+
+    else if (strCommand == "blocktxn" && !fImporting && !fReindex) // Ignore blocks received while importing
+    {
+        BlockTransactions resp;
+        vRecv >> resp;
+
+        std::shared_ptr<PartiallyDownloadedBlock> partialBlock;
+        {
+            LOCK(cs_main);
+            CNodeState* nodestate = State(pfrom->GetId());
+            if (!nodestate->partialBlock || nodestate->partialBlock->header.GetHash() != resp.blockhash) {
+                LogPrint("net", "peer=%d sent blocktxn for block %s we did not ask for\n", pfrom->id, resp.blockhash.ToString());
+                return true;
+            }
+            partialBlock.swap(nodestate->partialBlock);
+        }
+
+        CBlock block;
+        ReadStatus status = partialBlock->FillBlock(block, resp.txn);
+        if (status == READ_STATUS_INVALID) {
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), 100);
+            return error("invalid blocktxn for block %s from peer=%d", resp.blockhash.ToString(), pfrom->id);
+        } else if (status == READ_STATUS_FAILED) {
+            pfrom->PushMessage("getdata", std::vector<CInv>(1, CInv(MSG_BLOCK, resp.blockhash)));
+            return true;
+        }
+        ProcessReceivedBlock(pfrom, strCommand, block);
+    }
+
+
+    else if (strCommand == "sendcmpct") {
+        bool fAnnounce;
+        uint64_t nCmpctVersion;
+        vRecv >> fAnnounce >> nCmpctVersion;
+        // Unknown versions are ignored, the peer just gets full blocks
+        if (nCmpctVersion == COMPACT_BLOCKS_VERSION && (nLocalServices & NODE_COMPACT_BLOCKS)) {
+            pfrom->fSupportsCompactBlocks = true;
+            pfrom->fPreferCompactBlocks = fAnnounce;
         }
     }
 
@@ -6396,9 +7163,9 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
         if (!IsInitialBlockDownload() && (GetTime() - nLastRebroadcast > 24 * 60 * 60)) {
             LOCK(cs_vNodes);
             for (CNode* pnode : vNodes) {
-                // Periodically clear setAddrKnown to allow refresh broadcasts
+                // Periodically clear addrKnown to allow refresh broadcasts
                 if (nLastRebroadcast)
-                    pnode->setAddrKnown.clear();
+                    pnode->addrKnown.reset();
 
                 // Rebroadcast our address
                 AdvertiseLocal(pnode);
@@ -6414,8 +7181,8 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
             std::vector<CAddress> vAddr;
             vAddr.reserve(pto->vAddrToSend.size());
             for (const CAddress& addr : pto->vAddrToSend) {
-                // returns true if wasn't already contained in the set
-                if (pto->setAddrKnown.insert(addr).second) {
+                if (!pto->addrKnown.contains(addr.GetKey())) {
+                    pto->addrKnown.insert(addr.GetKey());
                     vAddr.push_back(addr);
                     // receiver rejects addr messages larger than 1000
                     if (vAddr.size() >= 1000) {
@@ -6448,6 +7215,12 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
             pto->PushMessage("reject", (std::string) "block", reject.chRejectCode, reject.strRejectReason, reject.hashBlock);
         state.rejects.clear();
 
+        // Switch the peer between pushing us compact blocks and announcing blocks with an inv
+        if (state.fWantCompactAnnounce != state.fSentCompactAnnounce) {
+            pto->PushMessage("sendcmpct", state.fWantCompactAnnounce, COMPACT_BLOCKS_VERSION);
+            state.fSentCompactAnnounce = state.fWantCompactAnnounce;
+        }
+
         // Start block sync
         if (pindexBestHeader == NULL)
             pindexBestHeader = chainActive.Tip();
@@ -6481,7 +7254,7 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
             vInv.reserve(pto->vInventoryToSend.size());
             vInvWait.reserve(pto->vInventoryToSend.size());
             for (const CInv& inv : pto->vInventoryToSend) {
-                if (pto->setInventoryKnown.count(inv))
+                if (pto->filterInventoryKnown.contains(inv.GetKey()))
                     continue;
 
                 // trickle out tx inv to protect privacy
@@ -6500,13 +7273,12 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
                     }
                 }
 
-                // returns true if wasn't already contained in the set
-                if (pto->setInventoryKnown.insert(inv).second) {
-                    vInv.push_back(inv);
-                    if (vInv.size() >= 1000) {
-                        pto->PushMessage("inv", vInv);
-                        vInv.clear();
-                    }
+                // already filtered out above if known
+                pto->filterInventoryKnown.insert(inv.GetKey());
+                vInv.push_back(inv);
+                if (vInv.size() >= 1000) {
+                    pto->PushMessage("inv", vInv);
+                    vInv.clear();
                 }
             }
             pto->vInventoryToSend = vInvWait;
@@ -15,6 +15,7 @@
 #include "config/yoda-config.h"
 #endif
 
+#include "addressindex.h"
 #include "amount.h"
 #include "chain.h"
 #include "chainparams.h"
@@ -29,6 +30,7 @@
 #include "script/script.h"
 #include "script/sigcache.h"
 #include "script/standard.h"
+#include "spentindex.h"
 #include "sync.h"
 #include "tinyformat.h"
 #include "txmempool.h"
@@ -39,6 +41,7 @@
 #include <atomic>
 #include <exception>
 #include <map>
+#include <memory>
 #include <set>
 #include <stdint.h>
 #include <string>
@@ -60,6 +63,7 @@ class CValidationInterface;
 class CValidationState;
 
 struct CBlockTemplate;
+struct CBlockTimingRecord;
 struct CNodeStateStats;
 
 /** Default for -blockmaxsize and -blockminsize, which control the range of sizes the mining code will create **/
@@ -83,9 +87,17 @@ static const unsigned int BLOCKFILE_CHUNK_SIZE = 0x1000000; // 16 MiB
 /** The pre-allocation chunk size for rev?????.dat files (since 0.8) */
 static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 /** Maximum number of script-checking threads allowed */
-static const int MAX_SCRIPTCHECK_THREADS = 16;
+static const int MAX_SCRIPTCHECK_THREADS = 64;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** Maximum number of threads decoding and checking blocks for -reindex and -loadblock */
+static const int MAX_IMPORT_THREADS = 8;
+/** Raw block bytes -reindex and -loadblock may read ahead of the block being connected */
+static const uint64_t MAX_IMPORT_READAHEAD = 64 * 1024 * 1024;
+/** Default for -addressindex, -spentindex and -timestampindex */
+static const bool DEFAULT_ADDRESSINDEX = false;
+static const bool DEFAULT_SPENTINDEX = false;
+static const bool DEFAULT_TIMESTAMPINDEX = false;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
@@ -106,6 +118,9 @@ static const unsigned int MAX_REJECT_MESSAGE_LENGTH = 111;
 /** Enable bloom filter */
  static const bool DEFAULT_PEERBLOOMFILTERS = true;
 
+/** Relay blocks to and from peers that support it as compact blocks */
+static const bool DEFAULT_BLOCK_COMPACT = true;
+
 /** If the tip is older than this (in seconds), the node is considered to be in initial block download. */
 static const int64_t DEFAULT_MAX_TIP_AGE = 24 * 60 * 60;
 
@@ -139,6 +154,9 @@ extern std::atomic<bool> fImporting;
 extern std::atomic<bool> fReindex;
 extern int nScriptCheckThreads;
 extern bool fTxIndex;
+extern bool fAddressIndex;
+extern bool fSpentIndex;
+extern bool fTimestampIndex;
 extern bool fIsBareMultisigStd;
 extern bool fCheckBlockIndex;
 extern unsigned int nCoinCacheSize;
@@ -174,9 +192,10 @@ void UnregisterNodeSignals(CNodeSignals& nodeSignals);
  * @param[in]   pfrom   The node which we are receiving the block from; it is added to mapBlockSource and may be penalised if the block is invalid.
  * @param[in]   pblock  The block we want to process.
  * @param[out]  dbp     If pblock is stored to disk (or already there), this will be set to its location.
+ * @param[in]   fPrechecked The import pipeline already ran the context-free block checks, the transaction checks and the block signature check on pblock.
  * @return True if state.IsValid()
  */
-bool ProcessNewBlock(CValidationState& state, CNode* pfrom, CBlock* pblock, CDiskBlockPos* dbp = NULL);
+bool ProcessNewBlock(CValidationState& state, CNode* pfrom, CBlock* pblock, CDiskBlockPos* dbp = NULL, bool fPrechecked = false);
 /** Check whether enough disk space is available for an incoming block */
 bool CheckDiskSpace(uint64_t nAdditionalBytes = 0);
 /** Open a block file (blk?????.dat) */
@@ -247,6 +266,7 @@ struct CNodeStateStats {
     int nMisbehavior;
     int nSyncHeight;
     int nCommonHeight;
+    int nBlocksInFlight;
     std::vector<int> vHeightInFlight;
 };
 
@@ -281,6 +301,22 @@ bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsVi
 /** Apply the effects of this transaction on the UTXO set represented by view */
 void UpdateCoins(const CTransaction& tx, CValidationState& state, CCoinsViewCache& inputs, CTxUndo& txundo, int nHeight);
 
+/** Address and spent index entries of one block, in the order they must be applied */
+struct CBlockIndexEntries {
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vAddressIndex;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vAddressUnspentIndex;
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > vSpentIndex;
+};
+
+/** Add the index entries of a transaction being connected, while its inputs are still in view */
+void AddConnectIndexEntries(const CTransaction& tx, const CCoinsViewCache& view, int nHeight, unsigned int nTx, CBlockIndexEntries& entries);
+/** Add the index entries of a transaction being disconnected, once its inputs are restored in view */
+void AddDisconnectIndexEntries(const CTransaction& tx, const CCoinsViewCache& view, int nHeight, unsigned int nTx, CBlockIndexEntries& entries);
+/** Apply the entries of a connected block, and add it to the timestamp index */
+bool WriteBlockIndexEntries(const CBlockIndexEntries& entries, const CBlockIndex* pindex);
+/** Apply the entries of a disconnected block, and remove it from the timestamp index */
+bool EraseBlockIndexEntries(const CBlockIndexEntries& entries, const CBlockIndex* pindex);
+
 bool IsTransactionInChain(const uint256& txId, int& nHeightTx, CTransaction& tx);
 bool IsTransactionInChain(const uint256& txId, int& nHeightTx);
 bool IsBlockHashInChain(const uint256& hashBlock);
@@ -313,11 +349,13 @@ private:
     unsigned int nFlags;
     bool cacheStore;
     ScriptError error;
+    //! Shared by the checks of all inputs of ptxTo, may be null
+    std::shared_ptr<const PrecomputedTransactionData> txdata;
 
 public:
     CScriptCheck() : ptxTo(0), nIn(0), nFlags(0), cacheStore(false), error(SCRIPT_ERR_UNKNOWN_ERROR) {}
-    CScriptCheck(const CCoins& txFromIn, const CTransaction& txToIn, unsigned int nInIn, unsigned int nFlagsIn, bool cacheIn) : scriptPubKey(txFromIn.vout[txToIn.vin[nInIn].prevout.n].scriptPubKey),
-                                                                                                                                ptxTo(&txToIn), nIn(nInIn), nFlags(nFlagsIn), cacheStore(cacheIn), error(SCRIPT_ERR_UNKNOWN_ERROR) {}
+    CScriptCheck(const CCoins& txFromIn, const CTransaction& txToIn, unsigned int nInIn, unsigned int nFlagsIn, bool cacheIn, const std::shared_ptr<const PrecomputedTransactionData>& txdataIn = nullptr) : scriptPubKey(txFromIn.vout[txToIn.vin[nInIn].prevout.n].scriptPubKey),
+                                                                                                                                ptxTo(&txToIn), nIn(nInIn), nFlags(nFlagsIn), cacheStore(cacheIn), error(SCRIPT_ERR_UNKNOWN_ERROR), txdata(txdataIn) {}
 
     bool operator()();
 
@@ -329,6 +367,7 @@ public:
         std::swap(nFlags, check.nFlags);
         std::swap(cacheStore, check.cacheStore);
         std::swap(error, check.error);
+        txdata.swap(check.txdata);
     }
 
     ScriptError GetScriptError() const { return error; }
@@ -353,8 +392,8 @@ bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex
 bool DisconnectBlocks(int nBlocks);
 void ReprocessBlocks(int nBlocks);
 
-/** Apply the effects of this block (with given index) on the UTXO set represented by coins */
-bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& coins, bool fJustCheck, bool fAlreadyChecked = false);
+/** Apply the effects of this block (with given index) on the UTXO set represented by coins; ptiming gets the time of its stages */
+bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& coins, bool fJustCheck, bool fAlreadyChecked = false, CBlockTimingRecord* ptiming = nullptr);
 
 /** Context-independent validity checks */
 bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, bool fCheckPOW = true);
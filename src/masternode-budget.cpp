@@ -16,6 +16,8 @@
 #include "util.h"
 #include <boost/filesystem.hpp>
 
+#include <limits>
+
 CBudgetManager budget;
 CCriticalSection cs_budget;
 
@@ -446,6 +448,7 @@ bool CBudgetManager::AddProposal(CBudgetProposal& budgetProposal)
     }
 
     mapProposals.insert(std::make_pair(budgetProposal.GetHash(), budgetProposal));
+    nVoteEpoch++;
     LogPrint("mnbudget","CBudgetManager::AddProposal - proposal %s added\n", budgetProposal.GetName ().c_str ());
     return true;
 }
@@ -516,6 +519,7 @@ void CBudgetManager::CheckAndRemove()
     // Remove invalid entries by overwriting complete map
     mapFinalizedBudgets.swap(tmpMapFinalizedBudgets);
     mapProposals.swap(tmpMapProposals);
+    nVoteEpoch++;
 
     // clang doesn't accept copy assignemnts :-/
     // mapFinalizedBudgets = tmpMapFinalizedBudgets;
@@ -770,6 +774,22 @@ std::vector<CBudgetProposal*> CBudgetManager::GetBudget()
 {
     LOCK(cs);
 
+    CBlockIndex* pindexPrev;
+    {
+        LOCK(cs_main);
+        pindexPrev = chainActive.Tip();
+    }
+    if (pindexPrev == NULL) return std::vector<CBudgetProposal*>();
+
+    int mnCount = mnodeman.CountEnabled(ActiveProtocol());
+    uint64_t nListGeneration = mnodeman.GetListGeneration();
+    int64_t nNow = GetAdjustedTime();
+    if (fCachedBudget && nCachedBudgetHeight == pindexPrev->nHeight && nCachedBudgetVoteEpoch == nVoteEpoch &&
+        nCachedBudgetListGeneration == nListGeneration && nCachedBudgetMnCount == mnCount &&
+        nNow > nCachedBudgetEstablishedAfter && nNow <= nCachedBudgetPendingUntil) {
+        return vCachedBudget;
+    }
+
     // ------- Sort budgets by Yes Count
 
     std::vector<std::pair<CBudgetProposal*, int> > vBudgetPorposalsSort;
@@ -789,16 +809,8 @@ std::vector<CBudgetProposal*> CBudgetManager::GetBudget()
 
     CAmount nBudgetAllocated = 0;
 
-    CBlockIndex* pindexPrev;
-    {
-        LOCK(cs_main);
-        pindexPrev = chainActive.Tip();
-    }
-    if (pindexPrev == NULL) return vBudgetProposalsRet;
-
     int nBlockStart = pindexPrev->nHeight - pindexPrev->nHeight % Params().GetBudgetCycleBlocks() + Params().GetBudgetCycleBlocks();
     int nBlockEnd = nBlockStart + Params().GetBudgetCycleBlocks() - 1;
-    int mnCount = mnodeman.CountEnabled(ActiveProtocol());
     CAmount nTotalBudget = GetTotalBudget(nBlockStart);
 
     std::vector<std::pair<CBudgetProposal*, int> >::iterator it2 = vBudgetPorposalsSort.begin();
@@ -833,6 +845,26 @@ std::vector<CBudgetProposal*> CBudgetManager::GetBudget()
         ++it2;
     }
 
+    // IsEstablished() flips when the adjusted time passes nTime plus the establishment time
+    int64_t nEstablishedAfter = std::numeric_limits<int64_t>::min();
+    int64_t nPendingUntil = std::numeric_limits<int64_t>::max();
+    for (it = mapProposals.begin(); it != mapProposals.end(); ++it) {
+        int64_t nEstablishedTime = (*it).second.nTime + Params().GetProposalEstablishmentTime();
+        if (nNow > nEstablishedTime)
+            nEstablishedAfter = std::max(nEstablishedAfter, nEstablishedTime);
+        else
+            nPendingUntil = std::min(nPendingUntil, nEstablishedTime);
+    }
+
+    vCachedBudget = vBudgetProposalsRet;
+    fCachedBudget = true;
+    nCachedBudgetHeight = pindexPrev->nHeight;
+    nCachedBudgetVoteEpoch = nVoteEpoch;
+    nCachedBudgetListGeneration = nListGeneration;
+    nCachedBudgetMnCount = mnCount;
+    nCachedBudgetEstablishedAfter = nEstablishedAfter;
+    nCachedBudgetPendingUntil = nPendingUntil;
+
     return vBudgetProposalsRet;
 }
 
@@ -1413,7 +1445,10 @@ bool CBudgetManager::UpdateProposal(CBudgetVote& vote, CNode* pfrom, std::string
     }
 
 
-    return mapProposals[vote.nProposalHash].AddOrUpdateVote(vote, strError);
+    if (!mapProposals[vote.nProposalHash].AddOrUpdateVote(vote, strError))
+        return false;
+    nVoteEpoch++;
+    return true;
 }
 
 bool CBudgetManager::UpdateFinalizedBudget(CFinalizedBudgetVote& vote, CNode* pfrom, std::string& strError)
@@ -1450,6 +1485,7 @@ CBudgetProposal::CBudgetProposal()
     nAmount = 0;
     nTime = 0;
     fValid = true;
+    RecountVotes();
 }
 
 CBudgetProposal::CBudgetProposal(std::string strProposalNameIn, std::string strURLIn, int nBlockStartIn, int nBlockEndIn, CScript addressIn, CAmount nAmountIn, uint256 nFeeTXHashIn)
@@ -1462,6 +1498,7 @@ CBudgetProposal::CBudgetProposal(std::string strProposalNameIn, std::string strU
     nAmount = nAmountIn;
     nFeeTXHash = nFeeTXHashIn;
     fValid = true;
+    RecountVotes();
 }
 
 CBudgetProposal::CBudgetProposal(const CBudgetProposal& other)
@@ -1476,6 +1513,11 @@ CBudgetProposal::CBudgetProposal(const CBudgetProposal& other)
     nFeeTXHash = other.nFeeTXHash;
     mapVotes = other.mapVotes;
     fValid = true;
+    nYeas = other.nYeas;
+    nNays = other.nNays;
+    nAbstains = other.nAbstains;
+    nRatioYeas = other.nRatioYeas;
+    nRatioNays = other.nRatioNays;
 }
 
 bool CBudgetProposal::IsValid(std::string& strError, bool fCheckCollateral)
@@ -1610,7 +1652,11 @@ bool CBudgetProposal::AddOrUpdateVote(CBudgetVote& vote, std::string& strError)
         return false;
     }
 
+    std::map<uint256, CBudgetVote>::iterator it = mapVotes.find(hash);
+    if (it != mapVotes.end())
+        CountVote((*it).second, -1);
     mapVotes[hash] = vote;
+    CountVote(vote, 1);
     LogPrint("mnbudget", "CBudgetProposal::AddOrUpdateVote - %s %s\n", strAction.c_str(), vote.GetHash().ToString().c_str());
 
     return true;
@@ -1623,66 +1669,47 @@ void CBudgetProposal::CleanAndRemove()
 
     while (it != mapVotes.end()) {
         CMasternode* pmn = mnodeman.Find((*it).second.GetVin());
-        (*it).second.fValid = (pmn != nullptr);
-        ++it;
-    }
-}
-
-double CBudgetProposal::GetRatio()
-{
-    int yeas = 0;
-    int nays = 0;
-
-    std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
-
-    while (it != mapVotes.end()) {
-        if ((*it).second.nVote == VOTE_YES) yeas++;
-        if ((*it).second.nVote == VOTE_NO) nays++;
+        bool fVoteValid = (pmn != nullptr);
+        if ((*it).second.fValid != fVoteValid) {
+            CountVote((*it).second, -1);
+            (*it).second.fValid = fVoteValid;
+            CountVote((*it).second, 1);
+        }
         ++it;
     }
-
-    if (yeas + nays == 0) return 0.0f;
-
-    return ((double)(yeas) / (double)(yeas + nays));
 }
 
-int CBudgetProposal::GetYeas() const
+void CBudgetProposal::CountVote(const CBudgetVote& vote, int nSign)
 {
-    int ret = 0;
+    if (vote.nVote == VOTE_YES) nRatioYeas += nSign;
+    if (vote.nVote == VOTE_NO) nRatioNays += nSign;
 
-    std::map<uint256, CBudgetVote>::const_iterator it = mapVotes.begin();
-    while (it != mapVotes.end()) {
-        if ((*it).second.nVote == VOTE_YES && (*it).second.fValid) ret++;
-        ++it;
-    }
-
-    return ret;
+    if (!vote.fValid) return;
+    if (vote.nVote == VOTE_YES) nYeas += nSign;
+    if (vote.nVote == VOTE_NO) nNays += nSign;
+    if (vote.nVote == VOTE_ABSTAIN) nAbstains += nSign;
 }
 
-int CBudgetProposal::GetNays() const
+void CBudgetProposal::RecountVotes()
 {
-    int ret = 0;
+    nYeas = 0;
+    nNays = 0;
+    nAbstains = 0;
+    nRatioYeas = 0;
+    nRatioNays = 0;
 
     std::map<uint256, CBudgetVote>::const_iterator it = mapVotes.begin();
     while (it != mapVotes.end()) {
-        if ((*it).second.nVote == VOTE_NO && (*it).second.fValid) ret++;
+        CountVote((*it).second, 1);
         ++it;
     }
-
-    return ret;
 }
 
-int CBudgetProposal::GetAbstains() const
+double CBudgetProposal::GetRatio()
 {
-    int ret = 0;
+    if (nRatioYeas + nRatioNays == 0) return 0.0f;
 
-    std::map<uint256, CBudgetVote>::const_iterator it = mapVotes.begin();
-    while (it != mapVotes.end()) {
-        if ((*it).second.nVote == VOTE_ABSTAIN && (*it).second.fValid) ret++;
-        ++it;
-    }
-
-    return ret;
+    return ((double)(nRatioYeas) / (double)(nRatioYeas + nRatioNays));
 }
 
 int CBudgetProposal::GetBlockStartCycle()
@@ -181,6 +181,21 @@ private:
     // XX42    std::map<uint256, CTransaction> mapCollateral;
     std::map<uint256, uint256> mapCollateralTxids;
 
+    // Bumped by every change to the proposals or their votes
+    uint64_t nVoteEpoch;
+
+    // Last result of GetBudget(), which stays right for as long as the tip height,
+    // vote epoch, masternode list and enabled masternode count are the same, and
+    // the adjusted time does not cross the time a proposal becomes established
+    std::vector<CBudgetProposal*> vCachedBudget;
+    bool fCachedBudget;
+    int nCachedBudgetHeight;
+    uint64_t nCachedBudgetVoteEpoch;
+    uint64_t nCachedBudgetListGeneration;
+    int nCachedBudgetMnCount;
+    int64_t nCachedBudgetEstablishedAfter;
+    int64_t nCachedBudgetPendingUntil;
+
 public:
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
@@ -200,6 +215,8 @@ public:
     {
         mapProposals.clear();
         mapFinalizedBudgets.clear();
+        nVoteEpoch = 0;
+        fCachedBudget = false;
     }
 
     void ClearSeen()
@@ -255,6 +272,7 @@ public:
         mapSeenFinalizedBudgetVotes.clear();
         mapOrphanMasternodeBudgetVotes.clear();
         mapOrphanFinalizedBudgetVotes.clear();
+        nVoteEpoch++;
     }
     void CheckAndRemove();
     std::string ToString() const;
@@ -274,6 +292,8 @@ public:
 
         READWRITE(mapProposals);
         READWRITE(mapFinalizedBudgets);
+        if (ser_action.ForRead())
+            nVoteEpoch++;
     }
 };
 
@@ -458,6 +478,20 @@ private:
     mutable CCriticalSection cs;
     CAmount nAlloted;
 
+    // Tallies of mapVotes, kept up to date as votes are added, updated and expire,
+    // so reading them does not walk the votes. Yeas, nays and abstains count valid
+    // votes only; the ratio counts every vote.
+    int nYeas;
+    int nNays;
+    int nAbstains;
+    int nRatioYeas;
+    int nRatioNays;
+
+    void CountVote(const CBudgetVote& vote, int nSign);
+
+protected:
+    void RecountVotes();
+
 public:
     bool fValid;
     std::string strProposalName;
@@ -474,6 +508,7 @@ public:
     int64_t nTime;
     uint256 nFeeTXHash;
 
+    // Only AddOrUpdateVote and CleanAndRemove may add votes or change their nVote or fValid
     std::map<uint256, CBudgetVote> mapVotes;
     //cache object
 
@@ -502,9 +537,9 @@ public:
     int GetBlockCurrentCycle();
     int GetBlockEndCycle();
     double GetRatio();
-    int GetYeas() const;
-    int GetNays() const;
-    int GetAbstains() const;
+    int GetYeas() const { return nYeas; }
+    int GetNays() const { return nNays; }
+    int GetAbstains() const { return nAbstains; }
     CAmount GetAmount() { return nAmount; }
     void SetAllotted(CAmount nAllotedIn) { nAlloted = nAllotedIn; }
     CAmount GetAllotted() { return nAlloted; }
@@ -543,6 +578,8 @@ public:
 
         //for saving to the serialized db
         READWRITE(mapVotes);
+        if (ser_action.ForRead())
+            RecountVotes();
     }
 };
 
@@ -571,6 +608,8 @@ public:
         swap(first.nTime, second.nTime);
         swap(first.nFeeTXHash, second.nFeeTXHash);
         first.mapVotes.swap(second.mapVotes);
+        first.RecountVotes();
+        second.RecountVotes();
     }
 
     CBudgetProposalBroadcast& operator=(CBudgetProposalBroadcast from)
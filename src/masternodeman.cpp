@@ -8,6 +8,7 @@
 #include "addrman.h"
 #include "masternode.h"
 #include "messagesigner.h"
+#include "metrics.h"
 #include "obfuscation.h"
 #include "spork.h"
 #include "util.h"
@@ -196,6 +197,21 @@ void DumpMasternodes()
 CMasternodeMan::CMasternodeMan()
 {
     nDsqCount = 0;
+    nListGeneration = 0;
+}
+
+void CMasternodeMan::ListChanged()
+{
+    nListGeneration++;
+    // DumpMasternodes reads the old cache into a temporary manager; only the node's list counts
+    if (this == &mnodeman)
+        metrics::masternodes.Set(vMasternodes.size());
+}
+
+uint64_t CMasternodeMan::GetListGeneration()
+{
+    LOCK(cs);
+    return nListGeneration;
 }
 
 bool CMasternodeMan::Add(CMasternode& mn)
@@ -209,6 +225,7 @@ bool CMasternodeMan::Add(CMasternode& mn)
     if (pmn == NULL) {
         LogPrint("masternode", "CMasternodeMan: Adding new Masternode %s - %i now\n", mn.vin.prevout.hash.ToString(), size() + 1);
         vMasternodes.push_back(mn);
+        ListChanged();
         return true;
     }
 
@@ -279,6 +296,7 @@ void CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
             }
 
             it = vMasternodes.erase(it);
+            ListChanged();
         } else {
             ++it;
         }
@@ -340,6 +358,7 @@ void CMasternodeMan::Clear()
 {
     LOCK(cs);
     vMasternodes.clear();
+    ListChanged();
     mAskedUsForMasternodeList.clear();
     mWeAskedForMasternodeList.clear();
     mWeAskedForMasternodeListEntry.clear();
@@ -592,15 +611,15 @@ CMasternode* CMasternodeMan::GetCurrentMasterNode(int mod, int64_t nBlockHeight,
     return winner;
 }
 
-int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, int minProtocol, bool fOnlyActive)
+bool CMasternodeMan::GetMasternodeScores(int64_t nBlockHeight, int minProtocol, bool fOnlyActive, std::vector<std::pair<int64_t, CTxIn> >& vecMasternodeScores)
 {
-    std::vector<std::pair<int64_t, CTxIn> > vecMasternodeScores;
     int64_t nMasternode_Min_Age = MN_WINNER_MINIMUM_AGE;
     int64_t nMasternode_Age = 0;
+    vecMasternodeScores.clear();
 
     //make sure we know about this block
     uint256 hash = 0;
-    if (!GetBlockHash(hash, nBlockHeight)) return -1;
+    if (!GetBlockHash(hash, nBlockHeight)) return false;
 
     // scan for winner
     for (CMasternode& mn : vMasternodes) {
@@ -627,6 +646,13 @@ int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, in
     }
 
     sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareScoreTxIn());
+    return true;
+}
+
+int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, int minProtocol, bool fOnlyActive)
+{
+    std::vector<std::pair<int64_t, CTxIn> > vecMasternodeScores;
+    if (!GetMasternodeScores(nBlockHeight, minProtocol, fOnlyActive, vecMasternodeScores)) return -1;
 
     int rank = 0;
     for (PAIRTYPE(int64_t, CTxIn) & s : vecMasternodeScores) {
@@ -1144,6 +1170,7 @@ void CMasternodeMan::Remove(CTxIn vin)
         if ((*it).vin == vin) {
             LogPrint("masternode", "CMasternodeMan: Removing Masternode %s - %i now\n", (*it).vin.prevout.hash.ToString(), size() - 1);
             vMasternodes.erase(it);
+            ListChanged();
             break;
         }
         ++it;
@@ -64,6 +64,10 @@ private:
     std::map<CNetAddr, int64_t> mWeAskedForMasternodeList;
     // which Masternodes we've asked for
     std::map<COutPoint, int64_t> mWeAskedForMasternodeListEntry;
+    // bumped whenever an entry is added to or removed from vMasternodes
+    uint64_t nListGeneration;
+
+    void ListChanged();
 
 public:
     // Keep track of all broadcasts I've seen
@@ -88,6 +92,8 @@ public:
 
         READWRITE(mapSeenMasternodeBroadcast);
         READWRITE(mapSeenMasternodePing);
+        if (ser_action.ForRead())
+            ListChanged();
     }
 
     CMasternodeMan();
@@ -110,6 +116,9 @@ public:
 
     int CountEnabled(int protocolVersion = -1);
 
+    /// Changes whenever an entry is added or removed, so callers can tell if Find() may answer differently
+    uint64_t GetListGeneration();
+
     void CountNetworks(int protocolVersion, int& ipv4, int& ipv6, int& onion);
 
     void DsegUpdate(CNode* pnode);
@@ -136,6 +145,8 @@ public:
 
     std::vector<std::pair<int, CMasternode> > GetMasternodeRanks(int64_t nBlockHeight, int minProtocol = 0);
     int GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, int minProtocol = 0, bool fOnlyActive = true);
+    /// The masternodes GetMasternodeRank() ranks, best first, with their scores; false if the block is unknown
+    bool GetMasternodeScores(int64_t nBlockHeight, int minProtocol, bool fOnlyActive, std::vector<std::pair<int64_t, CTxIn> >& vecMasternodeScores);
     CMasternode* GetMasternodeByRank(int nRank, int64_t nBlockHeight, int minProtocol = 0, bool fOnlyActive = true);
 
     void ProcessMasternodeConnections();
@@ -0,0 +1,132 @@
+// Copyright (c) 2020 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "metrics.h"
+
+#include "httpserver.h"
+#include "rpc/protocol.h"
+#include "tinyformat.h"
+
+#include <boost/assign/list_of.hpp>
+
+static std::vector<const CMetric*>& GetMetricRegistry()
+{
+    static std::vector<const CMetric*> vMetrics;
+    return vMetrics;
+}
+
+//! Whether /metrics serves the wallet and staking metrics, set before the handler is registered
+static bool fServeWalletMetrics = false;
+
+CMetric::CMetric(const char* pszNameIn, const char* pszHelpIn, bool fWalletIn) : pszName(pszNameIn), pszHelp(pszHelpIn), fWallet(fWalletIn)
+{
+    GetMetricRegistry().push_back(this);
+}
+
+void CMetric::WriteHeader(std::string& strOut, const char* pszType) const
+{
+    strOut += strprintf("# HELP %s %s\n# TYPE %s %s\n", pszName, pszHelp, pszName, pszType);
+}
+
+void CMetricCounter::Write(std::string& strOut) const
+{
+    WriteHeader(strOut, "counter");
+    strOut += strprintf("%s %u\n", pszName, Get());
+}
+
+void CMetricGauge::Write(std::string& strOut) const
+{
+    WriteHeader(strOut, "gauge");
+    strOut += strprintf("%s %d\n", pszName, Get());
+}
+
+CMetricHistogram::CMetricHistogram(const char* pszNameIn, const char* pszHelpIn, const std::vector<double>& vBoundsIn)
+    : CMetric(pszNameIn, pszHelpIn, false), vBounds(vBoundsIn), vCounts(new std::atomic<uint64_t>[vBoundsIn.size() + 1]), nSumMicros(0)
+{
+    for (size_t i = 0; i <= vBounds.size(); i++)
+        vCounts[i].store(0, std::memory_order_relaxed);
+}
+
+void CMetricHistogram::ObserveMicros(int64_t nMicros)
+{
+    size_t nBucket = 0;
+    while (nBucket < vBounds.size() && nMicros > vBounds[nBucket] * 1000000)
+        nBucket++;
+    vCounts[nBucket].fetch_add(1, std::memory_order_relaxed);
+    nSumMicros.fetch_add(nMicros, std::memory_order_relaxed);
+}
+
+void CMetricHistogram::Write(std::string& strOut) const
+{
+    WriteHeader(strOut, "histogram");
+    // Buckets are cumulative in the exposition format. A scrape racing an update
+    // may be off by one sample, which the format tolerates.
+    uint64_t nCumulative = 0;
+    for (size_t i = 0; i < vBounds.size(); i++) {
+        nCumulative += vCounts[i].load(std::memory_order_relaxed);
+        strOut += strprintf("%s_bucket{le=\"%g\"} %u\n", pszName, vBounds[i], nCumulative);
+    }
+    nCumulative += vCounts[vBounds.size()].load(std::memory_order_relaxed);
+    strOut += strprintf("%s_bucket{le=\"+Inf\"} %u\n", pszName, nCumulative);
+    strOut += strprintf("%s_sum %.6f\n", pszName, nSumMicros.load(std::memory_order_relaxed) * 0.000001);
+    strOut += strprintf("%s_count %u\n", pszName, nCumulative);
+}
+
+std::string RenderMetrics(bool fIncludeWallet)
+{
+    std::string strOut;
+    for (const CMetric* pmetric : GetMetricRegistry()) {
+        if (pmetric->IsWallet() && !fIncludeWallet)
+            continue;
+        pmetric->Write(strOut);
+    }
+    return strOut;
+}
+
+static bool HTTPReq_Metrics(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (req->GetRequestMethod() != HTTPRequest::GET) {
+        req->WriteReply(HTTP_BAD_METHOD, "Only GET is supported\n");
+        return false;
+    }
+    req->WriteHeader("Content-Type", "text/plain; version=0.0.4");
+    req->WriteReply(HTTP_OK, RenderMetrics(fServeWalletMetrics));
+    return true;
+}
+
+bool StartHTTPMetrics(bool fIncludeWallet)
+{
+    fServeWalletMetrics = fIncludeWallet;
+    RegisterHTTPHandler("/metrics", true, HTTPReq_Metrics);
+    return true;
+}
+
+void StopHTTPMetrics()
+{
+    UnregisterHTTPHandler("/metrics", true);
+}
+
+namespace metrics
+{
+CMetricGauge chainHeight("yoda_chain_height", "Height of the active chain tip");
+CMetricCounter blocksConnected("yoda_blocks_connected_total", "Blocks connected to the active chain");
+CMetricCounter blocksDisconnected("yoda_blocks_disconnected_total", "Blocks disconnected from the active chain");
+CMetricHistogram blockConnectSeconds("yoda_block_connect_seconds", "Time to connect a block to the active chain",
+    boost::assign::list_of(0.005)(0.01)(0.025)(0.05)(0.1)(0.25)(0.5)(1)(2.5)(5)(10));
+
+CMetricGauge mempoolTransactions("yoda_mempool_transactions", "Transactions in the memory pool");
+CMetricGauge mempoolBytes("yoda_mempool_bytes", "Serialized size of the transactions in the memory pool");
+
+CMetricGauge peers("yoda_peers", "Connected peers");
+CMetricCounter netBytesReceived("yoda_net_received_bytes_total", "Bytes received from peers");
+CMetricCounter netBytesSent("yoda_net_sent_bytes_total", "Bytes sent to peers");
+
+CMetricCounter stakeSearches("yoda_stake_searches_total", "Searches for a kernel to stake a block with", true);
+CMetricCounter stakesFound("yoda_stakes_found_total", "Stake kernels found", true);
+CMetricCounter stakedBlocksAccepted("yoda_staked_blocks_accepted_total", "Staked blocks accepted by this node", true);
+
+CMetricGauge masternodes("yoda_masternodes", "Masternodes in the masternode list");
+
+CMetricGauge walletTransactions("yoda_wallet_transactions", "Transactions in the wallet", true);
+} // namespace metrics
@@ -0,0 +1,123 @@
+// Copyright (c) 2020 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef YODA_METRICS_H
+#define YODA_METRICS_H
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+static const bool DEFAULT_METRICS = false;
+static const bool DEFAULT_METRICS_WALLET = false;
+
+/**
+ * A value served on /metrics in the Prometheus text format.
+ *
+ * Metrics are plain atomics, updated in place by the code they measure and
+ * read without any lock when scraped. They register themselves when they are
+ * constructed, so they must all be defined before main() runs: the registry is
+ * never changed afterwards and needs no lock either.
+ *
+ * /metrics is served without authentication, so metrics that tell something
+ * about the wallet, including staking, are marked fWallet and only rendered
+ * when the node operator opts in with -metricswallet.
+ */
+class CMetric
+{
+protected:
+    const char* pszName;
+    const char* pszHelp;
+    const bool fWallet;
+
+    void WriteHeader(std::string& strOut, const char* pszType) const;
+
+public:
+    CMetric(const char* pszNameIn, const char* pszHelpIn, bool fWalletIn);
+    virtual ~CMetric() {}
+
+    bool IsWallet() const { return fWallet; }
+
+    virtual void Write(std::string& strOut) const = 0;
+};
+
+/** A count that only goes up */
+class CMetricCounter : public CMetric
+{
+private:
+    std::atomic<uint64_t> nValue;
+
+public:
+    CMetricCounter(const char* pszNameIn, const char* pszHelpIn, bool fWalletIn = false) : CMetric(pszNameIn, pszHelpIn, fWalletIn), nValue(0) {}
+
+    void Inc(uint64_t n = 1) { nValue.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t Get() const { return nValue.load(std::memory_order_relaxed); }
+    void Write(std::string& strOut) const override;
+};
+
+/** A current value */
+class CMetricGauge : public CMetric
+{
+private:
+    std::atomic<int64_t> nValue;
+
+public:
+    CMetricGauge(const char* pszNameIn, const char* pszHelpIn, bool fWalletIn = false) : CMetric(pszNameIn, pszHelpIn, fWalletIn), nValue(0) {}
+
+    void Set(int64_t n) { nValue.store(n, std::memory_order_relaxed); }
+    void Add(int64_t n) { nValue.fetch_add(n, std::memory_order_relaxed); }
+    int64_t Get() const { return nValue.load(std::memory_order_relaxed); }
+    void Write(std::string& strOut) const override;
+};
+
+/** Durations, counted in buckets by their upper bounds in seconds */
+class CMetricHistogram : public CMetric
+{
+private:
+    const std::vector<double> vBounds;
+    //! One more than vBounds, for +Inf
+    std::unique_ptr<std::atomic<uint64_t>[]> vCounts;
+    std::atomic<int64_t> nSumMicros;
+
+public:
+    CMetricHistogram(const char* pszNameIn, const char* pszHelpIn, const std::vector<double>& vBoundsIn);
+
+    void ObserveMicros(int64_t nMicros);
+    void Write(std::string& strOut) const override;
+};
+
+/** All registered metrics, in the text exposition format; wallet metrics only if fIncludeWallet */
+std::string RenderMetrics(bool fIncludeWallet);
+
+/** Serve /metrics from the HTTP server, which must be initialized. Only started with -server. */
+bool StartHTTPMetrics(bool fIncludeWallet);
+void StopHTTPMetrics();
+
+namespace metrics
+{
+// Validation
+extern CMetricGauge chainHeight;
+extern CMetricCounter blocksConnected;
+extern CMetricCounter blocksDisconnected;
+extern CMetricHistogram blockConnectSeconds;
+// Mempool
+extern CMetricGauge mempoolTransactions;
+extern CMetricGauge mempoolBytes;
+// Net
+extern CMetricGauge peers;
+extern CMetricCounter netBytesReceived;
+extern CMetricCounter netBytesSent;
+// Staking
+extern CMetricCounter stakeSearches;
+extern CMetricCounter stakesFound;
+extern CMetricCounter stakedBlocksAccepted;
+// Masternodes
+extern CMetricGauge masternodes;
+// Wallet
+extern CMetricGauge walletTransactions;
+} // namespace metrics
+
+#endif // YODA_METRICS_H
@@ -16,6 +16,7 @@
 #include "hash.h"
 #include "main.h"
 #include "masternode-sync.h"
+#include "metrics.h"
 #include "net.h"
 #include "pow.h"
 #include "primitives/block.h"
@@ -149,10 +150,12 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
         pblock->nBits = GetNextWorkRequired(pindexPrev, pblock);
         CMutableTransaction txCoinStake;
         int64_t nTxNewTime = 0;
+        metrics::stakeSearches.Inc();
         if (!pwallet->CreateCoinStake(*pwallet, pindexPrev, pblock->nBits, txCoinStake, nTxNewTime)) {
             LogPrint("staking", "%s : stake not found\n", __func__);
             return nullptr;
         }
+        metrics::stakesFound.Inc();
         // Stake found
         pblock->nTime = nTxNewTime;
         pblock->vtx[0].vout[0].SetEmpty();
@@ -544,6 +547,8 @@ bool ProcessBlockFound(CBlock* pblock, CWallet& wallet, CReserveKey& reservekey)
     if (!ProcessNewBlock(state, NULL, pblock)) {
         return error("YODAMiner : ProcessNewBlock, block not accepted");
     }
+    if (pblock->IsProofOfStake())
+        metrics::stakedBlocksAccepted.Inc();
 
     for (CNode* node : vNodes) {
         node->PushInventory(CInv(MSG_BLOCK, pblock->GetHash()));
@@ -33,7 +33,8 @@ static const char* ppszTypeName[] =
         "mn quorum",
         "mn announce",
         "mn ping",
-        "dstx"
+        "dstx",
+        "cmpctblock"
     };
 
 CMessageHeader::CMessageHeader()
@@ -139,7 +140,7 @@ bool CInv::IsKnownType() const
 }
 
 bool CInv::IsMasterNodeType() const{
-     return (type >= 6);
+     return (type >= MSG_SPORK && type <= MSG_DSTX);
 }
 
 const char* CInv::GetCommand() const
@@ -156,3 +157,13 @@ std::string CInv::ToString() const
 {
     return strprintf("%s %s", GetCommand(), hash.ToString());
 }
+
+std::vector<unsigned char> CInv::GetKey() const
+{
+    std::vector<unsigned char> vKey(hash.begin(), hash.end());
+    vKey.push_back(type & 0xff);
+    vKey.push_back((type >> 8) & 0xff);
+    vKey.push_back((type >> 16) & 0xff);
+    vKey.push_back((type >> 24) & 0xff);
+    return vKey;
+}
@@ -79,6 +79,10 @@ enum {
 
     NODE_BLOOM_WITHOUT_MN = (1 << 4),
 
+    // NODE_COMPACT_BLOCKS means the node understands "sendcmpct" and can relay blocks as
+    // a header plus salted short transaction ids ("cmpctblock", "getblocktxn", "blocktxn").
+    NODE_COMPACT_BLOCKS = (1 << 5),
+
     // Bits 24-31 are reserved for temporary experiments. Just pick a bit that
     // isn't getting used, or one not being used much, and notify the
     // bitcoin-development mailing list. Remember that service bits are just
@@ -144,6 +148,8 @@ public:
     bool IsMasterNodeType() const;
     const char* GetCommand() const;
     std::string ToString() const;
+    //! Hash followed by the type, so e.g. a tx and its swiftx lock request stay distinct in known-inventory filters
+    std::vector<unsigned char> GetKey() const;
 
     // TODO: make private (improves encapsulation)
 public:
@@ -169,7 +175,9 @@ enum {
     MSG_MASTERNODE_QUORUM,
     MSG_MASTERNODE_ANNOUNCE,
     MSG_MASTERNODE_PING,
-    MSG_DSTX
+    MSG_DSTX,
+    // getdata only: answer with a "cmpctblock" if the block is recent, a full "block" otherwise
+    MSG_CMPCT_BLOCK
 };
 
 #endif // BITCOIN_PROTOCOL_H
@@ -6,6 +6,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "base58.h"
+#include "blocktiming.h"
 #include "checkpoints.h"
 #include "clientversion.h"
 #include "kernel.h"
@@ -475,6 +476,44 @@ UniValue getblockhash(const UniValue& params, bool fHelp)
     return pblockindex->GetBlockHash().GetHex();
 }
 
+UniValue getblockhashes(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 2)
+        throw std::runtime_error(
+            "getblockhashes high low\n"
+            "\nReturns the hashes of the active chain blocks with a timestamp in [low, high). Requires -timestampindex.\n"
+
+            "\nArguments:\n"
+            "1. high   (numeric, required) The newer block timestamp, exclusive\n"
+            "2. low    (numeric, required) The older block timestamp, inclusive\n"
+
+            "\nResult:\n"
+            "[\n"
+            "  \"hash\"   (string) The block hash\n"
+            "  ,...\n"
+            "]\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("getblockhashes", "1231614698 1231024505") + HelpExampleRpc("getblockhashes", "1231614698, 1231024505"));
+
+    if (!fTimestampIndex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Timestamp index not enabled, restart with -timestampindex and -reindex");
+
+    int64_t nHigh = params[0].get_int64();
+    int64_t nLow = params[1].get_int64();
+    if (nLow < 0 || nHigh < nLow || nHigh > std::numeric_limits<unsigned int>::max())
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid timestamp range");
+
+    std::vector<uint256> vHashes;
+    if (!pblocktree->ReadTimestampIndex((unsigned int)nHigh, (unsigned int)nLow, vHashes))
+        throw JSONRPCError(RPC_DATABASE_ERROR, "No information for block hashes");
+
+    UniValue result(UniValue::VARR);
+    for (const uint256& hash : vHashes)
+        result.push_back(hash.GetHex());
+    return result;
+}
+
 UniValue getblock(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() < 1 || params.size() > 2)
@@ -617,7 +656,7 @@ UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
         throw std::runtime_error(
             "gettxoutsetinfo\n"
             "\nReturns statistics about the unspent transaction output set.\n"
-            "Note this call may take some time.\n"
+            "Note this call may take some time. Results are cached until the next block is connected.\n"
 
             "\nResult:\n"
             "{\n"
@@ -633,13 +672,19 @@ UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
             "\nExamples:\n" +
             HelpExampleCli("gettxoutsetinfo", "") + HelpExampleRpc("gettxoutsetinfo", ""));
 
-    LOCK(cs_main);
+    CCoinsView* pcoinsView;
+    {
+        // Only the flush needs cs_main: the scan runs on a snapshot of the coin database,
+        // and its result is cached until the best block changes.
+        LOCK(cs_main);
+        FlushStateToDisk();
+        pcoinsView = pcoinsTip;
+    }
 
     UniValue ret(UniValue::VOBJ);
 
     CCoinsStats stats;
-    FlushStateToDisk();
-    if (pcoinsTip->GetStats(stats)) {
+    if (pcoinsView->GetStats(stats)) {
         ret.push_back(Pair("height", (int64_t)stats.nHeight));
         ret.push_back(Pair("bestblock", stats.hashBlock.GetHex()));
         ret.push_back(Pair("transactions", (int64_t)stats.nTransactions));
@@ -1434,3 +1479,118 @@ UniValue getblockindexstats(const UniValue& params, bool fHelp) {
 
 }
 
+
+static UniValue BlockTimingToJSON(const CBlockTimingRecord& record)
+{
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("hash", record.hash.GetHex()));
+    ret.push_back(Pair("height", record.nHeight));
+    ret.push_back(Pair("tx", (int64_t)record.nTx));
+    ret.push_back(Pair("inputs", (int64_t)record.nInputs));
+    ret.push_back(Pair("proofofstake", record.fProofOfStake));
+    ret.push_back(Pair("time", record.nTime));
+    UniValue stages(UniValue::VOBJ);
+    for (int i = 0; i < BLOCKSTAGE_COUNT; i++) {
+        if (record.vStageMicros[i] >= 0)
+            stages.push_back(Pair(GetBlockStageName(i), record.vStageMicros[i] * 0.001));
+    }
+    ret.push_back(Pair("stages_ms", stages));
+    return ret;
+}
+
+static bool CompareBlockTimingSlowest(const CBlockTimingRecord& a, const CBlockTimingRecord& b)
+{
+    return a.vStageMicros[BLOCKSTAGE_CONNECT_TIP] > b.vStageMicros[BLOCKSTAGE_CONNECT_TIP];
+}
+
+UniValue getblockprocessingstats(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 1)
+        throw std::runtime_error(
+            "getblockprocessingstats ( count )\n"
+            "\nReturns where the time to accept and connect blocks went, per stage.\n"
+            "Histograms cover every block connected since startup, the slowest blocks\n"
+            "are picked from the last 1000.\n"
+
+            "\nArguments:\n"
+            "1. count              (numeric, optional, default=10) number of slowest blocks to return.\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"blocks\": xxxxx             (numeric) blocks connected since startup\n"
+            "  \"stages\": {\n"
+            "    \"name\": {               (object) a stage, e.g. checkblock, checkproofofstake, zerocoinspends,\n"
+            "                                fetchinputs, scriptwait, undowrite, flushstatetodisk, connecttip\n"
+            "      \"count\": xxxxx          (numeric) blocks that ran the stage\n"
+            "      \"mean_ms\": x.xxx        (numeric) mean time\n"
+            "      \"p50_ms\": x.xxx         (numeric) median, as the upper bound of its histogram bucket\n"
+            "      \"p90_ms\": x.xxx         (numeric) 90th percentile, likewise\n"
+            "      \"p99_ms\": x.xxx         (numeric) 99th percentile, likewise\n"
+            "      \"max_ms\": x.xxx         (numeric) longest time\n"
+            "      \"histogram\": {          (object) block counts by bucket, keyed by the bucket upper bound in ms\n"
+            "        \"x.xxx\": n\n"
+            "      }\n"
+            "    }, ...\n"
+            "  },\n"
+            "  \"slowest\": [              (array) the slowest recent blocks, slowest first\n"
+            "    {\n"
+            "      \"hash\": \"hash\",        (string) block hash\n"
+            "      \"height\": n,           (numeric) block height\n"
+            "      \"tx\": n,               (numeric) number of transactions\n"
+            "      \"inputs\": n,           (numeric) number of inputs\n"
+            "      \"proofofstake\": true|false,\n"
+            "      \"time\": ttt,           (numeric) when the block was connected, in seconds since epoch\n"
+            "      \"stages_ms\": {         (object) time of each stage the block ran\n"
+            "        \"name\": x.xxx\n"
+            "      }\n"
+            "    }, ...\n"
+            "  ]\n"
+            "}\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("getblockprocessingstats", "") + HelpExampleRpc("getblockprocessingstats", "5"));
+
+    int nCount = 10;
+    if (params.size() > 0)
+        nCount = params[0].get_int();
+    if (nCount < 0)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative count");
+
+    std::vector<CStageHistogram> vHistograms;
+    blockTimingLog.GetHistograms(vHistograms);
+    std::vector<CBlockTimingRecord> vRecords = blockTimingLog.GetRecords();
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("blocks", (int64_t)blockTimingLog.GetBlockCount()));
+
+    UniValue stages(UniValue::VOBJ);
+    for (int i = 0; i < BLOCKSTAGE_COUNT; i++) {
+        const CStageHistogram& histogram = vHistograms[i];
+        if (histogram.nCount == 0)
+            continue;
+        UniValue stage(UniValue::VOBJ);
+        stage.push_back(Pair("count", (int64_t)histogram.nCount));
+        stage.push_back(Pair("mean_ms", histogram.nTotalMicros * 0.001 / histogram.nCount));
+        stage.push_back(Pair("p50_ms", histogram.Percentile(0.5) * 0.001));
+        stage.push_back(Pair("p90_ms", histogram.Percentile(0.9) * 0.001));
+        stage.push_back(Pair("p99_ms", histogram.Percentile(0.99) * 0.001));
+        stage.push_back(Pair("max_ms", histogram.nMaxMicros * 0.001));
+        UniValue buckets(UniValue::VOBJ);
+        for (int j = 0; j < CStageHistogram::BUCKETS; j++) {
+            if (histogram.vBuckets[j] > 0)
+                buckets.push_back(Pair(strprintf("%.3f", CStageHistogram::BucketLimit(j) * 0.001), (int64_t)histogram.vBuckets[j]));
+        }
+        stage.push_back(Pair("histogram", buckets));
+        stages.push_back(Pair(GetBlockStageName(i), stage));
+    }
+    ret.push_back(Pair("stages", stages));
+
+    const size_t nSlowest = std::min(vRecords.size(), (size_t)nCount);
+    std::partial_sort(vRecords.begin(), vRecords.begin() + nSlowest, vRecords.end(), CompareBlockTimingSlowest);
+    UniValue slowest(UniValue::VARR);
+    for (size_t i = 0; i < nSlowest; i++)
+        slowest.push_back(BlockTimingToJSON(vRecords[i]));
+    ret.push_back(Pair("slowest", slowest));
+
+    return ret;
+}
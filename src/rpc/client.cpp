@@ -29,6 +29,9 @@ static const CRPCConvertParam vRPCConvertParams[] =
     {
         {"stop", 0},
         {"setmocktime", 0},
+        {"getlockstats", 0},
+        {"getlockstats", 1},
+        {"setlockprofiling", 0},
         {"getaddednodeinfo", 0},
         {"setgenerate", 0},
         {"setgenerate", 1},
@@ -160,10 +163,16 @@ static const CRPCConvertParam vRPCConvertParams[] =
         {"getblockindexstats", 0},
         {"getblockindexstats", 1},
         {"getblockindexstats", 2},
+        {"getblockprocessingstats", 0},
         {"getserials", 0},
         {"getserials", 1},
         {"getserials", 2},
         {"getfeeinfo", 0},
+        {"getaddressdeltas", 1},
+        {"getaddressdeltas", 2},
+        {"getspentinfo", 1},
+        {"getblockhashes", 0},
+        {"getblockhashes", 1},
     };
 
 class CRPCConvertTable
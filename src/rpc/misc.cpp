@@ -15,6 +15,7 @@
 #include "rpc/server.h"
 #include "spork.h"
 #include "timedata.h"
+#include "txdb.h"
 #include "util.h"
 #ifdef ENABLE_WALLET
 #include "wallet/wallet.h"
@@ -403,6 +404,162 @@ UniValue validateaddress(const UniValue& params, bool fHelp)
     return ret;
 }
 
+static void ParseIndexedAddress(const UniValue& param, int& nTypeRet, uint160& hashRet)
+{
+    if (!fAddressIndex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Address index not enabled, restart with -addressindex and -reindex");
+
+    CBitcoinAddress address(param.get_str());
+    if (!address.IsValid())
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid YODA address");
+
+    // Keyed the same way the index is written
+    if (!GetAddressIndexHash(GetScriptForDestination(address.Get()), nTypeRet, hashRet))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid YODA address");
+}
+
+UniValue getaddressbalance(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw std::runtime_error(
+            "getaddressbalance \"yodaaddress\"\n"
+            "\nReturns the balance of an address. Requires -addressindex.\n"
+
+            "\nArguments:\n"
+            "1. \"yodaaddress\"  (string, required) The yoda address\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"balance\": xxxxx,   (numeric) The current balance in yoda\n"
+            "  \"received\": xxxxx   (numeric) The total amount received by the address in yoda\n"
+            "}\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("getaddressbalance", "\"DMJRSsuU9zfyrvxVaAEFQqK4MxZg6vgeS6\"") + HelpExampleRpc("getaddressbalance", "\"DMJRSsuU9zfyrvxVaAEFQqK4MxZg6vgeS6\""));
+
+    int nType;
+    uint160 hashAddress;
+    ParseIndexedAddress(params[0], nType, hashAddress);
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vAddressIndex;
+    if (!pblocktree->ReadAddressIndex(hashAddress, nType, vAddressIndex))
+        throw JSONRPCError(RPC_DATABASE_ERROR, "No information available for address");
+
+    CAmount nBalance = 0;
+    CAmount nReceived = 0;
+    for (const std::pair<CAddressIndexKey, CAmount>& entry : vAddressIndex) {
+        if (entry.second > 0)
+            nReceived += entry.second;
+        nBalance += entry.second;
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("balance", ValueFromAmount(nBalance)));
+    result.push_back(Pair("received", ValueFromAmount(nReceived)));
+    return result;
+}
+
+UniValue getaddressdeltas(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() < 1 || params.size() > 3)
+        throw std::runtime_error(
+            "getaddressdeltas \"yodaaddress\" ( start end )\n"
+            "\nReturns all balance changes of an address, in chain order. Requires -addressindex.\n"
+
+            "\nArguments:\n"
+            "1. \"yodaaddress\"  (string, required) The yoda address\n"
+            "2. start          (numeric, optional) The first block height to include\n"
+            "3. end            (numeric, optional) The last block height to include\n"
+
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"satoshis\": n,     (numeric) The difference of satoshis\n"
+            "    \"txid\": \"hash\",    (string) The related txid\n"
+            "    \"index\": n,        (numeric) The related input or output index\n"
+            "    \"blockindex\": n,   (numeric) The position of the transaction in the block\n"
+            "    \"height\": n,       (numeric) The block height\n"
+            "    \"spending\": true|false  (boolean) If the delta comes from an input\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("getaddressdeltas", "\"DMJRSsuU9zfyrvxVaAEFQqK4MxZg6vgeS6\" 1000 2000") + HelpExampleRpc("getaddressdeltas", "\"DMJRSsuU9zfyrvxVaAEFQqK4MxZg6vgeS6\", 1000, 2000"));
+
+    int nType;
+    uint160 hashAddress;
+    ParseIndexedAddress(params[0], nType, hashAddress);
+
+    int nStart = params.size() > 1 ? params[1].get_int() : 0;
+    int nEnd = params.size() > 2 ? params[2].get_int() : 0;
+    if (nStart < 0 || nEnd < 0 || (nEnd > 0 && nEnd < nStart))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid height range");
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vAddressIndex;
+    if (!pblocktree->ReadAddressIndex(hashAddress, nType, vAddressIndex, nStart, nEnd))
+        throw JSONRPCError(RPC_DATABASE_ERROR, "No information available for address");
+
+    UniValue result(UniValue::VARR);
+    for (const std::pair<CAddressIndexKey, CAmount>& entry : vAddressIndex) {
+        UniValue delta(UniValue::VOBJ);
+        delta.push_back(Pair("satoshis", entry.second));
+        delta.push_back(Pair("txid", entry.first.txhash.GetHex()));
+        delta.push_back(Pair("index", (int)entry.first.index));
+        delta.push_back(Pair("blockindex", (int)entry.first.txindex));
+        delta.push_back(Pair("height", entry.first.blockHeight));
+        delta.push_back(Pair("spending", entry.first.spending));
+        result.push_back(delta);
+    }
+    return result;
+}
+
+UniValue getaddressutxos(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw std::runtime_error(
+            "getaddressutxos \"yodaaddress\"\n"
+            "\nReturns all unspent outputs of an address. Requires -addressindex.\n"
+
+            "\nArguments:\n"
+            "1. \"yodaaddress\"  (string, required) The yoda address\n"
+
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"txid\": \"hash\",      (string) The output txid\n"
+            "    \"outputIndex\": n,    (numeric) The output index\n"
+            "    \"script\": \"hex\",     (string) The script hex encoded\n"
+            "    \"satoshis\": n,       (numeric) The number of satoshis of the output\n"
+            "    \"height\": n          (numeric) The block height\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("getaddressutxos", "\"DMJRSsuU9zfyrvxVaAEFQqK4MxZg6vgeS6\"") + HelpExampleRpc("getaddressutxos", "\"DMJRSsuU9zfyrvxVaAEFQqK4MxZg6vgeS6\""));
+
+    int nType;
+    uint160 hashAddress;
+    ParseIndexedAddress(params[0], nType, hashAddress);
+
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vUnspent;
+    if (!pblocktree->ReadAddressUnspentIndex(hashAddress, nType, vUnspent))
+        throw JSONRPCError(RPC_DATABASE_ERROR, "No information available for address");
+
+    UniValue result(UniValue::VARR);
+    for (const std::pair<CAddressUnspentKey, CAddressUnspentValue>& entry : vUnspent) {
+        UniValue output(UniValue::VOBJ);
+        output.push_back(Pair("txid", entry.first.txhash.GetHex()));
+        output.push_back(Pair("outputIndex", (int)entry.first.index));
+        output.push_back(Pair("script", HexStr(entry.second.script.begin(), entry.second.script.end())));
+        output.push_back(Pair("satoshis", entry.second.satoshis));
+        output.push_back(Pair("height", entry.second.blockHeight));
+        result.push_back(output);
+    }
+    return result;
+}
+
 /**
  * Used by addmultisigaddress / createmultisig:
  */
@@ -581,6 +738,98 @@ UniValue setmocktime(const UniValue& params, bool fHelp)
     return NullUniValue;
 }
 
+static bool CompareLockSiteWait(const CLockSiteStats& a, const CLockSiteStats& b)
+{
+    if (a.nWaitMicros != b.nWaitMicros)
+        return a.nWaitMicros > b.nWaitMicros;
+    return a.nHoldMicros > b.nHoldMicros;
+}
+
+UniValue getlockstats(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 2)
+        throw std::runtime_error(
+            "getlockstats ( count reset )\n"
+            "\nReturns the lock sites that made threads wait the longest, while lock profiling\n"
+            "is on (-profilelocks or setlockprofiling).\n"
+
+            "\nArguments:\n"
+            "1. count     (numeric, optional, default=20) number of lock sites to return, 0 for all\n"
+            "2. reset     (boolean, optional, default=false) clear the statistics after reading them\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"enabled\": true|false,   (boolean) whether locks are being profiled\n"
+            "  \"sites\": [             (array) lock sites, most waited on first\n"
+            "    {\n"
+            "      \"lock\": \"name\",     (string) the locked expression, e.g. cs_main\n"
+            "      \"file\": \"file\",     (string) source file of the LOCK\n"
+            "      \"line\": n,          (numeric) source line of the LOCK\n"
+            "      \"locks\": n,         (numeric) times the lock was taken here\n"
+            "      \"contended\": n,     (numeric) times it had to wait, or a TRY_LOCK failed\n"
+            "      \"wait_ms\": x.xxx,   (numeric) total time spent waiting\n"
+            "      \"max_wait_ms\": x.xxx, (numeric) longest wait\n"
+            "      \"hold_ms\": x.xxx,   (numeric) total time the lock was held from here\n"
+            "      \"max_hold_ms\": x.xxx (numeric) longest hold\n"
+            "    }, ...\n"
+            "  ]\n"
+            "}\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("getlockstats", "") + HelpExampleCli("getlockstats", "0 true") + HelpExampleRpc("getlockstats", "10"));
+
+    int nCount = 20;
+    if (params.size() > 0)
+        nCount = params[0].get_int();
+    if (nCount < 0)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative count");
+    bool fReset = params.size() > 1 && params[1].get_bool();
+
+    std::vector<CLockSiteStats> vStats = GetLockStats();
+    if (fReset)
+        ResetLockStats();
+    std::sort(vStats.begin(), vStats.end(), CompareLockSiteWait);
+    if (nCount > 0 && vStats.size() > (size_t)nCount)
+        vStats.resize(nCount);
+
+    UniValue sites(UniValue::VARR);
+    for (const CLockSiteStats& stats : vStats) {
+        UniValue site(UniValue::VOBJ);
+        site.push_back(Pair("lock", stats.strName));
+        site.push_back(Pair("file", stats.strFile));
+        site.push_back(Pair("line", stats.nLine));
+        site.push_back(Pair("locks", (int64_t)stats.nLocks));
+        site.push_back(Pair("contended", (int64_t)stats.nContended));
+        site.push_back(Pair("wait_ms", stats.nWaitMicros * 0.001));
+        site.push_back(Pair("max_wait_ms", stats.nMaxWaitMicros * 0.001));
+        site.push_back(Pair("hold_ms", stats.nHoldMicros * 0.001));
+        site.push_back(Pair("max_hold_ms", stats.nMaxHoldMicros * 0.001));
+        sites.push_back(site);
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("enabled", g_profile_locks.load()));
+    ret.push_back(Pair("sites", sites));
+    return ret;
+}
+
+UniValue setlockprofiling(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw std::runtime_error(
+            "setlockprofiling enable\n"
+            "\nTurn lock profiling on or off. The statistics gathered so far are kept.\n"
+
+            "\nArguments:\n"
+            "1. enable    (boolean, required) true to profile locks, false to stop\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("setlockprofiling", "true") + HelpExampleRpc("setlockprofiling", "false"));
+
+    g_profile_locks = params[0].get_bool();
+    return NullUniValue;
+}
+
 #ifdef ENABLE_WALLET
 UniValue getstakingstatus(const UniValue& params, bool fHelp)
 {
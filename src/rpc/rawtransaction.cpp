@@ -19,6 +19,7 @@
 #include "script/sign.h"
 #include "script/standard.h"
 #include "swifttx.h"
+#include "txdb.h"
 #include "uint256.h"
 #include "utilmoneystr.h"
 #include "zpivchain.h"
@@ -203,6 +204,48 @@ UniValue getrawtransaction(const UniValue& params, bool fHelp)
     return result;
 }
 
+UniValue getspentinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 2)
+        throw std::runtime_error(
+            "getspentinfo \"txid\" n\n"
+            "\nReturns the transaction input spending an output. Requires -spentindex.\n"
+
+            "\nArguments:\n"
+            "1. \"txid\"   (string, required) The hex string of the txid\n"
+            "2. n        (numeric, required) The output index\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"txid\": \"hash\",   (string) The id of the spending transaction\n"
+            "  \"index\": n,       (numeric) The spending input index\n"
+            "  \"height\": n,      (numeric) The height of the block containing the spend\n"
+            "  \"satoshis\": n     (numeric) The value of the spent output\n"
+            "}\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("getspentinfo", "\"mytxid\" 0") + HelpExampleRpc("getspentinfo", "\"mytxid\", 0"));
+
+    if (!fSpentIndex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Spent index not enabled, restart with -spentindex and -reindex");
+
+    uint256 txid = ParseHashV(params[0], "txid");
+    int nOutput = params[1].get_int();
+    if (nOutput < 0)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid output index");
+
+    CSpentIndexValue value;
+    if (!pblocktree->ReadSpentIndex(CSpentIndexKey(txid, nOutput), value))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unable to get spent info");
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("txid", value.txid.GetHex()));
+    result.push_back(Pair("index", (int)value.inputIndex));
+    result.push_back(Pair("height", value.blockHeight));
+    result.push_back(Pair("satoshis", value.satoshis));
+    return result;
+}
+
 #ifdef ENABLE_WALLET
 UniValue listunspent(const UniValue& params, bool fHelp)
 {
@@ -851,7 +894,7 @@ UniValue sendrawtransaction(const UniValue& params, bool fHelp)
     if (!fHaveMempool && !fHaveChain) {
         // push to local node and sync with wallets
         if (fSwiftX) {
-            mapTxLockReq.insert(std::make_pair(tx.GetHash(), tx));
+            txLockManager.AddLockRequest(tx);
             CreateNewLock(tx);
             RelayTransactionLockReq(tx, true);
         }
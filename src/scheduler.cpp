@@ -5,15 +5,21 @@
 
 #include "scheduler.h"
 
+#include "crypto/common.h"
 #include "random.h"
 #include "reverselock.h"
 
+#include <algorithm>
 #include <assert.h>
 #include <boost/bind.hpp>
 #include <utility>
+#include <vector>
 
-CScheduler::CScheduler() : nThreadsServicingQueue(0), stopRequested(false), stopWhenEmpty(false)
+CScheduler::CScheduler() : nCurrentTick(0), nNextTaskId(1), nNextGroupId(1), nTasksRunning(0), nThreadsServicingQueue(0), stopRequested(false), stopWhenEmpty(false)
 {
+    for (int i = 0; i < LEVELS; i++)
+        vOccupied[i] = 0;
+    nCurrentTick = TickAtOrBefore(boost::chrono::system_clock::now());
 }
 
 CScheduler::~CScheduler()
@@ -29,57 +35,291 @@ static boost::system_time toPosixTime(const boost::chrono::system_clock::time_po
 }
 #endif
 
+int64_t CScheduler::TickAtOrBefore(boost::chrono::system_clock::time_point t)
+{
+    // Times before the epoch are long due; they all go in tick 0
+    int64_t nMicros = boost::chrono::duration_cast<boost::chrono::microseconds>(t.time_since_epoch()).count();
+    return nMicros > 0 ? nMicros / TICK_MICROS : 0;
+}
+
+int64_t CScheduler::TickAtOrAfter(boost::chrono::system_clock::time_point t)
+{
+    int64_t nMicros = boost::chrono::duration_cast<boost::chrono::microseconds>(t.time_since_epoch()).count();
+    return nMicros > 0 ? (nMicros + TICK_MICROS - 1) / TICK_MICROS : 0;
+}
+
+boost::chrono::system_clock::time_point CScheduler::TickTime(int64_t nTick)
+{
+    return boost::chrono::system_clock::time_point(boost::chrono::microseconds(nTick * TICK_MICROS));
+}
+
+void CScheduler::Insert(TaskId id, Task& task)
+{
+    if (task.nTick < nCurrentTick) {
+        task.nLevel = -1;
+        dequeReady.push_back(id);
+        return;
+    }
+
+    // The lowest wheel whose current turn holds the due tick
+    int nLevel = 0;
+    while (nLevel < LEVELS && (task.nTick >> (SLOT_BITS * (nLevel + 1))) != (nCurrentTick >> (SLOT_BITS * (nLevel + 1))))
+        nLevel++;
+
+    task.nLevel = nLevel;
+    if (nLevel == LEVELS) {
+        task.itSlot = lOverflow.insert(lOverflow.end(), id);
+        return;
+    }
+    task.nSlot = (task.nTick >> (SLOT_BITS * nLevel)) & (SLOTS - 1);
+    std::list<TaskId>& slot = vSlots[nLevel][task.nSlot];
+    task.itSlot = slot.insert(slot.end(), id);
+    vOccupied[nLevel] |= (uint64_t)1 << task.nSlot;
+}
+
+void CScheduler::Unlink(Task& task)
+{
+    if (task.nLevel < 0)
+        return;
+    if (task.nLevel == LEVELS) {
+        lOverflow.erase(task.itSlot);
+    } else {
+        std::list<TaskId>& slot = vSlots[task.nLevel][task.nSlot];
+        slot.erase(task.itSlot);
+        if (slot.empty())
+            vOccupied[task.nLevel] &= ~((uint64_t)1 << task.nSlot);
+    }
+    task.nLevel = -1;
+}
+
+bool CScheduler::NextEventTick(int64_t& nTick, int& nLevel) const
+{
+    // Slots of a level come after those of the levels below it, so the
+    // lowest level with an occupied slot ahead has the next event
+    for (int i = 0; i < LEVELS; i++) {
+        int nShift = SLOT_BITS * i;
+        int nCurrentSlot = (nCurrentTick >> nShift) & (SLOTS - 1);
+        uint64_t nAhead = vOccupied[i] & (~(uint64_t)0 << nCurrentSlot);
+        if (nAhead == 0)
+            continue;
+        int nSlot = CountBits(nAhead & (~nAhead + 1)) - 1;
+        nTick = std::max(nCurrentTick, ((nCurrentTick >> (nShift + SLOT_BITS)) << (nShift + SLOT_BITS)) + ((int64_t)nSlot << nShift));
+        nLevel = i;
+        return true;
+    }
+    if (!lOverflow.empty()) {
+        int nShift = SLOT_BITS * LEVELS;
+        nTick = ((nCurrentTick >> nShift) + 1) << nShift;
+        nLevel = LEVELS;
+        return true;
+    }
+    return false;
+}
+
+void CScheduler::Rebase(int64_t nNowTick)
+{
+    std::vector<TaskId> vPending(lOverflow.begin(), lOverflow.end());
+    lOverflow.clear();
+    for (int i = 0; i < LEVELS; i++) {
+        for (int j = 0; j < SLOTS; j++) {
+            vPending.insert(vPending.end(), vSlots[i][j].begin(), vSlots[i][j].end());
+            vSlots[i][j].clear();
+        }
+        vOccupied[i] = 0;
+    }
+
+    nCurrentTick = nNowTick;
+    boost::chrono::system_clock::time_point now = TickTime(nNowTick);
+    for (size_t i = 0; i < vPending.size(); i++) {
+        Task& task = mapTasks.find(vPending[i])->second;
+        task.nLevel = -1;
+        // A periodic task runs a period from now rather than waiting out the step
+        if (task.period != boost::chrono::microseconds::zero() && task.tDue > now + task.period) {
+            task.tDue = now + task.period;
+            task.nTick = TickAtOrAfter(task.tDue);
+        }
+        Insert(vPending[i], task);
+    }
+}
+
+void CScheduler::Advance(int64_t nNowTick)
+{
+    // Ticks up to nCurrentTick - 1 are taken out, so an earlier time means the clock stepped back
+    if (nNowTick + 1 < nCurrentTick)
+        Rebase(nNowTick);
+
+    int64_t nTick;
+    int nLevel;
+    while (NextEventTick(nTick, nLevel) && nTick <= nNowTick) {
+        nCurrentTick = nTick;
+        std::list<TaskId> lExpired;
+        if (nLevel == LEVELS) {
+            lExpired.swap(lOverflow);
+        } else {
+            int nSlot = (nTick >> (SLOT_BITS * nLevel)) & (SLOTS - 1);
+            lExpired.swap(vSlots[nLevel][nSlot]);
+            vOccupied[nLevel] &= ~((uint64_t)1 << nSlot);
+        }
+
+        if (nLevel > 0) {
+            // Spread the slot over the wheels below
+            for (std::list<TaskId>::const_iterator it = lExpired.begin(); it != lExpired.end(); ++it) {
+                Task& task = mapTasks.find(*it)->second;
+                task.nLevel = -1;
+                Insert(*it, task);
+            }
+            continue;
+        }
+
+        // Due; within a tick, in the order of the times asked for
+        std::vector<std::pair<boost::chrono::system_clock::time_point, TaskId> > vDue;
+        vDue.reserve(lExpired.size());
+        for (std::list<TaskId>::const_iterator it = lExpired.begin(); it != lExpired.end(); ++it) {
+            Task& task = mapTasks.find(*it)->second;
+            task.nLevel = -1;
+            vDue.push_back(std::make_pair(task.tDue, *it));
+        }
+        std::sort(vDue.begin(), vDue.end());
+        for (size_t i = 0; i < vDue.size(); i++)
+            dequeReady.push_back(vDue[i].second);
+        nCurrentTick = nTick + 1;
+    }
+    // Every slot up to now is empty, so the wheels can skip ahead
+    nCurrentTick = std::max(nCurrentTick, nNowTick + 1);
+}
+
+CScheduler::TaskId CScheduler::Finished(TaskId id, GroupId group)
+{
+    --nTasksRunning;
+    TaskMap::iterator it = mapTasks.find(id);
+    if (it != mapTasks.end()) {
+        // Still there, so periodic and not cancelled. The next run is due a
+        // whole number of periods after this one, skipping the ones already missed.
+        Task& task = it->second;
+        boost::chrono::system_clock::time_point now = boost::chrono::system_clock::now();
+        task.fRunning = false;
+        task.tDue += task.period;
+        if (task.tDue <= now)
+            task.tDue += task.period * ((now - task.tDue) / task.period + 1);
+        else if (task.tDue > now + task.period)
+            task.tDue = now + task.period; // the clock stepped back
+        task.nTick = TickAtOrAfter(task.tDue);
+        Insert(id, task);
+        // This thread may go on with its group, and the others may be waiting without a timeout
+        newTaskScheduled.notify_one();
+    }
+
+    if (group == 0)
+        return 0;
+    boost::unordered_map<GroupId, std::deque<TaskId> >::iterator itGroup = mapGroupsRunning.find(group);
+    while (!itGroup->second.empty()) {
+        TaskId idNext = itGroup->second.front();
+        itGroup->second.pop_front();
+        if (mapTasks.count(idNext))
+            return idNext;
+    }
+    mapGroupsRunning.erase(itGroup);
+    return 0;
+}
+
 void CScheduler::serviceQueue()
 {
     boost::unique_lock<boost::mutex> lock(newTaskMutex);
     ++nThreadsServicingQueue;
+    // A task of the group this thread just ran, which it runs next
+    TaskId idGroupNext = 0;
 
     // newTaskMutex is locked throughout this loop EXCEPT
     // when the thread is waiting or when the user's function
     // is called.
     while (!shouldStop()) {
         try {
-            if (!shouldStop() && taskQueue.empty()) {
+            if (mapTasks.empty() && nTasksRunning == 0) {
                 reverse_lock<boost::unique_lock<boost::mutex> > rlock(lock);
                 // Use this chance to get a tiny bit more entropy
                 RandAddSeedSleep();
             }
-            while (!shouldStop() && taskQueue.empty()) {
-                // Wait until there is something to do.
-                newTaskScheduled.wait(lock);
-            }
+            if (shouldStop())
+                continue;
 
-            // Wait until either there is a new task, or until
-            // the time of the first item on the queue:
+            TaskMap::iterator it = mapTasks.end();
+            if (idGroupNext != 0) {
+                it = mapTasks.find(idGroupNext);
+                idGroupNext = 0;
+            } else {
+                Advance(TickAtOrBefore(boost::chrono::system_clock::now()));
+                while (it == mapTasks.end() && !dequeReady.empty()) {
+                    TaskId id = dequeReady.front();
+                    dequeReady.pop_front();
+                    TaskMap::iterator itTask = mapTasks.find(id);
+                    if (itTask == mapTasks.end())
+                        continue; // cancelled
+                    GroupId group = itTask->second.group;
+                    if (group != 0) {
+                        boost::unordered_map<GroupId, std::deque<TaskId> >::iterator itGroup = mapGroupsRunning.find(group);
+                        if (itGroup != mapGroupsRunning.end()) {
+                            // Whoever runs the group now runs this after
+                            itGroup->second.push_back(id);
+                            continue;
+                        }
+                        mapGroupsRunning[group];
+                    }
+                    it = itTask;
+                }
+            }
 
+            if (it == mapTasks.end()) {
+                // Wait until either there is a new task, or until
+                // the next slot of the wheel is due:
+                int64_t nTick;
+                int nLevel;
+                if (!NextEventTick(nTick, nLevel)) {
+                    newTaskScheduled.wait(lock);
+                    continue;
+                }
 // wait_until needs boost 1.50 or later; older versions have timed_wait:
 #if BOOST_VERSION < 105000
-            while (!shouldStop() && !taskQueue.empty() &&
-                   newTaskScheduled.timed_wait(lock, toPosixTime(taskQueue.begin()->first))) {
-                // Keep waiting until timeout
-            }
+                newTaskScheduled.timed_wait(lock, toPosixTime(TickTime(nTick)));
 #else
-            // Some boost versions have a conflicting overload of wait_until that returns void.
-            // Explicitly use a template here to avoid hitting that overload.
-            while (!shouldStop() && !taskQueue.empty() &&
-                   newTaskScheduled.wait_until<>(lock, taskQueue.begin()->first) != boost::cv_status::timeout) {
-                // Keep waiting until timeout
-            }
+                // Some boost versions have a conflicting overload of wait_until that returns void.
+                // Explicitly use a template here to avoid hitting that overload.
+                newTaskScheduled.wait_until<>(lock, TickTime(nTick));
 #endif
-            // If there are multiple threads, the queue can empty while we're waiting (another
-            // thread may service the task we were waiting on).
-            if (shouldStop() || taskQueue.empty())
                 continue;
+            }
 
-            Function f = taskQueue.begin()->second;
-            taskQueue.erase(taskQueue.begin());
+            TaskId id = it->first;
+            Function f = it->second.f;
+            GroupId group = it->second.group;
+            if (it->second.period == boost::chrono::microseconds::zero())
+                mapTasks.erase(it);
+            else
+                it->second.fRunning = true;
+            ++nTasksRunning;
+            // Let another thread take the next due task
+            if (!dequeReady.empty())
+                newTaskScheduled.notify_one();
 
-            {
+            try {
                 // Unlock before calling f, so it can reschedule itself or another task
                 // without deadlocking:
                 reverse_lock<boost::unique_lock<boost::mutex> > rlock(lock);
                 f();
+            } catch (...) {
+                TaskId idNext = Finished(id, group);
+                if (idNext != 0) {
+                    // Nobody runs the group now; its waiting tasks go back to the front of the queue
+                    std::deque<TaskId>& dequeGroup = mapGroupsRunning[group];
+                    dequeGroup.push_front(idNext);
+                    dequeReady.insert(dequeReady.begin(), dequeGroup.begin(), dequeGroup.end());
+                    mapGroupsRunning.erase(group);
+                }
+                newTaskScheduled.notify_all();
+                throw;
             }
+            idGroupNext = Finished(id, group);
+            if (shouldStop())
+                newTaskScheduled.notify_all();
         } catch (...) {
             --nThreadsServicingQueue;
             throw;
@@ -101,39 +341,102 @@ void CScheduler::stop(bool drain)
     newTaskScheduled.notify_all();
 }
 
-void CScheduler::schedule(CScheduler::Function f, boost::chrono::system_clock::time_point t)
+CScheduler::TaskId CScheduler::AddTask(CScheduler::Function f, boost::chrono::system_clock::time_point t, boost::chrono::microseconds period, CScheduler::GroupId group)
 {
+    TaskId id = nNextTaskId++;
+    Task& task = mapTasks[id];
+    task.f = f;
+    task.tDue = t;
+    task.nTick = TickAtOrAfter(t);
+    task.period = period;
+    task.group = group;
+    task.nLevel = -1;
+    task.nSlot = 0;
+    task.fRunning = false;
+    boost::chrono::system_clock::time_point now = boost::chrono::system_clock::now();
+    if (TickAtOrBefore(now) + 1 < nCurrentTick)
+        Rebase(TickAtOrBefore(now));
+    if (group == 0 && t <= now) {
+        // Already due, so no need to wait for the tick. Grouped tasks go through
+        // the wheel, behind any of their group that are due but not yet taken out.
+        dequeReady.push_back(id);
+        return id;
+    }
+    Insert(id, task);
+    return id;
+}
+
+CScheduler::TaskId CScheduler::schedule(CScheduler::Function f, boost::chrono::system_clock::time_point t, CScheduler::GroupId group)
+{
+    TaskId id;
     {
         boost::unique_lock<boost::mutex> lock(newTaskMutex);
-        taskQueue.insert(std::make_pair(t, f));
+        id = AddTask(f, t, boost::chrono::microseconds::zero(), group);
     }
     newTaskScheduled.notify_one();
+    return id;
+}
+
+CScheduler::TaskId CScheduler::scheduleFromNow(CScheduler::Function f, int64_t deltaSeconds, CScheduler::GroupId group)
+{
+    return schedule(f, boost::chrono::system_clock::now() + boost::chrono::seconds(deltaSeconds), group);
+}
+
+CScheduler::TaskId CScheduler::scheduleEvery(CScheduler::Function f, int64_t deltaSeconds, CScheduler::GroupId group)
+{
+    return scheduleEvery(f, boost::chrono::microseconds(boost::chrono::seconds(deltaSeconds)), group);
 }
 
-void CScheduler::scheduleFromNow(CScheduler::Function f, int64_t deltaSeconds)
+CScheduler::TaskId CScheduler::scheduleEvery(CScheduler::Function f, boost::chrono::microseconds period, CScheduler::GroupId group)
 {
-    schedule(f, boost::chrono::system_clock::now() + boost::chrono::seconds(deltaSeconds));
+    // A period of zero would mark the task as running once
+    period = std::max(period, boost::chrono::microseconds(1));
+    TaskId id;
+    {
+        boost::unique_lock<boost::mutex> lock(newTaskMutex);
+        id = AddTask(f, boost::chrono::system_clock::now() + period, period, group);
+    }
+    newTaskScheduled.notify_one();
+    return id;
 }
 
-static void Repeat(CScheduler* s, CScheduler::Function f, int64_t deltaSeconds)
+bool CScheduler::cancel(CScheduler::TaskId id)
 {
-    f();
-    s->scheduleFromNow(boost::bind(&Repeat, s, f, deltaSeconds), deltaSeconds);
+    {
+        boost::unique_lock<boost::mutex> lock(newTaskMutex);
+        TaskMap::iterator it = mapTasks.find(id);
+        if (it == mapTasks.end())
+            return false;
+        // Ready tasks stay in dequeReady or their group's queue, and are skipped there
+        Unlink(it->second);
+        mapTasks.erase(it);
+        if (!mapTasks.empty())
+            return true;
+    }
+    // Threads draining the queue may be done now
+    newTaskScheduled.notify_all();
+    return true;
 }
 
-void CScheduler::scheduleEvery(CScheduler::Function f, int64_t deltaSeconds)
+CScheduler::GroupId CScheduler::newSerialGroup()
 {
-    scheduleFromNow(boost::bind(&Repeat, this, f, deltaSeconds), deltaSeconds);
+    boost::unique_lock<boost::mutex> lock(newTaskMutex);
+    return nNextGroupId++;
 }
 
 size_t CScheduler::getQueueInfo(boost::chrono::system_clock::time_point &first,
                              boost::chrono::system_clock::time_point &last) const
 {
     boost::unique_lock<boost::mutex> lock(newTaskMutex);
-    size_t result = taskQueue.size();
-    if (!taskQueue.empty()) {
-        first = taskQueue.begin()->first;
-        last = taskQueue.rbegin()->first;
+    size_t result = 0;
+    for (TaskMap::const_iterator it = mapTasks.begin(); it != mapTasks.end(); ++it) {
+        if (it->second.fRunning)
+            continue;
+        if (result == 0 || it->second.tDue < first)
+            first = it->second.tDue;
+        if (result == 0 || it->second.tDue > last)
+            last = it->second.tDue;
+        result++;
     }
     return result;
 }
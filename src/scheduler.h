@@ -14,7 +14,13 @@
 #include <boost/function.hpp>
 #include <boost/chrono/chrono.hpp>
 #include <boost/thread.hpp>
-#include <map>
+#include <boost/unordered_map.hpp>
+#include <deque>
+#include <list>
+#include <stdint.h>
+
+static const int DEFAULT_SCHEDULER_THREADS = 2;
+static const int MAX_SCHEDULER_THREADS = 16;
 
 //
 // Simple class for background tasks that should be run
@@ -33,6 +39,21 @@
 // delete t;
 // delete s; // Must be done after thread is interrupted/joined.
 //
+// Any number of threads may run serviceQueue; they form the worker pool
+// and run due tasks concurrently. Tasks that must not overlap can share
+// a serial group (see newSerialGroup).
+//
+// Pending tasks are kept in a hierarchical timer wheel: LEVELS wheels of
+// SLOTS slots each, one tick (a millisecond) per slot at the lowest level
+// and SLOTS times coarser at each level above. A task goes into the lowest
+// wheel whose current turn contains its due tick, so scheduling and
+// cancelling are a constant amount of work however many tasks are pending.
+// When a wheel turns over, the next slot of the wheel above is spread out
+// over the lower ones. Tasks past the top wheel's turn wait in an overflow
+// list that is looked at once per turn of the top wheel. If the system
+// clock steps back, the wheel is rebuilt around the new time, so tasks
+// scheduled from now do not run early.
+//
 
 class CScheduler
 {
@@ -41,21 +62,34 @@ public:
     ~CScheduler();
 
     typedef boost::function<void(void)> Function;
+    //! Handle of a scheduled task, never 0
+    typedef uint64_t TaskId;
+    //! Tasks in the same serial group run one at a time, in due order; 0 is no group
+    typedef uint64_t GroupId;
 
     // Call func at/after time t
-    void schedule(Function f, boost::chrono::system_clock::time_point t);
+    TaskId schedule(Function f, boost::chrono::system_clock::time_point t, GroupId group = 0);
 
     // Convenience method: call f once deltaSeconds from now
-    void scheduleFromNow(Function f, int64_t deltaSeconds);
+    TaskId scheduleFromNow(Function f, int64_t deltaSeconds, GroupId group = 0);
 
-    // Another convenience method: call f approximately
-    // every deltaSeconds forever, starting deltaSeconds from now.
-    // To be more precise: every time f is finished, it
-    // is rescheduled to run deltaSeconds later. If you
-    // need more accurate scheduling, don't use this method.
-    void scheduleEvery(Function f, int64_t deltaSeconds);
+    // Another convenience method: call f every deltaSeconds forever,
+    // starting deltaSeconds from now. Runs are due at fixed multiples
+    // of deltaSeconds from the first, so they do not drift by the time
+    // f takes; runs missed because f or the queue fell behind are
+    // skipped rather than run back to back. A run never overlaps the
+    // previous one. The handle stays valid for every run.
+    TaskId scheduleEvery(Function f, int64_t deltaSeconds, GroupId group = 0);
+    // The same, with a period finer than a second
+    TaskId scheduleEvery(Function f, boost::chrono::microseconds period, GroupId group = 0);
 
-    // To keep things as simple as possible, there is no unschedule.
+    // Remove a task before it runs; a periodic task is not run again.
+    // A run that already started is not interrupted. Returns false if
+    // the task is unknown, already ran, or was cancelled before.
+    bool cancel(TaskId id);
+
+    // A new serial group to schedule tasks in
+    GroupId newSerialGroup();
 
     // Services the queue 'forever'. Should be run in a thread,
     // and interrupted using boost::interrupt_thread
@@ -72,13 +106,66 @@ public:
                         boost::chrono::system_clock::time_point &last) const;
 
 private:
-    std::multimap<boost::chrono::system_clock::time_point, Function> taskQueue;
+    static const int LEVELS = 4;
+    static const int SLOT_BITS = 6;
+    static const int SLOTS = 1 << SLOT_BITS;
+    //! Microseconds per tick
+    static const int64_t TICK_MICROS = 1000;
+
+    struct Task {
+        Function f;
+        boost::chrono::system_clock::time_point tDue;
+        int64_t nTick;
+        //! Zero for tasks that run once
+        boost::chrono::microseconds period;
+        GroupId group;
+        //! Wheel level, LEVELS for the overflow list, -1 once out of the wheel
+        int nLevel;
+        int nSlot;
+        std::list<TaskId>::iterator itSlot;
+        bool fRunning;
+    };
+
+    typedef boost::unordered_map<TaskId, Task> TaskMap;
+
+    TaskMap mapTasks;
+    std::list<TaskId> vSlots[LEVELS][SLOTS];
+    //! Bit i set when vSlots[level][i] is not empty
+    uint64_t vOccupied[LEVELS];
+    std::list<TaskId> lOverflow;
+    //! Ticks before this one have been taken out of the wheel
+    int64_t nCurrentTick;
+    //! Due tasks, in due order; may hold ids of cancelled tasks
+    std::deque<TaskId> dequeReady;
+    //! Groups with a running task, and their tasks that became due meanwhile
+    boost::unordered_map<GroupId, std::deque<TaskId> > mapGroupsRunning;
+    TaskId nNextTaskId;
+    GroupId nNextGroupId;
+    int nTasksRunning;
+
     boost::condition_variable newTaskScheduled;
     mutable boost::mutex newTaskMutex;
     int nThreadsServicingQueue;
     bool stopRequested;
     bool stopWhenEmpty;
-    bool shouldStop() { return stopRequested || (stopWhenEmpty && taskQueue.empty()); }
+    bool shouldStop() { return stopRequested || (stopWhenEmpty && mapTasks.empty() && nTasksRunning == 0); }
+
+    static int64_t TickAtOrAfter(boost::chrono::system_clock::time_point t);
+    static int64_t TickAtOrBefore(boost::chrono::system_clock::time_point t);
+    static boost::chrono::system_clock::time_point TickTime(int64_t nTick);
+
+    // All of these require newTaskMutex to be held
+    TaskId AddTask(Function f, boost::chrono::system_clock::time_point t, boost::chrono::microseconds period, GroupId group);
+    void Insert(TaskId id, Task& task);
+    void Unlink(Task& task);
+    //! The next tick at which a slot expires or cascades, false if the wheel is empty
+    bool NextEventTick(int64_t& nTick, int& nLevel) const;
+    //! Take everything due by nNowTick out of the wheel and into dequeReady
+    void Advance(int64_t nNowTick);
+    //! Move the wheel back to nNowTick after the clock stepped back
+    void Rebase(int64_t nNowTick);
+    //! Bookkeeping after a task ran (or threw); returns the next task of its group to run, or 0
+    TaskId Finished(TaskId id, GroupId group);
 };
 
 #endif
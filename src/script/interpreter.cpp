@@ -1085,9 +1085,86 @@ public:
     }
 };
 
+/** Stream that serializes straight into a SHA256 hasher state */
+class CSHA256Writer
+{
+private:
+    CSHA256& ctx;
+    const int nType;
+    const int nVersion;
+
+public:
+    CSHA256Writer(CSHA256& ctxIn, int nTypeIn, int nVersionIn) : ctx(ctxIn), nType(nTypeIn), nVersion(nVersionIn) {}
+
+    int GetType() const { return nType; }
+    int GetVersion() const { return nVersion; }
+
+    CSHA256Writer& write(const char* pch, size_t size)
+    {
+        ctx.Write((const unsigned char*)pch, size);
+        return (*this);
+    }
+
+    template <typename T>
+    CSHA256Writer& operator<<(const T& obj)
+    {
+        ::Serialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
+};
+
+/** Stream that appends to a byte vector */
+class CVectorWriter
+{
+private:
+    std::vector<unsigned char>& vch;
+    const int nType;
+    const int nVersion;
+
+public:
+    CVectorWriter(std::vector<unsigned char>& vchIn, int nTypeIn, int nVersionIn) : vch(vchIn), nType(nTypeIn), nVersion(nVersionIn) {}
+
+    int GetType() const { return nType; }
+    int GetVersion() const { return nVersion; }
+
+    CVectorWriter& write(const char* pch, size_t size)
+    {
+        vch.insert(vch.end(), (const unsigned char*)pch, (const unsigned char*)pch + size);
+        return (*this);
+    }
+};
+
 } // anon namespace
 
-uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType)
+PrecomputedTransactionData::PrecomputedTransactionData(const CTransaction& txTo)
+{
+    // Every input as the other inputs of a SIGHASH_ALL signature see it, then the outputs
+    CTransactionSignatureSerializer txTmp(txTo, CScript(), 0, SIGHASH_ALL);
+    CVectorWriter ss(vchBlanked, SER_GETHASH, 0);
+    for (unsigned int nInput = 0; nInput < txTo.vin.size(); nInput++) {
+        vInputPos.push_back(vchBlanked.size());
+        ::Serialize(ss, txTo.vin[nInput].prevout, SER_GETHASH, 0);
+        ::Serialize(ss, CScript(), SER_GETHASH, 0);
+        ::Serialize(ss, txTo.vin[nInput].nSequence, SER_GETHASH, 0);
+    }
+    vInputPos.push_back(vchBlanked.size());
+    ::WriteCompactSize(ss, txTo.vout.size());
+    for (unsigned int nOutput = 0; nOutput < txTo.vout.size(); nOutput++)
+        txTmp.SerializeOutput(ss, nOutput, SER_GETHASH, 0);
+    ::Serialize(ss, txTo.nLockTime, SER_GETHASH, 0);
+
+    CSHA256 ctx;
+    CSHA256Writer writer(ctx, SER_GETHASH, 0);
+    writer << txTo.nVersion;
+    ::WriteCompactSize(writer, txTo.vin.size());
+    vPrefix.reserve(txTo.vin.size());
+    for (unsigned int nInput = 0; nInput < txTo.vin.size(); nInput++) {
+        vPrefix.push_back(ctx);
+        ctx.Write(&vchBlanked[vInputPos[nInput]], vInputPos[nInput + 1] - vInputPos[nInput]);
+    }
+}
+
+uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType, const PrecomputedTransactionData* txdata)
 {
     if (nIn >= txTo.vin.size()) {
         //  nIn out of range
@@ -1105,6 +1182,23 @@ uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsig
     // Wrapper to serialize only the necessary parts of the transaction being signed
     CTransactionSignatureSerializer txTmp(txTo, scriptCode, nIn, nHashType);
 
+    // Without ANYONECANPAY, NONE or SINGLE, only the signed input differs from the precomputed serialization
+    if (txdata && !(nHashType & SIGHASH_ANYONECANPAY) &&
+        (nHashType & 0x1f) != SIGHASH_NONE && (nHashType & 0x1f) != SIGHASH_SINGLE) {
+        assert(txdata->vPrefix.size() == txTo.vin.size());
+        CSHA256 ctx(txdata->vPrefix[nIn]);
+        CSHA256Writer writer(ctx, SER_GETHASH, 0);
+        txTmp.SerializeInput(writer, nIn, SER_GETHASH, 0);
+        const size_t nRest = txdata->vInputPos[nIn + 1];
+        ctx.Write(&txdata->vchBlanked[nRest], txdata->vchBlanked.size() - nRest);
+        writer << nHashType;
+        // Double SHA256, like CHashWriter
+        uint256 hash;
+        ctx.Finalize(hash.begin());
+        ctx.Reset().Write(hash.begin(), CSHA256::OUTPUT_SIZE).Finalize(hash.begin());
+        return hash;
+    }
+
     // Serialize and hash
     CHashWriter ss(SER_GETHASH, 0);
     ss << txTmp << nHashType;
@@ -1129,7 +1223,7 @@ bool TransactionSignatureChecker::CheckSig(const std::vector<unsigned char>& vch
     int nHashType = vchSig.back();
     vchSig.pop_back();
 
-    uint256 sighash = SignatureHash(scriptCode, *txTo, nIn, nHashType);
+    uint256 sighash = SignatureHash(scriptCode, *txTo, nIn, nHashType, txdata);
 
     if (!VerifySignature(vchSig, pubkey, sighash))
         return false;
@@ -0,0 +1,72 @@
+// Copyright (c) 2016 BitPay, Inc.
+// Copyright (c) 2020 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef YODA_SPENTINDEX_H
+#define YODA_SPENTINDEX_H
+
+#include "amount.h"
+#include "serialize.h"
+#include "uint256.h"
+
+/** The output whose spender is recorded */
+struct CSpentIndexKey {
+    uint256 txid;
+    unsigned int outputIndex;
+
+    CSpentIndexKey() : outputIndex(0) {}
+    CSpentIndexKey(const uint256& hash, unsigned int n) : txid(hash), outputIndex(n) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(txid);
+        READWRITE(outputIndex);
+    }
+};
+
+/** The input spending an output, with the spent amount and address so no lookup of the prevout is needed */
+struct CSpentIndexValue {
+    uint256 txid;
+    unsigned int inputIndex;
+    int blockHeight;
+    CAmount satoshis;
+    int addressType;
+    uint160 addressHash;
+
+    CSpentIndexValue() { SetNull(); }
+
+    CSpentIndexValue(const uint256& hash, unsigned int nInput, int nHeight, CAmount nValue, int nAddressType, const uint160& hashAddress)
+        : txid(hash), inputIndex(nInput), blockHeight(nHeight), satoshis(nValue), addressType(nAddressType), addressHash(hashAddress) {}
+
+    //! A null value in an update batch erases the entry
+    void SetNull()
+    {
+        txid.SetNull();
+        inputIndex = 0;
+        blockHeight = 0;
+        satoshis = 0;
+        addressType = 0;
+        addressHash.SetNull();
+    }
+
+    bool IsNull() const { return txid.IsNull(); }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(txid);
+        READWRITE(inputIndex);
+        READWRITE(blockHeight);
+        READWRITE(satoshis);
+        READWRITE(addressType);
+        READWRITE(addressHash);
+    }
+};
+
+#endif // YODA_SPENTINDEX_H
@@ -31,18 +31,45 @@ std::vector<CSporkDef> sporkDefs = {
 CSporkManager sporkManager;
 std::map<uint256, CSporkMessage> mapSporks;
 
-CSporkManager::CSporkManager()
+CSporkManager::CSporkManager() : nFirstSporkID(0), pSporkValues(nullptr)
 {
     for (auto& sporkDef : sporkDefs) {
         sporkDefsById.emplace(sporkDef.sporkId, &sporkDef);
         sporkDefsByName.emplace(sporkDef.name, &sporkDef);
     }
+
+    if (!sporkDefsById.empty()) {
+        nFirstSporkID = sporkDefsById.begin()->first;
+        vSporkDefined.resize(sporkDefsById.rbegin()->first - nFirstSporkID + 1, false);
+        for (const auto& it : sporkDefsById)
+            vSporkDefined[it.first - nFirstSporkID] = true;
+    }
+
+    // Nothing else can see the manager yet
+    PublishSporkValues();
+}
+
+void CSporkManager::PublishSporkValues()
+{
+    std::unique_ptr<std::vector<int64_t> > pValues(new std::vector<int64_t>(vSporkDefined.size(), -1));
+    for (const auto& it : sporkDefsById)
+        (*pValues)[it.first - nFirstSporkID] = it.second->defaultValue;
+    for (const auto& it : mapSporksActive) {
+        size_t nIndex = it.first - nFirstSporkID;
+        if (nIndex < vSporkDefined.size() && vSporkDefined[nIndex])
+            (*pValues)[nIndex] = it.second.nValue;
+    }
+
+    pSporkValues.store(pValues.get(), std::memory_order_release);
+    vSporkValuesPublished.push_back(std::move(pValues));
 }
 
 void CSporkManager::Clear()
 {
+    LOCK(cs);
     strMasterPrivKey = "";
     mapSporksActive.clear();
+    PublishSporkValues();
 }
 
 // YODA: on startup load spork values from previous session if they exist in the sporkDB
@@ -71,6 +98,9 @@ void CSporkManager::LoadSporksFromDB()
                       sporkName, spork.nValue);
         }
     }
+
+    LOCK(cs);
+    PublishSporkValues();
 }
 
 void CSporkManager::ProcessSpork(CNode* pfrom, std::string& strCommand, CDataStream& vRecv)
@@ -148,6 +178,7 @@ void CSporkManager::ProcessSpork(CNode* pfrom, std::string& strCommand, CDataStr
             LOCK(cs);
             mapSporks[hash] = spork;
             mapSporksActive[spork.nSporkID] = spork;
+            PublishSporkValues();
         }
         spork.Relay();
 
@@ -181,6 +212,7 @@ bool CSporkManager::UpdateSpork(SporkId nSporkID, int64_t nValue)
         LOCK(cs);
         mapSporks[spork.GetHash()] = spork;
         mapSporksActive[nSporkID] = spork;
+        PublishSporkValues();
         return true;
     }
 
@@ -196,20 +228,11 @@ bool CSporkManager::IsSporkActive(SporkId nSporkID)
 // grab the value of the spork on the network, or the default
 int64_t CSporkManager::GetSporkValue(SporkId nSporkID)
 {
-    LOCK(cs);
-
-    if (mapSporksActive.count(nSporkID)) {
-        return mapSporksActive[nSporkID].nValue;
-
-    } else {
-        auto it = sporkDefsById.find(nSporkID);
-        if (it != sporkDefsById.end()) {
-            return it->second->defaultValue;
-        } else {
-            LogPrintf("%s : Unknown Spork %d\n", __func__, nSporkID);
-        }
-    }
+    size_t nIndex = nSporkID - nFirstSporkID;
+    if (nIndex < vSporkDefined.size() && vSporkDefined[nIndex])
+        return (*pSporkValues.load(std::memory_order_acquire))[nIndex];
 
+    LogPrintf("%s : Unknown Spork %d\n", __func__, nSporkID);
     return -1;
 }
 
@@ -18,6 +18,9 @@
 #include "obfuscation.h"
 #include "protocol.h"
 
+#include <atomic>
+#include <memory>
+
 
 class CSporkMessage;
 class CSporkManager;
@@ -92,6 +95,19 @@ private:
     std::map<std::string, CSporkDef*> sporkDefsByName;
     std::map<SporkId, CSporkMessage> mapSporksActive;
 
+    // Sporks are read on every block and transaction but change a few times a
+    // year, so readers get the current value of every spork from a table that is
+    // never modified once published, indexed by nSporkID - nFirstSporkID. Each
+    // change publishes a new table. Old tables are kept until shutdown, as a
+    // reader may still hold one.
+    int32_t nFirstSporkID;
+    std::vector<bool> vSporkDefined;
+    std::atomic<const std::vector<int64_t>*> pSporkValues;
+    std::vector<std::unique_ptr<const std::vector<int64_t> > > vSporkValuesPublished;
+
+    //! Publish the values in mapSporksActive; cs must be held
+    void PublishSporkValues();
+
 public:
     CSporkManager();
 
@@ -102,6 +118,10 @@ public:
     {
         READWRITE(mapSporksActive);
         // we don't serialize private key to prevent its leakage
+        if (ser_action.ForRead()) {
+            LOCK(cs);
+            PublishSporkValues();
+        }
     }
 
     void Clear();
@@ -13,33 +13,47 @@
 
 bool CPivStake::SetInput(CTransaction txPrev, unsigned int n)
 {
+    if (n >= txPrev.vout.size())
+        return false;
     this->txFrom = txPrev;
-    this->nPosition = n;
+    this->outpointFrom = COutPoint(txPrev.GetHash(), n);
+    this->outFrom = txPrev.vout[n];
+    return true;
+}
+
+bool CPivStake::SetPrevout(const COutPoint& prevout, const CTxOut& out, CBlockIndex* pindex)
+{
+    this->outpointFrom = prevout;
+    this->outFrom = out;
+    this->pindexFrom = pindex;
     return true;
 }
 
 bool CPivStake::GetTxFrom(CTransaction& tx) const
 {
+    // Not available when the input was set from the UTXO set
+    if (txFrom.IsNull())
+        return false;
     tx = txFrom;
     return true;
 }
 
 bool CPivStake::CreateTxIn(CWallet* pwallet, CTxIn& txIn, uint256 hashTxOut)
 {
-    txIn = CTxIn(txFrom.GetHash(), nPosition);
+    txIn = CTxIn(outpointFrom);
     return true;
 }
 
 CAmount CPivStake::GetValue() const
 {
-    return txFrom.vout[nPosition].nValue;
+    return outFrom.nValue;
 }
 
 bool CPivStake::CreateTxOuts(CWallet* pwallet, std::vector<CTxOut>& vout, CAmount nTotal)
 {
     std::vector<valtype> vSolutions;
     txnouttype whichType;
-    CScript scriptPubKeyKernel = txFrom.vout[nPosition].scriptPubKey;
+    CScript scriptPubKeyKernel = outFrom.scriptPubKey;
     if (!Solver(scriptPubKeyKernel, whichType, vSolutions))
         return error("%s: failed to parse kernel", __func__);
 
@@ -50,11 +64,16 @@ bool CPivStake::CreateTxOuts(CWallet* pwallet, std::vector<CTxOut>& vout, CAmoun
     CKey key;
     if (whichType == TX_PUBKEYHASH) {
         // if P2PKH check that we have the input private key
-        if (!pwallet->GetKey(CKeyID(uint160(vSolutions[0])), key))
+        CKeyID keyID = CKeyID(uint160(vSolutions[0]));
+        if (!pwallet->GetKey(keyID, key))
             return error("%s: Unable to get staking private key", __func__);
 
-        // convert to P2PK inputs
-        scriptPubKey << key.GetPubKey() << OP_CHECKSIG;
+        // convert to P2PK inputs. An encrypted wallet stores the pubkey, an
+        // unencrypted one would only derive it from the key again.
+        CPubKey pubkey;
+        if (!pwallet->IsCrypted() || !pwallet->GetPubKey(keyID, pubkey))
+            pubkey = key.GetPubKey();
+        scriptPubKey << pubkey << OP_CHECKSIG;
 
     } else {
         // if P2CS, check that we have the coldstaking private key
@@ -89,7 +108,7 @@ CDataStream CPivStake::GetUniqueness() const
 {
     //The unique identifier for a YODA stake is the outpoint
     CDataStream ss(SER_NETWORK, 0);
-    ss << nPosition << txFrom.GetHash();
+    ss << outpointFrom.n << outpointFrom.hash;
     return ss;
 }
 
@@ -100,7 +119,7 @@ CBlockIndex* CPivStake::GetIndexFrom()
         return pindexFrom;
     uint256 hashBlock = 0;
     CTransaction tx;
-    if (GetTransaction(txFrom.GetHash(), tx, hashBlock, true)) {
+    if (GetTransaction(outpointFrom.hash, tx, hashBlock, true)) {
         // If the index is in the chain, then set it as the "index from"
         if (mapBlockIndex.count(hashBlock)) {
             CBlockIndex* pindex = mapBlockIndex.at(hashBlock);
@@ -108,7 +127,7 @@ CBlockIndex* CPivStake::GetIndexFrom()
                 pindexFrom = pindex;
         }
     } else {
-        LogPrintf("%s : failed to find tx %s\n", __func__, txFrom.GetHash().GetHex());
+        LogPrintf("%s : failed to find tx %s\n", __func__, outpointFrom.hash.GetHex());
     }
 
     return pindexFrom;
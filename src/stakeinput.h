@@ -34,12 +34,15 @@ class CPivStake : public CStakeInput
 {
 private:
     CTransaction txFrom;
-    unsigned int nPosition;
+    COutPoint outpointFrom;
+    CTxOut outFrom;
 
 public:
     CPivStake(){}
 
     bool SetInput(CTransaction txPrev, unsigned int n);
+    // Set from the kernel output alone, when the caller already knows the block that created it
+    bool SetPrevout(const COutPoint& prevout, const CTxOut& out, CBlockIndex* pindex);
 
     CBlockIndex* GetIndexFrom() override;
     bool GetTxFrom(CTransaction& tx) const override;
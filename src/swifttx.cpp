@@ -13,6 +13,7 @@
 #include "net.h"
 #include "obfuscation.h"
 #include "protocol.h"
+#include "random.h"
 #include "spork.h"
 #include "sync.h"
 #include "util.h"
@@ -20,12 +21,7 @@
 #include <boost/foreach.hpp>
 
 
-std::map<uint256, CTransaction> mapTxLockReq;
-std::map<uint256, CTransaction> mapTxLockReqRejected;
-std::map<uint256, CConsensusVote> mapTxLockVote;
-std::map<uint256, CTransactionLock> mapTxLocks;
-std::map<COutPoint, uint256> mapLockedInputs;
-std::map<uint256, int64_t> mapUnknownVotes; //track votes with no tx for DOS
+CTxLockManager txLockManager;
 int nCompleteTXLocks;
 
 //txlock - Locks transaction
@@ -51,7 +47,7 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
         pfrom->AddInventoryKnown(inv);
         GetMainSignals().Inventory(inv.hash);
 
-        if (mapTxLockReq.count(tx.GetHash()) || mapTxLockReqRejected.count(tx.GetHash())) {
+        if (txLockManager.HaveLockRequest(tx.GetHash())) {
             return;
         }
 
@@ -83,7 +79,7 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
 
             DoConsensusVote(tx, nBlockHeight);
 
-            mapTxLockReq.insert(std::make_pair(tx.GetHash(), tx));
+            txLockManager.AddLockRequest(tx);
 
             LogPrintf("%s : Transaction Lock Request: %s %s : accepted %s\n", __func__,
                     pfrom->addr.ToString().c_str(), pfrom->cleanSubVer.c_str(),
@@ -96,7 +92,7 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
             return;
 
         } else {
-            mapTxLockReqRejected.insert(std::make_pair(tx.GetHash(), tx));
+            txLockManager.AddRejectedLockRequest(tx);
 
             // can we get the conflicting transaction as proof?
 
@@ -104,24 +100,15 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
                 pfrom->addr.ToString().c_str(), pfrom->cleanSubVer.c_str(),
                 tx.GetHash().ToString().c_str());
 
-            for (const CTxIn& in : tx.vin) {
-                if (!mapLockedInputs.count(in.prevout)) {
-                    mapLockedInputs.insert(std::make_pair(in.prevout, tx.GetHash()));
-                }
-            }
-
             // resolve conflicts
-            std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(tx.GetHash());
-            if (i != mapTxLocks.end()) {
-                //we only care if we have a complete tx lock
-                if ((*i).second.CountSignatures() >= SWIFTTX_SIGNATURES_REQUIRED) {
-                    if (!CheckForConflictingLocks(tx)) {
-                        LogPrintf("%s : Found Existing Complete IX Lock\n", __func__);
-
-                        //reprocess the last 15 blocks
-                        ReprocessBlocks(15);
-                        mapTxLockReq.insert(std::make_pair(tx.GetHash(), tx));
-                    }
+            //we only care if we have a complete tx lock
+            if (txLockManager.GetSignatures(tx.GetHash()) >= SWIFTTX_SIGNATURES_REQUIRED) {
+                if (!txLockManager.CheckForConflictingLocks(tx)) {
+                    LogPrintf("%s : Found Existing Complete IX Lock\n", __func__);
+
+                    //reprocess the last 15 blocks
+                    ReprocessBlocks(15);
+                    txLockManager.AddLockRequest(tx);
                 }
             }
 
@@ -135,39 +122,35 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
         CInv inv(MSG_TXLOCK_VOTE, ctx.GetHash());
         pfrom->AddInventoryKnown(inv);
 
-        if (mapTxLockVote.count(ctx.GetHash())) {
+        if (txLockManager.HaveVote(ctx.GetHash())) {
             return;
         }
 
-        mapTxLockVote.insert(std::make_pair(ctx.GetHash(), ctx));
-
         if (ProcessConsensusVote(pfrom, ctx)) {
+            // Only accepted votes are kept, they go when their lock does; our own votes after an hour
+            txLockManager.AddVote(ctx);
+
             //Spam/Dos protection
             /*
                 Masternodes will sometimes propagate votes before the transaction is known to the client.
                 This tracks those messages and allows it at the same rate of the rest of the network, if
                 a peer violates it, it will simply be ignored
             */
-            if (!mapTxLockReq.count(ctx.txHash) && !mapTxLockReqRejected.count(ctx.txHash)) {
-                if (!mapUnknownVotes.count(ctx.vinMasternode.prevout.hash)) {
-                    mapUnknownVotes[ctx.vinMasternode.prevout.hash] = GetTime() + (60 * 10);
-                }
-
-                if (mapUnknownVotes[ctx.vinMasternode.prevout.hash] > GetTime() &&
-                    mapUnknownVotes[ctx.vinMasternode.prevout.hash] - GetAverageVoteTime() > 60 * 10) {
+            // As before, votes on rejected requests are not counted as unknown
+            if (!txLockManager.HaveLockRequest(ctx.txHash)) {
+                if (txLockManager.IsUnknownVoteSpam(ctx.vinMasternode.prevout.hash)) {
                     LogPrintf("%s : masternode is spamming transaction votes: %s %s\n", __func__,
                         ctx.vinMasternode.ToString().c_str(),
                         ctx.txHash.ToString().c_str());
                     return;
-                } else {
-                    mapUnknownVotes[ctx.vinMasternode.prevout.hash] = GetTime() + (60 * 10);
                 }
             }
             RelayInv(inv);
         }
 
-        if (mapTxLockReq.count(ctx.txHash) && GetTransactionLockSignatures(ctx.txHash) == SWIFTTX_SIGNATURES_REQUIRED) {
-            GetMainSignals().NotifyTransactionLock(mapTxLockReq[ctx.txHash]);
+        CTransaction tx;
+        if (txLockManager.GetLockRequest(ctx.txHash, tx) && GetTransactionLockSignatures(ctx.txHash) == SWIFTTX_SIGNATURES_REQUIRED) {
+            GetMainSignals().NotifyTransactionLock(tx);
         }
 
         return;
@@ -241,20 +224,7 @@ int64_t CreateNewLock(CTransaction tx)
     */
     int nBlockHeight = (chainActive.Tip()->nHeight - nTxAge) + 4;
 
-    if (!mapTxLocks.count(tx.GetHash())) {
-        LogPrintf("%s : New Transaction Lock %s !\n", __func__, tx.GetHash().ToString().c_str());
-
-        CTransactionLock newLock;
-        newLock.nBlockHeight = nBlockHeight;
-        newLock.nExpiration = GetTime() + (60 * 60); //locks expire after 60 minutes (24 confirmations)
-        newLock.nTimeout = GetTime() + (60 * 5);
-        newLock.txHash = tx.GetHash();
-        mapTxLocks.insert(std::make_pair(tx.GetHash(), newLock));
-    } else {
-        mapTxLocks[tx.GetHash()].nBlockHeight = nBlockHeight;
-        LogPrint("swiftx", "%s : Transaction Lock Exists %s !\n", __func__, tx.GetHash().ToString().c_str());
-    }
-
+    txLockManager.SetLockHeight(tx.GetHash(), nBlockHeight);
 
     return nBlockHeight;
 }
@@ -264,7 +234,7 @@ void DoConsensusVote(CTransaction& tx, int64_t nBlockHeight)
 {
     if (!fMasterNode) return;
 
-    int n = mnodeman.GetMasternodeRank(activeMasternode.vin, nBlockHeight, MIN_SWIFTTX_PROTO_VERSION);
+    int n = txLockManager.GetMasternodeRank(activeMasternode.vin, nBlockHeight);
 
     if (n == -1) {
         LogPrint("swiftx", "%s : Unknown Masternode\n", __func__);
@@ -299,7 +269,7 @@ void DoConsensusVote(CTransaction& tx, int64_t nBlockHeight)
         return;
     }
 
-    mapTxLockVote[ctx.GetHash()] = ctx;
+    txLockManager.AddOwnVote(ctx);
 
     CInv inv(MSG_TXLOCK_VOTE, ctx.GetHash());
     RelayInv(inv);
@@ -308,7 +278,7 @@ void DoConsensusVote(CTransaction& tx, int64_t nBlockHeight)
 //received a consensus vote
 bool ProcessConsensusVote(CNode* pnode, CConsensusVote& ctx)
 {
-    int n = mnodeman.GetMasternodeRank(ctx.vinMasternode, ctx.nBlockHeight, MIN_SWIFTTX_PROTO_VERSION);
+    int n = txLockManager.GetMasternodeRank(ctx.vinMasternode, ctx.nBlockHeight);
 
     CMasternode* pmn = mnodeman.Find(ctx.vinMasternode);
     if (pmn != NULL)
@@ -333,148 +303,367 @@ bool ProcessConsensusVote(CNode* pnode, CConsensusVote& ctx)
         return error("%s : Signature invalid\n", __func__);
     }
 
-    if (!mapTxLocks.count(ctx.txHash)) {
-        LogPrintf("%s : New Transaction Lock %s !\n", __func__, ctx.txHash.ToString().c_str());
-
-        CTransactionLock newLock;
-        newLock.nBlockHeight = 0;
-        newLock.nExpiration = GetTime() + (60 * 60);
-        newLock.nTimeout = GetTime() + (60 * 5);
-        newLock.txHash = ctx.txHash;
-        mapTxLocks.insert(std::make_pair(ctx.txHash, newLock));
-    } else
-        LogPrint("swiftx", "%s : Transaction Lock Exists %s !\n", __func__, ctx.txHash.ToString().c_str());
-
     //compile consessus vote
-    std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(ctx.txHash);
-    if (i != mapTxLocks.end()) {
-        (*i).second.AddSignature(ctx);
+    int nSignatures = txLockManager.AddSignature(ctx);
 
 #ifdef ENABLE_WALLET
-        if (pwalletMain) {
-            //when we get back signatures, we'll count them as requests. Otherwise the client will think it didn't propagate.
-            if (pwalletMain->mapRequestCount.count(ctx.txHash))
-                pwalletMain->mapRequestCount[ctx.txHash]++;
-        }
+    if (pwalletMain) {
+        //when we get back signatures, we'll count them as requests. Otherwise the client will think it didn't propagate.
+        if (pwalletMain->mapRequestCount.count(ctx.txHash))
+            pwalletMain->mapRequestCount[ctx.txHash]++;
+    }
 #endif
 
-        LogPrint("swiftx", "%s : Transaction Lock Votes %d - %s !\n", __func__, (*i).second.CountSignatures(), ctx.GetHash().ToString().c_str());
+    LogPrint("swiftx", "%s : Transaction Lock Votes %d - %s !\n", __func__, nSignatures, ctx.GetHash().ToString().c_str());
 
-        if ((*i).second.CountSignatures() >= SWIFTTX_SIGNATURES_REQUIRED) {
-            LogPrint("swiftx", "%s : Transaction Lock Is Complete %s !\n", __func__, (*i).second.GetHash().ToString().c_str());
+    if (nSignatures >= SWIFTTX_SIGNATURES_REQUIRED) {
+        LogPrint("swiftx", "%s : Transaction Lock Is Complete %s !\n", __func__, ctx.txHash.ToString().c_str());
 
-            CTransaction& tx = mapTxLockReq[ctx.txHash];
-            if (!CheckForConflictingLocks(tx)) {
+        // Without the request there are no inputs to lock or check yet
+        CTransaction tx;
+        bool fHaveRequest = txLockManager.GetLockRequest(ctx.txHash, tx);
+        if (!txLockManager.CheckForConflictingLocks(tx)) {
 #ifdef ENABLE_WALLET
-                if (pwalletMain) {
-                    if (pwalletMain->UpdatedTransaction((*i).second.txHash)) {
-                        nCompleteTXLocks++;
-                    }
+            if (pwalletMain) {
+                if (pwalletMain->UpdatedTransaction(ctx.txHash)) {
+                    nCompleteTXLocks++;
                 }
+            }
 #endif
 
-                if (mapTxLockReq.count(ctx.txHash)) {
-                    for (const CTxIn& in : tx.vin) {
-                        if (!mapLockedInputs.count(in.prevout)) {
-                            mapLockedInputs.insert(std::make_pair(in.prevout, ctx.txHash));
-                        }
-                    }
-                }
+            if (fHaveRequest)
+                txLockManager.LockInputs(tx);
 
-                // resolve conflicts
+            // resolve conflicts
 
-                //if this tx lock was rejected, we need to remove the conflicting blocks
-                if (mapTxLockReqRejected.count((*i).second.txHash)) {
-                    //reprocess the last 15 blocks
-                    ReprocessBlocks(15);
-                }
+            //if this tx lock was rejected, we need to remove the conflicting blocks
+            if (txLockManager.HaveRejectedLockRequest(ctx.txHash)) {
+                //reprocess the last 15 blocks
+                ReprocessBlocks(15);
             }
         }
-        return true;
     }
+    return true;
+}
 
-    return false;
+void CleanTransactionLocksList()
+{
+    if (chainActive.Tip() == NULL) return;
+
+    txLockManager.Clean(GetTime());
 }
 
-bool CheckForConflictingLocks(CTransaction& tx)
+int GetTransactionLockSignatures(uint256 txHash)
 {
-    /*
-        It's possible (very unlikely though) to get 2 conflicting transaction locks approved by the network.
-        In that case, they will cancel each other out.
+    if(fLargeWorkForkFound || fLargeWorkInvalidChainFound) return -2;
+    if (!sporkManager.IsSporkActive(SPORK_2_SWIFTTX)) return -1;
 
-        Blocks could have been rejected during this time, which is OK. After they cancel out, the client will
-        rescan the blocks and find they're acceptable and then take the chain with the most work.
-    */
+    return txLockManager.GetSignatures(txHash);
+}
+
+COutPointHasher::COutPointHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())),
+                                      k1(GetRand(std::numeric_limits<uint64_t>::max()))
+{
+}
+
+CTransactionLock& CTxLockManager::GetOrCreateLock(const uint256& txHash, int nBlockHeight)
+{
+    AssertLockHeld(cs);
+
+    boost::unordered_map<uint256, CTransactionLock, BlockHasher>::iterator it = mapTxLocks.find(txHash);
+    if (it != mapTxLocks.end()) {
+        LogPrint("swiftx", "%s : Transaction Lock Exists %s !\n", __func__, txHash.ToString().c_str());
+        return it->second;
+    }
+
+    LogPrintf("%s : New Transaction Lock %s !\n", __func__, txHash.ToString().c_str());
+    CTransactionLock& lock = mapTxLocks[txHash];
+    lock.nBlockHeight = nBlockHeight;
+    lock.nExpiration = GetTime() + (60 * 60); //locks expire after 60 minutes (24 confirmations)
+    lock.nTimeout = GetTime() + (60 * 5);
+    lock.txHash = txHash;
+    setLockExpirations.insert(std::make_pair((int64_t)lock.nExpiration, txHash));
+    return lock;
+}
+
+void CTxLockManager::SetExpiration(CTransactionLock& lock, int64_t nExpiration)
+{
+    AssertLockHeld(cs);
+
+    setLockExpirations.erase(std::make_pair((int64_t)lock.nExpiration, lock.txHash));
+    lock.nExpiration = nExpiration;
+    setLockExpirations.insert(std::make_pair((int64_t)lock.nExpiration, lock.txHash));
+}
+
+bool CTxLockManager::HaveLockRequest(const uint256& txHash) const
+{
+    LOCK(cs);
+    return mapTxLockReq.count(txHash) || mapTxLockReqRejected.count(txHash);
+}
+
+bool CTxLockManager::HaveRejectedLockRequest(const uint256& txHash) const
+{
+    LOCK(cs);
+    return mapTxLockReqRejected.count(txHash);
+}
+
+bool CTxLockManager::GetLockRequest(const uint256& txHash, CTransaction& txRet) const
+{
+    LOCK(cs);
+    boost::unordered_map<uint256, CTransaction, BlockHasher>::const_iterator it = mapTxLockReq.find(txHash);
+    if (it == mapTxLockReq.end())
+        return false;
+    txRet = it->second;
+    return true;
+}
+
+void CTxLockManager::AddLockRequest(const CTransaction& tx)
+{
+    LOCK(cs);
+    const uint256 txHash = tx.GetHash();
+    if (!mapTxLockReq.insert(std::make_pair(txHash, tx)).second)
+        return;
+    // Requests that get no lock, such as those with too few confirmations, need an expiration of their own
+    if (!mapTxLocks.count(txHash))
+        setLockExpirations.insert(std::make_pair(GetTime() + (60 * 60), txHash));
+}
+
+void CTxLockManager::AddRejectedLockRequest(const CTransaction& tx)
+{
+    LOCK(cs);
+    const uint256 txHash = tx.GetHash();
+    if (!mapTxLockReqRejected.insert(std::make_pair(txHash, tx)).second)
+        return;
+    for (const CTxIn& in : tx.vin)
+        mapLockedInputs.insert(std::make_pair(in.prevout, txHash));
+    // Requests with unknown inputs get no lock, so they need an expiration of their own
+    if (!mapTxLocks.count(txHash))
+        setLockExpirations.insert(std::make_pair(GetTime() + (60 * 60), txHash));
+}
+
+void CTxLockManager::UnlockInputs(const CTransaction& tx)
+{
+    AssertLockHeld(cs);
+
+    const uint256 txHash = tx.GetHash();
     for (const CTxIn& in : tx.vin) {
-        if (mapLockedInputs.count(in.prevout)) {
-            if (mapLockedInputs[in.prevout] != tx.GetHash()) {
-                LogPrintf("%s : found two complete conflicting locks - removing both. %s %s", __func__,
-                        tx.GetHash().ToString().c_str(), mapLockedInputs[in.prevout].ToString().c_str());
-                if (mapTxLocks.count(tx.GetHash())) mapTxLocks[tx.GetHash()].nExpiration = GetTime();
-                if (mapTxLocks.count(mapLockedInputs[in.prevout])) mapTxLocks[mapLockedInputs[in.prevout]].nExpiration = GetTime();
-                return true;
-            }
-        }
+        boost::unordered_map<COutPoint, uint256, COutPointHasher>::iterator it = mapLockedInputs.find(in.prevout);
+        // Inputs that were already locked stay with the transaction that locked them
+        if (it != mapLockedInputs.end() && it->second == txHash)
+            mapLockedInputs.erase(it);
     }
+}
 
-    return false;
+bool CTxLockManager::HaveVote(const uint256& voteHash) const
+{
+    LOCK(cs);
+    return mapTxLockVote.count(voteHash);
+}
+
+bool CTxLockManager::GetVote(const uint256& voteHash, CConsensusVote& voteRet) const
+{
+    LOCK(cs);
+    boost::unordered_map<uint256, CConsensusVote, BlockHasher>::const_iterator it = mapTxLockVote.find(voteHash);
+    if (it == mapTxLockVote.end())
+        return false;
+    voteRet = it->second;
+    return true;
+}
+
+bool CTxLockManager::AddVote(const CConsensusVote& vote)
+{
+    LOCK(cs);
+    return mapTxLockVote.insert(std::make_pair(vote.GetHash(), vote)).second;
 }
 
-int64_t GetAverageVoteTime()
+void CTxLockManager::AddOwnVote(const CConsensusVote& vote)
 {
-    std::map<uint256, int64_t>::iterator it = mapUnknownVotes.begin();
-    int64_t total = 0;
-    int64_t count = 0;
+    LOCK(cs);
+    const uint256 voteHash = vote.GetHash();
+    if (mapTxLockVote.insert(std::make_pair(voteHash, vote)).second)
+        setOwnVoteExpirations.insert(std::make_pair(GetTime() + (60 * 60), voteHash));
+}
+
+void CTxLockManager::SetLockHeight(const uint256& txHash, int nBlockHeight)
+{
+    LOCK(cs);
+    GetOrCreateLock(txHash, nBlockHeight).nBlockHeight = nBlockHeight;
+}
+
+int CTxLockManager::AddSignature(const CConsensusVote& vote)
+{
+    LOCK(cs);
+    CTransactionLock& lock = GetOrCreateLock(vote.txHash, 0);
+    lock.AddSignature(vote);
+    return lock.CountSignatures();
+}
+
+int CTxLockManager::GetSignatures(const uint256& txHash) const
+{
+    LOCK(cs);
+    boost::unordered_map<uint256, CTransactionLock, BlockHasher>::const_iterator it = mapTxLocks.find(txHash);
+    if (it == mapTxLocks.end())
+        return -1;
+    return it->second.CountSignatures();
+}
+
+bool CTxLockManager::IsLockTimedOut(const uint256& txHash) const
+{
+    LOCK(cs);
+    boost::unordered_map<uint256, CTransactionLock, BlockHasher>::const_iterator it = mapTxLocks.find(txHash);
+    if (it == mapTxLocks.end())
+        return false;
+    return GetTime() > it->second.nTimeout;
+}
 
-    while (it != mapUnknownVotes.end()) {
-        total += it->second;
-        count++;
-        it++;
+bool CTxLockManager::GetConflictingLock(const CTransaction& tx, uint256& hashLockRet) const
+{
+    LOCK(cs);
+    if (mapLockedInputs.empty())
+        return false;
+
+    const uint256 txHash = tx.GetHash();
+    for (const CTxIn& in : tx.vin) {
+        boost::unordered_map<COutPoint, uint256, COutPointHasher>::const_iterator it = mapLockedInputs.find(in.prevout);
+        if (it != mapLockedInputs.end() && it->second != txHash) {
+            hashLockRet = it->second;
+            return true;
+        }
     }
+    return false;
+}
 
-    return total / count;
+void CTxLockManager::LockInputs(const CTransaction& tx)
+{
+    LOCK(cs);
+    for (const CTxIn& in : tx.vin)
+        mapLockedInputs.insert(std::make_pair(in.prevout, tx.GetHash()));
 }
 
-void CleanTransactionLocksList()
+bool CTxLockManager::CheckForConflictingLocks(const CTransaction& tx)
 {
-    if (chainActive.Tip() == NULL) return;
+    /*
+        It's possible (very unlikely though) to get 2 conflicting transaction locks approved by the network.
+        In that case, they will cancel each other out.
 
-    std::map<uint256, CTransactionLock>::iterator it = mapTxLocks.begin();
+        Blocks could have been rejected during this time, which is OK. After they cancel out, the client will
+        rescan the blocks and find they're acceptable and then take the chain with the most work.
+    */
+    LOCK(cs);
+    uint256 hashLock;
+    if (!GetConflictingLock(tx, hashLock))
+        return false;
 
-    while (it != mapTxLocks.end()) {
-        if (GetTime() > it->second.nExpiration) { //keep them for an hour
-            LogPrintf("%s : Removing old transaction lock %s\n", __func__,
-                    it->second.txHash.ToString().c_str());
+    LogPrintf("%s : found two complete conflicting locks - removing both. %s %s", __func__,
+            tx.GetHash().ToString().c_str(), hashLock.ToString().c_str());
+    boost::unordered_map<uint256, CTransactionLock, BlockHasher>::iterator it = mapTxLocks.find(tx.GetHash());
+    if (it != mapTxLocks.end()) SetExpiration(it->second, GetTime());
+    it = mapTxLocks.find(hashLock);
+    if (it != mapTxLocks.end()) SetExpiration(it->second, GetTime());
+    return true;
+}
 
-            if (mapTxLockReq.count(it->second.txHash)) {
-                CTransaction& tx = mapTxLockReq[it->second.txHash];
+bool CTxLockManager::IsUnknownVoteSpam(const uint256& hashMasternode)
+{
+    LOCK(cs);
+    int64_t nNow = GetTime();
+    boost::unordered_map<uint256, int64_t, BlockHasher>::iterator it = mapUnknownVotes.find(hashMasternode);
+    if (it == mapUnknownVotes.end()) {
+        it = mapUnknownVotes.insert(std::make_pair(hashMasternode, nNow + (60 * 10))).first;
+        nUnknownVotesTotal += it->second;
+    }
 
-                for (const CTxIn& in : tx.vin)
-                    mapLockedInputs.erase(in.prevout);
+    if (it->second > nNow && it->second - GetAverageVoteTime() > 60 * 10)
+        return true;
 
-                mapTxLockReq.erase(it->second.txHash);
-                mapTxLockReqRejected.erase(it->second.txHash);
+    nUnknownVotesTotal += nNow + (60 * 10) - it->second;
+    it->second = nNow + (60 * 10);
+    return false;
+}
 
-                for (CConsensusVote& v : it->second.vecConsensusVotes)
-                    mapTxLockVote.erase(v.GetHash());
-            }
+int64_t CTxLockManager::GetAverageVoteTime() const
+{
+    LOCK(cs);
+    if (mapUnknownVotes.empty())
+        return 0;
+    return nUnknownVotesTotal / (int64_t)mapUnknownVotes.size();
+}
 
-            mapTxLocks.erase(it++);
-        } else {
-            it++;
+int CTxLockManager::GetMasternodeRank(const CTxIn& vin, int nBlockHeight)
+{
+    int64_t nNow = GetTime();
+    uint64_t nListGeneration = mnodeman.GetListGeneration();
+    {
+        LOCK(cs);
+        std::map<int, CRankCache>::const_iterator it = mapRankCache.find(nBlockHeight);
+        if (it != mapRankCache.end() && it->second.nListGeneration == nListGeneration &&
+            nNow >= it->second.nTime && nNow - it->second.nTime < RANK_CACHE_SECONDS) {
+            boost::unordered_map<COutPoint, int, COutPointHasher>::const_iterator itRank = it->second.mapRanks.find(vin.prevout);
+            return itRank == it->second.mapRanks.end() ? -1 : itRank->second;
         }
     }
+
+    // Checking the masternodes takes cs_main and looks up our locked inputs, so ranking runs without our lock
+    std::vector<std::pair<int64_t, CTxIn> > vecScores;
+    if (!mnodeman.GetMasternodeScores(nBlockHeight, MIN_SWIFTTX_PROTO_VERSION, true, vecScores))
+        return -1;
+
+    CRankCache cache;
+    cache.nTime = nNow;
+    cache.nListGeneration = nListGeneration;
+    int nRank = 0;
+    for (const std::pair<int64_t, CTxIn>& score : vecScores)
+        cache.mapRanks.insert(std::make_pair(score.second.prevout, ++nRank));
+
+    boost::unordered_map<COutPoint, int, COutPointHasher>::const_iterator itRank = cache.mapRanks.find(vin.prevout);
+    int nRet = itRank == cache.mapRanks.end() ? -1 : itRank->second;
+
+    LOCK(cs);
+    mapRankCache[nBlockHeight] = cache;
+    while (mapRankCache.size() > RANK_CACHE_HEIGHTS)
+        mapRankCache.erase(mapRankCache.begin());
+    return nRet;
 }
 
-int GetTransactionLockSignatures(uint256 txHash)
+void CTxLockManager::Clean(int64_t nNow)
 {
-    if(fLargeWorkForkFound || fLargeWorkInvalidChainFound) return -2;
-    if (!sporkManager.IsSporkActive(SPORK_2_SWIFTTX)) return -1;
+    LOCK(cs);
+
+    //keep them for an hour
+    while (!setLockExpirations.empty() && nNow > setLockExpirations.begin()->first) {
+        const int64_t nExpiration = setLockExpirations.begin()->first;
+        const uint256 txHash = setLockExpirations.begin()->second;
+        setLockExpirations.erase(setLockExpirations.begin());
+
+        boost::unordered_map<uint256, CTransactionLock, BlockHasher>::iterator it = mapTxLocks.find(txHash);
+        // A rejected request that got a lock later goes when the lock does
+        if (it != mapTxLocks.end() && it->second.nExpiration != nExpiration)
+            continue;
+
+        boost::unordered_map<uint256, CTransaction, BlockHasher>::iterator itReq = mapTxLockReq.find(txHash);
+        if (itReq != mapTxLockReq.end()) {
+            UnlockInputs(itReq->second);
+            mapTxLockReq.erase(itReq);
+        }
+        itReq = mapTxLockReqRejected.find(txHash);
+        if (itReq != mapTxLockReqRejected.end()) {
+            UnlockInputs(itReq->second);
+            mapTxLockReqRejected.erase(itReq);
+        }
+
+        if (it == mapTxLocks.end())
+            continue;
 
-    std::map<uint256, CTransactionLock>::iterator it = mapTxLocks.find(txHash);
-    if(it != mapTxLocks.end()) return it->second.CountSignatures();
+        LogPrintf("%s : Removing old transaction lock %s\n", __func__, txHash.ToString());
+        for (const CConsensusVote& v : it->second.vecConsensusVotes)
+            mapTxLockVote.erase(v.GetHash());
+        mapTxLocks.erase(it);
+    }
 
-    return -1;
+    while (!setOwnVoteExpirations.empty() && nNow > setOwnVoteExpirations.begin()->first) {
+        mapTxLockVote.erase(setOwnVoteExpirations.begin()->second);
+        setOwnVoteExpirations.erase(setOwnVoteExpirations.begin());
+    }
 }
 
 uint256 CConsensusVote::GetHash() const
@@ -500,7 +689,7 @@ std::string CConsensusVote::GetStrMessage() const
 bool CTransactionLock::SignaturesValid()
 {
     for (CConsensusVote vote : vecConsensusVotes) {
-        int n = mnodeman.GetMasternodeRank(vote.vinMasternode, vote.nBlockHeight, MIN_SWIFTTX_PROTO_VERSION);
+        int n = txLockManager.GetMasternodeRank(vote.vinMasternode, vote.nBlockHeight);
 
         if (n == -1) {
             return error("%s : Unknown Masternode", __func__);
@@ -518,12 +707,12 @@ bool CTransactionLock::SignaturesValid()
     return true;
 }
 
-void CTransactionLock::AddSignature(CConsensusVote& cv)
+void CTransactionLock::AddSignature(const CConsensusVote& cv)
 {
     vecConsensusVotes.push_back(cv);
 }
 
-int CTransactionLock::CountSignatures()
+int CTransactionLock::CountSignatures() const
 {
     /*
         Only count signatures where the BlockHeight matches the transaction's blockheight.
@@ -533,7 +722,7 @@ int CTransactionLock::CountSignatures()
     if (nBlockHeight == 0) return -1;
 
     int n = 0;
-    for (CConsensusVote v : vecConsensusVotes) {
+    for (const CConsensusVote& v : vecConsensusVotes) {
         if (v.nBlockHeight == nBlockHeight) {
             n++;
         }
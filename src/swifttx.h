@@ -7,6 +7,7 @@
 #define SWIFTTX_H
 
 #include "base58.h"
+#include "hash.h"
 #include "key.h"
 #include "main.h"
 #include "net.h"
@@ -14,6 +15,10 @@
 #include "sync.h"
 #include "util.h"
 
+#include <set>
+
+#include <boost/unordered_map.hpp>
+
 /*
     At 15 signatures, 1/2 of the masternode network can be owned by
     one party without comprimising the security of SwiftX
@@ -30,14 +35,11 @@
 class CConsensusVote;
 class CTransaction;
 class CTransactionLock;
+class CTxLockManager;
 
 static const int MIN_SWIFTTX_PROTO_VERSION = 70103;
 
-extern std::map<uint256, CTransaction> mapTxLockReq;
-extern std::map<uint256, CTransaction> mapTxLockReqRejected;
-extern std::map<uint256, CConsensusVote> mapTxLockVote;
-extern std::map<uint256, CTransactionLock> mapTxLocks;
-extern std::map<COutPoint, uint256> mapLockedInputs;
+extern CTxLockManager txLockManager;
 extern int nCompleteTXLocks;
 
 
@@ -45,9 +47,6 @@ int64_t CreateNewLock(CTransaction tx);
 
 bool IsIXTXValid(const CTransaction& txCollateral);
 
-// if two conflicting locks are approved by the network, they will cancel out
-bool CheckForConflictingLocks(CTransaction& tx);
-
 void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
 
 //check if we need to vote on this transaction
@@ -62,8 +61,6 @@ void CleanTransactionLocksList();
 // get the accepted transaction lock signatures
 int GetTransactionLockSignatures(uint256 txHash);
 
-int64_t GetAverageVoteTime();
-
 class CConsensusVote : public CSignedMessage
 {
 public:
@@ -113,8 +110,8 @@ public:
     int nTimeout;
 
     bool SignaturesValid();
-    int CountSignatures();
-    void AddSignature(CConsensusVote& cv);
+    int CountSignatures() const;
+    void AddSignature(const CConsensusVote& cv);
 
     uint256 GetHash()
     {
@@ -122,5 +119,111 @@ public:
     }
 };
 
+/** Outpoint hash for the lock maps. The prevouts come from peers, so it is keyed per map with a random salt. */
+class COutPointHasher
+{
+    uint64_t k0, k1;
+
+public:
+    COutPointHasher();
+    size_t operator()(const COutPoint& outpoint) const { return SipHashUint256(k0, k1, outpoint.hash) ^ outpoint.n; }
+};
+
+/**
+ * SwiftTX lock requests, votes and locks, and the inputs held by locks.
+ *
+ * Everything is found by hash, and the locks are also indexed by expiration
+ * time, so checking a transaction against the locks costs one lookup per input
+ * and cleaning up only visits the locks that expired. The masternode ranks at
+ * a height are computed once and reused by every vote at that height for up
+ * to RANK_CACHE_SECONDS.
+ *
+ * The rank cache is dropped when the masternode list changes, but not when a
+ * listed masternode becomes enabled or disabled, changes protocol version or
+ * gets old enough to rank. Those only show up in CMasternode::Check() and in
+ * the clock, so there is no cheap key for them; ranks may be up to
+ * RANK_CACHE_SECONDS behind such a change instead, which is well inside the
+ * minutes those states take to change.
+ *
+ * cs is only held inside the methods, which never call out of the manager, so
+ * they may be called with cs_main held or not.
+ */
+class CTxLockManager
+{
+private:
+    static const int64_t RANK_CACHE_SECONDS = 60;
+    static const size_t RANK_CACHE_HEIGHTS = 32;
+
+    struct CRankCache {
+        int64_t nTime;
+        uint64_t nListGeneration;
+        boost::unordered_map<COutPoint, int, COutPointHasher> mapRanks;
+    };
+
+    mutable CCriticalSection cs;
+    boost::unordered_map<uint256, CTransaction, BlockHasher> mapTxLockReq;
+    boost::unordered_map<uint256, CTransaction, BlockHasher> mapTxLockReqRejected;
+    boost::unordered_map<uint256, CConsensusVote, BlockHasher> mapTxLockVote;
+    boost::unordered_map<uint256, CTransactionLock, BlockHasher> mapTxLocks;
+    boost::unordered_map<COutPoint, uint256, COutPointHasher> mapLockedInputs;
+    //! (nExpiration, txHash) of every lock in mapTxLocks, and of rejected requests that have no lock
+    std::set<std::pair<int64_t, uint256> > setLockExpirations;
+    //! (nExpiration, voteHash) of our own votes, which are not signatures of our locks
+    std::set<std::pair<int64_t, uint256> > setOwnVoteExpirations;
+    //! Time until which each masternode may not vote on unknown transactions, and the sum of those times.
+    //! Entries are never dropped: the old times of idle masternodes pull the average into the past,
+    //! which is what holds a masternode to about one unknown vote per 10 minutes.
+    boost::unordered_map<uint256, int64_t, BlockHasher> mapUnknownVotes;
+    int64_t nUnknownVotesTotal;
+    std::map<int, CRankCache> mapRankCache;
+
+    CTransactionLock& GetOrCreateLock(const uint256& txHash, int nBlockHeight);
+    void SetExpiration(CTransactionLock& lock, int64_t nExpiration);
+    //! Release the inputs locked by tx
+    void UnlockInputs(const CTransaction& tx);
+
+public:
+    CTxLockManager() : nUnknownVotesTotal(0) {}
+
+    bool HaveLockRequest(const uint256& txHash) const;
+    bool HaveRejectedLockRequest(const uint256& txHash) const;
+    bool GetLockRequest(const uint256& txHash, CTransaction& txRet) const;
+    void AddLockRequest(const CTransaction& tx);
+    //! Keep a rejected request for an hour, and lock its inputs unless they already are
+    void AddRejectedLockRequest(const CTransaction& tx);
+
+    bool HaveVote(const uint256& voteHash) const;
+    bool GetVote(const uint256& voteHash, CConsensusVote& voteRet) const;
+    //! Keep a vote that was accepted; false if it was already known
+    bool AddVote(const CConsensusVote& vote);
+    //! Keep a vote of our masternode for an hour; it does not count towards our own lock
+    void AddOwnVote(const CConsensusVote& vote);
+
+    //! Create the lock of a transaction, or move an existing one to nBlockHeight
+    void SetLockHeight(const uint256& txHash, int nBlockHeight);
+    //! Add a vote to its lock, creating the lock if needed; returns the lock's signature count
+    int AddSignature(const CConsensusVote& vote);
+    //! Signatures of a transaction's lock, -1 if it has none
+    int GetSignatures(const uint256& txHash) const;
+    bool IsLockTimedOut(const uint256& txHash) const;
+
+    //! Whether an input of tx is locked by another transaction, which is returned in hashLockRet
+    bool GetConflictingLock(const CTransaction& tx, uint256& hashLockRet) const;
+    //! Lock the inputs of tx that are not locked yet
+    void LockInputs(const CTransaction& tx);
+    //! If tx conflicts with another lock, expire both locks and return true
+    bool CheckForConflictingLocks(const CTransaction& tx);
+
+    //! Whether a masternode votes on unknown transactions faster than the network average
+    bool IsUnknownVoteSpam(const uint256& hashMasternode);
+    int64_t GetAverageVoteTime() const;
+
+    //! Rank among the masternodes that may vote on locks at nBlockHeight, -1 if unknown
+    int GetMasternodeRank(const CTxIn& vin, int nBlockHeight);
+
+    //! Remove the locks and requests that expired, with their votes and inputs, and our expired votes
+    void Clean(int64_t nNow);
+};
+
 
 #endif
@@ -5,8 +5,12 @@
 
 #include "sync.h"
 
+#include <algorithm>
+#include <chrono>
+#include <map>
 #include <memory>
 #include <set>
+#include <unordered_map>
 
 #include "util.h"
 #include "utilstrencodings.h"
@@ -193,3 +197,183 @@ void DeleteLock(void* cs)
 }
 
 #endif /* DEBUG_LOCKORDER */
+
+std::atomic<bool> g_profile_locks(false);
+
+int64_t LockProfileMicros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+namespace {
+/** A lock site by the addresses of its string literals, which are unique per site */
+struct LockSiteKey {
+    const char* pszName;
+    const char* pszFile;
+    int nLine;
+
+    bool operator==(const LockSiteKey& other) const { return pszName == other.pszName && pszFile == other.pszFile && nLine == other.nLine; }
+};
+
+struct LockSiteKeyHasher {
+    size_t operator()(const LockSiteKey& key) const
+    {
+        return std::hash<const void*>()(key.pszFile) ^ (std::hash<const void*>()(key.pszName) << 1) ^ ((size_t)key.nLine << 16);
+    }
+};
+
+typedef std::unordered_map<LockSiteKey, CLockSiteStats, LockSiteKeyHasher> LockSiteMap;
+
+/** The samples of one thread. Its mutex is only contended while the stats are read. */
+struct LockProfileBucket {
+    std::mutex mutex;
+    LockSiteMap mapSites;
+};
+
+/** The buckets of running threads, and the totals of threads that exited */
+struct LockProfileData {
+    std::mutex mutex;
+    std::set<LockProfileBucket*> setBuckets;
+    LockSiteMap mapRetired;
+};
+
+LockProfileData& GetLockProfileData()
+{
+    // Leaked, so threads that exit during shutdown can still retire their buckets
+    static LockProfileData* data = new LockProfileData();
+    return *data;
+}
+
+void AddLockSiteStats(CLockSiteStats& stats, const CLockSiteStats& other)
+{
+    stats.nLocks += other.nLocks;
+    stats.nContended += other.nContended;
+    stats.nWaitMicros += other.nWaitMicros;
+    stats.nMaxWaitMicros = std::max(stats.nMaxWaitMicros, other.nMaxWaitMicros);
+    stats.nHoldMicros += other.nHoldMicros;
+    stats.nMaxHoldMicros = std::max(stats.nMaxHoldMicros, other.nMaxHoldMicros);
+}
+
+void MergeLockSites(LockSiteMap& mapTo, const LockSiteMap& mapFrom)
+{
+    for (const auto& entry : mapFrom) {
+        auto it = mapTo.emplace(entry.first, CLockSiteStats()).first;
+        it->second.nLine = entry.first.nLine;
+        AddLockSiteStats(it->second, entry.second);
+    }
+}
+
+#if defined(HAVE_THREAD_LOCAL)
+static thread_local LockProfileBucket* g_lock_profile_bucket = nullptr;
+static thread_local bool g_lock_profile_exited = false;
+
+/** Registers the bucket of a thread, and folds it into the retired totals when the thread exits */
+class LockProfileBucketOwner
+{
+public:
+    LockProfileBucket bucket;
+
+    LockProfileBucketOwner()
+    {
+        LockProfileData& data = GetLockProfileData();
+        std::lock_guard<std::mutex> lock(data.mutex);
+        data.setBuckets.insert(&bucket);
+    }
+
+    ~LockProfileBucketOwner()
+    {
+        // Locks taken by later thread_local destructors are not counted
+        g_lock_profile_bucket = nullptr;
+        g_lock_profile_exited = true;
+        LockProfileData& data = GetLockProfileData();
+        std::lock_guard<std::mutex> lock(data.mutex);
+        data.setBuckets.erase(&bucket);
+        std::lock_guard<std::mutex> lockBucket(bucket.mutex);
+        MergeLockSites(data.mapRetired, bucket.mapSites);
+    }
+};
+
+LockProfileBucket* GetLockProfileBucket()
+{
+    if (!g_lock_profile_bucket && !g_lock_profile_exited) {
+        static thread_local LockProfileBucketOwner owner;
+        g_lock_profile_bucket = &owner.bucket;
+    }
+    return g_lock_profile_bucket;
+}
+#else
+/** Without thread_local, all threads share one bucket */
+LockProfileBucket* GetLockProfileBucket()
+{
+    static LockProfileBucket* bucket = [] {
+        LockProfileBucket* pbucket = new LockProfileBucket();
+        LockProfileData& data = GetLockProfileData();
+        std::lock_guard<std::mutex> lock(data.mutex);
+        data.setBuckets.insert(pbucket);
+        return pbucket;
+    }();
+    return bucket;
+}
+#endif
+} // namespace
+
+void ProfileLock(const char* pszName, const char* pszFile, int nLine, bool fContended, int64_t nWaitMicros, int64_t nHoldMicros)
+{
+    LockProfileBucket* pbucket = GetLockProfileBucket();
+    if (!pbucket)
+        return;
+    std::lock_guard<std::mutex> lock(pbucket->mutex);
+    CLockSiteStats& stats = pbucket->mapSites[LockSiteKey{pszName, pszFile, nLine}];
+    if (fContended) {
+        stats.nContended++;
+        stats.nWaitMicros += nWaitMicros;
+        stats.nMaxWaitMicros = std::max(stats.nMaxWaitMicros, nWaitMicros);
+    }
+    if (nHoldMicros >= 0) {
+        stats.nLocks++;
+        stats.nHoldMicros += nHoldMicros;
+        stats.nMaxHoldMicros = std::max(stats.nMaxHoldMicros, nHoldMicros);
+    }
+}
+
+std::vector<CLockSiteStats> GetLockStats()
+{
+    LockSiteMap mapSites;
+    {
+        LockProfileData& data = GetLockProfileData();
+        std::lock_guard<std::mutex> lock(data.mutex);
+        mapSites = data.mapRetired;
+        for (LockProfileBucket* pbucket : data.setBuckets) {
+            std::lock_guard<std::mutex> lockBucket(pbucket->mutex);
+            MergeLockSites(mapSites, pbucket->mapSites);
+        }
+    }
+
+    // The same site can show up under different literal addresses, e.g. from inlined
+    // functions in several translation units
+    std::map<std::pair<std::pair<std::string, std::string>, int>, CLockSiteStats> mapMerged;
+    for (const auto& entry : mapSites) {
+        CLockSiteStats& stats = mapMerged[std::make_pair(std::make_pair(std::string(entry.first.pszName), std::string(entry.first.pszFile)), entry.first.nLine)];
+        stats.strName = entry.first.pszName;
+        stats.strFile = entry.first.pszFile;
+        stats.nLine = entry.first.nLine;
+        AddLockSiteStats(stats, entry.second);
+    }
+
+    std::vector<CLockSiteStats> vStats;
+    vStats.reserve(mapMerged.size());
+    for (const auto& entry : mapMerged)
+        vStats.push_back(entry.second);
+    return vStats;
+}
+
+void ResetLockStats()
+{
+    LockProfileData& data = GetLockProfileData();
+    std::lock_guard<std::mutex> lock(data.mutex);
+    data.mapRetired.clear();
+    for (LockProfileBucket* pbucket : data.setBuckets) {
+        std::lock_guard<std::mutex> lockBucket(pbucket->mutex);
+        pbucket->mapSites.clear();
+    }
+}
@@ -9,9 +9,13 @@
 
 #include "threadsafety.h"
 
+#include <atomic>
 #include <condition_variable>
+#include <stdint.h>
+#include <string>
 #include <thread>
 #include <mutex>
+#include <vector>
 
 
 /////////////////////////////////////////////////
@@ -106,14 +110,70 @@ typedef std::unique_lock<std::mutex> WaitableLock;
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine);
 #endif
 
+/**
+ * Lock profiling, switched on at runtime. Each lock taken through the LOCK
+ * macros then records how long it waited and how long it was held, by lock
+ * name and site. Samples go to a table of the calling thread, the tables of
+ * all threads are merged by GetLockStats.
+ */
+extern std::atomic<bool> g_profile_locks;
+static const bool DEFAULT_PROFILE_LOCKS = false;
+
+/** Totals for one lock site */
+struct CLockSiteStats {
+    std::string strName;
+    std::string strFile;
+    int nLine;
+    //! Locks taken, and how many of them had to wait or were failed TRY_LOCKs
+    uint64_t nLocks;
+    uint64_t nContended;
+    int64_t nWaitMicros;
+    int64_t nMaxWaitMicros;
+    int64_t nHoldMicros;
+    int64_t nMaxHoldMicros;
+
+    CLockSiteStats() : nLine(0), nLocks(0), nContended(0), nWaitMicros(0), nMaxWaitMicros(0), nHoldMicros(0), nMaxHoldMicros(0) {}
+};
+
+int64_t LockProfileMicros();
+//! Record a lock that was released after nHoldMicros, or a failed TRY_LOCK if nHoldMicros is negative
+void ProfileLock(const char* pszName, const char* pszFile, int nLine, bool fContended, int64_t nWaitMicros, int64_t nHoldMicros);
+std::vector<CLockSiteStats> GetLockStats();
+void ResetLockStats();
+
 /** Wrapper around std::unique_lock style lock for Mutex. */
 template <typename Mutex, typename Base = typename Mutex::UniqueLock>
 class SCOPED_LOCKABLE UniqueLock  : public Base
 {
 private:
+    //! Site of the lock while it is profiled, NULL otherwise
+    const char* pszProfileName = nullptr;
+    const char* pszProfileFile = nullptr;
+    int nProfileLine = 0;
+    bool fProfileContended = false;
+    int64_t nProfileWait = 0;
+    int64_t nProfileStart = 0;
+
+    void EnterProfiled(const char* pszName, const char* pszFile, int nLine)
+    {
+        int64_t nStart = LockProfileMicros();
+        fProfileContended = !Base::try_lock();
+        if (fProfileContended)
+            Base::lock();
+        nProfileStart = LockProfileMicros();
+        nProfileWait = nProfileStart - nStart;
+        pszProfileName = pszName;
+        pszProfileFile = pszFile;
+        nProfileLine = nLine;
+    }
+
     void Enter(const char* pszName, const char* pszFile, int nLine)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(Base::mutex()));
+        if (g_profile_locks.load(std::memory_order_relaxed)) {
+            EnterProfiled(pszName, pszFile, nLine);
+            return;
+        }
 #ifdef DEBUG_LOCKCONTENTION
         if (!Base::try_lock()) {
             PrintLockContention(pszName, pszFile, nLine);
@@ -130,6 +190,16 @@ private:
         Base::try_lock();
         if (!Base::owns_lock())
             LeaveCritical();
+        if (g_profile_locks.load(std::memory_order_relaxed)) {
+            if (Base::owns_lock()) {
+                nProfileStart = LockProfileMicros();
+                pszProfileName = pszName;
+                pszProfileFile = pszFile;
+                nProfileLine = nLine;
+            } else {
+                ProfileLock(pszName, pszFile, nLine, true, 0, -1);
+            }
+        }
         return Base::owns_lock();
     }
 
@@ -155,8 +225,15 @@ public:
 
     ~UniqueLock() UNLOCK_FUNCTION()
     {
-        if (Base::owns_lock())
+        if (Base::owns_lock()) {
             LeaveCritical();
+            if (pszProfileFile) {
+                // Record once the mutex is free, so profiling does not lengthen the hold it measures
+                int64_t nHold = LockProfileMicros() - nProfileStart;
+                Base::unlock();
+                ProfileLock(pszProfileName, pszProfileFile, nProfileLine, fProfileContended, nProfileWait, nHold);
+            }
+        }
     }
 
     operator bool()
@@ -9,6 +9,7 @@
 
 
 
+#include "blockencodings.h"
 #include "keystore.h"
 #include "main.h"
 #include "net.h"
@@ -35,6 +36,8 @@ struct COrphanTx {
 };
 extern std::map<uint256, COrphanTx> mapOrphanTransactions;
 extern std::map<uint256, std::set<uint256> > mapOrphanTransactionsByPrev;
+extern void MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, CBlockIndex* pindex);
+extern bool ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vRecv, int64_t nTimeReceived);
 
 CService ip(uint32_t i)
 {
@@ -198,4 +201,37 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
     BOOST_CHECK(mapOrphanTransactionsByPrev.empty());
 }
 
+BOOST_AUTO_TEST_CASE(DoS_cmpctblock_unknown_parent)
+{
+    CAddress addr(ip(0xa0b0c003));
+    CNode dummyNode(INVALID_SOCKET, addr, "", true);
+    dummyNode.nVersion = 1;
+
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig.resize(10);
+    tx.vout.resize(1);
+    CBlock block;
+    block.vtx.push_back(tx);
+    block.hashPrevBlock = GetRandHash();
+    CBlockHeaderAndShortTxIDs cmpctblock(block);
+
+    // Requested as a compact block, answered with one we cannot connect
+    {
+        LOCK(cs_main);
+        MarkBlockAsInFlight(dummyNode.GetId(), block.GetHash(), NULL);
+    }
+    CNodeStateStats stats;
+    BOOST_CHECK(GetNodeStateStats(dummyNode.GetId(), stats));
+    BOOST_CHECK_EQUAL(stats.nBlocksInFlight, 1);
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << cmpctblock;
+    BOOST_CHECK(ProcessMessage(&dummyNode, "cmpctblock", ss, GetTimeMicros()));
+
+    // The full block is asked for instead, and the compact request no longer holds the download slot
+    BOOST_CHECK(GetNodeStateStats(dummyNode.GetId(), stats));
+    BOOST_CHECK_EQUAL(stats.nBlocksInFlight, 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,110 @@
+// Copyright (c) 2020 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "main.h"
+#include "key.h"
+#include "script/standard.h"
+#include "txdb.h"
+#include "test/test_yoda.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(addressindex_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(indexes_follow_connect_and_disconnect)
+{
+    fAddressIndex = fSpentIndex = fTimestampIndex = true;
+
+    CKey keyFrom, keyTo;
+    keyFrom.MakeNewKey(true);
+    keyTo.MakeNewKey(true);
+    uint160 hashFrom = keyFrom.GetPubKey().GetID();
+    uint160 hashTo = keyTo.GetPubKey().GetID();
+
+    // An output to keyFrom confirmed at height 10, spent to keyTo at height 11
+    CMutableTransaction txPrev;
+    txPrev.vout.resize(1);
+    txPrev.vout[0].nValue = 5 * COIN;
+    txPrev.vout[0].scriptPubKey = GetScriptForDestination(keyFrom.GetPubKey().GetID());
+    CMutableTransaction txSpend;
+    txSpend.vin.resize(1);
+    txSpend.vin[0].prevout = COutPoint(txPrev.GetHash(), 0);
+    txSpend.vout.resize(1);
+    txSpend.vout[0].nValue = 4 * COIN;
+    txSpend.vout[0].scriptPubKey = GetScriptForDestination(keyTo.GetPubKey().GetID());
+    const CTransaction tx(txSpend);
+
+    CCoinsView viewDummy;
+    CCoinsViewCache view(&viewDummy);
+    *view.ModifyCoins(txPrev.GetHash()) = CCoins(txPrev, 10);
+
+    CBlockIndex index;
+    uint256 hashBlock = GetRandHash();
+    index.phashBlock = &hashBlock;
+    index.nHeight = 11;
+    index.nTime = 1500000000;
+
+    CBlockIndexEntries connectEntries;
+    AddConnectIndexEntries(tx, view, index.nHeight, 1, connectEntries);
+    BOOST_CHECK(WriteBlockIndexEntries(connectEntries, &index));
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vAddressIndex;
+    BOOST_CHECK(pblocktree->ReadAddressIndex(hashFrom, ADDRESS_INDEX_PUBKEYHASH, vAddressIndex));
+    BOOST_CHECK_EQUAL(vAddressIndex.size(), 1U);
+    BOOST_CHECK(vAddressIndex[0].first.spending);
+    BOOST_CHECK_EQUAL(vAddressIndex[0].second, -5 * COIN);
+    vAddressIndex.clear();
+    BOOST_CHECK(pblocktree->ReadAddressIndex(hashTo, ADDRESS_INDEX_PUBKEYHASH, vAddressIndex));
+    BOOST_CHECK_EQUAL(vAddressIndex.size(), 1U);
+    BOOST_CHECK_EQUAL(vAddressIndex[0].second, 4 * COIN);
+
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vUnspent;
+    BOOST_CHECK(pblocktree->ReadAddressUnspentIndex(hashTo, ADDRESS_INDEX_PUBKEYHASH, vUnspent));
+    BOOST_CHECK_EQUAL(vUnspent.size(), 1U);
+    BOOST_CHECK(vUnspent[0].first.txhash == tx.GetHash());
+    BOOST_CHECK_EQUAL(vUnspent[0].second.blockHeight, 11);
+
+    CSpentIndexValue spent;
+    BOOST_CHECK(pblocktree->ReadSpentIndex(CSpentIndexKey(txPrev.GetHash(), 0), spent));
+    BOOST_CHECK(spent.txid == tx.GetHash());
+    BOOST_CHECK_EQUAL(spent.blockHeight, 11);
+    BOOST_CHECK_EQUAL(spent.satoshis, 5 * COIN);
+
+    std::vector<uint256> vHashes;
+    BOOST_CHECK(pblocktree->ReadTimestampIndex(index.nTime + 1, index.nTime, vHashes));
+    BOOST_CHECK_EQUAL(vHashes.size(), 1U);
+    BOOST_CHECK(vHashes[0] == hashBlock);
+
+    // Disconnecting undoes all of it and gives the spent output back to keyFrom
+    CBlockIndexEntries disconnectEntries;
+    AddDisconnectIndexEntries(tx, view, index.nHeight, 1, disconnectEntries);
+    BOOST_CHECK(EraseBlockIndexEntries(disconnectEntries, &index));
+
+    vAddressIndex.clear();
+    BOOST_CHECK(pblocktree->ReadAddressIndex(hashFrom, ADDRESS_INDEX_PUBKEYHASH, vAddressIndex));
+    BOOST_CHECK(vAddressIndex.empty());
+    BOOST_CHECK(pblocktree->ReadAddressIndex(hashTo, ADDRESS_INDEX_PUBKEYHASH, vAddressIndex));
+    BOOST_CHECK(vAddressIndex.empty());
+
+    vUnspent.clear();
+    BOOST_CHECK(pblocktree->ReadAddressUnspentIndex(hashTo, ADDRESS_INDEX_PUBKEYHASH, vUnspent));
+    BOOST_CHECK(vUnspent.empty());
+    BOOST_CHECK(pblocktree->ReadAddressUnspentIndex(hashFrom, ADDRESS_INDEX_PUBKEYHASH, vUnspent));
+    BOOST_CHECK_EQUAL(vUnspent.size(), 1U);
+    BOOST_CHECK(vUnspent[0].first.txhash == txPrev.GetHash());
+    BOOST_CHECK_EQUAL(vUnspent[0].second.satoshis, 5 * COIN);
+    BOOST_CHECK_EQUAL(vUnspent[0].second.blockHeight, 10);
+
+    BOOST_CHECK(!pblocktree->ReadSpentIndex(CSpentIndexKey(txPrev.GetHash(), 0), spent));
+
+    vHashes.clear();
+    BOOST_CHECK(pblocktree->ReadTimestampIndex(index.nTime + 1, index.nTime, vHashes));
+    BOOST_CHECK(vHashes.empty());
+
+    fAddressIndex = DEFAULT_ADDRESSINDEX;
+    fSpentIndex = DEFAULT_SPENTINDEX;
+    fTimestampIndex = DEFAULT_TIMESTAMPINDEX;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,97 @@
+// Copyright (c) 2020 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blocktiming.h"
+#include "test/test_yoda.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blocktiming_tests, BasicTestingSetup)
+
+static CBlockTimingRecord MakeRecord(int n)
+{
+    CBlockTimingRecord record;
+    record.hash = uint256(n);
+    record.nHeight = n;
+    record.Add(BLOCKSTAGE_CONNECT_TIP, n * 1000);
+    return record;
+}
+
+BOOST_AUTO_TEST_CASE(blocktiming_ring)
+{
+    CBlockTimingLog log(3);
+    for (int i = 1; i <= 5; i++)
+        log.Add(MakeRecord(i));
+    BOOST_CHECK_EQUAL(log.GetBlockCount(), 5U);
+
+    // Only the last three are kept, oldest first
+    std::vector<CBlockTimingRecord> vRecords = log.GetRecords();
+    BOOST_CHECK_EQUAL(vRecords.size(), 3U);
+    for (size_t i = 0; i < vRecords.size(); i++)
+        BOOST_CHECK_EQUAL(vRecords[i].nHeight, (int)i + 3);
+
+    // But the histograms count every block
+    std::vector<CStageHistogram> vHistograms;
+    log.GetHistograms(vHistograms);
+    BOOST_CHECK_EQUAL(vHistograms[BLOCKSTAGE_CONNECT_TIP].nCount, 5U);
+    BOOST_CHECK_EQUAL(vHistograms[BLOCKSTAGE_CONNECT_TIP].nMaxMicros, 5000);
+    BOOST_CHECK_EQUAL(vHistograms[BLOCKSTAGE_CHECK_BLOCK].nCount, 0U);
+}
+
+BOOST_AUTO_TEST_CASE(blocktiming_pending_and_late)
+{
+    CBlockTimingLog log(10);
+    log.AddPending(uint256(1), BLOCKSTAGE_CHECK_BLOCK, 100);
+    log.AddPending(uint256(1), BLOCKSTAGE_CHECK_BLOCK, 50);
+    log.AddPending(uint256(2), BLOCKSTAGE_CHECK_STAKE, 70);
+    log.Add(MakeRecord(1));
+    log.AddLate(uint256(1), BLOCKSTAGE_CB_UPDATED_BLOCK_TIP, 30);
+    // Not connected, so not logged
+    log.AddLate(uint256(3), BLOCKSTAGE_CB_UPDATED_BLOCK_TIP, 30);
+
+    std::vector<CBlockTimingRecord> vRecords = log.GetRecords();
+    BOOST_CHECK_EQUAL(vRecords.size(), 1U);
+    BOOST_CHECK_EQUAL(vRecords[0].vStageMicros[BLOCKSTAGE_CHECK_BLOCK], 150);
+    BOOST_CHECK_EQUAL(vRecords[0].vStageMicros[BLOCKSTAGE_CHECK_STAKE], -1);
+    BOOST_CHECK_EQUAL(vRecords[0].vStageMicros[BLOCKSTAGE_CB_UPDATED_BLOCK_TIP], 30);
+
+    std::vector<CStageHistogram> vHistograms;
+    log.GetHistograms(vHistograms);
+    BOOST_CHECK_EQUAL(vHistograms[BLOCKSTAGE_CB_UPDATED_BLOCK_TIP].nCount, 1U);
+    BOOST_CHECK_EQUAL(vHistograms[BLOCKSTAGE_CHECK_STAKE].nCount, 0U);
+}
+
+BOOST_AUTO_TEST_CASE(blocktiming_pending_evicts_oldest)
+{
+    // Blocks that are never connected make room for newer ones, one at a time
+    CBlockTimingLog log(10);
+    for (int i = 1; i <= 257; i++)
+        log.AddPending(uint256(i), BLOCKSTAGE_CHECK_BLOCK, i);
+    log.Add(MakeRecord(1));
+    log.Add(MakeRecord(2));
+    log.Add(MakeRecord(257));
+
+    std::vector<CBlockTimingRecord> vRecords = log.GetRecords();
+    BOOST_CHECK_EQUAL(vRecords.size(), 3U);
+    BOOST_CHECK_EQUAL(vRecords[0].vStageMicros[BLOCKSTAGE_CHECK_BLOCK], -1);
+    BOOST_CHECK_EQUAL(vRecords[1].vStageMicros[BLOCKSTAGE_CHECK_BLOCK], 2);
+    BOOST_CHECK_EQUAL(vRecords[2].vStageMicros[BLOCKSTAGE_CHECK_BLOCK], 257);
+}
+
+BOOST_AUTO_TEST_CASE(blocktiming_histogram)
+{
+    CStageHistogram histogram;
+    BOOST_CHECK_EQUAL(histogram.Percentile(0.5), 0);
+    for (int i = 0; i < 90; i++)
+        histogram.Add(100);
+    for (int i = 0; i < 10; i++)
+        histogram.Add(10000);
+    // Percentiles are bucket bounds, capped at the maximum
+    BOOST_CHECK_EQUAL(histogram.Percentile(0.5), 128);
+    BOOST_CHECK_EQUAL(histogram.Percentile(0.9), 128);
+    BOOST_CHECK_EQUAL(histogram.Percentile(0.99), 10000);
+    BOOST_CHECK_EQUAL(histogram.nTotalMicros, 90 * 100 + 10 * 10000);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -9,6 +9,7 @@
 #include "clientversion.h"
 #include "key.h"
 #include "merkleblock.h"
+#include "mruset.h"
 #include "serialize.h"
 #include "streams.h"
 #include "uint256.h"
@@ -197,7 +198,7 @@ BOOST_AUTO_TEST_CASE(merkle_block_1)
     BOOST_CHECK(merkleBlock.header.GetHash() == block.GetHash());
 
     BOOST_CHECK(merkleBlock.vMatchedTxn.size() == 1);
-    pair<unsigned int, uint256> pair = merkleBlock.vMatchedTxn[0];
+    std::pair<unsigned int, uint256> pair = merkleBlock.vMatchedTxn[0];
 
     BOOST_CHECK(merkleBlock.vMatchedTxn[0].second == uint256("0x74d681e0e03bafa802c8aa084379aa98d9fcd632ddc2ed9782b586ec87451f20"));
     BOOST_CHECK(merkleBlock.vMatchedTxn[0].first == 8);
@@ -242,7 +243,7 @@ BOOST_AUTO_TEST_CASE(merkle_block_2)
     BOOST_CHECK(merkleBlock.header.GetHash() == block.GetHash());
 
     BOOST_CHECK(merkleBlock.vMatchedTxn.size() == 1);
-    pair<unsigned int, uint256> pair = merkleBlock.vMatchedTxn[0];
+    std::pair<unsigned int, uint256> pair = merkleBlock.vMatchedTxn[0];
 
     BOOST_CHECK(merkleBlock.vMatchedTxn[0].second == uint256("0xe980fe9f792d014e73b95203dc1335c5f9ce19ac537a419e6df5b47aecb93b70"));
     BOOST_CHECK(merkleBlock.vMatchedTxn[0].first == 0);
@@ -296,7 +297,7 @@ BOOST_AUTO_TEST_CASE(merkle_block_2_with_update_none)
     BOOST_CHECK(merkleBlock.header.GetHash() == block.GetHash());
 
     BOOST_CHECK(merkleBlock.vMatchedTxn.size() == 1);
-    pair<unsigned int, uint256> pair = merkleBlock.vMatchedTxn[0];
+    std::pair<unsigned int, uint256> pair = merkleBlock.vMatchedTxn[0];
 
     BOOST_CHECK(merkleBlock.vMatchedTxn[0].second == uint256("0xe980fe9f792d014e73b95203dc1335c5f9ce19ac537a419e6df5b47aecb93b70"));
     BOOST_CHECK(merkleBlock.vMatchedTxn[0].first == 0);
@@ -385,7 +386,7 @@ BOOST_AUTO_TEST_CASE(merkle_block_4)
     BOOST_CHECK(merkleBlock.header.GetHash() == block.GetHash());
 
     BOOST_CHECK(merkleBlock.vMatchedTxn.size() == 1);
-    pair<unsigned int, uint256> pair = merkleBlock.vMatchedTxn[0];
+    std::pair<unsigned int, uint256> pair = merkleBlock.vMatchedTxn[0];
 
     BOOST_CHECK(merkleBlock.vMatchedTxn[0].second == uint256("0x0a2a92f0bda4727d0a13eaddf4dd9ac6b5c61a1429e6b2b818f19b15df0ac154"));
     BOOST_CHECK(merkleBlock.vMatchedTxn[0].first == 6);
@@ -459,4 +460,87 @@ BOOST_AUTO_TEST_CASE(merkle_block_4_test_update_none)
     BOOST_CHECK(!filter.contains(COutPoint(uint256("0x02981fa052f0481dbc5868f4fc2166035a10f27a03cfd2de67326471df5bc041"), 0)));
 }
 
+BOOST_AUTO_TEST_CASE(rolling_bloom)
+{
+    // Last-100-entry, 1% false positive CRollingBloomFilter
+    CRollingBloomFilter rb1(100, 0.01);
+
+    // Overfill
+    std::vector<uint256> vHashes;
+    for (int i = 0; i < 399; i++) {
+        uint256 hash = InsecureRand256();
+        vHashes.push_back(hash);
+        rb1.insert(hash);
+        BOOST_CHECK(rb1.contains(hash));
+    }
+
+    // The last 100 inserted are always present, anything older than two full windows is forgotten
+    for (int i = 299; i < 399; i++)
+        BOOST_CHECK(rb1.contains(vHashes[i]));
+    int nOldHits = 0;
+    for (int i = 0; i < 199; i++)
+        if (rb1.contains(vHashes[i])) ++nOldHits;
+    BOOST_CHECK(nOldHits <= 10);
+
+    // Random hashes should hit roughly 1% of the time
+    int nHits = 0;
+    for (int i = 0; i < 10000; i++)
+        if (rb1.contains(InsecureRand256())) ++nHits;
+    BOOST_CHECK(nHits <= 200);
+
+    // reset() forgets everything
+    rb1.reset();
+    nHits = 0;
+    for (int i = 299; i < 399; i++)
+        if (rb1.contains(vHashes[i])) ++nHits;
+    BOOST_CHECK_EQUAL(nHits, 0);
+
+    // A tiny false positive rate still gives a usable filter
+    CRollingBloomFilter rb2(1000, 0.000001);
+    for (int i = 0; i < 1000; i++)
+        rb2.insert(vHashes[i % vHashes.size()]);
+    for (int i = 0; i < 399; i++)
+        BOOST_CHECK(rb2.contains(vHashes[i]));
+    nHits = 0;
+    for (int i = 0; i < 10000; i++)
+        if (rb2.contains(InsecureRand256())) ++nHits;
+    BOOST_CHECK(nHits <= 2);
+}
+
+// The rolling filter replaces mruset for known-inventory tracking: it must never forget
+// anything an mruset of the same size would still remember, and should stay much smaller
+BOOST_AUTO_TEST_CASE(rolling_bloom_vs_mruset)
+{
+    const unsigned int nWindow = 1000;
+    CRollingBloomFilter filter(nWindow, 0.000001);
+    mruset<CInv> setKnown(nWindow);
+
+    std::vector<CInv> vInv;
+    for (unsigned int i = 0; i < 5 * nWindow; i++) {
+        CInv inv(i % 3 ? MSG_TX : MSG_BLOCK, InsecureRand256());
+        vInv.push_back(inv);
+        filter.insert(inv.GetKey());
+        setKnown.insert(inv);
+        if (i % 97 == 0) {
+            for (const CInv& invKnown : vInv)
+                if (setKnown.count(invKnown))
+                    BOOST_CHECK(filter.contains(invKnown.GetKey()));
+        }
+    }
+    for (const CInv& inv : vInv)
+        if (setKnown.count(inv))
+            BOOST_CHECK(filter.contains(inv.GetKey()));
+
+    // The type is part of the key, a tx being known does not make its lock request known
+    CRollingBloomFilter filterTypes(10, 0.000001);
+    CInv invTx(MSG_TX, vInv.back().hash);
+    CInv invLock(MSG_TXLOCK_REQUEST, vInv.back().hash);
+    filterTypes.insert(invTx.GetKey());
+    BOOST_CHECK(filterTypes.contains(invTx.GetKey()));
+    BOOST_CHECK(!filterTypes.contains(invLock.GetKey()));
+
+    // mruset keeps a std::set node and a deque slot per entry, the filter a fixed bit array
+    BOOST_CHECK(filter.DynamicMemoryUsage() < nWindow * (sizeof(CInv) * 2 + 32));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -2,7 +2,9 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "clientversion.h"
 #include "masternode-budget.h"
+#include "streams.h"
 #include "tinyformat.h"
 #include "utilmoneystr.h"
 #include "test_yoda.h"
@@ -30,4 +32,57 @@ BOOST_AUTO_TEST_CASE(budget_value)
     CheckBudgetValue(nHeightTest, "mainnet", 43200*COIN);
 }
 
+static CBudgetVote MakeVote(unsigned int nVoter, int nVote)
+{
+    return CBudgetVote(CTxIn(COutPoint(uint256(nVoter), 0)), uint256(1), nVote);
+}
+
+static void CheckTallies(const CBudgetProposal& proposal, int nYeas, int nNays, int nAbstains)
+{
+    BOOST_CHECK_EQUAL(proposal.GetYeas(), nYeas);
+    BOOST_CHECK_EQUAL(proposal.GetNays(), nNays);
+    BOOST_CHECK_EQUAL(proposal.GetAbstains(), nAbstains);
+}
+
+BOOST_AUTO_TEST_CASE(budget_vote_tallies)
+{
+    CBudgetProposal proposal;
+    std::string strError;
+    CheckTallies(proposal, 0, 0, 0);
+    BOOST_CHECK_EQUAL(proposal.GetRatio(), 0.0);
+
+    CBudgetVote vote1 = MakeVote(1, VOTE_YES);
+    CBudgetVote vote2 = MakeVote(2, VOTE_YES);
+    CBudgetVote vote3 = MakeVote(3, VOTE_NO);
+    CBudgetVote vote4 = MakeVote(4, VOTE_ABSTAIN);
+    BOOST_CHECK(proposal.AddOrUpdateVote(vote1, strError));
+    BOOST_CHECK(proposal.AddOrUpdateVote(vote2, strError));
+    BOOST_CHECK(proposal.AddOrUpdateVote(vote3, strError));
+    BOOST_CHECK(proposal.AddOrUpdateVote(vote4, strError));
+    CheckTallies(proposal, 2, 1, 1);
+    BOOST_CHECK_CLOSE(proposal.GetRatio(), 2.0 / 3.0, 0.0001);
+
+    // Updating a vote too soon changes nothing, later it moves the vote
+    CBudgetVote vote2No = MakeVote(2, VOTE_NO);
+    BOOST_CHECK(!proposal.AddOrUpdateVote(vote2No, strError));
+    CheckTallies(proposal, 2, 1, 1);
+    vote2No.nTime = vote2.nTime + BUDGET_VOTE_UPDATE_MIN;
+    BOOST_CHECK(proposal.AddOrUpdateVote(vote2No, strError));
+    CheckTallies(proposal, 1, 2, 1);
+
+    // The tallies survive a copy and a round trip through serialization
+    CheckTallies(CBudgetProposal(proposal), 1, 2, 1);
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << proposal;
+    CBudgetProposal proposalRead;
+    ss >> proposalRead;
+    CheckTallies(proposalRead, 1, 2, 1);
+
+    // None of the voters is a known masternode, so their votes expire. The
+    // ratio counts expired votes too.
+    proposal.CleanAndRemove();
+    CheckTallies(proposal, 0, 0, 0);
+    BOOST_CHECK_CLOSE(proposal.GetRatio(), 1.0 / 3.0, 0.0001);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,96 @@
+// Copyright (c) 2020 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "checkqueue.h"
+#include "test/test_yoda.h"
+
+#include <atomic>
+
+#include <boost/thread.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(checkqueue_tests, BasicTestingSetup)
+
+static const unsigned int QUEUE_BATCH_SIZE = 128;
+static const int QUEUE_WORKERS = 3;
+
+struct FakeCheck {
+    static std::atomic<unsigned int> nChecked;
+    bool fOk;
+
+    FakeCheck(bool fOkIn = true) : fOk(fOkIn) {}
+    bool operator()()
+    {
+        nChecked++;
+        return fOk;
+    }
+    void swap(FakeCheck& x) { std::swap(fOk, x.fOk); }
+};
+std::atomic<unsigned int> FakeCheck::nChecked(0);
+
+/** Run nBatches batches of 0 to 9 checks through the queue, one failing if nFail is reached */
+static bool RunBatches(CCheckQueue<FakeCheck>& queue, unsigned int nBatches, unsigned int nFail, unsigned int& nTotal)
+{
+    CCheckQueueControl<FakeCheck> control(&queue);
+    nTotal = 0;
+    for (unsigned int i = 0; i < nBatches; i++) {
+        std::vector<FakeCheck> vChecks;
+        for (unsigned int j = 0; j < i % 10; j++)
+            vChecks.emplace_back(nTotal++ != nFail);
+        control.Add(vChecks);
+    }
+    return control.Wait();
+}
+
+BOOST_AUTO_TEST_CASE(checkqueue_all_ok)
+{
+    CCheckQueue<FakeCheck> queue(QUEUE_BATCH_SIZE, QUEUE_WORKERS);
+    boost::thread_group threads;
+    for (int i = 0; i < QUEUE_WORKERS; i++)
+        threads.create_thread(boost::bind(&CCheckQueue<FakeCheck>::Thread, &queue));
+
+    // Every check runs exactly once, and the queue can be reused right away
+    for (unsigned int nBatches : {0, 1, 10, 1000, 20000}) {
+        FakeCheck::nChecked = 0;
+        unsigned int nTotal;
+        BOOST_CHECK(RunBatches(queue, nBatches, (unsigned int)-1, nTotal));
+        BOOST_CHECK_EQUAL(FakeCheck::nChecked, nTotal);
+        BOOST_CHECK(queue.IsIdle());
+    }
+
+    threads.interrupt_all();
+    threads.join_all();
+}
+
+BOOST_AUTO_TEST_CASE(checkqueue_failure)
+{
+    CCheckQueue<FakeCheck> queue(QUEUE_BATCH_SIZE, QUEUE_WORKERS);
+    boost::thread_group threads;
+    for (int i = 0; i < QUEUE_WORKERS; i++)
+        threads.create_thread(boost::bind(&CCheckQueue<FakeCheck>::Thread, &queue));
+
+    for (unsigned int nFail : {0, 1, 777, 4499}) {
+        unsigned int nTotal;
+        BOOST_CHECK(!RunBatches(queue, 1000, nFail, nTotal));
+        // A failure does not stick to the next block
+        BOOST_CHECK(queue.IsIdle());
+        BOOST_CHECK(RunBatches(queue, 100, (unsigned int)-1, nTotal));
+    }
+
+    threads.interrupt_all();
+    threads.join_all();
+}
+
+BOOST_AUTO_TEST_CASE(checkqueue_no_workers)
+{
+    // The master alone must get through everything it added
+    CCheckQueue<FakeCheck> queue(QUEUE_BATCH_SIZE, QUEUE_WORKERS);
+    FakeCheck::nChecked = 0;
+    unsigned int nTotal;
+    BOOST_CHECK(RunBatches(queue, 1000, (unsigned int)-1, nTotal));
+    BOOST_CHECK_EQUAL(FakeCheck::nChecked, nTotal);
+    BOOST_CHECK(!RunBatches(queue, 1000, 5, nTotal));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -4,7 +4,9 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "coins.h"
+#include "hash.h"
 #include "script/standard.h"
+#include "txdb.h"
 #include "uint256.h"
 #include "utilstrencodings.h"
 #include "test/test_yoda.h"
@@ -12,6 +14,7 @@
 #include <vector>
 #include <map>
 
+#include <boost/scoped_ptr.hpp>
 #include <boost/test/unit_test.hpp>
 
 namespace
@@ -61,6 +64,54 @@ public:
 
     bool GetStats(CCoinsStats& stats) const { return false; }
 };
+
+//! In-memory coin database that can also be scanned the way GetStats did before it was parallelized
+class CCoinsViewDBSerial : public CCoinsViewDB
+{
+public:
+    CCoinsViewDBSerial() : CCoinsViewDB(1 << 20, true) {}
+
+    void GetStatsSerial(CCoinsStats& stats)
+    {
+        boost::scoped_ptr<leveldb::Iterator> pcursor(db.NewIterator());
+        pcursor->SeekToFirst();
+
+        CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+        stats.hashBlock = GetBestBlock();
+        ss << stats.hashBlock;
+        for (; pcursor->Valid(); pcursor->Next()) {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            char chType;
+            ssKey >> chType;
+            if (chType != 'c')
+                continue;
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+            CCoins coins;
+            ssValue >> coins;
+            uint256 txhash;
+            ssKey >> txhash;
+            ss << txhash;
+            ss << VARINT(coins.nVersion);
+            ss << (coins.fCoinBase ? 'c' : 'n');
+            ss << VARINT(coins.nHeight);
+            stats.nTransactions++;
+            for (unsigned int i = 0; i < coins.vout.size(); i++) {
+                const CTxOut& out = coins.vout[i];
+                if (!out.IsNull()) {
+                    stats.nTransactionOutputs++;
+                    ss << VARINT(i + 1);
+                    ss << out;
+                    stats.nTotalAmount += out.nValue;
+                }
+            }
+            stats.nSerializedSize += 32 + slValue.size();
+            ss << VARINT(0);
+        }
+        stats.hashSerialized = ss.GetHash();
+    }
+};
 }
 
 BOOST_FIXTURE_TEST_SUITE(coins_tests, BasicTestingSetup)
@@ -247,4 +298,49 @@ BOOST_AUTO_TEST_CASE(ccoins_serialization)
     }
 }
 
+BOOST_FIXTURE_TEST_CASE(coins_stats_parallel_scan, TestingSetup)
+{
+    CCoinsViewDBSerial view;
+
+    CCoinsMap mapCoins;
+    for (int i = 0; i < 2000; i++) {
+        CCoinsCacheEntry& entry = mapCoins[InsecureRand256()];
+        entry.flags = CCoinsCacheEntry::DIRTY;
+        entry.coins.nVersion = 1;
+        entry.coins.fCoinBase = InsecureRandBool();
+        entry.coins.nHeight = InsecureRandRange(1000000);
+        entry.coins.vout.resize(1 + InsecureRandRange(4));
+        for (unsigned int n = 0; n < entry.coins.vout.size(); n++) {
+            if (n > 0 && InsecureRandRange(3) == 0)
+                continue; // spent, left null
+            entry.coins.vout[n].nValue = InsecureRandRange(100000000);
+            entry.coins.vout[n].scriptPubKey = GetScriptForDestination(CKeyID(uint160(InsecureRandBytes(20))));
+        }
+    }
+    BOOST_CHECK(view.BatchWrite(mapCoins, InsecureRand256()));
+
+    CCoinsStats statsSerial;
+    view.GetStatsSerial(statsSerial);
+    BOOST_CHECK_EQUAL(statsSerial.nTransactions, 2000U);
+
+    const int vThreads[] = {1, 3, MAX_STATS_SCAN_THREADS};
+    for (int nThreads : vThreads) {
+        CCoinsStats stats;
+        BOOST_CHECK(view.ScanStats(stats, nThreads));
+        BOOST_CHECK(stats.hashBlock == statsSerial.hashBlock);
+        BOOST_CHECK(stats.hashSerialized == statsSerial.hashSerialized);
+        BOOST_CHECK_EQUAL(stats.nTransactions, statsSerial.nTransactions);
+        BOOST_CHECK_EQUAL(stats.nTransactionOutputs, statsSerial.nTransactionOutputs);
+        BOOST_CHECK_EQUAL(stats.nSerializedSize, statsSerial.nSerializedSize);
+        BOOST_CHECK_EQUAL(stats.nTotalAmount, statsSerial.nTotalAmount);
+    }
+
+    // Served from the cache the second time, for the same best block
+    CCoinsStats stats1, stats2;
+    BOOST_CHECK(view.GetStats(stats1));
+    BOOST_CHECK(view.GetStats(stats2));
+    BOOST_CHECK(stats1.hashSerialized == statsSerial.hashSerialized);
+    BOOST_CHECK(stats2.hashSerialized == statsSerial.hashSerialized);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,110 @@
+// Copyright (c) 2020 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "cuckoocache.h"
+#include "test/test_yoda.h"
+#include "uint256.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(cuckoocache_tests, BasicTestingSetup)
+
+/** Same as the signature cache: random keys, so their bytes are the hashes */
+struct RandomHasher {
+    template <uint8_t hash_select>
+    uint32_t operator()(const uint256& key) const
+    {
+        uint32_t u;
+        std::memcpy(&u, key.begin() + 4 * hash_select, 4);
+        return u;
+    }
+};
+
+typedef CuckooCache::cache<uint256, RandomHasher> TestCache;
+
+/** Fraction of the last inserted elements that can still be found, after filling a cache to load times its size */
+static double HitRate(double load, bool fErase)
+{
+    SeedInsecureRand(true);
+    TestCache cache;
+    const size_t nSize = cache.setup_bytes(1 << 20);
+    std::vector<uint256> vInserted;
+    for (size_t i = 0; i < nSize * load; i++) {
+        vInserted.push_back(InsecureRand256());
+        cache.insert(vInserted.back());
+        // Erase half of everything right away, like confirmed signatures
+        if (fErase && i % 2 == 0)
+            cache.contains(vInserted.back(), true);
+    }
+    size_t nFound = 0, nChecked = 0;
+    for (size_t i = vInserted.size() - std::min(vInserted.size(), nSize / 2); i < vInserted.size(); i++) {
+        if (fErase && i % 2 == 0)
+            continue;
+        nChecked++;
+        nFound += cache.contains(vInserted[i], false);
+    }
+    return (double)nFound / nChecked;
+}
+
+BOOST_AUTO_TEST_CASE(cuckoocache_no_fakes)
+{
+    SeedInsecureRand(true);
+    TestCache cache;
+    cache.setup_bytes(32 << 20);
+    for (int i = 0; i < 100000; i++)
+        cache.insert(InsecureRand256());
+    for (int i = 0; i < 100000; i++)
+        BOOST_CHECK(!cache.contains(InsecureRand256(), false));
+}
+
+BOOST_AUTO_TEST_CASE(cuckoocache_sizes)
+{
+    TestCache cache;
+    BOOST_CHECK_EQUAL(cache.setup_bytes(0), 2U);
+    BOOST_CHECK_EQUAL(cache.setup_bytes(1 << 20), (1U << 20) / sizeof(uint256));
+    // A tiny cache still holds what was just inserted
+    uint256 hash = GetRandHash();
+    cache.setup(2);
+    cache.insert(hash);
+    BOOST_CHECK(cache.contains(hash, false));
+}
+
+BOOST_AUTO_TEST_CASE(cuckoocache_hit_rate)
+{
+    // Below capacity, every recent element is found
+    BOOST_CHECK(HitRate(0.5, false) > 0.99);
+    // Over capacity, the most recent half of the table survives
+    BOOST_CHECK(HitRate(2.0, false) > 0.95);
+    // Erased entries make room for the rest
+    BOOST_CHECK(HitRate(1.5, true) > 0.99);
+}
+
+BOOST_AUTO_TEST_CASE(cuckoocache_erase)
+{
+    SeedInsecureRand(true);
+    TestCache cache;
+    const size_t nSize = cache.setup_bytes(1 << 20);
+    std::vector<uint256> vOld;
+    for (size_t i = 0; i < nSize / 2; i++) {
+        vOld.push_back(InsecureRand256());
+        cache.insert(vOld.back());
+    }
+    // Erasing is lazy: the entry stays until its slot is reused
+    for (const uint256& hash : vOld)
+        BOOST_CHECK(cache.contains(hash, true));
+    for (const uint256& hash : vOld)
+        BOOST_CHECK(cache.contains(hash, false));
+    // A full table of new entries reuses the erased slots first
+    std::vector<uint256> vNew;
+    for (size_t i = 0; i < nSize / 2; i++) {
+        vNew.push_back(InsecureRand256());
+        cache.insert(vNew.back());
+    }
+    size_t nFound = 0;
+    for (const uint256& hash : vNew)
+        nFound += cache.contains(hash, false);
+    BOOST_CHECK_EQUAL(nFound, vNew.size());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
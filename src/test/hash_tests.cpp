@@ -46,4 +46,22 @@ BOOST_AUTO_TEST_CASE(murmurhash3)
 #undef T
 }
 
+BOOST_AUTO_TEST_CASE(siphash)
+{
+    // Reference vector for the 32 byte input 00..1f with key 00..0f
+    uint256 val;
+    for (int i = 0; i < 32; i++)
+        *(val.begin() + i) = i;
+    BOOST_CHECK_EQUAL(SipHashUint256(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL, val), 0x7127512f72f27cceULL);
+
+    // Every key word and every value word matters
+    BOOST_CHECK(SipHashUint256(1, 0, val) != SipHashUint256(0, 0, val));
+    BOOST_CHECK(SipHashUint256(0, 1, val) != SipHashUint256(0, 0, val));
+    for (int i = 0; i < 4; i++) {
+        uint256 val2 = val;
+        *(val2.begin() + i * 8) ^= 1;
+        BOOST_CHECK(SipHashUint256(0, 0, val2) != SipHashUint256(0, 0, val));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
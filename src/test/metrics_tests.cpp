@@ -0,0 +1,92 @@
+// Copyright (c) 2020 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "masternodeman.h"
+#include "metrics.h"
+#include "test/test_yoda.h"
+
+#include <boost/assign/list_of.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(metrics_tests, BasicTestingSetup)
+
+// Metrics register themselves for good, so they have to outlive the test
+static CMetricCounter testCounter("test_counter_total", "A test counter");
+static CMetricGauge testGauge("test_gauge", "A test gauge");
+static CMetricGauge testWalletGauge("test_wallet_gauge", "A test wallet gauge", true);
+static CMetricHistogram testHistogram("test_seconds", "A test histogram", boost::assign::list_of(0.001)(0.01)(0.1));
+
+static bool Contains(const std::string& str, const std::string& strPart)
+{
+    return str.find(strPart) != std::string::npos;
+}
+
+BOOST_AUTO_TEST_CASE(metrics_render)
+{
+    testCounter.Inc();
+    testCounter.Inc(2);
+    testGauge.Set(7);
+    testGauge.Add(-2);
+
+    std::string strOut = RenderMetrics(false);
+    BOOST_CHECK(Contains(strOut, "# HELP test_counter_total A test counter\n# TYPE test_counter_total counter\ntest_counter_total 3\n"));
+    BOOST_CHECK(Contains(strOut, "# TYPE test_gauge gauge\ntest_gauge 5\n"));
+    BOOST_CHECK(Contains(strOut, "# TYPE yoda_chain_height gauge\n"));
+}
+
+BOOST_AUTO_TEST_CASE(metrics_histogram)
+{
+    testHistogram.ObserveMicros(500);
+    testHistogram.ObserveMicros(1000);
+    testHistogram.ObserveMicros(50000);
+    testHistogram.ObserveMicros(2000000);
+
+    // Buckets are cumulative, and a sample on a bound falls in that bound's bucket
+    std::string strOut = RenderMetrics(false);
+    BOOST_CHECK(Contains(strOut, "# TYPE test_seconds histogram\n"));
+    BOOST_CHECK(Contains(strOut, "test_seconds_bucket{le=\"0.001\"} 2\n"));
+    BOOST_CHECK(Contains(strOut, "test_seconds_bucket{le=\"0.01\"} 2\n"));
+    BOOST_CHECK(Contains(strOut, "test_seconds_bucket{le=\"0.1\"} 3\n"));
+    BOOST_CHECK(Contains(strOut, "test_seconds_bucket{le=\"+Inf\"} 4\n"));
+    BOOST_CHECK(Contains(strOut, "test_seconds_sum 2.051500\n"));
+    BOOST_CHECK(Contains(strOut, "test_seconds_count 4\n"));
+}
+
+BOOST_AUTO_TEST_CASE(metrics_wallet_opt_in)
+{
+    testWalletGauge.Set(3);
+
+    // Wallet and staking metrics are only served when asked for
+    std::string strOut = RenderMetrics(false);
+    BOOST_CHECK(!Contains(strOut, "test_wallet_gauge"));
+    BOOST_CHECK(!Contains(strOut, "yoda_wallet_transactions"));
+    BOOST_CHECK(!Contains(strOut, "yoda_stakes_found_total"));
+    BOOST_CHECK(Contains(strOut, "yoda_chain_height"));
+
+    strOut = RenderMetrics(true);
+    BOOST_CHECK(Contains(strOut, "# TYPE test_wallet_gauge gauge\ntest_wallet_gauge 3\n"));
+    BOOST_CHECK(Contains(strOut, "yoda_wallet_transactions"));
+    BOOST_CHECK(Contains(strOut, "yoda_stakes_found_total"));
+}
+
+BOOST_AUTO_TEST_CASE(metrics_masternodes)
+{
+    mnodeman.Clear();
+    BOOST_CHECK_EQUAL(metrics::masternodes.Get(), 0);
+
+    // A manager other than the node's, like the one DumpMasternodes reads the cache into, leaves the gauge alone
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << std::vector<CMasternode>(1);
+    ss << std::map<CNetAddr, int64_t>() << std::map<CNetAddr, int64_t>() << std::map<COutPoint, int64_t>();
+    ss << (int64_t)0;
+    ss << std::map<uint256, CMasternodeBroadcast>() << std::map<uint256, CMasternodePing>();
+    CMasternodeMan tempMnodeman;
+    ss >> tempMnodeman;
+    BOOST_CHECK_EQUAL(tempMnodeman.size(), 1);
+    BOOST_CHECK_EQUAL(metrics::masternodes.Get(), 0);
+    tempMnodeman.Clear();
+    BOOST_CHECK_EQUAL(metrics::masternodes.Get(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
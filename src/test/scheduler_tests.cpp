@@ -17,6 +17,8 @@
 #include <boost/thread.hpp>
 #include <boost/test/unit_test.hpp>
 
+#include <vector>
+
 BOOST_AUTO_TEST_SUITE(scheduler_tests)
 
 static void microTask(CScheduler& s, boost::mutex& mutex, int& counter, int delta, boost::chrono::system_clock::time_point rescheduleTime)
@@ -118,4 +120,149 @@ BOOST_AUTO_TEST_CASE(manythreads)
     BOOST_CHECK_EQUAL(counterSum, 200);
 }
 
+static void Count(boost::mutex& mutex, int& counter)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    counter++;
+}
+
+BOOST_AUTO_TEST_CASE(cancel)
+{
+    CScheduler s;
+    boost::mutex counterMutex;
+    int counter = 0;
+    CScheduler::Function f = boost::bind(&Count, boost::ref(counterMutex), boost::ref(counter));
+    boost::chrono::system_clock::time_point now = boost::chrono::system_clock::now();
+    boost::chrono::system_clock::time_point first, last;
+
+    // Due soon, in an hour (a higher wheel) and in ten days (the overflow list)
+    CScheduler::TaskId idSoon = s.schedule(f, now + boost::chrono::milliseconds(5));
+    CScheduler::TaskId idHour = s.schedule(f, now + boost::chrono::hours(1));
+    CScheduler::TaskId idFar = s.schedule(f, now + boost::chrono::hours(240));
+    s.schedule(f, now);
+    BOOST_CHECK(idSoon != 0 && idSoon != idHour && idHour != idFar);
+    BOOST_CHECK_EQUAL(s.getQueueInfo(first, last), 4U);
+    BOOST_CHECK(last == now + boost::chrono::hours(240));
+
+    BOOST_CHECK(s.cancel(idSoon));
+    BOOST_CHECK(!s.cancel(idSoon));
+    BOOST_CHECK(s.cancel(idFar));
+    BOOST_CHECK_EQUAL(s.getQueueInfo(first, last), 2U);
+    BOOST_CHECK(last == now + boost::chrono::hours(1));
+
+    boost::thread t(boost::bind(&CScheduler::serviceQueue, &s));
+    MicroSleep(20000);
+    BOOST_CHECK(s.cancel(idHour));
+    s.stop(true);
+    t.join();
+    // Only the task due now ran
+    BOOST_CHECK_EQUAL(counter, 1);
+    BOOST_CHECK_EQUAL(s.getQueueInfo(first, last), 0U);
+}
+
+static void GroupTask(boost::mutex& mutex, std::vector<int>& vOrder, int& nRunning, bool& fOverlap, int n)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (nRunning++ > 0)
+            fOverlap = true;
+    }
+    MicroSleep(100);
+    boost::unique_lock<boost::mutex> lock(mutex);
+    vOrder.push_back(n);
+    nRunning--;
+}
+
+BOOST_AUTO_TEST_CASE(serial_group)
+{
+    // Tasks of one group never overlap and run in due order, however
+    // many threads service the queue
+    CScheduler s;
+    boost::mutex mutex;
+    std::vector<int> vOrder;
+    int nRunning = 0;
+    bool fOverlap = false;
+
+    CScheduler::GroupId group = s.newSerialGroup();
+    BOOST_CHECK(group != 0 && s.newSerialGroup() != group);
+    boost::chrono::system_clock::time_point now = boost::chrono::system_clock::now();
+    std::vector<CScheduler::TaskId> vIds;
+    for (int i = 0; i < 50; i++)
+        vIds.push_back(s.schedule(boost::bind(&GroupTask, boost::ref(mutex), boost::ref(vOrder), boost::ref(nRunning), boost::ref(fOverlap), i),
+                                  now + boost::chrono::microseconds(i * 50), group));
+    // A cancelled task in the middle is skipped
+    BOOST_CHECK(s.cancel(vIds[25]));
+
+    boost::thread_group threads;
+    for (int i = 0; i < 4; i++)
+        threads.create_thread(boost::bind(&CScheduler::serviceQueue, &s));
+    s.stop(true);
+    threads.join_all();
+
+    BOOST_CHECK(!fOverlap);
+    BOOST_CHECK_EQUAL(vOrder.size(), 49U);
+    for (size_t i = 0; i < vOrder.size(); i++)
+        BOOST_CHECK_EQUAL(vOrder[i], (int)(i < 25 ? i : i + 1));
+}
+
+BOOST_AUTO_TEST_CASE(periodic)
+{
+    CScheduler s;
+    boost::mutex counterMutex;
+    int counter = 0;
+    boost::thread t(boost::bind(&CScheduler::serviceQueue, &s));
+
+    CScheduler::TaskId id = s.scheduleEvery(boost::bind(&Count, boost::ref(counterMutex), boost::ref(counter)), boost::chrono::milliseconds(50));
+    MicroSleep(275000);
+    // A periodic task keeps its handle across runs
+    BOOST_CHECK(s.cancel(id));
+    int nRuns;
+    {
+        boost::unique_lock<boost::mutex> lock(counterMutex);
+        nRuns = counter;
+    }
+    // Due at 50, 100, ... 250ms; a busy machine may run late and skip some, never more
+    BOOST_CHECK(nRuns >= 1 && nRuns <= 5);
+
+    s.stop(true);
+    t.join();
+    BOOST_CHECK_EQUAL(counter, nRuns);
+}
+
+static void SleepTask(boost::mutex& mutex, int& nDone, uint64_t nMicros)
+{
+    MicroSleep(nMicros);
+    boost::unique_lock<boost::mutex> lock(mutex);
+    nDone++;
+}
+
+BOOST_AUTO_TEST_CASE(periodic_beside_long_group_task)
+{
+    // One slow task must not hold up the timers: while a long task of a group
+    // keeps one thread busy, the other runs a periodic task on time
+    CScheduler s;
+    boost::mutex mutex;
+    int nPeriodic = 0;
+    int nLongDone = 0;
+
+    boost::thread_group threads;
+    for (int i = 0; i < 2; i++)
+        threads.create_thread(boost::bind(&CScheduler::serviceQueue, &s));
+
+    CScheduler::TaskId id = s.scheduleEvery(boost::bind(&SleepTask, boost::ref(mutex), boost::ref(nPeriodic), 1000), boost::chrono::milliseconds(20));
+    s.scheduleFromNow(boost::bind(&SleepTask, boost::ref(mutex), boost::ref(nLongDone), 400000), 0, s.newSerialGroup());
+    MicroSleep(200000);
+    {
+        // About ten runs are due by now, none of them if the long task held up the queue
+        boost::unique_lock<boost::mutex> lock(mutex);
+        BOOST_CHECK_EQUAL(nLongDone, 0);
+        BOOST_CHECK(nPeriodic >= 3);
+    }
+
+    BOOST_CHECK(s.cancel(id));
+    s.stop(true);
+    threads.join_all();
+    BOOST_CHECK_EQUAL(nLongDone, 1);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
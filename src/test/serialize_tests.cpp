@@ -47,6 +47,24 @@ BOOST_AUTO_TEST_CASE(varints)
     }
 }
 
+BOOST_AUTO_TEST_CASE(bigendian32)
+{
+    // round trip, and the encoding sorts like the numbers it encodes
+    std::string strPrev;
+    for (unsigned int i = 0; i < 4000000000U; i += 39916801) {
+        CDataStream ss(SER_DISK, 0);
+        ss << BIGENDIAN32(i);
+        BOOST_CHECK_EQUAL(ss.size(), 4U);
+        BOOST_CHECK_EQUAL(::GetSerializeSize(BIGENDIAN32(i), 0, 0), 4U);
+        BOOST_CHECK(strPrev < ss.str());
+        strPrev = ss.str();
+
+        unsigned int j = 0;
+        ss >> BIGENDIAN32(j);
+        BOOST_CHECK_MESSAGE(i == j, "decoded:" << j << " expected:" << i);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(compactsize)
 {
     CDataStream ss(SER_DISK, 0);
@@ -157,12 +157,40 @@ BOOST_AUTO_TEST_CASE(sighash_test)
         std::cout << "\n";
         #endif
         BOOST_CHECK(sh == sho);
+        const CTransaction tx(txTo);
+        const PrecomputedTransactionData txdata(tx);
+        BOOST_CHECK(SignatureHash(scriptCode, tx, nIn, nHashType, &txdata) == sho);
     }
     #if defined(PRINT_SIGHASH_JSON)
     std::cout << "]\n";
     #endif
 }
 
+// Goal: check that the precomputed data gives the same hash for every input of a large transaction
+BOOST_AUTO_TEST_CASE(sighash_precomputed)
+{
+    SeedInsecureRand(false);
+
+    for (int i = 0; i < 20; i++) {
+        CMutableTransaction txTo;
+        RandomTransaction(txTo, false);
+        for (int in = InsecureRandRange(200); in > 0; in--) {
+            txTo.vin.push_back(txTo.vin[0]);
+            txTo.vin.back().prevout.hash = InsecureRand256();
+            txTo.vin.back().nSequence = InsecureRand32();
+        }
+        const CTransaction tx(txTo);
+        const PrecomputedTransactionData txdata(tx);
+        for (unsigned int nIn = 0; nIn < tx.vin.size(); nIn++) {
+            CScript scriptCode;
+            RandomScript(scriptCode);
+            for (int nHashType : std::vector<int>{SIGHASH_ALL, SIGHASH_ALL | SIGHASH_ANYONECANPAY, SIGHASH_NONE, 0, 0x41}) {
+                BOOST_CHECK(SignatureHash(scriptCode, tx, nIn, nHashType, &txdata) == SignatureHashOld(scriptCode, tx, nIn, nHashType));
+            }
+        }
+    }
+}
+
 // Goal: check that SignatureHash generates correct hash
 BOOST_AUTO_TEST_CASE(sighash_from_data)
 {
@@ -0,0 +1,171 @@
+// Copyright (c) 2020 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "swifttx.h"
+#include "test/test_yoda.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(swifttx_tests, BasicTestingSetup)
+
+static CTransaction SpendTx(const uint256& hashPrev, uint32_t n, CAmount nValue)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(hashPrev, n);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = nValue;
+    return tx;
+}
+
+BOOST_AUTO_TEST_CASE(txlock_conflicts)
+{
+    CTxLockManager locks;
+    CTransaction tx1 = SpendTx(uint256(1), 0, 1 * COIN);
+    CTransaction tx2 = SpendTx(uint256(1), 0, 2 * COIN);
+    CTransaction tx3 = SpendTx(uint256(1), 1, 3 * COIN);
+    uint256 hashLock;
+
+    BOOST_CHECK(!locks.GetConflictingLock(tx1, hashLock));
+
+    locks.AddLockRequest(tx1);
+    locks.SetLockHeight(tx1.GetHash(), 100);
+    locks.SetLockHeight(tx2.GetHash(), 100);
+    locks.LockInputs(tx1);
+    BOOST_CHECK(!locks.GetConflictingLock(tx1, hashLock));
+    BOOST_CHECK(!locks.GetConflictingLock(tx3, hashLock));
+    BOOST_CHECK(locks.GetConflictingLock(tx2, hashLock));
+    BOOST_CHECK(hashLock == tx1.GetHash());
+
+    // Locking again keeps the first lock on the input
+    locks.LockInputs(tx2);
+    BOOST_CHECK(locks.GetConflictingLock(tx2, hashLock));
+    BOOST_CHECK(hashLock == tx1.GetHash());
+
+    // Conflicting locks expire each other, which takes tx1's inputs with it
+    BOOST_CHECK(locks.CheckForConflictingLocks(tx2));
+    BOOST_CHECK_EQUAL(locks.GetSignatures(tx1.GetHash()), 0);
+    locks.Clean(GetTime() + 1);
+    BOOST_CHECK_EQUAL(locks.GetSignatures(tx1.GetHash()), -1);
+    BOOST_CHECK_EQUAL(locks.GetSignatures(tx2.GetHash()), -1);
+    BOOST_CHECK(!locks.HaveLockRequest(tx1.GetHash()));
+    BOOST_CHECK(!locks.GetConflictingLock(tx2, hashLock));
+}
+
+BOOST_AUTO_TEST_CASE(txlock_expiry)
+{
+    CTxLockManager locks;
+    CTransaction tx = SpendTx(uint256(2), 0, 1 * COIN);
+    locks.AddLockRequest(tx);
+    locks.SetLockHeight(tx.GetHash(), 100);
+    locks.LockInputs(tx);
+
+    CConsensusVote vote;
+    vote.txHash = tx.GetHash();
+    vote.nBlockHeight = 100;
+    BOOST_CHECK(locks.AddVote(vote));
+    BOOST_CHECK(!locks.AddVote(vote));
+    BOOST_CHECK_EQUAL(locks.AddSignature(vote), 1);
+
+    // Locks are kept for an hour
+    locks.Clean(GetTime() + 60);
+    BOOST_CHECK_EQUAL(locks.GetSignatures(tx.GetHash()), 1);
+    BOOST_CHECK(locks.HaveVote(vote.GetHash()));
+
+    locks.Clean(GetTime() + 2 * 60 * 60);
+    BOOST_CHECK_EQUAL(locks.GetSignatures(tx.GetHash()), -1);
+    BOOST_CHECK(!locks.HaveLockRequest(tx.GetHash()));
+    BOOST_CHECK(!locks.HaveVote(vote.GetHash()));
+    uint256 hashLock;
+    BOOST_CHECK(!locks.GetConflictingLock(SpendTx(uint256(2), 0, 2 * COIN), hashLock));
+}
+
+BOOST_AUTO_TEST_CASE(txlock_rejected_expiry)
+{
+    // A rejected request with unknown inputs gets no lock, but still holds its inputs
+    CTxLockManager locks;
+    CTransaction txLocked = SpendTx(uint256(3), 0, 1 * COIN);
+    locks.AddLockRequest(txLocked);
+    locks.SetLockHeight(txLocked.GetHash(), 100);
+    locks.LockInputs(txLocked);
+
+    CMutableTransaction txRejectedMut = SpendTx(uint256(4), 0, 1 * COIN);
+    txRejectedMut.vin.push_back(txLocked.vin[0]);
+    CTransaction txRejected(txRejectedMut);
+    locks.AddRejectedLockRequest(txRejected);
+    BOOST_CHECK(locks.HaveRejectedLockRequest(txRejected.GetHash()));
+    BOOST_CHECK_EQUAL(locks.GetSignatures(txRejected.GetHash()), -1);
+    uint256 hashLock;
+    BOOST_CHECK(locks.GetConflictingLock(SpendTx(uint256(4), 0, 2 * COIN), hashLock));
+    BOOST_CHECK(hashLock == txRejected.GetHash());
+    // An input that was locked already stays with its lock
+    BOOST_CHECK(locks.GetConflictingLock(SpendTx(uint256(3), 0, 2 * COIN), hashLock));
+    BOOST_CHECK(hashLock == txLocked.GetHash());
+
+    // Kept for an hour, like a lock
+    locks.Clean(GetTime() + 60);
+    BOOST_CHECK(locks.HaveRejectedLockRequest(txRejected.GetHash()));
+
+    // Then its inputs are free again
+    locks.Clean(GetTime() + 2 * 60 * 60);
+    BOOST_CHECK(!locks.HaveRejectedLockRequest(txRejected.GetHash()));
+    BOOST_CHECK(!locks.HaveLockRequest(txRejected.GetHash()));
+    BOOST_CHECK(!locks.GetConflictingLock(SpendTx(uint256(4), 0, 2 * COIN), hashLock));
+    BOOST_CHECK(!locks.GetConflictingLock(SpendTx(uint256(3), 0, 2 * COIN), hashLock));
+    BOOST_CHECK_EQUAL(locks.GetSignatures(txLocked.GetHash()), -1);
+}
+
+BOOST_AUTO_TEST_CASE(txlock_unlocked_expiry)
+{
+    // Requests and our own votes that never get a lock
+    CTxLockManager locks;
+    int64_t nStartTime = GetTime();
+    SetMockTime(nStartTime);
+    CTransaction tx = SpendTx(uint256(8), 0, 1 * COIN);
+    locks.AddLockRequest(tx);
+    CConsensusVote vote;
+    vote.txHash = uint256(9);
+    locks.AddOwnVote(vote);
+    BOOST_CHECK(locks.HaveVote(vote.GetHash()));
+
+    // Kept for an hour, like a lock
+    SetMockTime(nStartTime + 30 * 60);
+    locks.Clean(GetTime());
+    BOOST_CHECK(locks.HaveLockRequest(tx.GetHash()));
+    BOOST_CHECK(locks.HaveVote(vote.GetHash()));
+
+    SetMockTime(nStartTime + 61 * 60);
+    locks.Clean(GetTime());
+    BOOST_CHECK(!locks.HaveLockRequest(tx.GetHash()));
+    BOOST_CHECK(!locks.HaveVote(vote.GetHash()));
+    BOOST_CHECK_EQUAL(locks.GetSignatures(tx.GetHash()), -1);
+
+    SetMockTime(0);
+}
+
+BOOST_AUTO_TEST_CASE(txlock_unknown_vote_spam)
+{
+    CTxLockManager locks;
+    int64_t nStartTime = GetTime();
+    SetMockTime(nStartTime);
+    BOOST_CHECK(!locks.IsUnknownVoteSpam(uint256(5)));
+    BOOST_CHECK(!locks.IsUnknownVoteSpam(uint256(6)));
+    BOOST_CHECK(!locks.IsUnknownVoteSpam(uint256(7)));
+    BOOST_CHECK_EQUAL(locks.GetAverageVoteTime(), nStartTime + 10 * 60);
+
+    // Masternodes whose wait is over stay in the average
+    SetMockTime(nStartTime + 20 * 60);
+    locks.Clean(GetTime());
+    BOOST_CHECK_EQUAL(locks.GetAverageVoteTime(), nStartTime + 10 * 60);
+
+    // So a masternode may vote again once its wait is over, but not within 10 minutes
+    BOOST_CHECK(!locks.IsUnknownVoteSpam(uint256(5)));
+    SetMockTime(nStartTime + 21 * 60);
+    locks.Clean(GetTime());
+    BOOST_CHECK(locks.IsUnknownVoteSpam(uint256(5)));
+
+    SetMockTime(0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
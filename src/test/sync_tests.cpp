@@ -0,0 +1,63 @@
+// Copyright (c) 2020 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "sync.h"
+#include "test/test_yoda.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(sync_tests, BasicTestingSetup)
+
+static const CLockSiteStats* FindSite(const std::vector<CLockSiteStats>& vStats, const std::string& strName)
+{
+    for (const CLockSiteStats& stats : vStats) {
+        if (stats.strName == strName)
+            return &stats;
+    }
+    return NULL;
+}
+
+BOOST_AUTO_TEST_CASE(lock_profiling)
+{
+    CCriticalSection csProfiled;
+    ResetLockStats();
+
+    // Nothing is recorded while profiling is off
+    {
+        LOCK(csProfiled);
+    }
+    BOOST_CHECK(!FindSite(GetLockStats(), "csProfiled"));
+
+    g_profile_locks = true;
+    for (int i = 0; i < 3; i++) {
+        LOCK(csProfiled);
+    }
+    // A failed TRY_LOCK counts as contention, from another thread since the lock is recursive
+    {
+        LOCK(csProfiled);
+        std::thread thread([&csProfiled] {
+            TRY_LOCK(csProfiled, lockTry);
+            assert(!lockTry);
+        });
+        thread.join();
+    }
+    g_profile_locks = false;
+
+    // The thread has exited, its samples are kept
+    std::vector<CLockSiteStats> vStats = GetLockStats();
+    uint64_t nLocks = 0, nContended = 0;
+    for (const CLockSiteStats& stats : vStats) {
+        if (stats.strName != "csProfiled")
+            continue;
+        nLocks += stats.nLocks;
+        nContended += stats.nContended;
+    }
+    BOOST_CHECK_EQUAL(nLocks, 4U);
+    BOOST_CHECK_EQUAL(nContended, 1U);
+
+    ResetLockStats();
+    BOOST_CHECK(!FindSite(GetLockStats(), "csProfiled"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
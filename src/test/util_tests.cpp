@@ -6,6 +6,7 @@
 #include "util.h"
 
 #include "clientversion.h"
+#include "logring.h"
 #include "primitives/transaction.h"
 #include "sync.h"
 #include "utilstrencodings.h"
@@ -16,6 +17,7 @@
 #include <vector>
 
 #include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
 
 
 BOOST_FIXTURE_TEST_SUITE(util_tests, BasicTestingSetup)
@@ -424,4 +426,55 @@ BOOST_AUTO_TEST_CASE(test_FormatSubVersion)
     BOOST_CHECK_EQUAL(FormatSubVersion("Test", 99900, comments),std::string("/Test:0.9.99(comment1)/"));
     BOOST_CHECK_EQUAL(FormatSubVersion("Test", 99900, comments2),std::string("/Test:0.9.99(comment1; comment2)/"));
 }
+
+BOOST_AUTO_TEST_CASE(util_logring)
+{
+    CLogRing ring(5);
+    BOOST_CHECK_EQUAL(ring.Capacity(), 8U);
+
+    // Full queues refuse lines instead of overwriting them
+    std::string str;
+    for (int i = 0; i < 8; i++) {
+        str = strprintf("line %d\n", i);
+        BOOST_CHECK(ring.Push(str));
+    }
+    str = "overflow\n";
+    BOOST_CHECK(!ring.Push(str));
+    BOOST_CHECK_EQUAL(str, "overflow\n");
+    BOOST_CHECK_EQUAL(ring.Size(), 8U);
+    for (int i = 0; i < 8; i++) {
+        BOOST_CHECK(ring.Pop(str));
+        BOOST_CHECK_EQUAL(str, strprintf("line %d\n", i));
+    }
+    BOOST_CHECK(!ring.Pop(str));
+
+    // Concurrent producers: every line arrives once, and each producer's lines stay in order
+    CLogRing ring2(256);
+    const int nThreads = 4, nLines = 10000;
+    boost::thread_group threads;
+    for (int t = 0; t < nThreads; t++) {
+        threads.create_thread([&ring2, t, nLines] {
+            for (int i = 0; i < nLines; i++) {
+                std::string strLine = strprintf("%d %d", t, i);
+                while (!ring2.Push(strLine))
+                    boost::this_thread::yield();
+            }
+        });
+    }
+    std::vector<int> vNext(nThreads, 0);
+    int nReceived = 0;
+    while (nReceived < nThreads * nLines) {
+        if (!ring2.Pop(str)) {
+            boost::this_thread::yield();
+            continue;
+        }
+        int t, i;
+        BOOST_REQUIRE(sscanf(str.c_str(), "%d %d", &t, &i) == 2);
+        BOOST_CHECK_EQUAL(i, vNext[t]++);
+        nReceived++;
+    }
+    threads.join_all();
+    BOOST_CHECK(!ring2.Pop(str));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
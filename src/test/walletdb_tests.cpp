@@ -0,0 +1,266 @@
+// Copyright (c) 2020 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "wallet/wallet.h"
+#include "wallet/walletdb.h"
+
+#include "test/test_yoda.h"
+
+#include <boost/test/unit_test.hpp>
+
+extern CWallet* pwalletMain;
+
+BOOST_FIXTURE_TEST_SUITE(walletdb_tests, TestingSetup)
+
+/** Exposes the raw key/value access of CDB */
+class CTestWalletDB : public CWalletDB
+{
+public:
+    explicit CTestWalletDB(const std::string& strFilename) : CWalletDB(strFilename) {}
+
+    using CDB::Read;
+    using CDB::Exists;
+    using CDB::Write;
+    using CDB::Erase;
+    using CDB::WriteBehind;
+    using CDB::EraseBehind;
+    using CDB::GetCursor;
+};
+
+static int ReadInt(const std::string& strKey)
+{
+    CTestWalletDB db(pwalletMain->strWalletFile);
+    int n = -1;
+    db.Read(strKey, n);
+    return n;
+}
+
+BOOST_AUTO_TEST_CASE(walletdb_batch)
+{
+    const std::string& strFile = pwalletMain->strWalletFile;
+    CTestWalletDB db(strFile);
+
+    // Aborted batches leave no trace
+    BOOST_CHECK(db.BatchBegin());
+    BOOST_CHECK(!db.BatchBegin());
+    BOOST_CHECK(db.Write(std::string("batchtest"), 1));
+    BOOST_CHECK(db.Exists(std::string("batchtest")));
+    db.BatchAbort();
+    BOOST_CHECK(!db.Exists(std::string("batchtest")));
+
+    // Only the last write of a key in the batch counts, and nothing is visible to others before the commit
+    BOOST_CHECK(db.BatchBegin());
+    BOOST_CHECK(db.Write(std::string("batchtest"), 1));
+    BOOST_CHECK(db.Write(std::string("batchtest"), 2));
+    BOOST_CHECK(db.Write(std::string("batchtest2"), 3));
+    BOOST_CHECK(!db.Write(std::string("batchtest2"), 4, false));
+    BOOST_CHECK_EQUAL(ReadInt("batchtest"), -1);
+    BOOST_CHECK(db.BatchCommit(true));
+    BOOST_CHECK_EQUAL(ReadInt("batchtest"), 2);
+    BOOST_CHECK_EQUAL(ReadInt("batchtest2"), 3);
+
+    BOOST_CHECK(db.BatchBegin());
+    BOOST_CHECK(db.Erase(std::string("batchtest")));
+    BOOST_CHECK(db.BatchCommit());
+    BOOST_CHECK_EQUAL(ReadInt("batchtest"), -1);
+}
+
+BOOST_AUTO_TEST_CASE(walletdb_write_behind)
+{
+    const std::string& strFile = pwalletMain->strWalletFile;
+
+    // Without the flush thread, updates are written through
+    {
+        CTestWalletDB db(strFile);
+        BOOST_CHECK(db.WriteBehind(std::string("queuetest"), 1));
+        BOOST_CHECK(!bitdb.IsQueueDue(strFile, true));
+    }
+    BOOST_CHECK_EQUAL(ReadInt("queuetest"), 1);
+
+    bitdb.SetWriteBehind(true);
+    {
+        CTestWalletDB db(strFile);
+        BOOST_CHECK(db.WriteBehind(std::string("queuetest"), 2));
+        BOOST_CHECK(db.WriteBehind(std::string("queuetest"), 3));
+        BOOST_CHECK(db.WriteBehind(std::string("queuetest2"), 4));
+        BOOST_CHECK(bitdb.IsQueueDue(strFile, true));
+        BOOST_CHECK(!bitdb.IsQueueDue(strFile, false));
+    }
+    // Queued updates are visible to reads before they are committed
+    BOOST_CHECK_EQUAL(ReadInt("queuetest"), 3);
+    BOOST_CHECK(CDB::FlushQueued(strFile));
+    BOOST_CHECK(!bitdb.IsQueueDue(strFile, true));
+    BOOST_CHECK_EQUAL(ReadInt("queuetest"), 3);
+    BOOST_CHECK_EQUAL(ReadInt("queuetest2"), 4);
+
+    // So are queued erases
+    {
+        CTestWalletDB db(strFile);
+        BOOST_CHECK(db.EraseBehind(std::string("queuetest")));
+        BOOST_CHECK(!db.Exists(std::string("queuetest")));
+    }
+    BOOST_CHECK_EQUAL(ReadInt("queuetest"), -1);
+
+    // Opening a cursor commits the queue, so iteration sees everything
+    {
+        CTestWalletDB db(strFile);
+        Dbc* pcursor = db.GetCursor();
+        BOOST_CHECK(pcursor);
+        BOOST_CHECK(!bitdb.IsQueueDue(strFile, true));
+        pcursor->close();
+    }
+    BOOST_CHECK_EQUAL(ReadInt("queuetest"), -1);
+
+    // Batches bypass the queue
+    {
+        CTestWalletDB db(strFile);
+        BOOST_CHECK(db.BatchBegin());
+        BOOST_CHECK(db.WriteBehind(std::string("queuetest"), 5));
+        BOOST_CHECK(!bitdb.IsQueueDue(strFile, true));
+        BOOST_CHECK(db.BatchCommit());
+    }
+    BOOST_CHECK_EQUAL(ReadInt("queuetest"), 5);
+    bitdb.SetWriteBehind(false);
+}
+
+BOOST_AUTO_TEST_CASE(walletdb_best_block_behind_queue)
+{
+    const std::string& strFile = pwalletMain->strWalletFile;
+    CBlockLocator locator;
+    locator.vHave.push_back(GetRandHash());
+
+    // The locator is queued behind the transactions, and committed with them
+    bitdb.SetWriteBehind(true);
+    {
+        CTestWalletDB db(strFile);
+        BOOST_CHECK(db.WriteBehind(std::string("queuetest"), 6));
+        BOOST_CHECK(db.WriteBestBlock(locator));
+        BOOST_CHECK(bitdb.IsQueueDue(strFile, true));
+    }
+    BOOST_CHECK(CDB::FlushQueued(strFile));
+    BOOST_CHECK_EQUAL(ReadInt("queuetest"), 6);
+    {
+        CTestWalletDB db(strFile);
+        CBlockLocator locatorRead;
+        BOOST_CHECK(db.ReadBestBlock(locatorRead));
+        BOOST_CHECK(locatorRead.vHave == locator.vHave);
+    }
+
+    // Written through a batch, it commits the queue first
+    {
+        CTestWalletDB db(strFile);
+        BOOST_CHECK(db.WriteBehind(std::string("queuetest"), 7));
+        BOOST_CHECK(db.BatchBegin());
+        BOOST_CHECK(db.WriteBestBlock(locator));
+        BOOST_CHECK(!bitdb.IsQueueDue(strFile, true));
+        BOOST_CHECK(db.BatchCommit());
+    }
+    BOOST_CHECK_EQUAL(ReadInt("queuetest"), 7);
+    bitdb.SetWriteBehind(false);
+}
+
+static int64_t ReadTxOrderPos(const uint256& hash)
+{
+    CTestWalletDB db(pwalletMain->strWalletFile);
+    CWalletTx wtx;
+    if (!db.Read(std::make_pair(std::string("tx"), hash), wtx))
+        return -1;
+    return wtx.nOrderPos;
+}
+
+BOOST_AUTO_TEST_CASE(walletdb_direct_write_supersedes_queue)
+{
+    const std::string& strFile = pwalletMain->strWalletFile;
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout.hash = GetRandHash();
+    tx.vout.resize(1);
+    CWalletTx wtx(NULL, tx);
+    const uint256 hash = wtx.GetHash();
+
+    // A transaction written in a database transaction after being queued
+    bitdb.SetWriteBehind(true);
+    {
+        CTestWalletDB db(strFile);
+        wtx.nOrderPos = 1;
+        BOOST_CHECK(db.WriteTx(hash, wtx));
+        BOOST_CHECK(db.TxnBegin());
+        wtx.nOrderPos = 2;
+        BOOST_CHECK(db.WriteTx(hash, wtx));
+        BOOST_CHECK(db.TxnCommit());
+    }
+    BOOST_CHECK(CDB::FlushQueued(strFile));
+    BOOST_CHECK_EQUAL(ReadTxOrderPos(hash), 2);
+
+    // Queued by another handle while the database transaction is open
+    {
+        CTestWalletDB dbTxn(strFile);
+        BOOST_CHECK(dbTxn.TxnBegin());
+        {
+            CTestWalletDB db(strFile);
+            wtx.nOrderPos = 3;
+            BOOST_CHECK(db.WriteTx(hash, wtx));
+        }
+        wtx.nOrderPos = 4;
+        BOOST_CHECK(dbTxn.WriteTx(hash, wtx));
+        BOOST_CHECK(dbTxn.TxnCommit());
+    }
+    BOOST_CHECK(CDB::FlushQueued(strFile));
+    BOOST_CHECK_EQUAL(ReadTxOrderPos(hash), 4);
+
+    // And in a batch
+    {
+        CTestWalletDB db(strFile);
+        wtx.nOrderPos = 5;
+        BOOST_CHECK(db.WriteTx(hash, wtx));
+        BOOST_CHECK(db.BatchBegin());
+        BOOST_CHECK(db.EraseTx(hash));
+        BOOST_CHECK(db.BatchCommit());
+    }
+    BOOST_CHECK(CDB::FlushQueued(strFile));
+    BOOST_CHECK_EQUAL(ReadTxOrderPos(hash), -1);
+    bitdb.SetWriteBehind(false);
+}
+
+BOOST_AUTO_TEST_CASE(walletdb_parallel_load)
+{
+    const std::string& strFile = pwalletMain->strWalletFile;
+    std::vector<uint256> vHashes;
+    std::vector<CPubKey> vPubKeys;
+    {
+        // Enough records for the loader to use its threads
+        CWalletDB walletdb(strFile);
+        for (size_t i = 0; i < WALLET_LOAD_MIN_RECORDS_PER_THREAD * 4; i++) {
+            CMutableTransaction tx;
+            tx.vin.resize(1);
+            tx.vin[0].prevout.hash = GetRandHash();
+            tx.vout.resize(1);
+            tx.vout[0].nValue = i;
+            CWalletTx wtx(NULL, tx);
+            wtx.nOrderPos = i;
+            vHashes.push_back(wtx.GetHash());
+            BOOST_CHECK(walletdb.WriteTx(wtx.GetHash(), wtx));
+        }
+        for (int i = 0; i < 20; i++) {
+            CKey key;
+            key.MakeNewKey(true);
+            vPubKeys.push_back(key.GetPubKey());
+            BOOST_CHECK(walletdb.WriteKey(key.GetPubKey(), key.GetPrivKey(), CKeyMetadata(GetTime())));
+        }
+    }
+
+    CWallet wallet(strFile);
+    bool fFirstRun;
+    BOOST_CHECK(wallet.LoadWallet(fFirstRun) == DB_LOAD_OK);
+    LOCK(wallet.cs_wallet);
+    for (size_t i = 0; i < vHashes.size(); i++) {
+        BOOST_CHECK(wallet.mapWallet.count(vHashes[i]));
+        BOOST_CHECK_EQUAL(wallet.mapWallet[vHashes[i]].nOrderPos, (int64_t)i);
+        BOOST_CHECK_EQUAL(wallet.mapWallet[vHashes[i]].vout[0].nValue, (CAmount)i);
+    }
+    for (const CPubKey& pubkey : vPubKeys)
+        BOOST_CHECK(wallet.HaveKey(pubkey.GetID()));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -56,6 +56,69 @@ BOOST_AUTO_TEST_CASE(zerocoin_spend_test)
 
 }
 
+BOOST_AUTO_TEST_CASE(zerocoin_spend_record_test)
+{
+    CZerocoinSpendRecord record(GetRandHash(), GetRandHash(), 1234);
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << record;
+    BOOST_CHECK_EQUAL(ss.size(), 68U);
+
+    // Older versions read the txid and ignore the rest
+    CDataStream ssOld(ss);
+    uint256 txid;
+    ssOld >> txid;
+    BOOST_CHECK(txid == record.txid);
+
+    CZerocoinSpendRecord record2;
+    ss >> record2;
+    BOOST_CHECK(record2.HasBlock());
+    BOOST_CHECK(record2.txid == record.txid);
+    BOOST_CHECK(record2.hashBlock == record.hashBlock);
+    BOOST_CHECK_EQUAL(record2.nHeight, 1234);
+
+    // Records written by older versions only hold the txid
+    CDataStream ssLegacy(SER_DISK, CLIENT_VERSION);
+    ssLegacy << record.txid;
+    CZerocoinSpendRecord record3;
+    ssLegacy >> record3;
+    BOOST_CHECK(!record3.HasBlock());
+    BOOST_CHECK(record3.txid == record.txid);
+    BOOST_CHECK_EQUAL(record3.nHeight, -1);
+}
+
+BOOST_AUTO_TEST_CASE(zerocoin_spend_index_reload_test)
+{
+    uint256 hashSerial = GetRandHash();
+    CZerocoinSpendRecord record(GetRandHash(), GetRandHash(), 1234);
+    {
+        CZerocoinDB db(1 << 20, false, true);
+        BOOST_CHECK(db.Write(std::make_pair('s', hashSerial), record));
+    }
+
+    // Reopening loads the spend from disk; an unknown serial is unspent
+    {
+        CZerocoinDB db(1 << 20);
+        BOOST_CHECK_EQUAL(db.GetCoinSpendCount(), 1U);
+        CZerocoinSpendRecord record2;
+        BOOST_CHECK(db.ReadCoinSpend(hashSerial, record2));
+        BOOST_CHECK(record2.txid == record.txid);
+        BOOST_CHECK(record2.hashBlock == record.hashBlock);
+        BOOST_CHECK_EQUAL(record2.nHeight, 1234);
+        BOOST_CHECK(!db.ReadCoinSpend(GetRandHash(), record2));
+
+        // A record that does not decode makes the next load fail
+        BOOST_CHECK(db.Write(std::make_pair('s', uint256(0)), 'x'));
+    }
+
+    // Serials missing from memory are then read from disk
+    CZerocoinDB db(1 << 20);
+    BOOST_CHECK_EQUAL(db.GetCoinSpendCount(), 0U);
+    CZerocoinSpendRecord record3;
+    BOOST_CHECK(db.ReadCoinSpend(hashSerial, record3));
+    BOOST_CHECK(record3.txid == record.txid);
+    BOOST_CHECK(!db.ReadCoinSpend(GetRandHash(), record3));
+}
+
 BOOST_AUTO_TEST_CASE(zerocoin_schnorr_signature_test)
 {
     const int NUM_OF_TESTS = 50;
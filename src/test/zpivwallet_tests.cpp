@@ -0,0 +1,37 @@
+// Copyright (c) 2019 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "zpiv/zpivwallet.h"
+#include "init.h"
+#include "wallet/wallet.h"
+#include "test/test_yoda.h"
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(zpivwallet_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(derive_mint_values_parallel)
+{
+    CzYODAWallet zwallet(pwalletMain->strWalletFile);
+    BOOST_CHECK(zwallet.SetMasterSeed(uint256("0x4b1a2f7c90d3e8a6b5c4d3e2f1a0b9c8d7e6f5a4b3c2d1e0f9a8b7c6d5e4f3a2"), true));
+
+    // Not contiguous, and more counts than threads so every thread takes a few
+    std::vector<uint32_t> vCounts = {1, 2, 3, 5, 8, 13, 21};
+
+    std::vector<CBigNum> vSerial;
+    zwallet.DeriveMintValues(vCounts, vSerial, 1);
+    BOOST_CHECK_EQUAL(vSerial.size(), vCounts.size());
+    for (const CBigNum& bnValue : vSerial)
+        BOOST_CHECK(bnValue != 0);
+
+    for (int nThreads : {2, 3, MAX_MINTPOOL_THREADS}) {
+        std::vector<CBigNum> vParallel;
+        zwallet.DeriveMintValues(vCounts, vParallel, nThreads);
+        BOOST_CHECK(vParallel == vSerial);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
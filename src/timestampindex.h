@@ -0,0 +1,45 @@
+// Copyright (c) 2016 BitPay, Inc.
+// Copyright (c) 2020 The YODA developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef YODA_TIMESTAMPINDEX_H
+#define YODA_TIMESTAMPINDEX_H
+
+#include "serialize.h"
+#include "uint256.h"
+
+/** Block of the active chain keyed by its timestamp, big-endian so that range scans follow time order */
+struct CTimestampIndexKey {
+    unsigned int timestamp;
+    uint256 blockHash;
+
+    CTimestampIndexKey() : timestamp(0) {}
+    CTimestampIndexKey(unsigned int nTime, const uint256& hash) : timestamp(nTime), blockHash(hash) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(BIGENDIAN32(timestamp));
+        READWRITE(blockHash);
+    }
+};
+
+/** Seek prefix for CTimestampIndexKey entries at or after a given time */
+struct CTimestampIndexIteratorKey {
+    unsigned int timestamp;
+
+    explicit CTimestampIndexIteratorKey(unsigned int nTime) : timestamp(nTime) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(BIGENDIAN32(timestamp));
+    }
+};
+
+#endif // YODA_TIMESTAMPINDEX_H
@@ -10,8 +10,11 @@
 #include "pow.h"
 #include "uint256.h"
 
+#include <memory>
 #include <stdint.h>
 
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/thread.hpp>
 
 
@@ -28,7 +31,7 @@ void static BatchWriteHashBestChain(CLevelDBBatch& batch, const uint256& hash)
     batch.Write('B', hash);
 }
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe)
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe), fStatsCached(false)
 {
 }
 
@@ -104,57 +107,228 @@ bool CBlockTreeDB::ReadLastBlockFile(int& nFile)
     return Read('l', nFile);
 }
 
-bool CCoinsViewDB::GetStats(CCoinsStats& stats) const
+namespace {
+/** Totals and hash preimage of the coins whose txid starts with a byte in [nBegin, nEnd) */
+struct CCoinsStatsSlice {
+    int nBegin;
+    int nEnd;
+    uint64_t nTransactions;
+    uint64_t nTransactionOutputs;
+    uint64_t nSerializedSize;
+    CAmount nTotalAmount;
+    CDataStream ssHash;
+    bool fDone;
+    bool fError;
+    std::string strError;
+
+    CCoinsStatsSlice(int nBeginIn, int nEndIn) : nBegin(nBeginIn), nEnd(nEndIn), nTransactions(0), nTransactionOutputs(0),
+                                                 nSerializedSize(0), nTotalAmount(0), ssHash(SER_GETHASH, PROTOCOL_VERSION), fDone(false), fError(false) {}
+};
+
+/** Slices of one UTXO set scan, handed to the scan threads in key order */
+struct CCoinsStatsScan {
+    const CLevelDBSnapshot* psnapshot;
+    std::vector<std::unique_ptr<CCoinsStatsSlice> > vSlices;
+    boost::mutex cs;
+    boost::condition_variable cond;
+    //! next slice to hand out
+    int nNext;
+    //! slices already merged into the totals; at most nWindow slices beyond it are scanned ahead
+    int nMerged;
+    int nWindow;
+    bool fStop;
+
+    CCoinsStatsScan(const CLevelDBSnapshot* psnapshotIn, int nWindowIn) : psnapshot(psnapshotIn), nNext(0), nMerged(0), nWindow(nWindowIn), fStop(false)
+    {
+        for (int i = 0; i < STATS_SCAN_SLICES; i++)
+            vSlices.emplace_back(new CCoinsStatsSlice(i * 256 / STATS_SCAN_SLICES, (i + 1) * 256 / STATS_SCAN_SLICES));
+    }
+};
+
+void ScanCoinsSlice(const CLevelDBSnapshot* psnapshot, CCoinsStatsSlice* pslice)
 {
-    /* It seems that there are no "const iterators" for LevelDB.  Since we
-       only need read operations on it, use a const-cast to get around
-       that restriction.  */
-    boost::scoped_ptr<leveldb::Iterator> pcursor(const_cast<CLevelDBWrapper*>(&db)->NewIterator());
-    pcursor->SeekToFirst();
+    boost::scoped_ptr<leveldb::Iterator> pcursor(psnapshot->NewIterator());
 
-    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
-    stats.hashBlock = GetBestBlock();
-    ss << stats.hashBlock;
-    CAmount nTotalAmount = 0;
+    uint256 hashSeek(0);
+    *hashSeek.begin() = (unsigned char)pslice->nBegin;
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << std::make_pair('c', hashSeek);
+    pcursor->Seek(ssKeySet.str());
+
+    CDataStream& ss = pslice->ssHash;
     while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
         try {
             leveldb::Slice slKey = pcursor->key();
+            if (slKey.size() < 2 || slKey[0] != 'c' || (unsigned char)slKey[1] >= pslice->nEnd)
+                break;
             CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
             char chType;
             ssKey >> chType;
-            if (chType == 'c') {
-                leveldb::Slice slValue = pcursor->value();
-                CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
-                CCoins coins;
-                ssValue >> coins;
-                uint256 txhash;
-                ssKey >> txhash;
-                ss << txhash;
-                ss << VARINT(coins.nVersion);
-                ss << (coins.fCoinBase ? 'c' : 'n');
-                ss << VARINT(coins.nHeight);
-                stats.nTransactions++;
-                for (unsigned int i = 0; i < coins.vout.size(); i++) {
-                    const CTxOut& out = coins.vout[i];
-                    if (!out.IsNull()) {
-                        stats.nTransactionOutputs++;
-                        ss << VARINT(i + 1);
-                        ss << out;
-                        nTotalAmount += out.nValue;
-                    }
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+            CCoins coins;
+            ssValue >> coins;
+            uint256 txhash;
+            ssKey >> txhash;
+            ss << txhash;
+            ss << VARINT(coins.nVersion);
+            ss << (coins.fCoinBase ? 'c' : 'n');
+            ss << VARINT(coins.nHeight);
+            pslice->nTransactions++;
+            for (unsigned int i = 0; i < coins.vout.size(); i++) {
+                const CTxOut& out = coins.vout[i];
+                if (!out.IsNull()) {
+                    pslice->nTransactionOutputs++;
+                    ss << VARINT(i + 1);
+                    ss << out;
+                    pslice->nTotalAmount += out.nValue;
                 }
-                stats.nSerializedSize += 32 + slValue.size();
-                ss << VARINT(0);
             }
+            pslice->nSerializedSize += 32 + slValue.size();
+            ss << VARINT(0);
             pcursor->Next();
         } catch (const std::exception& e) {
-            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+            pslice->fError = true;
+            pslice->strError = e.what();
+            return;
+        }
+    }
+}
+
+void ThreadScanCoins(CCoinsStatsScan* pscan)
+{
+    while (true) {
+        CCoinsStatsSlice* pslice;
+        {
+            boost::unique_lock<boost::mutex> lock(pscan->cs);
+            while (!pscan->fStop && pscan->nNext < STATS_SCAN_SLICES && pscan->nNext >= pscan->nMerged + pscan->nWindow)
+                pscan->cond.wait(lock);
+            if (pscan->fStop || pscan->nNext == STATS_SCAN_SLICES)
+                return;
+            pslice = pscan->vSlices[pscan->nNext++].get();
+        }
+        ScanCoinsSlice(pscan->psnapshot, pslice);
+        {
+            boost::unique_lock<boost::mutex> lock(pscan->cs);
+            pslice->fDone = true;
+        }
+        pscan->cond.notify_all();
+    }
+}
+}
+
+bool CCoinsViewDB::GetStats(CCoinsStats& stats) const
+{
+    // gettxoutsetinfo calls this after releasing cs_main, so the snapshot is not taken at the
+    // best block the caller flushed: more blocks may have been connected in between. The result
+    // is still consistent because coins and best block are written in a single batch and the
+    // best block reported is the one read from the snapshot, not chainActive's.
+    CLevelDBSnapshot snapshot(db);
+    uint256 hashBestBlock;
+    if (!snapshot.Read('B', hashBestBlock))
+        hashBestBlock = uint256(0);
+
+    {
+        LOCK(cs_stats);
+        if (fStatsCached && statsCached.hashBlock == hashBestBlock) {
+            stats = statsCached;
+            return true;
         }
     }
-    stats.nHeight = mapBlockIndex.find(GetBestBlock())->second->nHeight;
+
+    int nThreads = std::max(1, std::min((int)boost::thread::hardware_concurrency(), MAX_STATS_SCAN_THREADS));
+    int64_t nTimeStart = GetTimeMillis();
+    CCoinsStats statsNew;
+    if (!ScanStats(snapshot, hashBestBlock, statsNew, nThreads))
+        return false;
+
+    {
+        LOCK(cs_main);
+        BlockMap::const_iterator mi = mapBlockIndex.find(hashBestBlock);
+        if (mi != mapBlockIndex.end() && mi->second)
+            statsNew.nHeight = mi->second->nHeight;
+    }
+
+    LogPrint("coindb", "%s : scanned UTXO set at %s with %d threads in %dms\n", __func__, hashBestBlock.GetHex(), nThreads, GetTimeMillis() - nTimeStart);
+
+    LOCK(cs_stats);
+    statsCached = statsNew;
+    fStatsCached = true;
+    stats = statsNew;
+    return true;
+}
+
+bool CCoinsViewDB::ScanStats(CCoinsStats& stats, int nThreads) const
+{
+    CLevelDBSnapshot snapshot(db);
+    uint256 hashBestBlock;
+    if (!snapshot.Read('B', hashBestBlock))
+        hashBestBlock = uint256(0);
+    return ScanStats(snapshot, hashBestBlock, stats, nThreads);
+}
+
+bool CCoinsViewDB::ScanStats(const CLevelDBSnapshot& snapshot, const uint256& hashBestBlock, CCoinsStats& stats, int nThreads) const
+{
+    // Split the 'c' key space by the first byte of the txid. The threads scan up to two slices
+    // each ahead of the merge, which feeds the hash preimages to the writer in key order, so the
+    // resulting hash_serialized is the same as a single sequential scan would give.
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << hashBestBlock;
+    stats = CCoinsStats();
+    stats.hashBlock = hashBestBlock;
+
+    CCoinsStatsScan scan(&snapshot, 2 * nThreads);
+    std::string strError;
+    bool fInterrupted = false;
+    {
+        // The threads point into scan; do not let an interruption unwind it under them
+        boost::this_thread::disable_interruption di;
+        boost::thread_group scanThreads;
+        for (int i = 0; i < nThreads; i++)
+            scanThreads.create_thread(boost::bind(&ThreadScanCoins, &scan));
+
+        for (int i = 0; i < STATS_SCAN_SLICES; i++) {
+            CCoinsStatsSlice* pslice = scan.vSlices[i].get();
+            {
+                boost::unique_lock<boost::mutex> lock(scan.cs);
+                while (!pslice->fDone)
+                    scan.cond.wait(lock);
+            }
+            if (pslice->fError) {
+                strError = pslice->strError;
+                break;
+            }
+            if (!pslice->ssHash.empty())
+                ss.write(&pslice->ssHash[0], pslice->ssHash.size());
+            stats.nTransactions += pslice->nTransactions;
+            stats.nTransactionOutputs += pslice->nTransactionOutputs;
+            stats.nSerializedSize += pslice->nSerializedSize;
+            stats.nTotalAmount += pslice->nTotalAmount;
+            {
+                boost::unique_lock<boost::mutex> lock(scan.cs);
+                scan.vSlices[i].reset();
+                scan.nMerged++;
+            }
+            scan.cond.notify_all();
+            if (boost::this_thread::interruption_requested()) {
+                fInterrupted = true;
+                break;
+            }
+        }
+
+        {
+            boost::unique_lock<boost::mutex> lock(scan.cs);
+            scan.fStop = true;
+        }
+        scan.cond.notify_all();
+        scanThreads.join_all();
+    }
+    if (fInterrupted)
+        boost::this_thread::interruption_point();
+    if (!strError.empty())
+        return error("%s : Deserialize or I/O error - %s", __func__, strError);
+
     stats.hashSerialized = ss.GetHash();
-    stats.nTotalAmount = nTotalAmount;
     return true;
 }
 
@@ -183,6 +357,152 @@ bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos>
     return WriteBatch(batch);
 }
 
+static const char DB_ADDRESSINDEX = 'a';
+static const char DB_ADDRESSUNSPENTINDEX = 'u';
+static const char DB_SPENTINDEX = 'p';
+static const char DB_TIMESTAMPINDEX = 's';
+
+bool CBlockTreeDB::UpdateBlockIndexes(const std::vector<std::pair<CAddressIndexKey, CAmount> >& vAddressIndex,
+                                      const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& vAddressUnspentIndex,
+                                      const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >& vSpentIndex,
+                                      const CTimestampIndexKey* pTimestampKey, bool fConnect)
+{
+    CLevelDBBatch batch;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it = vAddressIndex.begin(); it != vAddressIndex.end(); it++) {
+        if (fConnect)
+            batch.Write(std::make_pair(DB_ADDRESSINDEX, it->first), it->second);
+        else
+            batch.Erase(std::make_pair(DB_ADDRESSINDEX, it->first));
+    }
+    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it = vAddressUnspentIndex.begin(); it != vAddressUnspentIndex.end(); it++) {
+        if (it->second.IsNull())
+            batch.Erase(std::make_pair(DB_ADDRESSUNSPENTINDEX, it->first));
+        else
+            batch.Write(std::make_pair(DB_ADDRESSUNSPENTINDEX, it->first), it->second);
+    }
+    for (std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >::const_iterator it = vSpentIndex.begin(); it != vSpentIndex.end(); it++) {
+        if (it->second.IsNull())
+            batch.Erase(std::make_pair(DB_SPENTINDEX, it->first));
+        else
+            batch.Write(std::make_pair(DB_SPENTINDEX, it->first), it->second);
+    }
+    if (pTimestampKey) {
+        if (fConnect)
+            batch.Write(std::make_pair(DB_TIMESTAMPINDEX, *pTimestampKey), '1');
+        else
+            batch.Erase(std::make_pair(DB_TIMESTAMPINDEX, *pTimestampKey));
+    }
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadAddressIndex(const uint160& addressHash, int nType, std::vector<std::pair<CAddressIndexKey, CAmount> >& vAddressIndex, int nStart, int nEnd)
+{
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(nType, addressHash, nStart > 0 ? nStart : 0));
+    pcursor->Seek(ssKeySet.str());
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            char chType;
+            CAddressIndexKey indexKey;
+            ssKey >> chType;
+            if (chType != DB_ADDRESSINDEX)
+                break;
+            ssKey >> indexKey;
+            if (indexKey.type != nType || indexKey.hashBytes != addressHash)
+                break;
+            if (nEnd > 0 && indexKey.blockHeight > nEnd)
+                break;
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+            CAmount nValue;
+            ssValue >> nValue;
+            vAddressIndex.emplace_back(indexKey, nValue);
+            pcursor->Next();
+        } catch (const std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+
+    return true;
+}
+
+bool CBlockTreeDB::ReadAddressUnspentIndex(const uint160& addressHash, int nType, std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& vUnspent)
+{
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << std::make_pair(DB_ADDRESSUNSPENTINDEX, CAddressUnspentIteratorKey(nType, addressHash));
+    pcursor->Seek(ssKeySet.str());
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            char chType;
+            CAddressUnspentKey indexKey;
+            ssKey >> chType;
+            if (chType != DB_ADDRESSUNSPENTINDEX)
+                break;
+            ssKey >> indexKey;
+            if (indexKey.type != nType || indexKey.hashBytes != addressHash)
+                break;
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+            CAddressUnspentValue value;
+            ssValue >> value;
+            vUnspent.emplace_back(indexKey, value);
+            pcursor->Next();
+        } catch (const std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+
+    return true;
+}
+
+bool CBlockTreeDB::ReadSpentIndex(const CSpentIndexKey& key, CSpentIndexValue& value)
+{
+    return Read(std::make_pair(DB_SPENTINDEX, key), value);
+}
+
+bool CBlockTreeDB::ReadTimestampIndex(unsigned int nHigh, unsigned int nLow, std::vector<uint256>& vHashes)
+{
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << std::make_pair(DB_TIMESTAMPINDEX, CTimestampIndexIteratorKey(nLow));
+    pcursor->Seek(ssKeySet.str());
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            char chType;
+            CTimestampIndexKey indexKey;
+            ssKey >> chType;
+            if (chType != DB_TIMESTAMPINDEX)
+                break;
+            ssKey >> indexKey;
+            if (indexKey.timestamp >= nHigh)
+                break;
+            vHashes.push_back(indexKey.blockHash);
+            pcursor->Next();
+        } catch (const std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+
+    return true;
+}
+
 bool CBlockTreeDB::WriteFlag(const std::string& name, bool fValue)
 {
     return Write(std::make_pair('F', name), fValue ? '1' : '0');
@@ -270,8 +590,48 @@ bool CBlockTreeDB::LoadBlockIndexGuts()
     return true;
 }
 
-CZerocoinDB::CZerocoinDB(size_t nCacheSize, bool fMemory, bool fWipe) : CLevelDBWrapper(GetDataDir() / "zerocoin", nCacheSize, fMemory, fWipe)
+CZerocoinDB::CZerocoinDB(size_t nCacheSize, bool fMemory, bool fWipe) : CLevelDBWrapper(GetDataDir() / "zerocoin", nCacheSize, fMemory, fWipe), fSpendsLoaded(false)
+{
+    fSpendsLoaded = LoadCoinSpends();
+    if (!fSpendsLoaded)
+        LogPrintf("%s : failed to load the zerocoin spends, serials will be looked up on disk\n", __func__);
+}
+
+bool CZerocoinDB::LoadCoinSpends()
 {
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << std::make_pair('s', uint256(0));
+    pcursor->Seek(ssKeySet.str());
+
+    LOCK(cs_spends);
+    mapSpends.clear();
+    size_t nLegacy = 0;
+    for (; pcursor->Valid(); pcursor->Next()) {
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            char chType;
+            ssKey >> chType;
+            if (chType != 's')
+                break;
+            uint256 hashSerial;
+            ssKey >> hashSerial;
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+            CZerocoinSpendRecord record;
+            ssValue >> record;
+            if (!record.HasBlock())
+                nLegacy++;
+            mapSpends[hashSerial] = record;
+        } catch (const std::exception& e) {
+            mapSpends.clear();
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+
+    LogPrintf("Loaded %u zerocoin spends, %u without block (-reindexzerocoin adds it)\n", (unsigned int)mapSpends.size(), (unsigned int)nLegacy);
+    return true;
 }
 
 bool CZerocoinDB::WriteCoinMintBatch(const std::vector<std::pair<libzerocoin::PublicCoin, uint256> >& mintInfo)
@@ -299,50 +659,122 @@ bool CZerocoinDB::ReadCoinMint(const uint256& hashPubcoin, uint256& hashTx)
     return Read(std::make_pair('m', hashPubcoin), hashTx);
 }
 
+bool CZerocoinDB::ReadCoinMints(const std::vector<uint256>& vHashPubcoin, std::map<uint256, uint256>& mapTxHashes)
+{
+    // Seek in key order so the cursor only ever moves forward through the 'm' records
+    std::vector<std::pair<std::string, uint256> > vKeys;
+    vKeys.reserve(vHashPubcoin.size());
+    for (const uint256& hashPubcoin : vHashPubcoin) {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey << std::make_pair('m', hashPubcoin);
+        vKeys.push_back(std::make_pair(ssKey.str(), hashPubcoin));
+    }
+    std::sort(vKeys.begin(), vKeys.end());
+
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+    for (const auto& key : vKeys) {
+        pcursor->Seek(key.first);
+        if (!pcursor->Valid())
+            break;
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            if (slKey != leveldb::Slice(key.first))
+                continue;
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+            uint256 hashTx;
+            ssValue >> hashTx;
+            mapTxHashes[key.second] = hashTx;
+        } catch (const std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+
+    return true;
+}
+
 bool CZerocoinDB::EraseCoinMint(const CBigNum& bnPubcoin)
 {
     uint256 hash = GetPubCoinHash(bnPubcoin);
     return Erase(std::make_pair('m', hash));
 }
 
-bool CZerocoinDB::WriteCoinSpendBatch(const std::vector<std::pair<libzerocoin::CoinSpend, uint256> >& spendInfo)
+bool CZerocoinDB::WriteCoinSpendBatch(const std::vector<std::pair<libzerocoin::CoinSpend, uint256> >& spendInfo, const uint256& hashBlock, int nHeight, bool fSync)
 {
     CLevelDBBatch batch;
-    size_t count = 0;
+    std::vector<std::pair<uint256, CZerocoinSpendRecord> > vRecords;
     for (std::vector<std::pair<libzerocoin::CoinSpend, uint256> >::const_iterator it=spendInfo.begin(); it != spendInfo.end(); it++) {
-        CBigNum bnSerial = it->first.getCoinSerialNumber();
-        CDataStream ss(SER_GETHASH, 0);
-        ss << bnSerial;
-        uint256 hash = Hash(ss.begin(), ss.end());
-        batch.Write(std::make_pair('s', hash), it->second);
-        ++count;
+        uint256 hash = GetSerialHash(it->first.getCoinSerialNumber());
+        CZerocoinSpendRecord record(it->second, hashBlock, nHeight);
+        batch.Write(std::make_pair('s', hash), record);
+        vRecords.push_back(std::make_pair(hash, record));
     }
 
-    LogPrint("zero", "Writing %u coin spends to db.\n", (unsigned int)count);
-    return WriteBatch(batch, true);
+    LogPrint("zero", "Writing %u coin spends to db.\n", (unsigned int)vRecords.size());
+    if (!WriteBatch(batch, fSync))
+        return false;
+
+    LOCK(cs_spends);
+    for (const std::pair<uint256, CZerocoinSpendRecord>& entry : vRecords)
+        mapSpends[entry.first] = entry.second;
+    return true;
 }
 
 bool CZerocoinDB::ReadCoinSpend(const CBigNum& bnSerial, uint256& txHash)
 {
-    CDataStream ss(SER_GETHASH, 0);
-    ss << bnSerial;
-    uint256 hash = Hash(ss.begin(), ss.end());
-
-    return Read(std::make_pair('s', hash), txHash);
+    return ReadCoinSpend(GetSerialHash(bnSerial), txHash);
 }
 
 bool CZerocoinDB::ReadCoinSpend(const uint256& hashSerial, uint256 &txHash)
 {
-    return Read(std::make_pair('s', hashSerial), txHash);
+    CZerocoinSpendRecord record;
+    if (!ReadCoinSpend(hashSerial, record))
+        return false;
+    txHash = record.txid;
+    return true;
+}
+
+bool CZerocoinDB::ReadCoinSpend(const uint256& hashSerial, CZerocoinSpendRecord& record) const
+{
+    LOCK(cs_spends);
+    auto it = mapSpends.find(hashSerial);
+    if (it != mapSpends.end()) {
+        record = it->second;
+        return true;
+    }
+    if (fSpendsLoaded)
+        return false;
+    if (!Read(std::make_pair('s', hashSerial), record))
+        return false;
+    mapSpends[hashSerial] = record;
+    return true;
+}
+
+void CZerocoinDB::SetCoinSpendBlock(const uint256& hashSerial, const uint256& hashBlock, int nHeight)
+{
+    LOCK(cs_spends);
+    auto it = mapSpends.find(hashSerial);
+    if (it != mapSpends.end() && !it->second.HasBlock()) {
+        it->second.hashBlock = hashBlock;
+        it->second.nHeight = nHeight;
+    }
+}
+
+size_t CZerocoinDB::GetCoinSpendCount() const
+{
+    LOCK(cs_spends);
+    return mapSpends.size();
 }
 
 bool CZerocoinDB::EraseCoinSpend(const CBigNum& bnSerial)
 {
-    CDataStream ss(SER_GETHASH, 0);
-    ss << bnSerial;
-    uint256 hash = Hash(ss.begin(), ss.end());
+    uint256 hash = GetSerialHash(bnSerial);
+    if (!Erase(std::make_pair('s', hash)))
+        return false;
 
-    return Erase(std::make_pair('s', hash));
+    LOCK(cs_spends);
+    mapSpends.erase(hash);
+    return true;
 }
 
 bool CZerocoinDB::WipeCoins(std::string strType)
@@ -366,10 +798,8 @@ bool CZerocoinDB::WipeCoins(std::string strType)
             char chType;
             ssKey >> chType;
             if (chType == type) {
-                leveldb::Slice slValue = pcursor->value();
-                CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
                 uint256 hash;
-                ssValue >> hash;
+                ssKey >> hash;
                 setDelete.insert(hash);
                 pcursor->Next();
             } else {
@@ -385,6 +815,11 @@ bool CZerocoinDB::WipeCoins(std::string strType)
             LogPrintf("%s: error failed to delete %s\n", __func__, hash.GetHex());
     }
 
+    if (type == 's') {
+        LOCK(cs_spends);
+        mapSpends.clear();
+    }
+
     return true;
 }
 
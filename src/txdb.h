@@ -7,8 +7,12 @@
 #ifndef BITCOIN_TXDB_H
 #define BITCOIN_TXDB_H
 
+#include "addressindex.h"
 #include "leveldbwrapper.h"
 #include "main.h"
+#include "spentindex.h"
+#include "sync.h"
+#include "timestampindex.h"
 #include "zpiv/zerocoin.h"
 
 #include <map>
@@ -25,6 +29,10 @@ static const int64_t nDefaultDbCache = 100;
 static const int64_t nMaxDbCache = sizeof(void*) > 4 ? 4096 : 1024;
 //! min. -dbcache in (MiB)
 static const int64_t nMinDbCache = 4;
+//! number of key ranges the coin database is split into for GetStats
+static const int STATS_SCAN_SLICES = 64;
+//! max. threads used to scan the coin database for GetStats
+static const int MAX_STATS_SCAN_THREADS = 8;
 
 struct CDiskTxPos : public CDiskBlockPos {
     unsigned int nTxOffset; // after header
@@ -60,6 +68,13 @@ class CCoinsViewDB : public CCoinsView
 protected:
     CLevelDBWrapper db;
 
+    //! result of the last UTXO set scan, reused while the best block does not change
+    mutable CCriticalSection cs_stats;
+    mutable CCoinsStats statsCached;
+    mutable bool fStatsCached;
+
+    bool ScanStats(const CLevelDBSnapshot& snapshot, const uint256& hashBestBlock, CCoinsStats& stats, int nThreads) const;
+
 public:
     CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
 
@@ -67,7 +82,10 @@ public:
     bool HaveCoins(const uint256& txid) const;
     uint256 GetBestBlock() const;
     bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock);
+    //! Scans a snapshot of the database in parallel; does not require cs_main
     bool GetStats(CCoinsStats& stats) const;
+    //! Scans a new snapshot with nThreads threads, bypassing the cache; nHeight is left at 0
+    bool ScanStats(CCoinsStats& stats, int nThreads) const;
 };
 
 /** Access to the block database (blocks/index/) */
@@ -89,6 +107,21 @@ public:
     bool ReadReindexing(bool& fReindex);
     bool ReadTxIndex(const uint256& txid, CDiskTxPos& pos);
     bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >& list);
+    /**
+     * Connect (fConnect) or disconnect a block in the address, spent and timestamp indexes with one
+     * write, so they never disagree. Address index entries are written or erased; unspent and spent
+     * entries with a null value are erased, the others written; pTimestampKey may be NULL.
+     */
+    bool UpdateBlockIndexes(const std::vector<std::pair<CAddressIndexKey, CAmount> >& vAddressIndex,
+                            const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& vAddressUnspentIndex,
+                            const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >& vSpentIndex,
+                            const CTimestampIndexKey* pTimestampKey, bool fConnect);
+    /** Balance changes of an address, in chain order, optionally limited to heights [nStart, nEnd] */
+    bool ReadAddressIndex(const uint160& addressHash, int nType, std::vector<std::pair<CAddressIndexKey, CAmount> >& vAddressIndex, int nStart = 0, int nEnd = 0);
+    bool ReadAddressUnspentIndex(const uint160& addressHash, int nType, std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& vUnspent);
+    bool ReadSpentIndex(const CSpentIndexKey& key, CSpentIndexValue& value);
+    /** Hashes of the active chain blocks with a timestamp in [nLow, nHigh), in time order */
+    bool ReadTimestampIndex(unsigned int nHigh, unsigned int nLow, std::vector<uint256>& vHashes);
     bool WriteFlag(const std::string& name, bool fValue);
     bool ReadFlag(const std::string& name, bool& fValue);
     bool WriteInt(const std::string& name, int nValue);
@@ -96,6 +129,48 @@ public:
     bool LoadBlockIndexGuts();
 };
 
+/**
+ * Where a zerocoin serial was spent. Records written before the block hash and
+ * height were added only hold the txid; they read back with a null hashBlock.
+ */
+struct CZerocoinSpendRecord {
+    uint256 txid;
+    uint256 hashBlock;
+    int nHeight;
+
+    CZerocoinSpendRecord() : txid(0), hashBlock(0), nHeight(-1) {}
+    CZerocoinSpendRecord(const uint256& txidIn, const uint256& hashBlockIn, int nHeightIn) : txid(txidIn), hashBlock(hashBlockIn), nHeight(nHeightIn) {}
+
+    bool HasBlock() const { return hashBlock != 0; }
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const
+    {
+        CSizeComputer s(nType, nVersion);
+        Serialize(s, nType, nVersion);
+        return s.size();
+    }
+
+    template <typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        ::Serialize(s, txid, nType, nVersion);
+        ::Serialize(s, hashBlock, nType, nVersion);
+        ::Serialize(s, nHeight, nType, nVersion);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion)
+    {
+        ::Unserialize(s, txid, nType, nVersion);
+        hashBlock = 0;
+        nHeight = -1;
+        if (s.empty())
+            return;
+        ::Unserialize(s, hashBlock, nType, nVersion);
+        ::Unserialize(s, nHeight, nType, nVersion);
+    }
+};
+
 /** Zerocoin database (zerocoin/) */
 class CZerocoinDB : public CLevelDBWrapper
 {
@@ -106,15 +181,34 @@ private:
     CZerocoinDB(const CZerocoinDB&);
     void operator=(const CZerocoinDB&);
 
+    /**
+     * Every spend record by serial hash, loaded when the database is opened and
+     * kept in step with it, so spend lookups never touch the disk. If loading
+     * failed, the map only caches records and a serial missing from it is read
+     * from disk.
+     */
+    mutable CCriticalSection cs_spends;
+    mutable boost::unordered_map<uint256, CZerocoinSpendRecord, BlockHasher> mapSpends;
+    bool fSpendsLoaded;
+
+    bool LoadCoinSpends();
+
 public:
     /** Write zYODA mints to the zerocoinDB in a batch */
     bool WriteCoinMintBatch(const std::vector<std::pair<libzerocoin::PublicCoin, uint256> >& mintInfo);
     bool ReadCoinMint(const CBigNum& bnPubcoin, uint256& txHash);
     bool ReadCoinMint(const uint256& hashPubcoin, uint256& hashTx);
-    /** Write zYODA spends to the zerocoinDB in a batch */
-    bool WriteCoinSpendBatch(const std::vector<std::pair<libzerocoin::CoinSpend, uint256> >& spendInfo);
+    /** Look up many mints with a single cursor; only the pubcoin hashes found are added to mapTxHashes */
+    bool ReadCoinMints(const std::vector<uint256>& vHashPubcoin, std::map<uint256, uint256>& mapTxHashes);
+    /** Write zYODA spends, all confirmed in the block hashBlock at nHeight, to the zerocoinDB in a batch */
+    bool WriteCoinSpendBatch(const std::vector<std::pair<libzerocoin::CoinSpend, uint256> >& spendInfo, const uint256& hashBlock, int nHeight, bool fSync = true);
     bool ReadCoinSpend(const CBigNum& bnSerial, uint256& txHash);
     bool ReadCoinSpend(const uint256& hashSerial, uint256 &txHash);
+    /** Spend record of a serial, from memory when all of them are loaded */
+    bool ReadCoinSpend(const uint256& hashSerial, CZerocoinSpendRecord& record) const;
+    /** Remember where a legacy record was confirmed, for this session only */
+    void SetCoinSpendBlock(const uint256& hashSerial, const uint256& hashBlock, int nHeight);
+    size_t GetCoinSpendCount() const;
     bool EraseCoinMint(const CBigNum& bnPubcoin);
     bool EraseCoinSpend(const CBigNum& bnSerial);
     bool WipeCoins(std::string strType);
@@ -8,6 +8,7 @@
 
 #include "clientversion.h"
 #include "main.h"
+#include "metrics.h"
 #include "streams.h"
 #include "util.h"
 #include "utilmoneystr.h"
@@ -416,6 +417,8 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry& entry)
         }
         nTransactionsUpdated++;
         totalTxSize += entry.GetTxSize();
+        metrics::mempoolTransactions.Set(mapTx.size());
+        metrics::mempoolBytes.Set(totalTxSize);
     }
     return true;
 }
@@ -462,6 +465,8 @@ void CTxMemPool::remove(const CTransaction& origTx, std::list<CTransaction>& rem
             mapTx.erase(hash);
             nTransactionsUpdated++;
         }
+        metrics::mempoolTransactions.Set(mapTx.size());
+        metrics::mempoolBytes.Set(totalTxSize);
     }
 }
 
@@ -535,6 +540,8 @@ void CTxMemPool::clear()
     mapNextTx.clear();
     totalTxSize = 0;
     ++nTransactionsUpdated;
+    metrics::mempoolTransactions.Set(0);
+    metrics::mempoolBytes.Set(0);
 }
 
 void CTxMemPool::check(const CCoinsViewCache* pcoins) const
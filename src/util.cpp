@@ -13,12 +13,16 @@
 
 #include "allocators.h"
 #include "chainparamsbase.h"
+#include "logring.h"
 #include "random.h"
 #include "sync.h"
 #include "utilstrencodings.h"
 #include "utiltime.h"
 
+#include <chrono>
+#include <exception>
 #include <stdarg.h>
+#include <thread>
 
 #include <boost/date_time/posix_time/posix_time.hpp>
 
@@ -36,6 +40,7 @@
 #endif // __linux__
 
 #include <algorithm>
+#include <atomic>
 #include <fcntl.h>
 #include <sys/resource.h>
 #include <sys/stat.h>
@@ -180,7 +185,15 @@ static boost::once_flag debugPrintInitFlag = BOOST_ONCE_INIT;
  * in a thread-safe manner the first time called:
  */
 static FILE* fileout = NULL;
+//! Held by whoever writes to debug.log: the log thread, or a caller writing directly
 static boost::mutex* mutexDebugLog = NULL;
+static boost::condition_variable* condDebugLog = NULL;
+static CLogRing* pDebugLogRing = NULL;
+static boost::thread* pthreadDebugLog = NULL;
+//! Whether lines go through pDebugLogRing to the log thread
+static std::atomic<bool> fDebugLogAsync(false);
+//! Lines dropped since the last write
+static std::atomic<uint64_t> nDebugLogDropped(0);
 
 static void DebugPrintInit()
 {
@@ -192,6 +205,108 @@ static void DebugPrintInit()
     if (fileout) setbuf(fileout, NULL); // unbuffered
 
     mutexDebugLog = new boost::mutex();
+    condDebugLog = new boost::condition_variable();
+    pDebugLogRing = new CLogRing(LOG_RING_SIZE);
+}
+
+/** Write to debug.log, reopening it first if requested; mutexDebugLog must be held */
+static int WriteDebugLog(const std::string& str)
+{
+    if (fReopenDebugLog) {
+        fReopenDebugLog = false;
+        boost::filesystem::path pathDebug = GetDataDir() / "debug.log";
+        if (freopen(pathDebug.string().c_str(), "a", fileout) != NULL)
+            setbuf(fileout, NULL); // unbuffered
+    }
+    return fwrite(str.data(), 1, str.size(), fileout);
+}
+
+/** Write everything queued with a single write; mutexDebugLog must be held */
+static void DrainDebugLog()
+{
+    std::string strBatch, str;
+    while (pDebugLogRing->Pop(str))
+        strBatch += str;
+    uint64_t nDropped = nDebugLogDropped.exchange(0);
+    if (nDropped)
+        strBatch += strprintf("%s%u debug log lines dropped, the log queue was full\n",
+            fLogTimestamps ? DateTimeStrFormat("%Y-%m-%d %H:%M:%S ", GetTime()) : "", nDropped);
+    if (!strBatch.empty())
+        WriteDebugLog(strBatch);
+}
+
+static void ThreadDebugLog()
+{
+    util::ThreadRename("yoda-log");
+    boost::mutex::scoped_lock lock(*mutexDebugLog);
+    while (fDebugLogAsync) {
+        DrainDebugLog();
+        condDebugLog->timed_wait(lock, boost::posix_time::milliseconds(LOG_FLUSH_INTERVAL));
+    }
+    DrainDebugLog();
+}
+
+static std::terminate_handler prevTerminateHandler = NULL;
+
+/**
+ * std::terminate() is the last point a dying process still runs ordinary code. The terminating
+ * thread may hold the log mutex itself, so wait for it a bounded time only.
+ */
+[[noreturn]] static void TerminateFlushDebugLog()
+{
+    for (int i = 0; i < 100; i++) {
+        if (mutexDebugLog->try_lock()) {
+            DrainDebugLog();
+            fflush(fileout);
+            mutexDebugLog->unlock();
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    if (prevTerminateHandler)
+        prevTerminateHandler();
+    abort();
+}
+
+void StartDebugLogThread()
+{
+    if (fPrintToConsole || !fPrintToDebugLog || !AreBaseParamsConfigured())
+        return;
+    boost::call_once(&DebugPrintInit, debugPrintInitFlag);
+    if (fileout == NULL || pthreadDebugLog)
+        return;
+
+    // Lines still queued when the process exits are written by whoever calls exit() or
+    // std::terminate(). Fatal signals are left alone: nothing here is async-signal-safe.
+    static bool fAtExit = false;
+    if (!fAtExit) {
+        fAtExit = true;
+        atexit(FlushDebugLog);
+        prevTerminateHandler = std::set_terminate(TerminateFlushDebugLog);
+    }
+    fDebugLogAsync = true;
+    pthreadDebugLog = new boost::thread(&ThreadDebugLog);
+}
+
+void StopDebugLogThread()
+{
+    if (!pthreadDebugLog)
+        return;
+    fDebugLogAsync = false;
+    condDebugLog->notify_one();
+    pthreadDebugLog->join();
+    delete pthreadDebugLog;
+    pthreadDebugLog = NULL;
+    FlushDebugLog();
+}
+
+void FlushDebugLog()
+{
+    if (fileout == NULL)
+        return;
+    boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
+    DrainDebugLog();
+    fflush(fileout);
 }
 
 bool LogAcceptCategory(const char* category)
@@ -230,7 +345,7 @@ bool LogAcceptCategory(const char* category)
     return true;
 }
 
-int LogPrintStr(const std::string& str)
+int LogPrintStr(const std::string& str, bool fDroppable)
 {
     int ret = 0; // Returns total number of characters written
     if (fPrintToConsole) {
@@ -238,31 +353,38 @@ int LogPrintStr(const std::string& str)
         ret = fwrite(str.data(), 1, str.size(), stdout);
         fflush(stdout);
     } else if (fPrintToDebugLog && AreBaseParamsConfigured()) {
-        static bool fStartedNewLine = true;
+        static std::atomic<bool> fStartedNewLine(true);
         boost::call_once(&DebugPrintInit, debugPrintInitFlag);
 
         if (fileout == NULL)
             return ret;
 
-        boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
-
-        // reopen the log file, if requested
-        if (fReopenDebugLog) {
-            fReopenDebugLog = false;
-            boost::filesystem::path pathDebug = GetDataDir() / "debug.log";
-            if (freopen(pathDebug.string().c_str(), "a", fileout) != NULL)
-                setbuf(fileout, NULL); // unbuffered
+        // Debug print useful for profiling
+        std::string strLine;
+        bool fNewLine = !str.empty() && str[str.size() - 1] == '\n';
+        if (fStartedNewLine.exchange(fNewLine) && fLogTimestamps)
+            strLine = DateTimeStrFormat("%Y-%m-%d %H:%M:%S ", GetTime());
+        strLine += str;
+        ret = strLine.size();
+
+        if (fDebugLogAsync) {
+            if (pDebugLogRing->Push(strLine)) {
+                // The log thread wakes up on its own, unless the queue fills up faster than that
+                if (pDebugLogRing->Size() > pDebugLogRing->Capacity() / 2)
+                    condDebugLog->notify_one();
+                return ret;
+            }
+            // Overloaded: category output is dropped, everything else is written here and now
+            if (fDroppable) {
+                nDebugLogDropped++;
+                return 0;
+            }
         }
 
-        // Debug print useful for profiling
-        if (fLogTimestamps && fStartedNewLine)
-            ret += fprintf(fileout, "%s ", DateTimeStrFormat("%Y-%m-%d %H:%M:%S", GetTime()).c_str());
-        if (!str.empty() && str[str.size() - 1] == '\n')
-            fStartedNewLine = true;
-        else
-            fStartedNewLine = false;
-
-        ret = fwrite(str.data(), 1, str.size(), fileout);
+        boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
+        // Queued lines go first, so the log stays in order
+        DrainDebugLog();
+        ret = WriteDebugLog(strLine);
     }
 
     return ret;
@@ -391,6 +513,7 @@ void PrintExceptionContinue(const std::exception* pex, const char* pszThread)
     std::string message = FormatException(pex, pszThread);
     LogPrintf("\n\n************************\n%s\n", message);
     fprintf(stderr, "\n\n************************\n%s\n", message.c_str());
+    FlushDebugLog();
     strMiscWarning = message;
 }
 
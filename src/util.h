@@ -57,10 +57,26 @@ extern volatile bool fReopenDebugLog;
 void SetupEnvironment();
 bool SetupNetworking();
 
+/** Default for -logasync */
+static const bool DEFAULT_LOGASYNC = true;
+/** Number of lines the debug.log queue holds before output is dropped or written directly */
+static const size_t LOG_RING_SIZE = 16384;
+/** Milliseconds between the writes of the debug.log thread */
+static const int LOG_FLUSH_INTERVAL = 100;
+
 /** Return true if log accepts specified category */
 bool LogAcceptCategory(const char* category);
-/** Send a string to the log output */
-int LogPrintStr(const std::string& str);
+/**
+ * Send a string to the log output. While the debug.log thread runs, the line is queued for
+ * it; if the queue is full, droppable lines are counted and dropped, others written directly.
+ */
+int LogPrintStr(const std::string& str, bool fDroppable = false);
+/** Write debug.log from a background thread, with batched writes. Queued lines are still written on exit and std::terminate(). */
+void StartDebugLogThread();
+/** Write everything still queued and go back to writing from the caller */
+void StopDebugLogThread();
+/** Write everything queued for debug.log now */
+void FlushDebugLog();
 
 #define LogPrintf(...) LogPrint(NULL, __VA_ARGS__)
 
@@ -83,7 +99,7 @@ template<typename... Args> std::string FormatStringFromLogArgs(const char *fmt,
         } catch (std::runtime_error &e) {                                                       \
             _log_msg_ = "Error \"" + std::string(e.what()) + "\" while formatting log message: " + FormatStringFromLogArgs(format, TINYFORMAT_PASSARGS(n));\
         }                                                                                       \
-        return LogPrintStr(_log_msg_);                                                          \
+        return LogPrintStr(_log_msg_, category != NULL);                                        \
     }                                                                                           \
     /**   Log error and return false */                                                         \
     template <TINYFORMAT_ARGTYPES(n)>                                                           \
@@ -108,7 +124,7 @@ TINYFORMAT_FOREACH_ARGNUM(MAKE_ERROR_AND_LOG_FUNC)
 static inline int LogPrint(const char* category, const char* format)
 {
     if (!LogAcceptCategory(category)) return 0;
-    return LogPrintStr(format);
+    return LogPrintStr(format, category != NULL);
 }
 static inline bool error(const char* format)
 {
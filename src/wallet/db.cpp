@@ -54,7 +54,7 @@ void CDBEnv::Reset()
     fMockDb = false;
 }
 
-CDBEnv::CDBEnv() : dbenv(NULL)
+CDBEnv::CDBEnv() : dbenv(NULL), fWriteBehind(false)
 {
     Reset();
 }
@@ -223,8 +223,54 @@ void CDBEnv::CheckpointLSN(const std::string& strFile)
     dbenv->lsn_reset(strFile.c_str(), 0);
 }
 
+void CDBEnv::Queue(const std::string& strFile, const CDBBatch& batch)
+{
+    LOCK(cs_queue);
+    CWriteQueue& queue = mapQueue[strFile];
+    if (queue.batch.Empty())
+        queue.nOldestTime = GetTimeMillis();
+    queue.batch.Merge(batch);
+}
+
+bool CDBEnv::ReadQueued(const std::string& strFile, const CSerializeData& key, bool& fErase, CSerializeData& value)
+{
+    LOCK(cs_queue);
+    std::map<std::string, CWriteQueue>::const_iterator it = mapQueue.find(strFile);
+    if (it == mapQueue.end())
+        return false;
+    return it->second.batch.Lookup(key, fErase, value) || it->second.batchCommitting.Lookup(key, fErase, value);
+}
+
+void CDBEnv::Unqueue(const std::string& strFile, const CSerializeData& key)
+{
+    LOCK(cs_queue);
+    std::map<std::string, CWriteQueue>::iterator it = mapQueue.find(strFile);
+    if (it != mapQueue.end())
+        it->second.batch.Remove(key);
+}
 
-CDB::CDB(const std::string& strFilename, const char* pszMode, bool fFlushOnCloseIn) : pdb(NULL), activeTxn(NULL)
+bool CDBEnv::IsQueueDue(const std::string& strFile, bool fAll)
+{
+    LOCK(cs_queue);
+    std::map<std::string, CWriteQueue>::const_iterator it = mapQueue.find(strFile);
+    if (it == mapQueue.end() || it->second.batch.Empty())
+        return false;
+    return fAll || it->second.batch.Size() >= MAX_WRITE_BEHIND_KEYS ||
+           GetTimeMillis() - it->second.nOldestTime >= WRITE_BEHIND_DELAY;
+}
+
+std::vector<std::string> CDBEnv::GetQueuedFiles()
+{
+    LOCK(cs_queue);
+    std::vector<std::string> vFiles;
+    for (const auto& entry : mapQueue)
+        if (!entry.second.batch.Empty())
+            vFiles.push_back(entry.first);
+    return vFiles;
+}
+
+
+CDB::CDB(const std::string& strFilename, const char* pszMode, bool fFlushOnCloseIn) : pdb(NULL), activeTxn(NULL), pbatch(NULL)
 {
     int ret;
     fReadOnly = (!strchr(pszMode, '+') && !strchr(pszMode, 'w'));
@@ -297,6 +343,133 @@ void CDB::Flush()
     bitdb.dbenv->txn_checkpoint(nMinutes ? GetArg("-dblogsize", 100) * 1024 : 0, nMinutes, 0);
 }
 
+bool CDB::ReadPending(const CDataStream& ssKey, bool& fErase, CSerializeData& value)
+{
+    CSerializeData key(ssKey.begin(), ssKey.end());
+    if (pbatch && pbatch->Lookup(key, fErase, value))
+        return true;
+    return bitdb.ReadQueued(strFile, key, fErase, value);
+}
+
+bool CDB::SupersedeQueued(const CDataStream& ssKey)
+{
+    CSerializeData key(ssKey.begin(), ssKey.end());
+    bool fErase;
+    CSerializeData value;
+    if (!bitdb.ReadQueued(strFile, key, fErase, value))
+        return true;
+
+    // Inside a transaction the queue can't be committed on its own, as it would
+    // wait for our locks. TxnBegin committed what was queued before, so drop
+    // the update that was queued since; ours replaces it.
+    if (activeTxn) {
+        bitdb.Unqueue(strFile, key);
+        return true;
+    }
+    return CommitQueued(false);
+}
+
+bool CDB::BatchBegin()
+{
+    if (!pdb || pbatch)
+        return false;
+    pbatch = new CDBBatch();
+    return true;
+}
+
+bool CDB::BatchCommit(bool fSync)
+{
+    if (!pdb || !pbatch)
+        return false;
+    bool fOk = WriteBatch(*pbatch, fSync);
+    BatchAbort();
+    return fOk;
+}
+
+void CDB::BatchAbort()
+{
+    delete pbatch;
+    pbatch = NULL;
+}
+
+bool CDB::WriteBatch(const CDBBatch& batch, bool fSync)
+{
+    if (!pdb)
+        return false;
+    if (fReadOnly)
+        assert(!"WriteBatch called on database in read-only mode");
+    if (batch.Empty())
+        return true;
+
+    DbTxn* ptxn = activeTxn;
+    if (!ptxn && !(ptxn = bitdb.TxnBegin()))
+        return false;
+    for (const auto& op : batch.GetOps()) {
+        Dbt datKey(const_cast<char*>(op.first.data()), op.first.size());
+        int ret;
+        if (op.second.first) {
+            ret = pdb->del(ptxn, &datKey, 0);
+            if (ret == DB_NOTFOUND)
+                ret = 0;
+        } else {
+            Dbt datValue(const_cast<char*>(op.second.second.data()), op.second.second.size());
+            ret = pdb->put(ptxn, &datKey, &datValue, 0);
+        }
+        if (ret != 0) {
+            LogPrintf("CDB::WriteBatch : Error %d writing to %s\n", ret, strFile);
+            if (ptxn != activeTxn)
+                ptxn->abort();
+            return false;
+        }
+    }
+    if (ptxn == activeTxn)
+        return true;
+    return ptxn->commit(fSync ? DB_TXN_SYNC : 0) == 0;
+}
+
+bool CDB::CommitQueued(bool fSync)
+{
+    if (!pdb)
+        return false;
+
+    // Only the holder of cs_queue_commit changes batchCommitting, so it can be
+    // written without holding cs_queue; map nodes stay where they are.
+    LOCK(bitdb.cs_queue_commit);
+    CDBEnv::CWriteQueue* pqueue;
+    {
+        LOCK(bitdb.cs_queue);
+        std::map<std::string, CDBEnv::CWriteQueue>::iterator it = bitdb.mapQueue.find(strFile);
+        if (it == bitdb.mapQueue.end() || it->second.batch.Empty())
+            return true;
+        pqueue = &it->second;
+        std::swap(pqueue->batchCommitting, pqueue->batch);
+    }
+
+    int64_t nStart = GetTimeMillis();
+    bool fOk = WriteBatch(pqueue->batchCommitting, fSync);
+    LogPrint("db", "CDB::CommitQueued : %s %u keys to %s in %dms\n", fOk ? "committed" : "failed to commit",
+        pqueue->batchCommitting.Size(), strFile, GetTimeMillis() - nStart);
+
+    LOCK(bitdb.cs_queue);
+    if (!fOk) {
+        // Keep the updates, under anything queued since
+        if (pqueue->batch.Empty())
+            pqueue->nOldestTime = GetTimeMillis();
+        pqueue->batchCommitting.Merge(pqueue->batch);
+        std::swap(pqueue->batchCommitting, pqueue->batch);
+    }
+    pqueue->batchCommitting.Clear();
+    return fOk;
+}
+
+bool CDB::FlushQueued(const std::string& strFile, bool fSync)
+{
+    if (!bitdb.IsQueueDue(strFile, true))
+        return true;
+    CDB db(strFile, "r+", false);
+    return db.CommitQueued(fSync);
+}
+
 void CDB::Close()
 {
     if (!pdb)
@@ -304,6 +477,7 @@ void CDB::Close()
     if (activeTxn)
         activeTxn->abort();
     activeTxn = NULL;
+    BatchAbort();
     pdb = NULL;
 
     if (fFlushOnClose)
@@ -340,6 +514,9 @@ bool CDBEnv::RemoveDb(const std::string& strFile)
 
 bool CDB::Rewrite(const std::string& strFile, const char* pszSkip)
 {
+    if (!FlushQueued(strFile))
+        return false;
+
     while (true) {
         {
             LOCK(bitdb.cs_db);
@@ -429,6 +606,9 @@ void CDBEnv::Flush(bool fShutdown)
     LogPrint("db", "CDBEnv::Flush : Flush(%s)%s\n", fShutdown ? "true" : "false", fDbEnvInit ? "" : " database not started");
     if (!fDbEnvInit)
         return;
+    for (const std::string& strFile : GetQueuedFiles())
+        if (!CDB::FlushQueued(strFile))
+            LogPrintf("CDBEnv::Flush : Failed to commit queued writes to %s\n", strFile);
     {
         LOCK(cs_db);
         std::map<std::string, int>::iterator mi = mapFileUseCount.begin();
@@ -13,6 +13,7 @@
 #include "sync.h"
 #include "version.h"
 
+#include <atomic>
 #include <map>
 #include <string>
 #include <vector>
@@ -28,8 +29,76 @@ struct CBlockLocator;
 
 extern unsigned int nWalletDBUpdated;
 
+/** Queued writes are committed once the oldest of them is this old (in milliseconds) */
+static const int64_t WRITE_BEHIND_DELAY = 1000;
+/** ...or once this many keys are queued for a file */
+static const size_t MAX_WRITE_BEHIND_KEYS = 1000;
+
 void ThreadFlushWalletDB(const std::string& strWalletFile);
 
+/**
+ * Writes and erases collected in memory, to be committed to a database in a
+ * single transaction. A later operation on a key replaces the earlier one.
+ */
+class CDBBatch
+{
+public:
+    //! Serialized key -> (erase, serialized value)
+    typedef std::map<CSerializeData, std::pair<bool, CSerializeData> > OpMap;
+
+private:
+    OpMap mapOps;
+
+public:
+    template <typename K, typename T>
+    void Write(const K& key, const T& value)
+    {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey << key;
+        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        ssValue.reserve(10000);
+        ssValue << value;
+        std::pair<bool, CSerializeData>& op = mapOps[CSerializeData(ssKey.begin(), ssKey.end())];
+        op.first = false;
+        op.second.assign(ssValue.begin(), ssValue.end());
+    }
+
+    template <typename K>
+    void Erase(const K& key)
+    {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey << key;
+        std::pair<bool, CSerializeData>& op = mapOps[CSerializeData(ssKey.begin(), ssKey.end())];
+        op.first = true;
+        op.second.clear();
+    }
+
+    //! Find the pending operation on a serialized key
+    bool Lookup(const CSerializeData& key, bool& fErase, CSerializeData& value) const
+    {
+        OpMap::const_iterator it = mapOps.find(key);
+        if (it == mapOps.end())
+            return false;
+        fErase = it->second.first;
+        value = it->second.second;
+        return true;
+    }
+
+    //! Apply the operations of a newer batch on top of ours
+    void Merge(const CDBBatch& newer)
+    {
+        for (const auto& op : newer.mapOps)
+            mapOps[op.first] = op.second;
+    }
+
+    void Remove(const CSerializeData& key) { mapOps.erase(key); }
+
+    const OpMap& GetOps() const { return mapOps; }
+    size_t Size() const { return mapOps.size(); }
+    bool Empty() const { return mapOps.empty(); }
+    void Clear() { mapOps.clear(); }
+};
+
 
 class CDBEnv
 {
@@ -91,6 +160,38 @@ public:
             return NULL;
         return ptxn;
     }
+
+    /**
+     * Write-behind queue. While enabled (by the flush thread), CDB::WriteBehind
+     * only queues the update, and the queue of a file is committed in one
+     * transaction by CDB::FlushQueued. Reads see queued updates.
+     */
+    void SetWriteBehind(bool fEnable) { fWriteBehind = fEnable; }
+    bool IsWriteBehind() const { return fWriteBehind; }
+    void Queue(const std::string& strFile, const CDBBatch& batch);
+    bool ReadQueued(const std::string& strFile, const CSerializeData& key, bool& fErase, CSerializeData& value);
+    //! Drop the queued, not yet committing, update of a key
+    void Unqueue(const std::string& strFile, const CSerializeData& key);
+    //! Whether the queue of strFile is due: old or large enough, or nonempty if fAll
+    bool IsQueueDue(const std::string& strFile, bool fAll);
+    std::vector<std::string> GetQueuedFiles();
+
+private:
+    friend class CDB;
+
+    struct CWriteQueue {
+        CDBBatch batch;
+        //! Taken out of batch and being committed; still visible to reads
+        CDBBatch batchCommitting;
+        int64_t nOldestTime;
+        CWriteQueue() : nOldestTime(0) {}
+    };
+
+    std::atomic<bool> fWriteBehind;
+    CCriticalSection cs_queue;
+    //! Serializes commits of the queue, so they land in the order they were queued
+    CCriticalSection cs_queue_commit;
+    std::map<std::string, CWriteQueue> mapQueue;
 };
 
 extern CDBEnv bitdb;
@@ -103,9 +204,16 @@ protected:
     Db* pdb;
     std::string strFile;
     DbTxn* activeTxn;
+    //! When set, Write and Erase collect into it instead of touching the database
+    CDBBatch* pbatch;
     bool fReadOnly;
     bool fFlushOnClose;
 
+    //! Pending value of a serialized key in our batch or the write-behind queue
+    bool ReadPending(const CDataStream& ssKey, bool& fErase, CSerializeData& value);
+    //! Make sure a queued update of a serialized key can't land after a direct write of it
+    bool SupersedeQueued(const CDataStream& ssKey);
+
     explicit CDB(const std::string& strFilename, const char* pszMode = "r+", bool fFlushOnCloseIn=true);
     ~CDB() { Close(); }
 
@@ -128,6 +236,21 @@ protected:
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
+
+        bool fErase;
+        CSerializeData pending;
+        if (ReadPending(ssKey, fErase, pending)) {
+            if (fErase)
+                return false;
+            try {
+                CDataStream ssValue(pending, SER_DISK, CLIENT_VERSION);
+                ssValue >> value;
+            } catch (const std::exception&) {
+                return false;
+            }
+            return true;
+        }
+
         Dbt datKey(&ssKey[0], ssKey.size());
 
         // Read
@@ -160,10 +283,20 @@ protected:
         if (fReadOnly)
             assert(!"Write called on database in read-only mode");
 
+        if (pbatch && !fOverwrite && Exists(key))
+            return false;
+
         // Key
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
+        if (!SupersedeQueued(ssKey))
+            return false;
+
+        if (pbatch) {
+            pbatch->Write(key, value);
+            return true;
+        }
         Dbt datKey(&ssKey[0], ssKey.size());
 
         // Value
@@ -193,6 +326,13 @@ protected:
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
+        if (!SupersedeQueued(ssKey))
+            return false;
+
+        if (pbatch) {
+            pbatch->Erase(key);
+            return true;
+        }
         Dbt datKey(&ssKey[0], ssKey.size());
 
         // Erase
@@ -213,6 +353,12 @@ protected:
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
+
+        bool fErase;
+        CSerializeData pending;
+        if (ReadPending(ssKey, fErase, pending))
+            return !fErase;
+
         Dbt datKey(&ssKey[0], ssKey.size());
 
         // Exists
@@ -223,10 +369,44 @@ protected:
         return (ret == 0);
     }
 
+    /**
+     * Update that does not need to be durable right away: queued when write-behind
+     * is enabled, so that updates of the same key coalesce and are committed
+     * together. Callers that need durability call FlushQueued.
+     */
+    template <typename K, typename T>
+    bool WriteBehind(const K& key, const T& value)
+    {
+        if (pbatch || activeTxn || !bitdb.IsWriteBehind())
+            return Write(key, value);
+        if (!pdb)
+            return false;
+        CDBBatch batch;
+        batch.Write(key, value);
+        bitdb.Queue(strFile, batch);
+        return true;
+    }
+
+    template <typename K>
+    bool EraseBehind(const K& key)
+    {
+        if (pbatch || activeTxn || !bitdb.IsWriteBehind())
+            return Erase(key);
+        if (!pdb)
+            return false;
+        CDBBatch batch;
+        batch.Erase(key);
+        bitdb.Queue(strFile, batch);
+        return true;
+    }
+
+    //! Cursors only see the database, so commit what is queued for it first
     Dbc* GetCursor()
     {
         if (!pdb)
             return NULL;
+        if (!fReadOnly && !activeTxn && !pbatch)
+            CommitQueued(false);
         Dbc* pcursor = NULL;
         int ret = pdb->cursor(NULL, &pcursor, 0);
         if (ret != 0)
@@ -272,10 +452,13 @@ protected:
     }
 
 public:
+    //! Commits the write-behind queue first: it can't be committed on its own while the transaction holds locks
     bool TxnBegin()
     {
         if (!pdb || activeTxn)
             return false;
+        if (!fReadOnly && !pbatch && !CommitQueued(false))
+            return false;
         DbTxn* ptxn = bitdb.TxnBegin();
         if (!ptxn)
             return false;
@@ -301,6 +484,22 @@ public:
         return (ret == 0);
     }
 
+    /**
+     * Collect the following writes and erases in memory; BatchCommit writes
+     * them all in one transaction, BatchAbort drops them. Reads through this
+     * object see the batch.
+     */
+    bool BatchBegin();
+    bool BatchCommit(bool fSync = false);
+    void BatchAbort();
+
+    //! Write batch in one transaction (in the active one, if any). fSync waits for the log to hit the disk.
+    bool WriteBatch(const CDBBatch& batch, bool fSync = false);
+
+    //! Commit the write-behind queue of this file
+    bool CommitQueued(bool fSync);
+    static bool FlushQueued(const std::string& strFile, bool fSync = false);
+
     bool ReadVersion(int& nVersion)
     {
         nVersion = 0;
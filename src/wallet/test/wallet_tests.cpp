@@ -305,4 +305,72 @@ BOOST_AUTO_TEST_CASE(coin_selection_tests)
     empty_wallet();
 }
 
+/** Gives the tests the master key calls CWallet makes on its keystore */
+class CStakingTestKeyStore : public CCryptoKeyStore
+{
+public:
+    bool EncryptKeys(CKeyingMaterial& vMasterKeyIn) { return CCryptoKeyStore::EncryptKeys(vMasterKeyIn); }
+    bool Unlock(const CKeyingMaterial& vMasterKeyIn) { return CCryptoKeyStore::Unlock(vMasterKeyIn); }
+};
+
+BOOST_AUTO_TEST_CASE(staking_key_cache)
+{
+    CStakingTestKeyStore keystore;
+    CKey key, key2;
+    key.MakeNewKey(true);
+    key2.MakeNewKey(true);
+    BOOST_CHECK(keystore.AddKey(key));
+    BOOST_CHECK(keystore.AddKey(key2));
+    std::set<CKeyID> setKeys = {key.GetPubKey().GetID(), key2.GetPubKey().GetID(), CKeyID()};
+
+    // An unencrypted keystore has nothing to decrypt, so nothing is copied
+    keystore.SetStakingKeyCache(true);
+    keystore.UpdateStakingKeyCache(setKeys);
+    BOOST_CHECK_EQUAL(keystore.GetStakingKeyCacheSize(), 0U);
+
+    CKeyingMaterial vMasterKey(WALLET_CRYPTO_KEY_SIZE);
+    GetRandBytes(&vMasterKey[0], WALLET_CRYPTO_KEY_SIZE);
+    BOOST_CHECK(keystore.EncryptKeys(vMasterKey));
+    BOOST_CHECK(keystore.IsLocked());
+
+    // Opt-in only, and only while unlocked
+    keystore.SetStakingKeyCache(false);
+    BOOST_CHECK(keystore.Unlock(vMasterKey));
+    keystore.UpdateStakingKeyCache(setKeys);
+    BOOST_CHECK_EQUAL(keystore.GetStakingKeyCacheSize(), 0U);
+    keystore.SetStakingKeyCache(true);
+    BOOST_CHECK(keystore.Lock());
+    keystore.UpdateStakingKeyCache(setKeys);
+    BOOST_CHECK_EQUAL(keystore.GetStakingKeyCacheSize(), 0U);
+
+    // Keys we do not have are skipped
+    BOOST_CHECK(keystore.Unlock(vMasterKey));
+    keystore.UpdateStakingKeyCache(setKeys);
+    BOOST_CHECK_EQUAL(keystore.GetStakingKeyCacheSize(), 2U);
+    CKey keyOut;
+    CPubKey pubkeyOut;
+    BOOST_CHECK(keystore.GetKey(key.GetPubKey().GetID(), keyOut));
+    BOOST_CHECK(keyOut == key);
+    BOOST_CHECK(keystore.GetPubKey(key.GetPubKey().GetID(), pubkeyOut));
+    BOOST_CHECK(pubkeyOut == key.GetPubKey());
+
+    // The cache follows the stakeable set, other keys are still decrypted on demand
+    keystore.UpdateStakingKeyCache({key2.GetPubKey().GetID()});
+    BOOST_CHECK_EQUAL(keystore.GetStakingKeyCacheSize(), 1U);
+    BOOST_CHECK(keystore.GetKey(key.GetPubKey().GetID(), keyOut));
+    BOOST_CHECK(keyOut == key);
+
+    // Locking wipes the cache, cached keys are not handed out any more
+    BOOST_CHECK(keystore.Lock());
+    BOOST_CHECK_EQUAL(keystore.GetStakingKeyCacheSize(), 0U);
+    BOOST_CHECK(!keystore.GetKey(key2.GetPubKey().GetID(), keyOut));
+    BOOST_CHECK(keystore.GetPubKey(key2.GetPubKey().GetID(), pubkeyOut));
+
+    BOOST_CHECK(keystore.Unlock(vMasterKey));
+    keystore.UpdateStakingKeyCache(setKeys);
+    BOOST_CHECK_EQUAL(keystore.GetStakingKeyCacheSize(), 2U);
+    keystore.SetStakingKeyCache(false);
+    BOOST_CHECK_EQUAL(keystore.GetStakingKeyCacheSize(), 0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
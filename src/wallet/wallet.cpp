@@ -10,9 +10,10 @@
 #include "coincontrol.h"
 #include "init.h"
 #include "masternode-budget.h"
+#include "metrics.h"
 #include "script/sign.h"
 #include "spork.h"
-#include "swifttx.h"    // mapTxLockReq
+#include "swifttx.h"
 #include "util.h"
 #include "utilmoneystr.h"
 #include "zpivchain.h"
@@ -695,6 +696,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
         wtx.BindWallet(this);
         wtxOrdered.insert(std::make_pair(wtx.nOrderPos, TxPair(&wtx, (CAccountingEntry*)0)));
         AddToSpends(hash);
+        metrics::walletTransactions.Set(mapWallet.size());
     } else {
         LOCK(cs_wallet);
         // Inserts only if not already there, returns tx inserted or tx found
@@ -709,6 +711,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
             wtxOrdered.insert(std::make_pair(wtx.nOrderPos, TxPair(&wtx, (CAccountingEntry*)0)));
             wtx.nTimeSmart = ComputeTimeSmart(wtx);
             AddToSpends(hash);
+            metrics::walletTransactions.Set(mapWallet.size());
             for (const CTxIn& txin : wtx.vin) {
                 if (mapWallet.count(txin.prevout.hash)) {
                     CWalletTx& prevtx = mapWallet[txin.prevout.hash];
@@ -1636,7 +1639,7 @@ void CWalletTx::RelayWalletTransaction(std::string strCommand)
             LogPrintf("Relaying wtx %s\n", hash.ToString());
 
             if (strCommand == "ix") {
-                mapTxLockReq.insert(std::make_pair(hash, (CTransaction) * this));
+                txLockManager.AddLockRequest((CTransaction) * this);
                 CreateNewLock(((CTransaction) * this));
                 RelayTransactionLockReq((CTransaction) * this, true);
             } else {
@@ -2507,6 +2510,22 @@ bool CWallet::CreateCoinStake(
         return false;
     }
 
+    // Keep the keys that may have to sign a coinstake decrypted (-stakingkeycache)
+    if (IsStakingKeyCacheEnabled()) {
+        std::set<CKeyID> setStakingKeys;
+        for (const COutput& out : vCoins) {
+            std::vector<valtype> vSolutions;
+            txnouttype whichType;
+            if (!Solver(out.tx->vout[out.i].scriptPubKey, whichType, vSolutions))
+                continue;
+            if (whichType == TX_PUBKEY)
+                setStakingKeys.insert(CPubKey(vSolutions[0]).GetID());
+            else if (whichType == TX_PUBKEYHASH || whichType == TX_COLDSTAKE)
+                setStakingKeys.insert(CKeyID(uint160(vSolutions[0])));
+        }
+        UpdateStakingKeyCache(setStakingKeys);
+    }
+
     // Parse utxos into CPivStakes
     std::list<std::unique_ptr<CStakeInput> > listInputs;
     for (const COutput &out : vCoins) {
@@ -2665,6 +2684,13 @@ bool CWallet::CommitTransaction(CWalletTx& wtxNew, CReserveKey& reservekey, std:
             // otherwise just for transaction history.
             AddToWallet(wtxNew, false, pwalletdb);
 
+            // A sent transaction must be on disk before it is broadcast
+            if (fFileBacked && !pwalletdb->CommitQueued(true)) {
+                delete pwalletdb;
+                LogPrintf("CommitTransaction() : Error: Failed to write transaction to the wallet\n");
+                return false;
+            }
+
             // Notify that old coins are spent
             if (!wtxNew.HasZerocoinSpendInputs()) {
                 std::set<uint256> updated_hahes;
@@ -2873,13 +2899,17 @@ bool CWallet::NewKeyPool()
 {
     {
         LOCK(cs_wallet);
+        // The whole pool is replaced in one transaction
         CWalletDB walletdb(strWalletFile);
+        walletdb.BatchBegin();
         for (int64_t nIndex : setKeyPool)
             walletdb.ErasePool(nIndex);
         setKeyPool.clear();
 
-        if (IsLocked())
+        if (IsLocked()) {
+            walletdb.BatchCommit(true);
             return false;
+        }
 
         int64_t nKeys = std::max(GetArg("-keypool", 1000), (int64_t)0);
         for (int i = 0; i < nKeys; i++) {
@@ -2887,6 +2917,8 @@ bool CWallet::NewKeyPool()
             walletdb.WritePool(nIndex, CKeyPool(GenerateNewKey()));
             setKeyPool.insert(nIndex);
         }
+        if (!walletdb.BatchCommit(true))
+            throw std::runtime_error("NewKeyPool() : writing generated keys failed");
         LogPrintf("CWallet::NewKeyPool wrote %d new keys\n", nKeys);
     }
     return true;
@@ -2900,7 +2932,9 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
         if (IsLocked())
             return false;
 
+        // The new pool entries are committed together, once all keys are generated
         CWalletDB walletdb(strWalletFile);
+        walletdb.BatchBegin();
 
         // Top up key pool
         unsigned int nTargetSize;
@@ -2921,6 +2955,8 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
             std::string strMsg = strprintf(_("Loading wallet... (%3.2f %%)"), dProgress);
             uiInterface.InitMessage(strMsg);
         }
+        if (!walletdb.BatchCommit(true))
+            throw std::runtime_error("TopUpKeyPool() : writing generated keys failed");
     }
     return true;
 }
@@ -3738,26 +3774,14 @@ int CMerkleTx::GetTransactionLockSignatures() const
     if (!sporkManager.IsSporkActive(SPORK_2_SWIFTTX)) return -3;
     if (!fEnableSwiftTX) return -1;
 
-    //compile consessus vote
-    std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(GetHash());
-    if (i != mapTxLocks.end()) {
-        return (*i).second.CountSignatures();
-    }
-
-    return -1;
+    return txLockManager.GetSignatures(GetHash());
 }
 
 bool CMerkleTx::IsTransactionLockTimedOut() const
 {
     if (!fEnableSwiftTX) return 0;
 
-    //compile consessus vote
-    std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(GetHash());
-    if (i != mapTxLocks.end()) {
-        return GetTime() > (*i).second.nTimeout;
-    }
-
-    return false;
+    return txLockManager.IsLockTimedOut(GetHash());
 }
 
 std::string CWallet::GetUniqueWalletBackupName() const
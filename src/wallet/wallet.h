@@ -62,6 +62,8 @@ static const CAmount nHighTransactionMaxFeeWarning = 100 * nHighTransactionFeeWa
 static const unsigned int MAX_FREE_TRANSACTION_CREATE_SIZE = 1000;
 //! -custombackupthreshold default
 static const int DEFAULT_CUSTOMBACKUPTHRESHOLD = 1;
+//! -stakingkeycache default
+static const bool DEFAULT_STAKING_KEY_CACHE = false;
 
 class CAccountingEntry;
 class CCoinControl;
@@ -19,8 +19,10 @@
 
 #include <boost/filesystem.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <atomic>
 #include <boost/thread.hpp>
 #include <fstream>
+#include <memory>
 
 
 static uint64_t nAccountingEntryNumber = 0;
@@ -58,13 +60,13 @@ bool CWalletDB::ErasePurpose(const std::string& strPurpose)
 bool CWalletDB::WriteTx(uint256 hash, const CWalletTx& wtx)
 {
     nWalletDBUpdated++;
-    return Write(std::make_pair(std::string("tx"), hash), wtx);
+    return WriteBehind(std::make_pair(std::string("tx"), hash), wtx);
 }
 
 bool CWalletDB::EraseTx(uint256 hash)
 {
     nWalletDBUpdated++;
-    return Erase(std::make_pair(std::string("tx"), hash));
+    return EraseBehind(std::make_pair(std::string("tx"), hash));
 }
 
 bool CWalletDB::WriteKey(const CPubKey& vchPubKey, const CPrivKey& vchPrivKey, const CKeyMetadata& keyMeta)
@@ -143,8 +145,13 @@ bool CWalletDB::EraseMultiSig(const CScript& dest)
 bool CWalletDB::WriteBestBlock(const CBlockLocator& locator)
 {
     nWalletDBUpdated++;
-    Write(std::string("bestblock"), CBlockLocator()); // Write empty block locator so versions that require a merkle branch automatically rescan
-    return Write(std::string("bestblock_nomerkle"), locator);
+    // The locator must never reach the disk ahead of the wallet transactions it
+    // covers. Queue it behind them, so they are committed in one transaction; a
+    // write that bypasses the queue commits the queue first.
+    if ((pbatch || activeTxn) && !CommitQueued(false))
+        return false;
+    WriteBehind(std::string("bestblock"), CBlockLocator()); // Write empty block locator so versions that require a merkle branch automatically rescan
+    return WriteBehind(std::string("bestblock_nomerkle"), locator);
 }
 
 bool CWalletDB::ReadBestBlock(CBlockLocator& locator)
@@ -156,7 +163,7 @@ bool CWalletDB::ReadBestBlock(CBlockLocator& locator)
 bool CWalletDB::WriteOrderPosNext(int64_t nOrderPosNext)
 {
     nWalletDBUpdated++;
-    return Write(std::string("orderposnext"), nOrderPosNext);
+    return WriteBehind(std::string("orderposnext"), nOrderPosNext);
 }
 
 // presstab HyperStake
@@ -411,6 +418,96 @@ public:
     }
 };
 
+/** Decode a "tx" record, whose type was already read from ssKey */
+static bool ReadWalletTx(CDataStream& ssKey, CDataStream& ssValue, CWalletTx& wtx, bool& fUpgraded, std::string& strErr)
+{
+    uint256 hash;
+    ssKey >> hash;
+    ssValue >> wtx;
+    if (wtx.GetHash() != hash)
+        return false;
+
+    // Undo serialize changes in 31600
+    fUpgraded = false;
+    if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703) {
+        if (!ssValue.empty()) {
+            char fTmp;
+            char fUnused;
+            ssValue >> fTmp >> fUnused >> wtx.strFromAccount;
+            strErr = strprintf("LoadWallet() upgrading tx ver=%d %d '%s' %s",
+                wtx.fTimeReceivedIsTxTime, fTmp, wtx.strFromAccount, hash.ToString());
+            wtx.fTimeReceivedIsTxTime = fTmp;
+        } else {
+            strErr = strprintf("LoadWallet() repairing tx ver=%d %s", wtx.fTimeReceivedIsTxTime, hash.ToString());
+            wtx.fTimeReceivedIsTxTime = 0;
+        }
+        fUpgraded = true;
+    }
+    return true;
+}
+
+static void LoadWalletTx(CWallet* pwallet, const CWalletTx& wtx, bool fUpgraded, CWalletScanState& wss)
+{
+    if (fUpgraded)
+        wss.vWalletUpgrade.push_back(wtx.GetHash());
+    if (wtx.nOrderPos == -1)
+        wss.fAnyUnordered = true;
+    pwallet->AddToWallet(wtx, true, nullptr);
+}
+
+/** Decode and check a "key" or "wkey" record, whose type was already read from ssKey */
+static bool ReadWalletKey(const std::string& strType, CDataStream& ssKey, CDataStream& ssValue, CPubKey& vchPubKey, CKey& key, std::string& strErr)
+{
+    ssKey >> vchPubKey;
+    if (!vchPubKey.IsValid()) {
+        strErr = "Error reading wallet database: CPubKey corrupt";
+        return false;
+    }
+    CPrivKey pkey;
+    uint256 hash = 0;
+
+    if (strType == "key") {
+        ssValue >> pkey;
+    } else {
+        CWalletKey wkey;
+        ssValue >> wkey;
+        pkey = wkey.vchPrivKey;
+    }
+
+    // Old wallets store keys as "key" [pubkey] => [privkey]
+    // ... which was slow for wallets with lots of keys, because the public key is re-derived from the private key
+    // using EC operations as a checksum.
+    // Newer wallets store keys as "key"[pubkey] => [privkey][hash(pubkey,privkey)], which is much faster while
+    // remaining backwards-compatible.
+    try {
+        ssValue >> hash;
+    } catch (...) {
+    }
+
+    bool fSkipCheck = false;
+
+    if (hash != 0) {
+        // hash pubkey/privkey to accelerate wallet load
+        std::vector<unsigned char> vchKey;
+        vchKey.reserve(vchPubKey.size() + pkey.size());
+        vchKey.insert(vchKey.end(), vchPubKey.begin(), vchPubKey.end());
+        vchKey.insert(vchKey.end(), pkey.begin(), pkey.end());
+
+        if (Hash(vchKey.begin(), vchKey.end()) != hash) {
+            strErr = "Error reading wallet database: CPubKey/CPrivKey corrupt";
+            return false;
+        }
+
+        fSkipCheck = true;
+    }
+
+    if (!key.Load(pkey, vchPubKey, fSkipCheck)) {
+        strErr = "Error reading wallet database: CPrivKey corrupt";
+        return false;
+    }
+    return true;
+}
+
 bool ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue, CWalletScanState& wss, std::string& strType, std::string& strErr)
 {
     try {
@@ -427,33 +524,11 @@ bool ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue, CW
             ssKey >> strAddress;
             ssValue >> pwallet->mapAddressBook[CBitcoinAddress(strAddress).Get()].purpose;
         } else if (strType == "tx") {
-            uint256 hash;
-            ssKey >> hash;
             CWalletTx wtx;
-            ssValue >> wtx;
-            if (wtx.GetHash() != hash)
+            bool fUpgraded;
+            if (!ReadWalletTx(ssKey, ssValue, wtx, fUpgraded, strErr))
                 return false;
-
-            // Undo serialize changes in 31600
-            if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703) {
-                if (!ssValue.empty()) {
-                    char fTmp;
-                    char fUnused;
-                    ssValue >> fTmp >> fUnused >> wtx.strFromAccount;
-                    strErr = strprintf("LoadWallet() upgrading tx ver=%d %d '%s' %s",
-                        wtx.fTimeReceivedIsTxTime, fTmp, wtx.strFromAccount, hash.ToString());
-                    wtx.fTimeReceivedIsTxTime = fTmp;
-                } else {
-                    strErr = strprintf("LoadWallet() repairing tx ver=%d %s", wtx.fTimeReceivedIsTxTime, hash.ToString());
-                    wtx.fTimeReceivedIsTxTime = 0;
-                }
-                wss.vWalletUpgrade.push_back(hash);
-            }
-
-            if (wtx.nOrderPos == -1)
-                wss.fAnyUnordered = true;
-
-            pwallet->AddToWallet(wtx, true, nullptr);
+            LoadWalletTx(pwallet, wtx, fUpgraded, wss);
         } else if (strType == "acentry") {
             std::string strAccount;
             ssKey >> strAccount;
@@ -491,56 +566,12 @@ bool ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue, CW
             // so set the wallet birthday to the beginning of time.
             pwallet->nTimeFirstKey = 1;
         } else if (strType == "key" || strType == "wkey") {
+            if (strType == "key")
+                wss.nKeys++;
             CPubKey vchPubKey;
-            ssKey >> vchPubKey;
-            if (!vchPubKey.IsValid()) {
-                strErr = "Error reading wallet database: CPubKey corrupt";
-                return false;
-            }
             CKey key;
-            CPrivKey pkey;
-            uint256 hash = 0;
-
-            if (strType == "key") {
-                wss.nKeys++;
-                ssValue >> pkey;
-            } else {
-                CWalletKey wkey;
-                ssValue >> wkey;
-                pkey = wkey.vchPrivKey;
-            }
-
-            // Old wallets store keys as "key" [pubkey] => [privkey]
-            // ... which was slow for wallets with lots of keys, because the public key is re-derived from the private key
-            // using EC operations as a checksum.
-            // Newer wallets store keys as "key"[pubkey] => [privkey][hash(pubkey,privkey)], which is much faster while
-            // remaining backwards-compatible.
-            try {
-                ssValue >> hash;
-            } catch (...) {
-            }
-
-            bool fSkipCheck = false;
-
-            if (hash != 0) {
-                // hash pubkey/privkey to accelerate wallet load
-                std::vector<unsigned char> vchKey;
-                vchKey.reserve(vchPubKey.size() + pkey.size());
-                vchKey.insert(vchKey.end(), vchPubKey.begin(), vchPubKey.end());
-                vchKey.insert(vchKey.end(), pkey.begin(), pkey.end());
-
-                if (Hash(vchKey.begin(), vchKey.end()) != hash) {
-                    strErr = "Error reading wallet database: CPubKey/CPrivKey corrupt";
-                    return false;
-                }
-
-                fSkipCheck = true;
-            }
-
-            if (!key.Load(pkey, vchPubKey, fSkipCheck)) {
-                strErr = "Error reading wallet database: CPrivKey corrupt";
+            if (!ReadWalletKey(strType, ssKey, ssValue, vchPubKey, key, strErr))
                 return false;
-            }
             if (!pwallet->LoadKey(key, vchPubKey)) {
                 strErr = "Error reading wallet database: LoadKey failed";
                 return false;
@@ -664,6 +695,102 @@ bool ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue, CW
     return true;
 }
 
+/** A raw wallet record, and the result of decoding it when that was done on a loader thread */
+struct CWalletRecord {
+    CDataStream ssKey;
+    CDataStream ssValue;
+    //! Set for "tx", "key" and "wkey" records, the ones worth decoding in parallel
+    bool fDecoded;
+    bool fOk;
+    std::string strType;
+    std::string strErr;
+    std::unique_ptr<CWalletTx> pwtx;
+    bool fUpgraded;
+    CPubKey vchPubKey;
+    CKey key;
+
+    CWalletRecord() : ssKey(SER_DISK, CLIENT_VERSION), ssValue(SER_DISK, CLIENT_VERSION), fDecoded(false), fOk(false), fUpgraded(false) {}
+};
+
+static void DecodeWalletRecord(CWalletRecord& record)
+{
+    try {
+        if (record.strType == "tx") {
+            record.pwtx.reset(new CWalletTx());
+            record.fOk = ReadWalletTx(record.ssKey, record.ssValue, *record.pwtx, record.fUpgraded, record.strErr);
+        } else {
+            record.fOk = ReadWalletKey(record.strType, record.ssKey, record.ssValue, record.vchPubKey, record.key, record.strErr);
+        }
+    } catch (...) {
+        record.fOk = false;
+    }
+    // Done with the raw data
+    record.ssKey.clear();
+    record.ssValue.clear();
+}
+
+/**
+ * Deserialize the transactions and check the keys of a wallet on a few threads:
+ * that is most of the work of loading a large wallet, and needs no wallet state.
+ */
+static void DecodeWalletRecords(std::vector<CWalletRecord>& vRecords)
+{
+    std::vector<CWalletRecord*> vToDecode;
+    for (CWalletRecord& record : vRecords) {
+        try {
+            CDataStream ssKey(record.ssKey);
+            ssKey >> record.strType;
+        } catch (...) {
+            // Left to ReadKeyValue, which reports it
+            continue;
+        }
+        if (record.strType != "tx" && record.strType != "key" && record.strType != "wkey")
+            continue;
+        record.ssKey.ignore(GetSerializeSize(record.strType, SER_DISK, CLIENT_VERSION));
+        record.fDecoded = true;
+        vToDecode.push_back(&record);
+    }
+
+    int nThreads = std::min((int)boost::thread::hardware_concurrency(), MAX_WALLET_LOAD_THREADS);
+    if (vToDecode.size() < WALLET_LOAD_MIN_RECORDS_PER_THREAD * 2 || nThreads < 2) {
+        for (CWalletRecord* precord : vToDecode)
+            DecodeWalletRecord(*precord);
+        return;
+    }
+
+    nThreads = std::min(nThreads, (int)(vToDecode.size() / WALLET_LOAD_MIN_RECORDS_PER_THREAD));
+    std::atomic<size_t> nNext(0);
+    boost::thread_group threads;
+    for (int i = 0; i < nThreads; i++) {
+        threads.create_thread([&vToDecode, &nNext]() {
+            // Chunks keep the counter cold, records vary too much in size for a static split
+            static const size_t CHUNK = 64;
+            for (size_t nBegin = nNext.fetch_add(CHUNK); nBegin < vToDecode.size(); nBegin = nNext.fetch_add(CHUNK))
+                for (size_t n = nBegin; n < std::min(nBegin + CHUNK, vToDecode.size()); n++)
+                    DecodeWalletRecord(*vToDecode[n]);
+        });
+    }
+    threads.join_all();
+    LogPrint("db", "%s : decoded %u records on %d threads\n", __func__, vToDecode.size(), nThreads);
+}
+
+/** The part of ReadKeyValue that changes the wallet, for a record decoded by DecodeWalletRecord */
+static bool ApplyWalletRecord(CWallet* pwallet, CWalletRecord& record, CWalletScanState& wss, std::string& strErr)
+{
+    if (record.strType == "tx") {
+        LoadWalletTx(pwallet, *record.pwtx, record.fUpgraded, wss);
+        record.pwtx.reset();
+        return true;
+    }
+    if (record.strType == "key")
+        wss.nKeys++;
+    if (!pwallet->LoadKey(record.key, record.vchPubKey)) {
+        strErr = "Error reading wallet database: LoadKey failed";
+        return false;
+    }
+    return true;
+}
+
 static bool IsKeyType(std::string strType)
 {
     return (strType == "key" || strType == "wkey" ||
@@ -692,21 +819,40 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
             return DB_CORRUPT;
         }
 
+        // Read all records first, the database is not safe to share with the decoding threads
+        int64_t nStart = GetTimeMillis();
+        std::vector<CWalletRecord> vRecords;
         while (true) {
             // Read next record
-            CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-            CDataStream ssValue(SER_DISK, CLIENT_VERSION);
-            int ret = ReadAtCursor(pcursor, ssKey, ssValue);
-            if (ret == DB_NOTFOUND)
+            vRecords.emplace_back();
+            CWalletRecord& record = vRecords.back();
+            int ret = ReadAtCursor(pcursor, record.ssKey, record.ssValue);
+            if (ret == DB_NOTFOUND) {
+                vRecords.pop_back();
                 break;
-            else if (ret != 0) {
+            } else if (ret != 0) {
+                pcursor->close();
                 LogPrintf("Error reading next record from wallet database\n");
                 return DB_CORRUPT;
             }
+        }
+        pcursor->close();
 
+        DecodeWalletRecords(vRecords);
+
+        // Apply them in database order, as before
+        for (CWalletRecord& record : vRecords) {
             // Try to be tolerant of single corrupt records:
             std::string strType, strErr;
-            if (!ReadKeyValue(pwallet, ssKey, ssValue, wss, strType, strErr)) {
+            bool fOk;
+            if (record.fDecoded) {
+                strType = record.strType;
+                strErr = record.strErr;
+                fOk = record.fOk && ApplyWalletRecord(pwallet, record, wss, strErr);
+            } else {
+                fOk = ReadKeyValue(pwallet, record.ssKey, record.ssValue, wss, strType, strErr);
+            }
+            if (!fOk) {
                 // losing keys is considered a catastrophic error, anything else
                 // we assume the user can live with:
                 if (IsKeyType(strType) || strType == "defaultkey")
@@ -722,7 +868,7 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
             if (!strErr.empty())
                 LogPrintf("%s\n", strErr);
         }
-        pcursor->close();
+        LogPrintf("Loaded %u wallet records in %dms\n", vRecords.size(), GetTimeMillis() - nStart);
     } catch (const boost::thread_interrupted&) {
         throw;
     } catch (...) {
@@ -856,12 +1002,18 @@ void ThreadFlushWalletDB(const std::string& strFile)
     if (!GetBoolArg("-flushwallet", true))
         return;
 
+    // Queued updates are committed from here from now on, and at shutdown by bitdb.Flush
+    bitdb.SetWriteBehind(true);
+
     unsigned int nLastSeen = nWalletDBUpdated;
     unsigned int nLastFlushed = nWalletDBUpdated;
     int64_t nLastWalletUpdate = GetTime();
     while (true) {
         MilliSleep(500);
 
+        if (bitdb.IsQueueDue(strFile, false) && !CDB::FlushQueued(strFile))
+            LogPrintf("%s : Failed to commit queued wallet updates, retrying\n", __func__);
+
         if (nLastSeen != nWalletDBUpdated) {
             nLastSeen = nWalletDBUpdated;
             nLastWalletUpdate = GetTime();
@@ -929,6 +1081,11 @@ bool BackupWallet(const CWallet& wallet, const boost::filesystem::path& strDest,
         }
     }
 
+    if (!CDB::FlushQueued(wallet.strWalletFile, true)) {
+        NotifyBacked(wallet, false, "Failed to commit queued wallet updates before the backup\n");
+        return false;
+    }
+
     while (true) {
         {
             LOCK(bitdb.cs_db);
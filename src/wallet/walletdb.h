@@ -37,6 +37,11 @@ class CZerocoinSpend;
 class uint160;
 class uint256;
 
+/** Maximum number of threads decoding wallet records at load */
+static const int MAX_WALLET_LOAD_THREADS = 8;
+/** Fewer transaction and key records than this per thread are decoded on the loading thread */
+static const size_t WALLET_LOAD_MIN_RECORDS_PER_THREAD = 500;
+
 /** Error statuses for the wallet database */
 enum DBErrors {
     DB_LOAD_OK,
@@ -26,12 +26,16 @@ private:
     uint32_t nCountLastGenerated;
     uint32_t nCountLastRemoved;
 
+    //! count -> pubcoin hash, so generation can skip existing counts without scanning the pool
+    std::map<uint32_t, uint256> mapCounts;
+
 public:
     CMintPool();
     explicit CMintPool(uint32_t nCount);
     void Add(const CBigNum& bnValue, const uint32_t& nCount);
     void Add(const std::pair<uint256, uint32_t>& pMint, bool fVerbose = false);
     bool Has(const CBigNum& bnValue);
+    bool HasCount(const uint32_t& nCount) const { return mapCounts.count(nCount) > 0; }
     void Remove(const CBigNum& bnValue);
     void Remove(const uint256& hashPubcoin);
     std::pair<uint256, uint32_t> Get(const CBigNum& bnValue);
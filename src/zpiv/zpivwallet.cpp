@@ -11,6 +11,9 @@
 #include "deterministicmint.h"
 #include "zpivchain.h"
 
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
 
 CzYODAWallet::CzYODAWallet(std::string strWalletFile)
 {
@@ -102,6 +105,39 @@ void CzYODAWallet::AddToMintPool(const std::pair<uint256, uint32_t>& pMint, bool
     mintPool.Add(pMint, fVerbose);
 }
 
+void CzYODAWallet::DeriveMintValuesThread(const std::vector<uint32_t>& vCounts, std::vector<CBigNum>& vValues, size_t nFirst, size_t nStride)
+{
+    for (size_t i = nFirst; i < vCounts.size(); i += nStride) {
+        if (ShutdownRequested())
+            return;
+
+        CBigNum bnSerial;
+        CBigNum bnRandomness;
+        CKey key;
+        SeedToZPIV(GetZerocoinSeed(vCounts[i]), vValues[i], bnSerial, bnRandomness, key);
+    }
+}
+
+// Each count is derived independently from the master seed, and the prime search in SeedToZPIV
+// dominates, so spread the counts over a few threads. Every thread owns a fixed stride of vValues.
+void CzYODAWallet::DeriveMintValues(const std::vector<uint32_t>& vCounts, std::vector<CBigNum>& vValues, int nThreads)
+{
+    vValues.assign(vCounts.size(), CBigNum());
+    nThreads = std::min(std::max(nThreads, 1), (int)vCounts.size());
+    if (nThreads < 2) {
+        DeriveMintValuesThread(vCounts, vValues, 0, 1);
+        return;
+    }
+
+    // Make sure the shared zerocoin params are initialized before any worker touches them
+    Params().Zerocoin_Params(false);
+    boost::thread_group deriveThreads;
+    for (int t = 0; t < nThreads; t++)
+        deriveThreads.create_thread(boost::bind(&CzYODAWallet::DeriveMintValuesThread, this, boost::cref(vCounts), boost::ref(vValues), t, nThreads));
+    boost::this_thread::disable_interruption di;
+    deriveThreads.join_all();
+}
+
 //Add the next 20 mints to the mint pool
 void CzYODAWallet::GenerateMintPool(uint32_t nCountStart, uint32_t nCountEnd)
 {
@@ -119,37 +155,31 @@ void CzYODAWallet::GenerateMintPool(uint32_t nCountStart, uint32_t nCountEnd)
     if (nCountEnd > 0)
         nStop = std::max(n, n + nCountEnd);
 
-    bool fFound;
-
-    uint256 hashSeed = Hash(seedMaster.begin(), seedMaster.end());
-    LogPrintf("%s : n=%d nStop=%d\n", __func__, n, nStop - 1);
+    // Prevent unnecessary repeated minted
+    std::vector<uint32_t> vCounts;
     for (uint32_t i = n; i < nStop; ++i) {
-        if (ShutdownRequested())
-            return;
-
-        fFound = false;
+        if (!mintPool.HasCount(i))
+            vCounts.push_back(i);
+    }
 
-        // Prevent unnecessary repeated minted
-        for (auto& pair : mintPool) {
-            if(pair.second == i) {
-                fFound = true;
-                break;
-            }
-        }
+    LogPrintf("%s : n=%d nStop=%d missing=%d\n", __func__, n, nStop - 1, vCounts.size());
+    if (vCounts.empty())
+        return;
 
-        if(fFound)
-            continue;
+    std::vector<CBigNum> vValues;
+    DeriveMintValues(vCounts, vValues, std::min((int)boost::thread::hardware_concurrency(), MAX_MINTPOOL_THREADS));
 
-        uint512 seedZerocoin = GetZerocoinSeed(i);
-        CBigNum bnValue;
-        CBigNum bnSerial;
-        CBigNum bnRandomness;
-        CKey key;
-        SeedToZPIV(seedZerocoin, bnValue, bnSerial, bnRandomness, key);
+    // Add the results in count order, all through one wallet db handle
+    uint256 hashSeed = Hash(seedMaster.begin(), seedMaster.end());
+    CWalletDB walletdb(strWalletFile);
+    for (size_t i = 0; i < vCounts.size(); i++) {
+        // Left empty when shutdown interrupted the workers
+        if (vValues[i] == 0)
+            return;
 
-        mintPool.Add(bnValue, i);
-        CWalletDB(strWalletFile).WriteMintPoolPair(hashSeed, GetPubCoinHash(bnValue), i);
-        LogPrintf("%s : %s count=%d\n", __func__, bnValue.GetHex().substr(0, 6), i);
+        mintPool.Add(vValues[i], vCounts[i]);
+        walletdb.WriteMintPoolPair(hashSeed, GetPubCoinHash(vValues[i]), vCounts[i]);
+        LogPrintf("%s : %s count=%d\n", __func__, vValues[i].GetHex().substr(0, 6), vCounts[i]);
     }
 }
 
@@ -193,6 +223,20 @@ void CzYODAWallet::SyncWithChain(bool fGenerateMintPool)
 
         std::set<uint256> setChecked;
         std::list<std::pair<uint256,uint32_t> > listMints = mintPool.List();
+
+        // Resolve the whole pool against the zerocoin db in one pass instead of one read per mint
+        std::vector<uint256> vHashPubcoin;
+        vHashPubcoin.reserve(listMints.size());
+        for (const std::pair<uint256, uint32_t>& pMint : listMints)
+            vHashPubcoin.push_back(pMint.first);
+        std::map<uint256, uint256> mapMintTx;
+        if (!zerocoinDB->ReadCoinMints(vHashPubcoin, mapMintTx)) {
+            LogPrintf("%s : failed to read mints from the zerocoin db\n", __func__);
+            return;
+        }
+
+        // A mint transaction usually carries several of our mints, only fetch it once
+        std::map<uint256, std::pair<CTransaction, uint256> > mapTxCache;
         for (std::pair<uint256, uint32_t> pMint : listMints) {
             LOCK(cs_main);
             if (setChecked.count(pMint.first))
@@ -207,21 +251,27 @@ void CzYODAWallet::SyncWithChain(bool fGenerateMintPool)
                 continue;
             }
 
-            uint256 txHash;
-            CZerocoinMint mint;
-            if (zerocoinDB->ReadCoinMint(pMint.first, txHash)) {
+            auto mi = mapMintTx.find(pMint.first);
+            if (mi != mapMintTx.end()) {
+                const uint256& txHash = mi->second;
                 //this mint has already occurred on the chain, increment counter's state to reflect this
                 LogPrintf("%s : Found wallet coin mint=%s count=%d tx=%s\n", __func__, pMint.first.GetHex(), pMint.second, txHash.GetHex());
                 found = true;
 
-                uint256 hashBlock;
-                CTransaction tx;
-                if (!GetTransaction(txHash, tx, hashBlock, true)) {
-                    LogPrintf("%s : failed to get transaction for mint %s!\n", __func__, pMint.first.GetHex());
-                    found = false;
-                    nLastCountUsed = std::max(pMint.second, nLastCountUsed);
-                    continue;
+                auto ti = mapTxCache.find(txHash);
+                if (ti == mapTxCache.end()) {
+                    uint256 hashBlockRead;
+                    CTransaction txRead;
+                    if (!GetTransaction(txHash, txRead, hashBlockRead, true)) {
+                        LogPrintf("%s : failed to get transaction for mint %s!\n", __func__, pMint.first.GetHex());
+                        found = false;
+                        nLastCountUsed = std::max(pMint.second, nLastCountUsed);
+                        continue;
+                    }
+                    ti = mapTxCache.insert(std::make_pair(txHash, std::make_pair(txRead, hashBlockRead))).first;
                 }
+                const CTransaction& tx = ti->second.first;
+                const uint256& hashBlock = ti->second.second;
 
                 //Find the denomination
                 libzerocoin::CoinDenomination denomination = libzerocoin::CoinDenomination::ZQ_ERROR;
@@ -13,6 +13,9 @@
 
 class CDeterministicMint;
 
+/** Maximum number of threads deriving mint pool values */
+static const int MAX_MINTPOOL_THREADS = 8;
+
 class CzYODAWallet
 {
 private:
@@ -41,9 +44,11 @@ public:
     void Lock();
     void SeedToZPIV(const uint512& seed, CBigNum& bnValue, CBigNum& bnSerial, CBigNum& bnRandomness, CKey& key);
     bool CheckSeed(const CDeterministicMint& dMint);
+    void DeriveMintValues(const std::vector<uint32_t>& vCounts, std::vector<CBigNum>& vValues, int nThreads);
 
 private:
     uint512 GetZerocoinSeed(uint32_t n);
+    void DeriveMintValuesThread(const std::vector<uint32_t>& vCounts, std::vector<CBigNum>& vValues, size_t nFirst, size_t nStride);
 };
 
 #endif //YODA_ZPIVWALLET_H
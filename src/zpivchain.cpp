@@ -222,30 +222,53 @@ bool IsPubcoinInBlockchain(const uint256& hashPubcoin, uint256& txid)
     return zerocoinDB->ReadCoinMint(hashPubcoin, txid);
 }
 
-bool IsSerialInBlockchain(const CBigNum& bnSerial, int& nHeightTx)
+/**
+ * Whether the recorded spend of a serial is in the active chain. Spend records hold their
+ * block, so this is a lookup in memory; only records written before that fall back to the
+ * transaction index. The spending transaction is read only when ptx is set.
+ */
+static bool IsSpendInChain(const uint256& hashSerial, int& nHeightTx, uint256& txidSpend, CTransaction* ptx)
 {
-    uint256 txHash = 0;
+    CZerocoinSpendRecord record;
     // if not in zerocoinDB then its not in the blockchain
-    if (!zerocoinDB->ReadCoinSpend(bnSerial, txHash))
+    if (!zerocoinDB->ReadCoinSpend(hashSerial, record))
         return false;
+    txidSpend = record.txid;
+
+    if (record.HasBlock()) {
+        CBlockIndex* pindex = chainActive[record.nHeight];
+        if (!pindex || pindex->GetBlockHash() != record.hashBlock)
+            return false;
+        nHeightTx = record.nHeight;
+        uint256 hashBlock;
+        return !ptx || GetTransaction(txidSpend, *ptx, hashBlock, true);
+    }
+
+    CTransaction tx;
+    uint256 hashBlock;
+    if (!GetTransaction(txidSpend, ptx ? *ptx : tx, hashBlock, true) || !IsBlockHashInChain(hashBlock))
+        return false;
+    nHeightTx = mapBlockIndex.at(hashBlock)->nHeight;
+    zerocoinDB->SetCoinSpendBlock(hashSerial, hashBlock, nHeightTx);
+    return true;
+}
 
-    return IsTransactionInChain(txHash, nHeightTx);
+bool IsSerialInBlockchain(const CBigNum& bnSerial, int& nHeightTx)
+{
+    uint256 txidSpend;
+    return IsSpendInChain(GetSerialHash(bnSerial), nHeightTx, txidSpend, nullptr);
 }
 
 bool IsSerialInBlockchain(const uint256& hashSerial, int& nHeightTx, uint256& txidSpend)
 {
-    CTransaction tx;
-    return IsSerialInBlockchain(hashSerial, nHeightTx, txidSpend, tx);
+    txidSpend = 0;
+    return IsSpendInChain(hashSerial, nHeightTx, txidSpend, nullptr);
 }
 
 bool IsSerialInBlockchain(const uint256& hashSerial, int& nHeightTx, uint256& txidSpend, CTransaction& tx)
 {
     txidSpend = 0;
-    // if not in zerocoinDB then its not in the blockchain
-    if (!zerocoinDB->ReadCoinSpend(hashSerial, txidSpend))
-        return false;
-
-    return IsTransactionInChain(txidSpend, nHeightTx, tx);
+    return IsSpendInChain(hashSerial, nHeightTx, txidSpend, &tx);
 }
 
 std::string ReindexZerocoinDB()
@@ -314,11 +337,15 @@ std::string ReindexZerocoinDB()
             }
         }
 
+        // Spend records carry their block, so they are written per block, without syncing
+        if (!vSpendInfo.empty() && !zerocoinDB->WriteCoinSpendBatch(vSpendInfo, pindex->GetBlockHash(), pindex->nHeight, false))
+            return _("Error writing zerocoinDB to disk");
+        vSpendInfo.clear();
+
         // Flush the zerocoinDB to disk every 100 blocks
         if (pindex->nHeight % 100 == 0) {
-            if ((!vSpendInfo.empty() && !zerocoinDB->WriteCoinSpendBatch(vSpendInfo)) || (!vMintInfo.empty() && !zerocoinDB->WriteCoinMintBatch(vMintInfo)))
+            if (!vMintInfo.empty() && !zerocoinDB->WriteCoinMintBatch(vMintInfo))
                 return _("Error writing zerocoinDB to disk");
-            vSpendInfo.clear();
             vMintInfo.clear();
         }
 
@@ -327,7 +354,9 @@ std::string ReindexZerocoinDB()
     uiInterface.ShowProgress("", 100);
 
     // Final flush to disk in case any remaining information exists
-    if ((!vSpendInfo.empty() && !zerocoinDB->WriteCoinSpendBatch(vSpendInfo)) || (!vMintInfo.empty() && !zerocoinDB->WriteCoinMintBatch(vMintInfo)))
+    if (!vMintInfo.empty() && !zerocoinDB->WriteCoinMintBatch(vMintInfo))
+        return _("Error writing zerocoinDB to disk");
+    if (!zerocoinDB->Sync())
         return _("Error writing zerocoinDB to disk");
 
     uiInterface.ShowProgress("", 100);